@@ -0,0 +1,107 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "SensorDebug"
+
+#include <stdlib.h>
+#include <time.h>
+#include <cutils/log.h>
+#include <cutils/properties.h>
+
+#if defined(__BIONIC__)
+#define _REALLY_INCLUDE_SYS__SYSTEM_PROPERTIES_H_
+#include <sys/_system_properties.h>
+#endif
+
+#include "sensor_log.h"
+#include "sensor_trace.h"
+#include "debug_config.h"
+
+struct sensor_debug_config g_sensor_debug;
+
+/* written by the poll thread only */
+static uint32_t seen_serial;
+static int64_t reload_ns;
+
+/* bumped by every property change, a single load */
+static inline uint32_t property_serial(void)
+{
+#if defined(__BIONIC__)
+    return __system_property_area_serial();
+#else
+    return 0;
+#endif
+}
+
+static int64_t debug_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int read_int(const char *name)
+{
+    char propbuf[PROPERTY_VALUE_MAX];
+
+    property_get(name, propbuf, "0");
+    return atoi(propbuf);
+}
+
+static void read_own(void)
+{
+    int level = read_int(SENSOR_DEBUG_LEVEL_PROPERTY);
+    int time = read_int(SENSOR_DEBUG_TIME_PROPERTY);
+
+    if (level != sensor_debug_level() || time != sensor_debug_time())
+        ALOGI("%s %d, %s %d", SENSOR_DEBUG_LEVEL_PROPERTY, level,
+              SENSOR_DEBUG_TIME_PROPERTY, time);
+    __atomic_store_n(&g_sensor_debug.level, level, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_sensor_debug.time, time, __ATOMIC_RELAXED);
+}
+
+/*
+ * Runs once when the executable or shared object is loaded; sensor_log and
+ * sensor_trace read their own properties from their constructors.
+ */
+__attribute__((constructor))
+static void sensor_debug_init(void)
+{
+    seen_serial = property_serial();
+    read_own();
+}
+
+void sensor_debug_reload(void)
+{
+    read_own();
+    sensor_log_init();
+    sensor_trace_init();
+}
+
+void sensor_debug_poll(void)
+{
+    uint32_t serial = property_serial();
+    int64_t now;
+
+    if (serial == seen_serial)
+        return;
+    /* any property may have changed, re-read ours at a bounded rate */
+    now = debug_now_ns();
+    if (now - reload_ns < SENSOR_DEBUG_RELOAD_NS)
+        return;
+    /* taken before reading, a change made meanwhile is seen next time */
+    seen_serial = serial;
+    reload_ns = now;
+    sensor_debug_reload();
+}
@@ -0,0 +1,82 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runtime debug settings shared by the sensor HALs.
+ *
+ * All debug properties of a HAL are read once when the module is loaded:
+ *   sensor.debug.level  SENSOR_DEBUG_xxx mask, events logged from poll()
+ *   sensor.debug.time   log the delivery latency once a second
+ *   sensor.log.level    see sensor_log.h
+ *   sensor.trace        see sensor_trace.h
+ * The poll path calls sensor_debug_poll(), which only compares the serial
+ * of the system property area as long as no property changed.  When one
+ * did, all of the above are read again, at most once per
+ * SENSOR_DEBUG_RELOAD_NS, so a setprop takes effect within a second
+ * without a property lookup per poll().
+ * sensor_debug_reload() re-reads them at once.
+ *
+ * The cached values are read with sensor_debug_level() and
+ * sensor_debug_time() from any thread.
+ */
+
+#ifndef SENSOR_DEBUG_CONFIG_H
+#define SENSOR_DEBUG_CONFIG_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SENSOR_DEBUG_LEVEL_PROPERTY "sensor.debug.level"
+#define SENSOR_DEBUG_TIME_PROPERTY  "sensor.debug.time"
+
+/* sensor.debug.level bits */
+#define SENSOR_DEBUG_GYRO           0x01
+#define SENSOR_DEBUG_ACCEL          0x02
+#define SENSOR_DEBUG_MAG            0x04
+#define SENSOR_DEBUG_RAW_GYRO       0x08    /* uncalibrated gyro and bias */
+
+/* shortest time between two re-reads of the properties */
+#define SENSOR_DEBUG_RELOAD_NS      1000000000LL
+
+struct sensor_debug_config {
+    int level;
+    int time;
+};
+
+extern struct sensor_debug_config g_sensor_debug;
+
+/** Re-reads every debug property above right away. */
+void sensor_debug_reload(void);
+
+/** Picks up changed properties; call once per poll(), from one thread. */
+void sensor_debug_poll(void);
+
+static inline int sensor_debug_level(void)
+{
+    return __atomic_load_n(&g_sensor_debug.level, __ATOMIC_RELAXED);
+}
+
+static inline int sensor_debug_time(void)
+{
+    return __atomic_load_n(&g_sensor_debug.time, __ATOMIC_RELAXED);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SENSOR_DEBUG_CONFIG_H */
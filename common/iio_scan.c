@@ -0,0 +1,292 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "iio_scan.h"
+
+#define IIO_SCAN_OP_S16X3       (0)     /* three le s16, no shift */
+#define IIO_SCAN_OP_S16         (1)
+#define IIO_SCAN_OP_U16         (2)
+#define IIO_SCAN_OP_S32         (3)
+#define IIO_SCAN_OP_U32         (4)
+#define IIO_SCAN_OP_S64         (5)
+#define IIO_SCAN_OP_GENERIC     (6)     /* shift, mask, swap, extend */
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define HOST_BE                 (1)
+#else
+#define HOST_BE                 (0)
+#endif
+
+void iio_scan_layout_init(struct iio_scan_layout *layout)
+{
+    memset(layout, 0, sizeof(*layout));
+}
+
+int iio_scan_layout_add(struct iio_scan_layout *layout, const char *name,
+        unsigned index, const char *type)
+{
+    struct iio_scan_channel *ch;
+    char endian, sign;
+    unsigned bits, storage, shift = 0;
+
+    if (layout->num >= IIO_SCAN_MAX_CHANNELS)
+        return -ENOSPC;
+    if (sscanf(type, "%ce:%c%u/%u>>%u", &endian, &sign, &bits, &storage,
+            &shift) < 4)
+        return -EINVAL;
+    if ((storage != 8 && storage != 16 && storage != 32 && storage != 64) ||
+            bits == 0 || bits + shift > storage)
+        return -EINVAL;
+
+    ch = &layout->ch[layout->num++];
+    snprintf(ch->name, sizeof(ch->name), "%s", name);
+    ch->index = index;
+    ch->bytes = storage / 8;
+    ch->bits = bits;
+    ch->shift = shift;
+    ch->is_signed = (sign == 's' || sign == 'S');
+    ch->be = (endian == 'b');
+    return 0;
+}
+
+static int full_width(const struct iio_scan_channel *ch)
+{
+    return ch->be == HOST_BE && ch->shift == 0 && ch->bits == ch->bytes * 8;
+}
+
+static uint8_t op_kind(const struct iio_scan_channel *ch)
+{
+    if (!full_width(ch))
+        return IIO_SCAN_OP_GENERIC;
+    switch (ch->bytes) {
+    case 2:
+        return ch->is_signed ? IIO_SCAN_OP_S16 : IIO_SCAN_OP_U16;
+    case 4:
+        return ch->is_signed ? IIO_SCAN_OP_S32 : IIO_SCAN_OP_U32;
+    case 8:
+        return IIO_SCAN_OP_S64;
+    }
+    return IIO_SCAN_OP_GENERIC;
+}
+
+int iio_scan_layout_compile(struct iio_scan_layout *layout)
+{
+    struct iio_scan_channel tmp;
+    unsigned bytes = 0, align = 1;
+    int i, j;
+
+    /* scan order is index order */
+    for (i = 1; i < layout->num; i++) {
+        tmp = layout->ch[i];
+        for (j = i; j > 0 && layout->ch[j - 1].index > tmp.index; j--)
+            layout->ch[j] = layout->ch[j - 1];
+        layout->ch[j] = tmp;
+    }
+
+    /* every element is aligned to its own storage size */
+    for (i = 0; i < layout->num; i++) {
+        struct iio_scan_channel *ch = &layout->ch[i];
+
+        if (bytes % ch->bytes)
+            bytes += ch->bytes - bytes % ch->bytes;
+        ch->offset = bytes;
+        bytes += ch->bytes;
+        if (ch->bytes > align)
+            align = ch->bytes;
+    }
+    if (bytes % align)
+        bytes += align - bytes % align;
+    if (bytes > UINT16_MAX)
+        return -EINVAL;
+    layout->size = bytes;
+
+    layout->num_ops = 0;
+    for (i = 0; i < layout->num; i++) {
+        const struct iio_scan_channel *ch = &layout->ch[i];
+        struct iio_scan_op *op = &layout->ops[layout->num_ops++];
+
+        op->kind = op_kind(ch);
+        op->bytes = (uint8_t)ch->bytes;
+        op->shift = (uint8_t)ch->shift;
+        op->bits = (uint8_t)ch->bits;
+        op->is_signed = (uint8_t)ch->is_signed;
+        op->be = (uint8_t)ch->be;
+        op->offset = (uint16_t)ch->offset;
+        op->out = (uint16_t)i;
+        if (op->kind == IIO_SCAN_OP_S16 && i + 2 < layout->num &&
+                op_kind(&ch[1]) == IIO_SCAN_OP_S16 &&
+                op_kind(&ch[2]) == IIO_SCAN_OP_S16 &&
+                ch[1].offset == ch->offset + 2 &&
+                ch[2].offset == ch->offset + 4) {
+            op->kind = IIO_SCAN_OP_S16X3;
+            i += 2;
+        }
+    }
+    return 0;
+}
+
+static int read_attr(const char *dir, const char *name, const char *suffix,
+        char *buf, size_t size)
+{
+    char path[PATH_MAX];
+    FILE *fp;
+    int ok;
+
+    snprintf(path, sizeof(path), "%s/scan_elements/%s%s", dir, name, suffix);
+    fp = fopen(path, "r");
+    if (fp == NULL)
+        return -errno;
+    ok = fgets(buf, (int)size, fp) != NULL;
+    fclose(fp);
+    return ok ? 0 : -EIO;
+}
+
+int iio_scan_layout_load(struct iio_scan_layout *layout, const char *dev_dir)
+{
+    char path[PATH_MAX], name[IIO_SCAN_NAME_LEN], buf[32];
+    struct dirent *de;
+    DIR *dir;
+    size_t len;
+    int rt = 0;
+
+    iio_scan_layout_init(layout);
+    snprintf(path, sizeof(path), "%s/scan_elements", dev_dir);
+    dir = opendir(path);
+    if (dir == NULL)
+        return -errno;
+
+    while (rt == 0 && (de = readdir(dir)) != NULL) {
+        len = strlen(de->d_name);
+        if (len <= 3 || len - 3 >= sizeof(name) ||
+                strcmp(de->d_name + len - 3, "_en") != 0)
+            continue;
+        memcpy(name, de->d_name, len - 3);
+        name[len - 3] = 0;
+
+        if (read_attr(dev_dir, name, "_en", buf, sizeof(buf)) < 0 ||
+                atoi(buf) != 1)
+            continue;
+        rt = read_attr(dev_dir, name, "_index", buf, sizeof(buf));
+        if (rt < 0)
+            break;
+        len = (size_t)strtoul(buf, NULL, 10);
+        rt = read_attr(dev_dir, name, "_type", buf, sizeof(buf));
+        if (rt < 0)
+            break;
+        rt = iio_scan_layout_add(layout, name, (unsigned)len, buf);
+    }
+    closedir(dir);
+    if (rt < 0)
+        return rt;
+    return iio_scan_layout_compile(layout);
+}
+
+int iio_scan_layout_find(const struct iio_scan_layout *layout,
+        const char *name)
+{
+    int i;
+
+    for (i = 0; i < layout->num; i++)
+        if (strcmp(layout->ch[i].name, name) == 0)
+            return i;
+    return -1;
+}
+
+static int64_t decode_generic(const struct iio_scan_op *op, const uint8_t *p)
+{
+    uint64_t v = 0;
+    unsigned i;
+
+    /* assemble in the element's own byte order */
+    if (op->be) {
+        for (i = 0; i < op->bytes; i++)
+            v = (v << 8) | p[i];
+    } else {
+        for (i = op->bytes; i > 0; i--)
+            v = (v << 8) | p[i - 1];
+    }
+    v >>= op->shift;
+    if (op->bits < 64) {
+        v &= (1ULL << op->bits) - 1;
+        if (op->is_signed && (v & (1ULL << (op->bits - 1))))
+            v |= ~0ULL << op->bits;
+    }
+    return (int64_t)v;
+}
+
+size_t iio_scan_decode(const struct iio_scan_layout *layout,
+        const void *buf, size_t len, int64_t *out, size_t max_scans)
+{
+    const uint8_t *scan = (const uint8_t *)buf;
+    size_t n, s;
+    int i;
+
+    if (layout->size == 0)
+        return 0;
+    n = len / layout->size;
+    if (n > max_scans)
+        n = max_scans;
+
+    for (s = 0; s < n; s++, scan += layout->size, out += layout->num) {
+        for (i = 0; i < layout->num_ops; i++) {
+            const struct iio_scan_op *op = &layout->ops[i];
+            const uint8_t *p = scan + op->offset;
+            int16_t v16[3];
+            int32_t v32;
+            uint16_t u16;
+            uint32_t u32;
+            int64_t v64;
+
+            switch (op->kind) {
+            case IIO_SCAN_OP_S16X3:
+                memcpy(v16, p, sizeof(v16));
+                out[op->out] = v16[0];
+                out[op->out + 1] = v16[1];
+                out[op->out + 2] = v16[2];
+                break;
+            case IIO_SCAN_OP_S16:
+                memcpy(v16, p, 2);
+                out[op->out] = v16[0];
+                break;
+            case IIO_SCAN_OP_U16:
+                memcpy(&u16, p, 2);
+                out[op->out] = u16;
+                break;
+            case IIO_SCAN_OP_S32:
+                memcpy(&v32, p, 4);
+                out[op->out] = v32;
+                break;
+            case IIO_SCAN_OP_U32:
+                memcpy(&u32, p, 4);
+                out[op->out] = u32;
+                break;
+            case IIO_SCAN_OP_S64:
+                memcpy(&v64, p, 8);
+                out[op->out] = v64;
+                break;
+            default:
+                out[op->out] = decode_generic(op, p);
+                break;
+            }
+        }
+    }
+    return n;
+}
@@ -0,0 +1,105 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * IIO scan layout, compiled once from scan_elements.
+ *
+ * iio_scan_layout_load() reads the *_en, *_index and *_type attributes of
+ * an IIO device, orders the enabled channels by index, places them with
+ * the kernel's alignment rules and turns each into a decode op with the
+ * offset, shift and sign extension precomputed.  Runs of three aligned
+ * little-endian s16 channels (the x/y/z of a sensor) become a single op.
+ * iio_scan_decode() then runs the plan over any number of scans without
+ * looking at sysfs or the channel descriptions again.
+ *
+ * The layout is only valid for the set of enables it was loaded with;
+ * reload it whenever a channel is enabled or disabled.
+ */
+
+#ifndef IIO_SCAN_H
+#define IIO_SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IIO_SCAN_MAX_CHANNELS   (16)
+#define IIO_SCAN_NAME_LEN       (32)
+
+struct iio_scan_channel {
+    char name[IIO_SCAN_NAME_LEN];   /* "in_accel_x", without "_en" */
+    unsigned index;
+    unsigned offset;                /* in the scan, bytes */
+    unsigned bytes;                 /* storage: 1, 2, 4 or 8 */
+    unsigned bits;                  /* valid bits */
+    unsigned shift;
+    int is_signed;
+    int be;
+};
+
+struct iio_scan_op {
+    uint8_t kind;                   /* IIO_SCAN_OP_xxx, iio_scan.c */
+    uint8_t bytes;
+    uint8_t shift;
+    uint8_t bits;
+    uint8_t is_signed;
+    uint8_t be;
+    uint16_t offset;
+    uint16_t out;                   /* first output value */
+};
+
+struct iio_scan_layout {
+    int num;                        /* enabled channels */
+    unsigned size;                  /* bytes per scan */
+    struct iio_scan_channel ch[IIO_SCAN_MAX_CHANNELS];
+    int num_ops;
+    struct iio_scan_op ops[IIO_SCAN_MAX_CHANNELS];
+};
+
+/*
+ * Compile the layout of the device at @dev_dir (the iio:deviceN sysfs
+ * directory).  Returns 0, or a negative errno.
+ */
+int iio_scan_layout_load(struct iio_scan_layout *layout, const char *dev_dir);
+
+/*
+ * The same from descriptions already at hand: iio_scan_layout_init(), one
+ * iio_scan_layout_add() per enabled channel with its _type string
+ * ("le:s16/16>>0"), then iio_scan_layout_compile().
+ */
+void iio_scan_layout_init(struct iio_scan_layout *layout);
+int iio_scan_layout_add(struct iio_scan_layout *layout, const char *name,
+        unsigned index, const char *type);
+int iio_scan_layout_compile(struct iio_scan_layout *layout);
+
+/* position of channel @name in the decoded values, or -1 */
+int iio_scan_layout_find(const struct iio_scan_layout *layout,
+        const char *name);
+
+/*
+ * Decode the whole scans in @buf (@len bytes) into @out, layout->num
+ * values per scan in channel order, at most @max_scans of them.
+ * Returns the number of scans decoded.
+ */
+size_t iio_scan_decode(const struct iio_scan_layout *layout,
+        const void *buf, size_t len, int64_t *out, size_t max_scans);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IIO_SCAN_H */
@@ -0,0 +1,185 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "SampleGap"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "sensor_log.h"
+#include "sample_gap.h"
+
+struct gap_entry {
+    const char *name;
+    int64_t timestamp_ns;       /* first sample after the gap */
+    int64_t delta_ns;
+    int lost;
+};
+
+static pthread_mutex_t gap_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct sample_gap *streams;
+static struct gap_entry gap_log[SAMPLE_GAP_LOG_SIZE];
+static unsigned gap_log_next;
+
+void sample_gap_init(struct sample_gap *g, const char *name)
+{
+    struct sample_gap *s, *next = NULL;
+
+    pthread_mutex_lock(&gap_lock);
+    for (s = streams; s && s != g; s = s->next)
+        ;
+    /* registered already, keep its place in the list */
+    if (s)
+        next = g->next;
+    memset(g, 0, sizeof(*g));
+    g->name = name;
+    if (s) {
+        g->next = next;
+    } else {
+        g->next = streams;
+        streams = g;
+    }
+    pthread_mutex_unlock(&gap_lock);
+}
+
+void sample_gap_fini(struct sample_gap *g)
+{
+    struct sample_gap **p;
+
+    pthread_mutex_lock(&gap_lock);
+    for (p = &streams; *p; p = &(*p)->next) {
+        if (*p == g) {
+            *p = g->next;
+            break;
+        }
+    }
+    g->next = NULL;
+    pthread_mutex_unlock(&gap_lock);
+}
+
+void sample_gap_reset(struct sample_gap *g, int64_t period_ns)
+{
+    g->period_ns = period_ns > 0 ? period_ns : 0;
+    g->last_ns = 0;
+    g->consecutive = 0;
+    g->consecutive_lost = 0;
+}
+
+static void gap_log_add(const struct sample_gap *g, int64_t ts, int64_t delta,
+                        int lost)
+{
+    struct gap_entry *e;
+
+    pthread_mutex_lock(&gap_lock);
+    e = &gap_log[gap_log_next++ % SAMPLE_GAP_LOG_SIZE];
+    e->name = g->name;
+    e->timestamp_ns = ts;
+    e->delta_ns = delta;
+    e->lost = lost;
+    pthread_mutex_unlock(&gap_lock);
+}
+
+int sample_gap_check(struct sample_gap *g, int64_t ts)
+{
+    int64_t delta = ts - g->last_ns, period = g->period_ns;
+    int64_t lost;
+
+    g->samples++;
+    if (g->last_ns == 0) {
+        g->last_ns = ts;
+        return 0;
+    }
+    g->last_ns = ts;
+    if (delta <= 0) {
+        g->backwards++;
+        return 0;
+    }
+    if (period == 0) {
+        g->period_ns = delta;
+        return 0;
+    }
+    if (delta * 4 <= period * SAMPLE_GAP_THRESHOLD_Q4) {
+        /* follow the real rate, 1/8 per sample */
+        g->period_ns += (delta - period) / 8;
+        g->consecutive = 0;
+        g->consecutive_lost = 0;
+        return 0;
+    }
+
+    if (++g->consecutive >= SAMPLE_GAP_RESYNC) {
+        /* the device runs slower than programmed, not dropping data;
+           take back what the run counted */
+        HOT_LOGW("%s: period %lld ns, not %lld ns", g->name,
+                 (long long)delta, (long long)period);
+        g->gaps -= g->consecutive - 1;
+        g->lost -= g->consecutive_lost;
+        g->rate_changes++;
+        g->period_ns = delta;
+        g->consecutive = 0;
+        g->consecutive_lost = 0;
+        return 0;
+    }
+
+    lost = (delta + period / 2) / period - 1;
+    if (lost < 1)
+        lost = 1;
+    if (lost > 0x7fffffff)
+        lost = 0x7fffffff;
+    g->gaps++;
+    g->lost += lost;
+    g->consecutive_lost += lost;
+    if (lost > g->max_lost)
+        g->max_lost = (uint32_t)lost;
+    gap_log_add(g, ts, delta, (int)lost);
+    HOT_LOGW("%s: %lld ms gap, about %d samples lost", g->name,
+             (long long)(delta / 1000000), (int)lost);
+    return (int)lost;
+}
+
+void sample_gap_dump(int fd)
+{
+    char line[160];
+    const struct sample_gap *g;
+    unsigned i, n, first;
+    int len;
+
+    pthread_mutex_lock(&gap_lock);
+    for (g = streams; g; g = g->next) {
+        len = snprintf(line, sizeof(line),
+                "%-16s period %9lld ns  samples %llu  gaps %llu  "
+                "lost %llu  max %u  backwards %llu  rate changes %u\n",
+                g->name, (long long)g->period_ns,
+                (unsigned long long)g->samples,
+                (unsigned long long)g->gaps,
+                (unsigned long long)g->lost, g->max_lost,
+                (unsigned long long)g->backwards, g->rate_changes);
+        if (len > 0)
+            write(fd, line, len < (int)sizeof(line) ? len : (int)sizeof(line) - 1);
+    }
+    n = gap_log_next < SAMPLE_GAP_LOG_SIZE ? gap_log_next : SAMPLE_GAP_LOG_SIZE;
+    first = gap_log_next - n;
+    for (i = 0; i < n; i++) {
+        const struct gap_entry *e = &gap_log[(first + i) % SAMPLE_GAP_LOG_SIZE];
+
+        len = snprintf(line, sizeof(line),
+                "gap %-16s at %lld ns: %lld us, %d lost\n",
+                e->name, (long long)e->timestamp_ns,
+                (long long)(e->delta_ns / 1000), e->lost);
+        if (len > 0)
+            write(fd, line, len < (int)sizeof(line) ? len : (int)sizeof(line) - 1);
+    }
+    pthread_mutex_unlock(&gap_lock);
+}
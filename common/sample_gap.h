@@ -0,0 +1,103 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Lost sample detection from the timestamps of a sample stream.
+ *
+ * Each stream (one sensor of one HAL) keeps an estimate of its sample
+ * period, seeded with the period the HAL programmed and then tracked from
+ * the deltas it actually sees, so a device that rounds the requested rate
+ * does not look like it drops samples.  A delta of more than
+ * SAMPLE_GAP_THRESHOLD periods is a gap: a kernel FIFO that overflowed or
+ * a reader that fell behind.  sample_gap_check() returns the number of
+ * samples lost so that the caller can tell its fusion code that the data
+ * is not contiguous.
+ *
+ * Streams register themselves in sample_gap_init() and leave with
+ * sample_gap_fini().  Their counters and the last SAMPLE_GAP_LOG_SIZE gaps
+ * of all streams can be written out with sample_gap_dump(), which the HAL
+ * exports for debugging tools such as sensors_hal_bench (mpu/libsensors/sim).
+ *
+ * A stream is checked from the one thread that reads it; the counters are
+ * not locked, a dump that races with a sample may be one sample off.
+ */
+
+#ifndef SAMPLE_GAP_H
+#define SAMPLE_GAP_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* a delta above this many periods is a gap, in quarter periods */
+#define SAMPLE_GAP_THRESHOLD_Q4     7
+/*
+ * Consecutive gaps after which the stream is assumed to run slower than
+ * programmed; the gaps of the run are taken back from the counters, but
+ * the caller has already been told about them.
+ */
+#define SAMPLE_GAP_RESYNC           4
+#define SAMPLE_GAP_LOG_SIZE         32
+
+struct sample_gap {
+    const char *name;
+    int64_t period_ns;          /* estimated, 0 until known */
+    int64_t last_ns;            /* previous timestamp, 0 after a reset */
+    int consecutive;            /* gaps in a row */
+    uint64_t consecutive_lost;  /* samples they counted as lost */
+
+    /* cumulative, never reset */
+    uint64_t samples;
+    uint64_t gaps;
+    uint64_t lost;              /* estimated samples lost in the gaps */
+    uint64_t backwards;         /* timestamps not after the previous one */
+    uint32_t max_lost;
+    uint32_t rate_changes;      /* runs of gaps taken back, see above */
+
+    struct sample_gap *next;    /* registry */
+};
+
+/**
+ * Registers @g under @name, which must outlive the stream.  Calling it
+ * again on a registered stream only clears its counters.
+ */
+void sample_gap_init(struct sample_gap *g, const char *name);
+
+/** Unregisters @g; call it before the memory of @g goes away. */
+void sample_gap_fini(struct sample_gap *g);
+
+/**
+ * Starts over after the stream was enabled or its rate changed; the next
+ * sample is never a gap.
+ * @param period_ns The period the device was programmed for, 0 if unknown.
+ */
+void sample_gap_reset(struct sample_gap *g, int64_t period_ns);
+
+/**
+ * Accounts one sample.
+ * @return The estimated number of samples lost right before this one,
+ *         0 if the stream is contiguous.
+ */
+int sample_gap_check(struct sample_gap *g, int64_t timestamp_ns);
+
+/** Writes the counters of every stream and the recent gaps to @fd. */
+void sample_gap_dump(int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SAMPLE_GAP_H */
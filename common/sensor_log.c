@@ -0,0 +1,77 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include <cutils/properties.h>
+
+#include "sensor_log.h"
+
+int g_sensor_log_level = SENSOR_LOG_LEVEL;
+
+static int64_t sensor_log_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* runs once when the executable or shared object is loaded */
+__attribute__((constructor))
+void sensor_log_init(void)
+{
+    char propbuf[PROPERTY_VALUE_MAX];
+    int level;
+
+    property_get(SENSOR_LOG_PROPERTY, propbuf, "-1");
+    level = atoi(propbuf);
+    if (level < 0 || level > SENSOR_LOG_LEVEL)
+        level = SENSOR_LOG_LEVEL;
+    g_sensor_log_level = level;
+}
+
+/*
+ * The bucket is refilled lazily, one token per 1/rate second, up to burst.
+ * Buckets are per call site and each call site lives on a single reader
+ * thread, so no locking is done here; a lost update only costs one message.
+ */
+int sensor_log_bucket_take(struct sensor_log_bucket *b, int rate, int burst)
+{
+    int64_t now = sensor_log_now_ns();
+    int64_t period = 1000000000LL / (rate > 0 ? rate : 1);
+    int sup;
+
+    if (b->tokens < burst) {
+        int64_t add = (now - b->last_ns) / period;
+        if (add > 0) {
+            if (add >= burst - b->tokens) {
+                b->tokens = burst;
+                b->last_ns = now;
+            } else {
+                b->tokens += (int32_t)add;
+                b->last_ns += add * period;
+            }
+        }
+    }
+
+    if (b->tokens <= 0) {
+        b->suppressed++;
+        return -1;
+    }
+
+    b->tokens--;
+    sup = b->suppressed;
+    b->suppressed = 0;
+    return sup;
+}
@@ -0,0 +1,134 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Hot path logging shared by the sensor HALs and the akmd daemons.
+ *
+ * Every module picks its maximum log level at build time with
+ *   LOCAL_CFLAGS += -DSENSOR_LOG_LEVEL=SENSOR_LOG_LEVEL_xxx
+ * HOT_LOGx() calls above that level are preprocessed away, so their
+ * arguments are never evaluated.  The surviving ones are filtered against
+ * g_sensor_log_level, which is read once from the "sensor.log.level"
+ * property when the module is loaded, and then go through a per call site
+ * token bucket so that a 100 Hz sample path cannot flood logd.
+ *
+ * Use HOT_LOGx() only in per-sample code; one-shot paths keep using ALOGx().
+ */
+
+#ifndef SENSOR_LOG_H
+#define SENSOR_LOG_H
+
+#include <stdint.h>
+#include <cutils/log.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SENSOR_LOG_LEVEL_NONE       0
+#define SENSOR_LOG_LEVEL_ERROR      1
+#define SENSOR_LOG_LEVEL_WARN       2
+#define SENSOR_LOG_LEVEL_INFO       3
+#define SENSOR_LOG_LEVEL_DEBUG      4
+#define SENSOR_LOG_LEVEL_VERBOSE    5
+
+/* build time ceiling, per module */
+#ifndef SENSOR_LOG_LEVEL
+#define SENSOR_LOG_LEVEL            SENSOR_LOG_LEVEL_WARN
+#endif
+
+/* messages per second and burst size allowed through each call site */
+#ifndef SENSOR_LOG_RATE
+#define SENSOR_LOG_RATE             2
+#endif
+#ifndef SENSOR_LOG_BURST
+#define SENSOR_LOG_BURST            5
+#endif
+
+#define SENSOR_LOG_PROPERTY         "sensor.log.level"
+
+struct sensor_log_bucket {
+    int64_t  last_ns;
+    int32_t  tokens;
+    int32_t  suppressed;
+};
+
+/* runtime level, never above SENSOR_LOG_LEVEL */
+extern int g_sensor_log_level;
+
+/** Re-read SENSOR_LOG_PROPERTY. Called automatically on module load. */
+void sensor_log_init(void);
+
+/**
+ * Take one token from @b.
+ * @return -1 if the message must be dropped, otherwise the number of
+ *         messages dropped at this call site since the last one that went
+ *         through.
+ */
+int sensor_log_bucket_take(struct sensor_log_bucket *b, int rate, int burst);
+
+#define SENSOR_LOG_RL(level, prio, fmt, ...) \
+    do { \
+        if (g_sensor_log_level >= (level)) { \
+            static struct sensor_log_bucket __slb; \
+            int __sup = sensor_log_bucket_take(&__slb, \
+                            SENSOR_LOG_RATE, SENSOR_LOG_BURST); \
+            if (__sup == 0) \
+                LOG_PRI(prio, LOG_TAG, fmt, ##__VA_ARGS__); \
+            else if (__sup > 0) \
+                LOG_PRI(prio, LOG_TAG, fmt " [%d suppressed]", \
+                        ##__VA_ARGS__, __sup); \
+        } \
+    } while (0)
+
+#if SENSOR_LOG_LEVEL >= SENSOR_LOG_LEVEL_ERROR
+#define HOT_LOGE(fmt, ...) \
+    SENSOR_LOG_RL(SENSOR_LOG_LEVEL_ERROR, ANDROID_LOG_ERROR, fmt, ##__VA_ARGS__)
+#else
+#define HOT_LOGE(...)   ((void)0)
+#endif
+
+#if SENSOR_LOG_LEVEL >= SENSOR_LOG_LEVEL_WARN
+#define HOT_LOGW(fmt, ...) \
+    SENSOR_LOG_RL(SENSOR_LOG_LEVEL_WARN, ANDROID_LOG_WARN, fmt, ##__VA_ARGS__)
+#else
+#define HOT_LOGW(...)   ((void)0)
+#endif
+
+#if SENSOR_LOG_LEVEL >= SENSOR_LOG_LEVEL_INFO
+#define HOT_LOGI(fmt, ...) \
+    SENSOR_LOG_RL(SENSOR_LOG_LEVEL_INFO, ANDROID_LOG_INFO, fmt, ##__VA_ARGS__)
+#else
+#define HOT_LOGI(...)   ((void)0)
+#endif
+
+#if SENSOR_LOG_LEVEL >= SENSOR_LOG_LEVEL_DEBUG
+#define HOT_LOGD(fmt, ...) \
+    SENSOR_LOG_RL(SENSOR_LOG_LEVEL_DEBUG, ANDROID_LOG_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define HOT_LOGD(...)   ((void)0)
+#endif
+
+#if SENSOR_LOG_LEVEL >= SENSOR_LOG_LEVEL_VERBOSE
+#define HOT_LOGV(fmt, ...) \
+    SENSOR_LOG_RL(SENSOR_LOG_LEVEL_VERBOSE, ANDROID_LOG_VERBOSE, fmt, ##__VA_ARGS__)
+#else
+#define HOT_LOGV(...)   ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SENSOR_LOG_H */
@@ -0,0 +1,273 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "SensorStats"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cutils/log.h>
+
+#include "sysfs_root.h"
+#include "sensor_stats.h"
+
+enum {
+    HIST_PERIOD,
+    HIST_EARLY,
+    HIST_LATE,
+    HIST_LATENCY,
+    HIST_COUNT,
+};
+
+static const char *const hist_names[HIST_COUNT] = {
+    "period", "early", "late", "latency",
+};
+
+struct handle_stats {
+    /* written by sensor_stats_config() */
+    const char *name;
+    int64_t requested_ns;
+    int restart;
+
+    /* written by the poll thread only */
+    int64_t last_ns;
+    uint64_t events;
+    uint64_t ahead;             /* timestamps after the delivery time */
+    uint32_t hist[HIST_COUNT][SENSOR_STATS_BUCKETS];
+};
+
+static struct handle_stats stats[SENSOR_STATS_HANDLES];
+
+static inline int bucket(int64_t v)
+{
+    int msb;
+
+    if (v < SENSOR_STATS_SUB)
+        return v < 0 ? 0 : (int)v;
+    msb = 63 - __builtin_clzll((uint64_t)v);
+    if (msb > SENSOR_STATS_MAX_BITS)
+        return SENSOR_STATS_BUCKETS - 1;
+    return (msb - SENSOR_STATS_SUB_BITS + 1) * SENSOR_STATS_SUB
+            + (int)((v >> (msb - SENSOR_STATS_SUB_BITS)) & (SENSOR_STATS_SUB - 1));
+}
+
+/* smallest value that lands in bucket @i */
+static int64_t bucket_floor(int i)
+{
+    int msb;
+
+    if (i < SENSOR_STATS_SUB)
+        return i;
+    msb = i / SENSOR_STATS_SUB + SENSOR_STATS_SUB_BITS - 1;
+    return (int64_t)(SENSOR_STATS_SUB + i % SENSOR_STATS_SUB)
+            << (msb - SENSOR_STATS_SUB_BITS);
+}
+
+/* single writer: a plain increment published for the dump thread */
+static inline void bump(uint32_t *c)
+{
+    __atomic_store_n(c, *c + 1, __ATOMIC_RELAXED);
+}
+
+void sensor_stats_config(int handle, const char *name, int64_t period_ns)
+{
+    struct handle_stats *s;
+
+    if (handle < 0 || handle >= SENSOR_STATS_HANDLES)
+        return;
+    s = &stats[handle];
+    if (name)
+        __atomic_store_n(&s->name, name, __ATOMIC_RELAXED);
+    if (period_ns >= 0)
+        __atomic_store_n(&s->requested_ns, period_ns, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->restart, 1, __ATOMIC_RELEASE);
+}
+
+void sensor_stats_event(int handle, int64_t timestamp_ns, int64_t now_ns)
+{
+    struct handle_stats *s;
+    int64_t latency, period, requested;
+
+    if (handle < 0 || handle >= SENSOR_STATS_HANDLES)
+        return;
+    s = &stats[handle];
+
+    if (__atomic_load_n(&s->restart, __ATOMIC_ACQUIRE)) {
+        __atomic_store_n(&s->restart, 0, __ATOMIC_RELAXED);
+        s->last_ns = 0;
+    }
+    __atomic_store_n(&s->events, s->events + 1, __ATOMIC_RELAXED);
+
+    latency = now_ns - timestamp_ns;
+    if (latency < 0)
+        __atomic_store_n(&s->ahead, s->ahead + 1, __ATOMIC_RELAXED);
+    bump(&s->hist[HIST_LATENCY][bucket(latency)]);
+
+    if (s->last_ns != 0 && timestamp_ns > s->last_ns) {
+        period = timestamp_ns - s->last_ns;
+        bump(&s->hist[HIST_PERIOD][bucket(period)]);
+        requested = __atomic_load_n(&s->requested_ns, __ATOMIC_RELAXED);
+        if (requested > 0) {
+            if (period < requested)
+                bump(&s->hist[HIST_EARLY][bucket(requested - period)]);
+            else
+                bump(&s->hist[HIST_LATE][bucket(period - requested)]);
+        }
+    }
+    s->last_ns = timestamp_ns;
+}
+
+static void write_line(int fd, const char *line, int len, size_t size)
+{
+    if (len <= 0)
+        return;
+    if (len >= (int)size)
+        len = (int)size - 1;
+    while (len > 0) {
+        ssize_t n = write(fd, line, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        line += n;
+        len -= (int)n;
+    }
+}
+
+/* middle of the bucket @pct percent of @total fall into, in usec */
+static double percentile(const uint32_t *h, uint64_t total, int pct)
+{
+    uint64_t want = (total * pct + 99) / 100, sum = 0;
+    int i;
+
+    for (i = 0; i < SENSOR_STATS_BUCKETS - 1; i++) {
+        sum += h[i];
+        if (sum >= want)
+            break;
+    }
+    if (i == SENSOR_STATS_BUCKETS - 1)
+        return bucket_floor(i) / 1000.0;
+    return (bucket_floor(i) + bucket_floor(i + 1)) / 2000.0;
+}
+
+void sensor_stats_dump(int fd)
+{
+    static uint32_t snap[HIST_COUNT][SENSOR_STATS_BUCKETS];
+    static pthread_mutex_t dump_lock = PTHREAD_MUTEX_INITIALIZER;
+    char line[160];
+    int h, k, i, len;
+
+    /* the snapshot buffer is shared by concurrent dumps, not the writer */
+    pthread_mutex_lock(&dump_lock);
+    for (h = 0; h < SENSOR_STATS_HANDLES; h++) {
+        struct handle_stats *s = &stats[h];
+        uint64_t events = __atomic_load_n(&s->events, __ATOMIC_RELAXED);
+        const char *name = __atomic_load_n(&s->name, __ATOMIC_RELAXED);
+
+        if (events == 0)
+            continue;
+        for (k = 0; k < HIST_COUNT; k++)
+            for (i = 0; i < SENSOR_STATS_BUCKETS; i++)
+                snap[k][i] = __atomic_load_n(&s->hist[k][i], __ATOMIC_RELAXED);
+
+        len = snprintf(line, sizeof(line),
+                "handle %d %s: %llu events, requested %.1f us, "
+                "%llu stamped ahead of delivery\n",
+                h, name ? name : "", (unsigned long long)events,
+                __atomic_load_n(&s->requested_ns, __ATOMIC_RELAXED) / 1000.0,
+                (unsigned long long)__atomic_load_n(&s->ahead,
+                        __ATOMIC_RELAXED));
+        write_line(fd, line, len, sizeof(line));
+
+        for (k = 0; k < HIST_COUNT; k++) {
+            uint64_t total = 0;
+
+            for (i = 0; i < SENSOR_STATS_BUCKETS; i++)
+                total += snap[k][i];
+            if (total == 0)
+                continue;
+            len = snprintf(line, sizeof(line),
+                    "  %-8s %10llu  p50 %10.1f us  p90 %10.1f us  "
+                    "p99 %10.1f us\n",
+                    hist_names[k], (unsigned long long)total,
+                    percentile(snap[k], total, 50),
+                    percentile(snap[k], total, 90),
+                    percentile(snap[k], total, 99));
+            write_line(fd, line, len, sizeof(line));
+            for (i = 0; i < SENSOR_STATS_BUCKETS; i++) {
+                if (snap[k][i] == 0)
+                    continue;
+                len = snprintf(line, sizeof(line),
+                        "    >= %12.1f us %10u\n",
+                        bucket_floor(i) / 1000.0, snap[k][i]);
+                write_line(fd, line, len, sizeof(line));
+            }
+        }
+    }
+    pthread_mutex_unlock(&dump_lock);
+}
+
+static char fifo_path[PATH_MAX];
+
+static void *stats_server(void *arg)
+{
+    int fd;
+
+    (void)arg;
+    for (;;) {
+        /* blocks until somebody opens the FIFO for reading */
+        fd = open(fifo_path, O_WRONLY);
+        if (fd < 0) {
+            if (errno == EINTR)
+                continue;
+            ALOGE("open %s: %s", fifo_path, strerror(errno));
+            break;
+        }
+        sensor_stats_dump(fd);
+        close(fd);
+        /* let the reader see EOF before it can be handed a second dump */
+        usleep(100000);
+    }
+    return NULL;
+}
+
+int sensor_stats_start(const char *path)
+{
+    static int started;
+    pthread_attr_t attr;
+    pthread_t thread;
+    int err;
+
+    if (started)
+        return 0;
+    if (sysfs_root_path(fifo_path, sizeof(fifo_path), "%s", path) < 0)
+        return -ENAMETOOLONG;
+    if (mkfifo(fifo_path, 0660) < 0 && errno != EEXIST) {
+        err = -errno;
+        ALOGE("mkfifo %s: %s", fifo_path, strerror(errno));
+        return err;
+    }
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    err = -pthread_create(&thread, &attr, stats_server, NULL);
+    pthread_attr_destroy(&attr);
+    if (err == 0)
+        started = 1;
+    return err;
+}
@@ -0,0 +1,78 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Per handle timing statistics of the events a HAL delivers from poll().
+ *
+ * For every event the poll path reports its handle, its timestamp and the
+ * time it is handed to the framework.  Three log-linear histograms are kept
+ * per handle, SENSOR_STATS_SUB buckets per power of two nanoseconds:
+ *   - period:    delta to the previous event of the handle
+ *   - deviation: period minus the requested period, early and late apart
+ *   - latency:   delivery time minus event timestamp
+ *
+ * Each handle has a single writer, the poll thread, which never takes a
+ * lock; counters are published with relaxed atomic stores.  A snapshot can
+ * be taken from any thread at any time with sensor_stats_dump(), it may be
+ * a few events inconsistent between histograms but never stops sampling.
+ * sensor_stats_start() also serves snapshots on a FIFO:
+ *   adb shell cat /data/system/sensor_stats
+ */
+
+#ifndef SENSOR_STATS_H
+#define SENSOR_STATS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SENSOR_STATS_HANDLES        32
+/* buckets per power of two, as a shift */
+#define SENSOR_STATS_SUB_BITS       3
+#define SENSOR_STATS_SUB            (1 << SENSOR_STATS_SUB_BITS)
+/* values above 2^34 ns (17 s) share the last bucket */
+#define SENSOR_STATS_MAX_BITS       34
+#define SENSOR_STATS_BUCKETS \
+        ((SENSOR_STATS_MAX_BITS - SENSOR_STATS_SUB_BITS + 2) * SENSOR_STATS_SUB)
+
+#define SENSOR_STATS_FIFO           "/data/system/sensor_stats"
+
+/**
+ * Names @handle in the dump and sets the period it was asked for; starts a
+ * new period measurement.  Call from activate and setDelay.
+ * @param name      NULL keeps the current name.
+ * @param period_ns Requested period, negative keeps the current one.
+ */
+void sensor_stats_config(int handle, const char *name, int64_t period_ns);
+
+/** Accounts one event, from the poll thread only. */
+void sensor_stats_event(int handle, int64_t timestamp_ns, int64_t now_ns);
+
+/** Writes a snapshot of every handle that saw events to @fd. */
+void sensor_stats_dump(int fd);
+
+/**
+ * Serves a snapshot to every reader of the FIFO at @path (below
+ * $SENSORS_SYSFS_ROOT, see sysfs_root.h) from a thread of its own.
+ * Returns 0, or -errno if the FIFO or the thread could not be created.
+ */
+int sensor_stats_start(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SENSOR_STATS_H */
@@ -0,0 +1,130 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "SensorTrace"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <cutils/log.h>
+#include <cutils/properties.h>
+
+#include "sysfs_root.h"
+#include "sensor_trace.h"
+
+struct trace_entry {
+    int64_t now_ns;
+    int64_t timestamp;
+    int32_t handle;
+    int32_t stage;
+};
+
+int g_sensor_trace_mode = SENSOR_TRACE_OFF;
+
+static int marker_fd = -1;
+static struct trace_entry *ring;
+static uint32_t ring_next;
+
+/* runs once when the executable or shared object is loaded */
+__attribute__((constructor))
+void sensor_trace_init(void)
+{
+    char propbuf[PROPERTY_VALUE_MAX];
+    char path[PATH_MAX];
+    const char *name = SENSOR_TRACE_MARKER;
+    int mode;
+
+    property_get(SENSOR_TRACE_PROPERTY, propbuf, "0");
+    mode = atoi(propbuf);
+    if (mode == SENSOR_TRACE_FTRACE && marker_fd < 0) {
+        if (sysfs_root_path(path, sizeof(path), SENSOR_TRACE_MARKER) >= 0) {
+            name = path;
+            marker_fd = open(path, O_WRONLY | O_CLOEXEC);
+        }
+        if (marker_fd < 0) {
+            ALOGW("%s: %s, tracing to memory", name, strerror(errno));
+            mode = SENSOR_TRACE_MEMORY;
+        }
+    }
+    if (mode == SENSOR_TRACE_MEMORY && !ring) {
+        ring = (struct trace_entry *)calloc(SENSOR_TRACE_RING, sizeof(*ring));
+        if (!ring)
+            mode = SENSOR_TRACE_OFF;
+    }
+    if (mode != SENSOR_TRACE_FTRACE && mode != SENSOR_TRACE_MEMORY)
+        mode = SENSOR_TRACE_OFF;
+    g_sensor_trace_mode = mode;
+}
+
+static int64_t trace_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void sensor_trace_mark(int stage, int handle, int64_t timestamp)
+{
+    struct trace_entry *e;
+    char buf[48];
+    int len;
+
+    if (g_sensor_trace_mode == SENSOR_TRACE_FTRACE) {
+        /* a single write() is a single, atomic, ftrace event; a mark
+           that still fails is lost, the sample path never waits */
+        len = snprintf(buf, sizeof(buf), "sns %c %d %lld", stage, handle,
+                       (long long)timestamp);
+        while (write(marker_fd, buf, len) < 0 && errno == EINTR)
+            ;
+        return;
+    }
+    if (g_sensor_trace_mode == SENSOR_TRACE_MEMORY) {
+        e = &ring[__atomic_fetch_add(&ring_next, 1, __ATOMIC_RELAXED)
+                  % SENSOR_TRACE_RING];
+        e->now_ns = trace_now_ns();
+        e->timestamp = timestamp;
+        e->handle = handle;
+        e->stage = stage;
+    }
+}
+
+void sensor_trace_dump(int fd)
+{
+    uint32_t next, n, i;
+    char line[128];
+    int len;
+
+    if (!ring)
+        return;
+    next = __atomic_load_n(&ring_next, __ATOMIC_RELAXED);
+    n = next < SENSOR_TRACE_RING ? next : SENSOR_TRACE_RING;
+    for (i = next - n; i != next; i++) {
+        const struct trace_entry *e = &ring[i % SENSOR_TRACE_RING];
+
+        /* the line format of the ftrace buffer, see sensor_trace_report */
+        len = snprintf(line, sizeof(line),
+                "sensors-%d [000] .... %lld.%09lld: tracing_mark_write: "
+                "sns %c %d %lld\n", (int)getpid(),
+                (long long)(e->now_ns / 1000000000LL),
+                (long long)(e->now_ns % 1000000000LL),
+                (char)e->stage, (int)e->handle, (long long)e->timestamp);
+        if (len > 0 && write(fd, line, len) < 0)
+            break;
+    }
+}
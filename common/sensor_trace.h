@@ -0,0 +1,103 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Per sample pipeline trace points shared by the sensor HALs.
+ *
+ * SENSOR_TRACE_MARK(stage, handle, timestamp) marks that the sample stamped
+ * @timestamp by the hardware went through @stage:
+ *   R  read from the IIO buffer or input device
+ *   B  handed to the data builder
+ *   F  fusion done
+ *   O  turned into an Android event
+ *   P  returned from poll()
+ * @handle is the Android handle where there is one, -1 for stages shared
+ * by all sensors of a sample.
+ *
+ * Each mark is one line "sns <stage> <handle> <timestamp>" written to the
+ * ftrace trace_marker, so the kernel puts its own clock on it:
+ *   echo mono > /sys/kernel/debug/tracing/trace_clock
+ *   echo 1 > /sys/kernel/debug/tracing/tracing_on
+ *   setprop sensor.trace 1      (before the HAL is loaded)
+ *   cat /sys/kernel/debug/tracing/trace > trace.txt
+ * Where trace_marker cannot be opened, or with sensor.trace 2, the marks
+ * go to an in-process ring of the last SENSOR_TRACE_RING marks instead,
+ * written out by sensor_trace_dump() in the same format.
+ * sensor_trace_report (mpu/libsensors/sim) turns either into per stage
+ * latency distributions.
+ *
+ * Every module can compile the marks out with
+ *   LOCAL_CFLAGS += -DSENSOR_TRACE=0
+ * otherwise a disabled mark costs one load and branch.
+ */
+
+#ifndef SENSOR_TRACE_H
+#define SENSOR_TRACE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* build time switch, per module */
+#ifndef SENSOR_TRACE
+#define SENSOR_TRACE                1
+#endif
+
+#define SENSOR_TRACE_PROPERTY       "sensor.trace"
+#define SENSOR_TRACE_MARKER         "/sys/kernel/debug/tracing/trace_marker"
+#define SENSOR_TRACE_RING           8192
+
+enum {
+    SENSOR_TRACE_OFF = 0,
+    SENSOR_TRACE_FTRACE,
+    SENSOR_TRACE_MEMORY,
+};
+
+#define TRACE_READ                  'R'
+#define TRACE_BUILD                 'B'
+#define TRACE_FUSION                'F'
+#define TRACE_OUTPUT                'O'
+#define TRACE_POLL                  'P'
+
+/* SENSOR_TRACE_xxx in use */
+extern int g_sensor_trace_mode;
+
+/**
+ * Re-reads SENSOR_TRACE_PROPERTY and opens the marker file.  Called
+ * automatically on module load.
+ */
+void sensor_trace_init(void);
+
+void sensor_trace_mark(int stage, int handle, int64_t timestamp);
+
+/** Writes the marks held in memory to @fd, oldest first. */
+void sensor_trace_dump(int fd);
+
+#if SENSOR_TRACE
+#define SENSOR_TRACE_MARK(stage, handle, timestamp) \
+    do { \
+        if (__builtin_expect(g_sensor_trace_mode != SENSOR_TRACE_OFF, 0)) \
+            sensor_trace_mark((stage), (handle), (timestamp)); \
+    } while (0)
+#else
+#define SENSOR_TRACE_MARK(stage, handle, timestamp)   ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SENSOR_TRACE_H */
@@ -0,0 +1,47 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sysfs_root.h"
+
+const char *sysfs_root(void)
+{
+    static const char *root;
+
+    if (root == NULL) {
+        const char *env = getenv(SYSFS_ROOT_ENV);
+        root = env ? env : "";
+    }
+    return root;
+}
+
+int sysfs_root_path(char *buf, size_t size, const char *fmt, ...)
+{
+    va_list ap;
+    int n, m;
+
+    n = snprintf(buf, size, "%s", sysfs_root());
+    if (n < 0 || (size_t)n >= size)
+        return -1;
+
+    va_start(ap, fmt);
+    m = vsnprintf(buf + n, size - n, fmt, ap);
+    va_end(ap);
+    if (m < 0 || (size_t)(n + m) >= size)
+        return -1;
+    return n + m;
+}
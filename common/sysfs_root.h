@@ -0,0 +1,49 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Redirectable root for the /sys, /proc and /dev paths the HALs open.
+ *
+ * When $SENSORS_SYSFS_ROOT is set, every device path built through
+ * sysfs_root_path() is looked up below it instead of "/".  This lets the
+ * HALs run against a fake device tree, see mpu/libsensors/sim.  The
+ * variable is read once; with it unset the paths are unchanged.
+ */
+
+#ifndef SYSFS_ROOT_H
+#define SYSFS_ROOT_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYSFS_ROOT_ENV      "SENSORS_SYSFS_ROOT"
+
+/* "" when not redirected, never NULL */
+const char *sysfs_root(void);
+
+/*
+ * snprintf() into @buf with the root prepended to the formatted absolute
+ * path.  Returns the length written, or -1 if it did not fit.
+ */
+int sysfs_root_path(char *buf, size_t size, const char *fmt, ...)
+        __attribute__((format(printf, 3, 4)));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSFS_ROOT_H */
@@ -30,6 +30,8 @@
 #undef LOG_TAG
 #define LOG_TAG "AKMD2"
 
+#include "sensor_log.h"
+
 #ifndef ALOGE
 #ifdef LOGE
 #define ALOGE	LOGE
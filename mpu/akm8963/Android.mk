@@ -10,15 +10,18 @@ AKMD_ACC_AOT := yes
 
 include $(CLEAR_VARS)
 LOCAL_C_INCLUDES := \
-	$(LOCAL_PATH)/$(SMARTCOMPASS_LIB)
+	$(LOCAL_PATH)/$(SMARTCOMPASS_LIB) \
+	$(LOCAL_PATH)/../../common
 
 LOCAL_SRC_FILES:= \
 	AKMD_Driver.c \
 	DispMessage.c \
 	FileIO.c \
+	HDOEWorker.c \
 	Measure.c \
 	main.c \
-	misc.c
+	misc.c \
+	../../common/sensor_log.c
 	
 LOCAL_MODULE  := akmd
 
@@ -70,6 +73,7 @@ endif
 LOCAL_CFLAGS += -Wall -Wextra
 #LOCAL_CFLAGS += -DENABLE_AKMDEBUG=1
 #LOCAL_CFLAGS += -DAKM_LOG_ENABLE
+LOCAL_CFLAGS += -DSENSOR_LOG_LEVEL=SENSOR_LOG_LEVEL_INFO
 
 LOCAL_MODULE_TAGS := optional
 LOCAL_FORCE_STATIC_EXECUTABLE := false
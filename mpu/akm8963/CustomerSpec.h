@@ -71,5 +71,10 @@
 
 // DOEPlus(software softiron distortion compensation) Enable(1)/Disable(0)
 #define CSPEC_ENABLE_DOEPLUS	1
+
+// Run HDOE on a worker thread Enable(1)/Disable(0)
+#define CSPEC_ASYNC_HDOE		1
+// Nice value of the HDOE worker thread
+#define CSPEC_HDOE_WORKER_NICE	10
 #endif //AKMD_INC_CUSTOMERSPEC_H
 
@@ -25,6 +25,7 @@
 #include "AKMD_Driver.h"
 #include "DispMessage.h"
 #include "FileIO.h"
+#include "HDOEWorker.h"
 #include "Measure.h"
 #include "misc.h"
 
@@ -46,6 +47,8 @@
 #define AKMD_FUSION_INTERVAL	10000000	/*!< fusion interval */
 #define AKMD_LOOP_MARGIN		3000000		/*!< Minimum sleep time */
 #define AKMD_SETTING_INTERVAL	500000000	/*!< Setting event interval */
+#define AKMD_LATENCY_BINS		16			/*!< log2(usec) latency bins */
+#define AKMD_LATENCY_DUMP		1000		/*!< Samples between dumps */
 
 #define DEG2RAD(x)      ((AKSC_FLOAT)(((x) * AKSC_PI) / 180.0))
 #define AKSC2SI(x)		((AKSC_FLOAT)(((x) * 9.80665f) / 720.0))
@@ -58,6 +61,13 @@
 
 static FORM_CLASS* g_form = NULL;
 
+/* Per-sample latency of GetMagneticVector */
+typedef struct _AKMD_LATENCY_HIST {
+	uint32	bin[AKMD_LATENCY_BINS];	/* bin[i]: [2^i, 2^(i+1)) usec */
+	uint32	count;
+	int64_t	max;
+} AKMD_LATENCY_HIST;
+
 /*!
  This function open formation status device.
  @return Return 0 on success. Negative value on fail.
@@ -110,6 +120,97 @@ void RegisterFormClass(FORM_CLASS* pt)
 	g_form = pt;
 }
 
+/*!
+ Initialize HDOE parameters, on the worker too when it is running.
+ @param[in,out] prms A pointer to a #AKSCPRMS structure.
+ */
+static void initHDOE(AKSCPRMS* prms)
+{
+	AKSC_InitHDOEProcPrmsS3(
+		&prms->m_hdoev,
+		1,
+		&prms->m_ho,
+		prms->m_hdst
+	);
+	if (HDOEWorker_IsRunning()) {
+		HDOEWorker_Reset(HDOEW_RESET_INIT, &prms->m_ho, prms->m_hdst, 1);
+	}
+}
+
+/*!
+ Set a HDOE level, on the worker too when it is running.
+ @param[in,out] prms A pointer to a #AKSCPRMS structure.
+ @param[in] hdst HDOE level
+ */
+static void setHDOELevel(AKSCPRMS* prms, const AKSC_HDST hdst)
+{
+	AKSC_SetHDOELevel(
+		&prms->m_hdoev,
+		&prms->m_ho,
+		hdst,
+		1
+	);
+	prms->m_hdst = hdst;
+	if (HDOEWorker_IsRunning()) {
+		HDOEWorker_Reset(HDOEW_RESET_LEVEL, &prms->m_ho, hdst, 1);
+	}
+}
+
+/*!
+ Take over the offset estimated by HDOE.
+ @param[in,out] prms A pointer to a #AKSCPRMS structure.
+ @param[in] ho Offset
+ @param[in] hdst HDOE level
+ @param[in] hdSucc Return value of AKSC_HDOEProcessS3
+ */
+static void updateHOffset(
+	AKSCPRMS*		prms,
+	const int16vec*	ho,
+	const AKSC_HDST	hdst,
+	const int16		hdSucc)
+{
+	prms->m_ho = *ho;
+	prms->m_hdst = hdst;
+	if (hdSucc > 0) {
+		prms->HSUC_HO[prms->m_form] = prms->m_ho;
+		prms->m_ho32.u.x = (int32)prms->m_ho.u.x;
+		prms->m_ho32.u.y = (int32)prms->m_ho.u.y;
+		prms->m_ho32.u.z = (int32)prms->m_ho.u.z;
+
+		prms->HSUC_HDST[prms->m_form] = prms->m_hdst;
+		prms->HFLUCV_HREF[prms->m_form] = prms->m_hflucv.href;
+		prms->HSUC_HBASE[prms->m_form] = prms->m_hbase;
+	}
+}
+
+static void latencyAdd(AKMD_LATENCY_HIST* h, const int64_t ns)
+{
+	int64_t us = ns / 1000;
+	int16 i = 0;
+
+	while ((us >>= 1) > 0 && i < (AKMD_LATENCY_BINS - 1)) {
+		i++;
+	}
+	h->bin[i]++;
+	h->count++;
+	if (ns > h->max) {
+		h->max = ns;
+	}
+}
+
+static void latencyDump(const AKMD_LATENCY_HIST* h)
+{
+	char buf[AKMD_LATENCY_BINS * 12];
+	int16 i;
+	int len = 0;
+
+	for (i = 0; i < AKMD_LATENCY_BINS; i++) {
+		len += snprintf(buf + len, sizeof(buf) - len, " %u", h->bin[i]);
+	}
+	ALOGI("GetMagneticVector latency: n=%u max=%lldus log2(us) bins:%s",
+		h->count, (long long)(h->max / 1000), buf);
+}
+
 /*!
  Initialize #AKSCPRMS structure. At first, 0 is set to all parameters.
  After that, some parameters, which should not be 0, are set to specific
@@ -436,12 +537,7 @@ int16 Init_Measure(AKSCPRMS* prms)
 	}
 
 	// Initialize HDOE parameters
-	AKSC_InitHDOEProcPrmsS3(
-							&prms->m_hdoev,
-							1,
-							&prms->m_ho,
-							prms->m_hdst
-							);
+	initHDOE(prms);
 
 	AKSC_InitHFlucCheck(
 						&(prms->m_hflucv),
@@ -567,6 +663,10 @@ void MeasureSNGLoop(AKSCPRMS* prms)
 	int64_t minVal; /* The minimum duration to the next event */
 	int measuring = 0; /* The value is 1, if while measuring. */
 
+	struct timespec vecStart, vecEnd;
+	AKMD_LATENCY_HIST latency;
+	memset(&latency, 0, sizeof(latency));
+
 	if (openForm() < 0) {
 		AKMERROR;
 		return;
@@ -577,6 +677,13 @@ void MeasureSNGLoop(AKSCPRMS* prms)
 		goto MEASURE_SNG_END;
 	}
 
+#if CSPEC_ASYNC_HDOE
+	if (!HDOEWorker_Start(prms)) {
+		ALOGW("%s: HDOE worker is not available, run it inline.",
+			__FUNCTION__);
+	}
+#endif
+
 	/* Get initial interval */
 	if (GetInterval(
 				&acc_mes, &mag_mes,
@@ -691,15 +798,22 @@ void MeasureSNGLoop(AKSCPRMS* prms)
 						bData[i] = i2cData[i];
 					}
 
+					clock_gettime(CLOCK_MONOTONIC, &vecStart);
 					ret = GetMagneticVector(
 							bData,
 							prms,
 							checkForm(),
 							hdoe_interval);
+					clock_gettime(CLOCK_MONOTONIC, &vecEnd);
+					latencyAdd(&latency, CalcDuration(&vecEnd, &vecStart));
+					if ((g_dbgzone & AKMDBG_EXECTIME) &&
+						(latency.count % AKMD_LATENCY_DUMP) == 0) {
+						latencyDump(&latency);
+					}
 
 					// Check the return value
 					if ((ret != AKRET_PROC_SUCCEED) && (ret != AKRET_FORMATION_CHANGED)) {
-						ALOGE("GetMagneticVector has failed (0x%04X).\n", ret);
+						HOT_LOGE("GetMagneticVector has failed (0x%04X).\n", ret);
 					}
 
 					AKMDEBUG(AKMDBG_VECTOR, "mag(dec)=%6d,%6d,%6d\n",
@@ -759,6 +873,11 @@ void MeasureSNGLoop(AKSCPRMS* prms)
 	}
 
 MEASURE_SNG_END:
+	HDOEWorker_Stop();
+	if (latency.count > 0) {
+		latencyDump(&latency);
+	}
+
 	// Disable all sensors
 	if (AKD_SetMode(AKM_MODE_POWERDOWN) != AKD_SUCCESS) {AKMERROR;}
 	if (AKD_AccSetEnable(AKD_DISABLE)   != AKD_SUCCESS) {AKMERROR;}
@@ -794,6 +913,9 @@ int16 GetMagneticVector(
 	int16		overflow;
 	int16		hfluc;
 	int16		hdSucc;
+	int16vec	hoffset;
+	AKSC_HDST	hdst;
+	HDOEW_RESULT	hdoeResult;
 	int16		aksc_ret;
 	int16		ret;
 	int16		doep_ret;
@@ -840,12 +962,7 @@ int16 GetMagneticVector(
 			}
 
 			// Initialize HDOE parameters
-			AKSC_InitHDOEProcPrmsS3(
-				&prms->m_hdoev,
-				1,
-				&prms->m_ho,
-				prms->m_hdst
-			);
+			initHDOE(prms);
 
 			// Initialize HFlucCheck parameters
 			AKSC_InitHFlucCheck(
@@ -875,7 +992,7 @@ int16 GetMagneticVector(
 				);
 	if(g_akmlog_enable)
 		{
-		ALOGE("%s: ST1, HXH&HXL, HYH&HYL, HZH&HZL, ST2,"
+		HOT_LOGI("%s: ST1, HXH&HXL, HYH&HYL, HZH&HZL, ST2,"
 				" hdata[0].u.x, hdata[0].u.y, hdata[0].u.z,"
 				" asax, asay, asaz ="
 				" %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d\n",
@@ -923,13 +1040,7 @@ int16 GetMagneticVector(
 	if (hofl == 1) {
 		if (prms->m_cntSuspend <= 0) {
 			// Set a HDOE level as "HDST_UNSOLVED"
-			AKSC_SetHDOELevel(
-							  &prms->m_hdoev,
-							  &prms->m_ho,
-							  AKSC_HDST_UNSOLVED,
-							  1
-							  );
-			prms->m_hdst = AKSC_HDST_UNSOLVED;
+			setHDOELevel(prms, AKSC_HDST_UNSOLVED);
 		}
 		ret |= AKRET_DATA_OVERFLOW;
 		return ret;
@@ -957,13 +1068,7 @@ int16 GetMagneticVector(
 		);
 
 		if (prms->m_cntSuspend <= 0) {
-			AKSC_SetHDOELevel(
-				&prms->m_hdoev,
-				&prms->m_ho,
-				AKSC_HDST_UNSOLVED,
-				1
-			);
-			prms->m_hdst = AKSC_HDST_UNSOLVED;
+			setHDOELevel(prms, AKSC_HDST_UNSOLVED);
 		}
 
 		ret |= AKRET_HBASE_CHANGED;
@@ -976,13 +1081,7 @@ int16 GetMagneticVector(
 
 		if (hfluc == 1) {
 			// Set a HDOE level as "HDST_UNSOLVED"
-			AKSC_SetHDOELevel(
-				&prms->m_hdoev,
-				&prms->m_ho,
-				AKSC_HDST_UNSOLVED,
-				1
-			);
-			prms->m_hdst = AKSC_HDST_UNSOLVED;
+			setHDOELevel(prms, AKSC_HDST_UNSOLVED);
 			ret |= AKRET_HFLUC_OCCURRED;
 			return ret;
 		}
@@ -1018,43 +1117,32 @@ int16 GetMagneticVector(
 					}
 				}
 				//Calculate Magnetic sensor's offset by DOE
-				if (prms->m_en_doeplus == 1) {
+				if (HDOEWorker_IsRunning()) {
+					// The result is picked up by a later call.
+					HDOEWorker_Post(
+						(prms->m_en_doeplus == 1) ?
+							prms->m_hdata_plus : prms->m_hdata,
+						prms->m_hn);
+				} else {
+					hoffset = prms->m_ho;
+					hdst = prms->m_hdst;
 					hdSucc = AKSC_HDOEProcessS3(
 								prms->m_licenser,
 								prms->m_licensee,
 								prms->m_key,
 								&prms->m_hdoev,
-								prms->m_hdata_plus,
+								(prms->m_en_doeplus == 1) ?
+									prms->m_hdata_plus : prms->m_hdata,
 								prms->m_hn,
-								&prms->m_ho,
-								&prms->m_hdst
+								&hoffset,
+								&hdst
 							 );
-				} else {
-				hdSucc = AKSC_HDOEProcessS3(
-							prms->m_licenser,
-							prms->m_licensee,
-							prms->m_key,
-							&prms->m_hdoev,
-							prms->m_hdata,
-							prms->m_hn,
-							&prms->m_ho,
-							&prms->m_hdst
-						 );
-				}
 
-				if (hdSucc == AKSC_CERTIFICATION_DENIED) {
-					AKMERROR;
-					return AKRET_PROC_FAIL;
-				}
-				if (hdSucc > 0) {
-					prms->HSUC_HO[prms->m_form] = prms->m_ho;
-					prms->m_ho32.u.x = (int32)prms->m_ho.u.x;
-					prms->m_ho32.u.y = (int32)prms->m_ho.u.y;
-					prms->m_ho32.u.z = (int32)prms->m_ho.u.z;
-
-					prms->HSUC_HDST[prms->m_form] = prms->m_hdst;
-					prms->HFLUCV_HREF[prms->m_form] = prms->m_hflucv.href;
-					prms->HSUC_HBASE[prms->m_form] = prms->m_hbase;
+					if (hdSucc == AKSC_CERTIFICATION_DENIED) {
+						AKMERROR;
+						return AKRET_PROC_FAIL;
+					}
+					updateHOffset(prms, &hoffset, hdst, hdSucc);
 				}
 
 				//Set decimator counter
@@ -1063,6 +1151,19 @@ int16 GetMagneticVector(
 		}
 	}
 
+	// Use the latest offset published by the HDOE worker
+	if (HDOEWorker_IsRunning() && HDOEWorker_Fetch(&hdoeResult)) {
+		if (hdoeResult.succ == AKSC_CERTIFICATION_DENIED) {
+			AKMERROR;
+			return AKRET_PROC_FAIL;
+		}
+		updateHOffset(prms, &hdoeResult.ho, hdoeResult.hdst,
+					  hdoeResult.succ);
+		// The worker owns the live AKSC_HDOEVAR; mirror what DispMessage shows.
+		prms->m_hdoev.hthIdx = hdoeResult.hthIdx;
+		prms->m_hdoev.hrdoeHR = hdoeResult.hrdoeHR;
+	}
+
 	if (prms->m_en_doeplus == 1) {
 		// Calculate compensated vector
 		AKSC_DOEPlus_DistCompen(&have, prms->m_doep_var, &have);
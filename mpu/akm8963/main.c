@@ -161,7 +161,7 @@ void Disp_MeasurementResultHook(AKSCPRMS* prms, const uint16 flag)
 	 rbuf[13] = prms->m_theta;	/* yaw   */
 	 rbuf[14] = prms->m_phi180;	/* pitch */
 	 rbuf[15] = prms->m_eta90;	/* roll  */
-	 ALOGI("--------------rbuf[]1 2 3, 5 6 7, 13 14 15 =%d %d %d,%d %d %d, %d %d %d\n",rbuf[1],rbuf[2],rbuf[3],rbuf[5],rbuf[6],rbuf[7],rbuf[13]/64,rbuf[14]/64,rbuf[15]/64);
+	 HOT_LOGV("--------------rbuf[]1 2 3, 5 6 7, 13 14 15 =%d %d %d,%d %d %d, %d %d %d\n",rbuf[1],rbuf[2],rbuf[3],rbuf[5],rbuf[6],rbuf[7],rbuf[13]/64,rbuf[14]/64,rbuf[15]/64);
 	 /* Gravity (from AKSC format to Q16 format) */
 	 rbuf[16] = CONVERT_AKSC_Q16(prms->m_pgGravity.u.x);
 	 rbuf[17] = CONVERT_AKSC_Q16(prms->m_pgGravity.u.y);
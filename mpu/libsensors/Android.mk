@@ -128,7 +128,18 @@ endif
 LOCAL_SRC_FILES += SensorBase.cpp
 LOCAL_SRC_FILES += MPLSensor.cpp
 LOCAL_SRC_FILES += MPLSupport.cpp
+LOCAL_SRC_FILES += GyroTempSampler.cpp
 LOCAL_SRC_FILES += InputEventReader.cpp
+LOCAL_SRC_FILES += ../../common/sensor_log.c
+LOCAL_SRC_FILES += ../../common/sysfs_root.c
+LOCAL_SRC_FILES += ../../common/iio_scan.c
+LOCAL_SRC_FILES += ../../common/sample_gap.c
+LOCAL_SRC_FILES += ../../common/sensor_stats.c
+LOCAL_SRC_FILES += ../../common/sensor_trace.c
+LOCAL_SRC_FILES += ../../common/debug_config.c
+
+# hot path log ceiling, see common/sensor_log.h
+LOCAL_CFLAGS += -DSENSOR_LOG_LEVEL=SENSOR_LOG_LEVEL_WARN
 
 ifneq (,$(filter $(TARGET_BUILD_VARIANT),eng userdebug))
 ifeq ($(COMPILE_INVENSENSE_COMPASS_CAL),0)
@@ -151,6 +162,7 @@ LOCAL_C_INCLUDES += $(LOCAL_PATH)/$(BIN_PATH)/core/mllite
 LOCAL_C_INCLUDES += $(LOCAL_PATH)/$(BIN_PATH)/core/mllite/linux
 LOCAL_C_INCLUDES += $(LOCAL_PATH)/$(BIN_PATH)/core/driver/include
 LOCAL_C_INCLUDES += $(LOCAL_PATH)/$(BIN_PATH)/core/driver/include/linux
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../../common
 #LOCAL_C_INCLUDES += $(LOCAL_PATH)/yamaha/inc
 #LOCAL_C_INCLUDES += $(LOCAL_PATH)/yamaha/lib
 
@@ -242,5 +254,5 @@ LOCAL_SHARED_LIBRARIES += liblog
 LOCAL_SHARED_LIBRARIES += libmllite
 include $(BUILD_SHARED_LIBRARY)
 
-
-
+# virtual IIO device, HAL bench and host tools, last as it sets LOCAL_PATH
+include $(LOCAL_PATH)/sim/Android.mk
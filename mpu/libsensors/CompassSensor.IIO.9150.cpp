@@ -395,8 +395,8 @@ int CompassSensor::inv_init_sysfs_attributes(void)
 
     // get proper (in absolute/relative) IIO path & build MPU's sysfs paths
     // inv_get_sysfs_abs_path(sysfs_path);
-    inv_get_sysfs_path(sysfs_path);
-    inv_get_iio_trigger_path(iio_trigger_path);
+    inv_root_sysfs_path(sysfs_path, sizeof(sysfs_path));
+    inv_root_iio_trigger_path(iio_trigger_path, sizeof(iio_trigger_path));
 
     if (strcmp(sysfs_path, "") == 0  || strcmp(iio_trigger_path, "") == 0)
         return 0;
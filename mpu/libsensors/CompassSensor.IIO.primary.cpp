@@ -31,6 +31,7 @@
 #include "MPLSupport.h"
 #include "sensor_params.h"
 #include "ml_sysfs_helper.h"
+#include "sysfs_root.h"
 //#include "log.h"
 
 #define COMPASS_MAX_SYSFS_ATTRB sizeof(compassSysFs) / sizeof(char*)
@@ -156,7 +157,8 @@ void CompassSensor::enable_iio_sysfs()
     VFUNC_LOG;
 
     int tempFd = 0;
-    char iio_trigger_name[MAX_CHIP_ID_LEN], iio_device_node[MAX_CHIP_ID_LEN];
+    char iio_trigger_name[MAX_CHIP_ID_LEN];
+    char iio_device_node[MAX_SYSFS_NAME_LEN];
     FILE *tempFp = NULL;
     const char* compass = dev_full_name;
 
@@ -209,8 +211,8 @@ void CompassSensor::enable_iio_sysfs()
         fclose(tempFp);
     }
 
-    sprintf(iio_device_node, "%s%d", "/dev/iio:device",
-            find_type_by_name(compass, "iio:device"));
+    sysfs_root_path(iio_device_node, sizeof(iio_device_node),
+            "/dev/iio:device%d", inv_root_find_device(compass));
     compass_fd = open(iio_device_node, O_RDONLY);
     int res = errno;
     if (compass_fd < 0) {
@@ -588,10 +590,12 @@ int CompassSensor::inv_init_sysfs_attributes(void)
     } while (++i < COMPASS_MAX_SYSFS_ATTRB);
 
     // get proper (in absolute/relative) IIO path & build sysfs paths
-    sprintf(sysfs_path, "%s%d", "/sys/bus/iio/devices/iio:device",
-        find_type_by_name(compass, "iio:device"));
-    sprintf(iio_trigger_path, "%s%d", "/sys/bus/iio/devices/trigger",
-        find_type_by_name(compass, "iio:device"));
+    sysfs_root_path(sysfs_path, sizeof(sysfs_path),
+        "/sys/bus/iio/devices/iio:device%d",
+        inv_root_find_device(compass));
+    sysfs_root_path(iio_trigger_path, sizeof(iio_trigger_path),
+        "/sys/bus/iio/devices/trigger%d",
+        inv_root_find_device(compass));
 
 #if defined COMPASS_AK8975
     inv_get_input_number(compass, &num);
@@ -0,0 +1,213 @@
+/*
+* Copyright (C) 2012 Invensense, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cutils/log.h>
+
+#include "SensorBase.h"
+#include "MPLSupport.h"
+#include "GyroTempSampler.h"
+
+/* keep the sampler below the poll thread */
+#define TEMP_SAMPLER_NICE   (10)
+
+GyroTempSampler::GyroTempSampler()
+    : mFd(-1),
+      mRunning(false),
+      mStop(false),
+      mActive(false),
+      mPeriod(DEFAULT_TEMP_PERIOD_NS),
+      mSeen(0)
+{
+    pthread_condattr_t attr;
+
+    memset(&mSlot, 0, sizeof(mSlot));
+    pthread_mutex_init(&mLock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&mCond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+GyroTempSampler::~GyroTempSampler()
+{
+    stop();
+    pthread_cond_destroy(&mCond);
+    pthread_mutex_destroy(&mLock);
+}
+
+/**
+ *  Start sampling @a fd. The fd stays owned by the caller and must stay
+ *  open until stop() returns. Sampling is paused until setActive(1).
+ */
+int GyroTempSampler::start(int fd)
+{
+    VFUNC_LOG;
+
+    if (mRunning)
+        return 0;
+    if (fd < 0)
+        return -1;
+
+    mFd = fd;
+    mStop = false;
+    if (pthread_create(&mThread, NULL, threadMain, this) != 0) {
+        LOGE("HAL:could not start the temperature sampler");
+        return -1;
+    }
+    mRunning = true;
+    return 0;
+}
+
+void GyroTempSampler::stop()
+{
+    VFUNC_LOG;
+
+    if (!mRunning)
+        return;
+
+    pthread_mutex_lock(&mLock);
+    mStop = true;
+    pthread_cond_signal(&mCond);
+    pthread_mutex_unlock(&mLock);
+    pthread_join(mThread, NULL);
+    mRunning = false;
+}
+
+/**
+ *  Sample only while the gyro is on; the first reading is taken right
+ *  away so TC has a temperature for the first gyro samples.
+ */
+void GyroTempSampler::setActive(int active)
+{
+    pthread_mutex_lock(&mLock);
+    mActive = !!active;
+    pthread_cond_signal(&mCond);
+    pthread_mutex_unlock(&mLock);
+}
+
+void GyroTempSampler::setPeriod(int64_t ns)
+{
+    if (ns < MIN_TEMP_PERIOD_NS)
+        ns = MIN_TEMP_PERIOD_NS;
+
+    pthread_mutex_lock(&mLock);
+    mPeriod = ns;
+    pthread_cond_signal(&mCond);
+    pthread_mutex_unlock(&mLock);
+}
+
+/**
+ *  @return true and the reading if a new one was published since the
+ *          last call, false otherwise. Never blocks.
+ */
+bool GyroTempSampler::get(long long *temperature, long long *timestamp)
+{
+    uint32_t seq = __atomic_load_n(&mSlot.seq, __ATOMIC_ACQUIRE);
+    long long t, ts;
+
+    if ((seq & 1) || seq == mSeen)
+        return false;
+    t = mSlot.temperature;
+    ts = mSlot.timestamp;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&mSlot.seq, __ATOMIC_RELAXED) != seq)
+        return false;   // being written, pick it up next time
+
+    mSeen = seq;
+    *temperature = t;
+    *timestamp = ts;
+    return true;
+}
+
+void *GyroTempSampler::threadMain(void *arg)
+{
+    setpriority(PRIO_PROCESS, (id_t)syscall(__NR_gettid), TEMP_SAMPLER_NICE);
+    static_cast<GyroTempSampler *>(arg)->run();
+    return NULL;
+}
+
+void GyroTempSampler::run()
+{
+    long long temperature, timestamp;
+    struct timespec deadline;
+
+    pthread_mutex_lock(&mLock);
+    while (!mStop) {
+        if (!mActive) {
+            pthread_cond_wait(&mCond, &mLock);
+            continue;
+        }
+        pthread_mutex_unlock(&mLock);
+
+        if (read(&temperature, &timestamp) == 0) {
+            __atomic_store_n(&mSlot.seq, mSlot.seq + 1, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+            mSlot.temperature = temperature;
+            mSlot.timestamp = timestamp;
+            __atomic_store_n(&mSlot.seq, mSlot.seq + 1, __ATOMIC_RELEASE);
+        }
+
+        pthread_mutex_lock(&mLock);
+        if (mStop || !mActive)
+            continue;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += mPeriod / 1000000000LL;
+        deadline.tv_nsec += mPeriod % 1000000000LL;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        /* setActive() and setPeriod() cut the wait short */
+        pthread_cond_timedwait(&mCond, &mLock, &deadline);
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+int GyroTempSampler::read(long long *temperature, long long *timestamp)
+{
+    VHANDLER_LOG;
+
+    char raw_buf[40];
+    long raw = 0;
+    long long ts = 0;
+    int count;
+
+    memset(raw_buf, 0, sizeof(raw_buf));
+    count = read_attribute_sensor(mFd, raw_buf, sizeof(raw_buf) - 1);
+    if (count < 1) {
+        LOGE("HAL:error reading gyro temperature");
+        return -1;
+    }
+
+    count = sscanf(raw_buf, "%ld%lld", &raw, &ts);
+    if (count < 1) {
+        return -1;
+    }
+
+    LOGV_IF(ENG_VERBOSE,
+            "HAL:temperature raw = %ld, timestamp = %lld, count = %d",
+            raw, ts, count);
+    *temperature = raw;
+    *timestamp = ts;
+    return 0;
+}
@@ -0,0 +1,65 @@
+/*
+* Copyright (C) 2012 Invensense, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef ANDROID_GYRO_TEMP_SAMPLER_H
+#define ANDROID_GYRO_TEMP_SAMPLER_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define DEFAULT_TEMP_PERIOD_NS      (500000000LL)
+#define MIN_TEMP_PERIOD_NS          (10000000LL)
+
+/*
+ * Reads the gyro temperature attribute ("<raw> <timestamp>") on a helper
+ * thread so the gyro path never blocks on sysfs.  The latest reading is
+ * published through a sequence-locked slot; get() is wait-free and must
+ * only be called from one thread.
+ */
+class GyroTempSampler {
+public:
+    GyroTempSampler();
+    ~GyroTempSampler();
+
+    int start(int fd);
+    void stop();
+    void setActive(int active);
+    void setPeriod(int64_t ns);
+    bool get(long long *temperature, long long *timestamp);
+
+private:
+    static void *threadMain(void *arg);
+    void run();
+    int read(long long *temperature, long long *timestamp);
+
+    int mFd;
+    pthread_t mThread;
+    pthread_mutex_t mLock;
+    pthread_cond_t mCond;
+    bool mRunning;
+    bool mStop;             // under mLock
+    bool mActive;           // under mLock
+    int64_t mPeriod;        // under mLock
+
+    struct {
+        uint32_t seq;
+        long long temperature;
+        long long timestamp;
+    } mSlot;
+    uint32_t mSeen;         // owned by the get() caller
+};
+
+#endif // ANDROID_GYRO_TEMP_SAMPLER_H
@@ -27,9 +27,11 @@
 #include <stdlib.h>
 #include <sys/select.h>
 #include <sys/syscall.h>
+#include <time.h>
 #include <dlfcn.h>
 #include <pthread.h>
 #include <cutils/log.h>
+#include <cutils/properties.h>
 #include <utils/KeyedVector.h>
 #include <utils/String8.h>
 #include <string.h>
@@ -39,6 +41,10 @@
 #include "MPLSensor.h"
 #include "MPLSupport.h"
 #include "sensor_params.h"
+#include "sensor_log.h"
+#include "iio_scan.h"
+#include "sample_gap.h"
+#include "sensor_trace.h"
 
 #include "invensense.h"
 #include "invensense_adv.h"
@@ -65,6 +71,50 @@
 
 #define MAX_SYSFS_ATTRB (sizeof(struct sysfs_attrbs) / sizeof(char*))
 
+/******************************************************************************/
+/*  MPL algorithm modules                                                     */
+/******************************************************************************/
+/* exported by libmplmpu but missing from its headers */
+extern "C" {
+inv_error_t inv_start_compass_bias_w_gyro(void);
+inv_error_t inv_stop_compass_bias_w_gyro(void);
+inv_error_t inv_start_magnetic_disturbance(void);
+inv_error_t inv_stop_magnetic_disturbance(void);
+inv_error_t inv_stop_quaternion(void);
+inv_error_t inv_stop_no_gyro_fusion(void);
+}
+
+/* in start order, a module only depends on modules above it */
+static const struct {
+    uint32_t mask;
+    const char *name;
+    inv_error_t (*start)(void);
+    inv_error_t (*stop)(void);
+} sMplModules[] = {
+    { INV_MOD_HAL_OUTPUTS, "hal_outputs",
+      inv_start_hal_outputs, inv_stop_hal_outputs },
+    { INV_MOD_FAST_NOMOT, "fast_nomot",
+      inv_start_fast_nomot, inv_stop_fast_nomot },
+    { INV_MOD_GYRO_TC, "gyro_tc",
+      inv_start_gyro_tc, inv_stop_gyro_tc },
+    { INV_MOD_QUATERNION, "quaternion",
+      inv_start_quaternion, inv_stop_quaternion },
+    { INV_MOD_COMPASS_CAL, "vector_compass_cal",
+      inv_start_vector_compass_cal, inv_stop_vector_compass_cal },
+    { INV_MOD_COMPASS_BIAS_W_GYRO, "compass_bias_w_gyro",
+      inv_start_compass_bias_w_gyro, inv_stop_compass_bias_w_gyro },
+    { INV_MOD_9X_FUSION, "9x_sensor_fusion",
+      inv_start_9x_sensor_fusion, inv_stop_9x_sensor_fusion },
+    { INV_MOD_NO_GYRO_FUSION, "no_gyro_fusion",
+      inv_start_no_gyro_fusion, inv_stop_no_gyro_fusion },
+    { INV_MOD_HEADING_FROM_GYRO, "heading_from_gyro",
+      inv_start_heading_from_gyro, inv_stop_heading_from_gyro },
+    { INV_MOD_MAG_DISTURB, "magnetic_disturbance",
+      inv_start_magnetic_disturbance, inv_stop_magnetic_disturbance },
+    { INV_MOD_QUAT_ACCURACY, "quat_accuracy_monitor",
+      inv_start_quat_accuracy_monitor, inv_stop_quat_accuracy_monitor },
+};
+
 /******************************************************************************/
 /*  MPL interface misc.                                                       */
 /******************************************************************************/
@@ -287,7 +337,7 @@ static int self_test_auto_load_state_read(void)
     int res = 0;
     int fd;
 
-    inv_get_sysfs_path(sysfs_path);
+    inv_root_sysfs_path(sysfs_path, sizeof(sysfs_path));
     strcat(sysfs_path, cal_data_auto_load_path);
 
     fd = open(sysfs_path, O_RDONLY);
@@ -322,7 +372,7 @@ static void self_test_auto_load_state_write(int en)
     int res = 0;
     int fd;
 
-    inv_get_sysfs_path(sysfs_path);
+    inv_root_sysfs_path(sysfs_path, sizeof(sysfs_path));
     strcat(sysfs_path, cal_data_auto_load_path);
 
     fd = open(sysfs_path, O_WRONLY);
@@ -366,7 +416,6 @@ MPLSensor::MPLSensor(CompassSensor *compass, int (*m_pt2AccelCalLoadFunc)(long *
                          mGyroInputReader(32),
                          mTempScale(0),
                          mTempOffset(0),
-                         mTempCurrentTime(0),
 #if CAL_DATA_AUTO_LOAD == 1
                          mCalDataCurrentTime(0),
 #endif                                                  
@@ -374,7 +423,21 @@ MPLSensor::MPLSensor(CompassSensor *compass, int (*m_pt2AccelCalLoadFunc)(long *
                          mGyroScale(2000),
                          mPendingMask(0),
                          mSensorMask(0),
-                         mFeatureActiveMask(0) {
+                         mFeatureActiveMask(0),
+                         mMplModules(0),
+                         mMplModulesAvail(0),
+                         mMplModulesWanted(0),
+                         mMplCpuSamples(0),
+                         mMplCpuNs(0),
+                         mOdrGovEnabled(false),
+                         mOdrGovState(ODR_GOV_FULL),
+                         mNoMotionSince(0),
+                         mOdrGovSince(0),
+                         mOdrGovReported(0),
+                         mOdrGovSwitches(0),
+                         mOdrGovPending(false),
+                         mOdrGovStop(false),
+                         mOdrGovRunning(false) {
     VFUNC_LOG;
 
     inv_error_t rv;
@@ -394,6 +457,10 @@ MPLSensor::MPLSensor(CompassSensor *compass, int (*m_pt2AccelCalLoadFunc)(long *
     pthread_mutex_init(&mHALMutex, NULL);
     memset(mGyroOrientation, 0, sizeof(mGyroOrientation));
     memset(mAccelOrientation, 0, sizeof(mAccelOrientation));
+    sample_gap_init(&mGyroGap, "mpl gyro");
+    sample_gap_init(&mAccelGap, "mpl accel");
+    sample_gap_init(&mCompassGap, "mpl compass");
+    mTraceBuiltCount = 0;
 
 #ifdef INV_PLAYBACK_DBG
     LOGV_IF(PROCESS_VERBOSE, "HAL:inv_turn_on_data_logging");
@@ -406,7 +473,7 @@ MPLSensor::MPLSensor(CompassSensor *compass, int (*m_pt2AccelCalLoadFunc)(long *
     inv_init_sysfs_attributes();
 
     /* get chip name */
-    if (inv_get_chip_name(chip_ID) != INV_SUCCESS) {
+    if (inv_root_chip_name(chip_ID, sizeof(chip_ID)) < 0) {
         LOGE("HAL:ERR- Failed to get chip ID\n");
     } else {
         LOGV_IF(PROCESS_VERBOSE, "HAL:Chip ID= %s\n", chip_ID);
@@ -433,6 +500,12 @@ MPLSensor::MPLSensor(CompassSensor *compass, int (*m_pt2AccelCalLoadFunc)(long *
     } else {
         LOGV_IF(EXTRA_VERBOSE,
                 "HAL:temperature_fd opened: %s", mpu.temperature);
+        /* read off the gyro path, see buildMpuEvent() */
+        char propbuf[PROPERTY_VALUE_MAX];
+        property_get("sensor.mpl.temp_period_ms", propbuf, "");
+        if (propbuf[0])
+            mTempSampler.setPeriod(atoll(propbuf) * 1000000LL);
+        mTempSampler.start(gyro_temperature_fd);
     }
 
     /* read gyro FSR to calculate accel scale later */
@@ -541,6 +614,27 @@ MPLSensor::MPLSensor(CompassSensor *compass, int (*m_pt2AccelCalLoadFunc)(long *
 
     for (int i = 0; i < NumSensors; i++) {
         mDelays[i] = 1000000000LL;
+        mHoldTs[i] = 0;
+        mRealTs[i] = 0;
+    }
+
+    {
+        char propbuf[PROPERTY_VALUE_MAX];
+        property_get("sensor.mpl.odr_governor", propbuf, "0");
+        mOdrGovEnabled = (atoi(propbuf) != 0);
+        memset(mOdrGovTime, 0, sizeof(mOdrGovTime));
+        mOdrGovSince = mOdrGovReported = getTimestamp();
+        pthread_mutex_init(&mOdrGovLock, NULL);
+        pthread_cond_init(&mOdrGovCond, NULL);
+        if (mOdrGovEnabled) {
+            if (pthread_create(&mOdrGovThread, NULL, odrGovThread, this)) {
+                LOGE("HAL:could not start the ODR governor thread");
+                mOdrGovEnabled = false;
+            } else {
+                mOdrGovRunning = true;
+            }
+        }
+        LOGI_IF(mOdrGovEnabled, "HAL:motion-adaptive ODR governor on");
     }
 
     (void)inv_get_version(&ver_str);
@@ -613,7 +707,8 @@ void MPLSensor::enable_iio_sysfs()
 {
     VFUNC_LOG;
 
-    char iio_trigger_name[MAX_CHIP_ID_LEN], iio_device_node[MAX_CHIP_ID_LEN];
+    char iio_trigger_name[MAX_CHIP_ID_LEN];
+    char iio_device_node[MAX_SYSFS_NAME_LEN];
     FILE *tempFp = NULL;
 
     LOGV_IF(SYSFS_VERBOSE, "HAL:sysfs:echo 1 > %s (%lld)",
@@ -668,8 +763,9 @@ void MPLSensor::enable_iio_sysfs()
         fclose(tempFp);
     }
 
-    inv_get_iio_device_node(iio_device_node);
+    inv_root_iio_device_node(iio_device_node, sizeof(iio_device_node));
     iio_fd = open(iio_device_node, O_RDONLY);
+    mScanKey = -1;
     if (iio_fd < 0) {
         LOGE("HAL:could not open iio device node");
     } else {
@@ -694,6 +790,12 @@ int MPLSensor::inv_constructor_init()
         return result;
     }
 
+    /* everything enabled above has been started, keep only what the
+       enabled sensors need */
+    mMplModules = mMplModulesAvail;
+    mMplModulesWanted = computeMplModules(mEnabled);
+    applyMplModules(mMplModulesWanted);
+
     return result;
 }
 
@@ -719,11 +821,15 @@ ANY VIOLATION OF SUCH TERMS AND CONDITIONS WILL BE STRICTLY ENFORCED.
 
 *******************************************************************************/
 
+    /* Every module is enabled here so that its calibration data is
+       registered with the storage manager once and for all; the ones no
+       enabled sensor needs are stopped again in applyMplModules(). */
     result = inv_enable_quaternion();
     if (result) {
         LOGE("HAL:Cannot enable quaternion\n");
         return result;
     }
+    mMplModulesAvail |= INV_MOD_QUATERNION;
     
 #if 0
     result = inv_enable_in_use_auto_calibration();
@@ -742,16 +848,19 @@ ANY VIOLATION OF SUCH TERMS AND CONDITIONS WILL BE STRICTLY ENFORCED.
     if (result) {
         return result;
     }
+    mMplModulesAvail |= INV_MOD_FAST_NOMOT;
 
     result = inv_enable_gyro_tc();
     if (result) {
         return result;
     }
+    mMplModulesAvail |= INV_MOD_GYRO_TC;
 
     result = inv_enable_hal_outputs();
     if (result) {
         return result;
     }
+    mMplModulesAvail |= INV_MOD_HAL_OUTPUTS;
 
     if (!mCompassSensor->providesCalibration()) {
         /* Invensense compass calibration */
@@ -762,6 +871,7 @@ ANY VIOLATION OF SUCH TERMS AND CONDITIONS WILL BE STRICTLY ENFORCED.
             return result;
         } else {
             mFeatureActiveMask |= INV_COMPASS_CAL;
+            mMplModulesAvail |= INV_MOD_COMPASS_CAL;
         }
 
         // specify MPL's trust weight, used by compass algorithms
@@ -772,18 +882,21 @@ ANY VIOLATION OF SUCH TERMS AND CONDITIONS WILL BE STRICTLY ENFORCED.
             LOG_RESULT_LOCATION(result);
             return result;
         }
+        mMplModulesAvail |= INV_MOD_COMPASS_BIAS_W_GYRO;
 
         result = inv_enable_heading_from_gyro();
         if (result) {
             LOG_RESULT_LOCATION(result);
             return result;
         }
+        mMplModulesAvail |= INV_MOD_HEADING_FROM_GYRO;
 
         result = inv_enable_magnetic_disturbance();
         if (result) {
             LOG_RESULT_LOCATION(result);
             return result;
         }
+        mMplModulesAvail |= INV_MOD_MAG_DISTURB;
     }
 
     result = inv_enable_9x_sensor_fusion();
@@ -793,6 +906,7 @@ ANY VIOLATION OF SUCH TERMS AND CONDITIONS WILL BE STRICTLY ENFORCED.
     } else {
         // 9x sensor fusion enables Compass fit
         mFeatureActiveMask |= INV_COMPASS_FIT;
+        mMplModulesAvail |= INV_MOD_9X_FUSION;
     }
 
     result = inv_enable_no_gyro_fusion();
@@ -800,16 +914,229 @@ ANY VIOLATION OF SUCH TERMS AND CONDITIONS WILL BE STRICTLY ENFORCED.
         LOG_RESULT_LOCATION(result);
         return result;
     }
+    mMplModulesAvail |= INV_MOD_NO_GYRO_FUSION;
 
     result = inv_enable_quat_accuracy_monitor();
     if (result) {
         LOG_RESULT_LOCATION(result);
         return result;
     }
+    mMplModulesAvail |= INV_MOD_QUAT_ACCURACY;
 
     return result;
 }
 
+/**
+ *  The MPL modules needed by the sensors in @a enabled (MPLSensor enum bits).
+ */
+uint32_t MPLSensor::computeMplModules(uint32_t enabled)
+{
+    uint32_t mods = INV_MOD_HAL_OUTPUTS;
+
+    if (enabled & ((1 << Orientation) | (1 << RotationVector))) {
+        mods |= INV_MOD_9X_FUSION | INV_MOD_NO_GYRO_FUSION
+                | INV_MOD_MAG_DISTURB | INV_MOD_QUAT_ACCURACY
+                | INV_MOD_HEADING_FROM_GYRO | INV_MOD_COMPASS_BIAS_W_GYRO;
+    }
+    if (enabled & ((1 << LinearAccel) | (1 << Gravity))) {
+        mods |= INV_MOD_QUATERNION;
+    }
+    if (enabled & (1 << MagneticField)) {
+        // compass fit comes with 9x fusion
+        mods |= INV_MOD_COMPASS_BIAS_W_GYRO | INV_MOD_9X_FUSION;
+    }
+    if (enabled & (1 << Gyro)) {
+        mods |= INV_MOD_FAST_NOMOT | INV_MOD_GYRO_TC;
+    }
+
+    /* dependencies */
+    if (mods & (INV_MOD_9X_FUSION | INV_MOD_HEADING_FROM_GYRO
+                | INV_MOD_MAG_DISTURB | INV_MOD_QUAT_ACCURACY)) {
+        mods |= INV_MOD_QUATERNION;
+    }
+    if (mods & INV_MOD_QUATERNION) {
+        // gyro bias for the 6-axis quaternion
+        mods |= INV_MOD_FAST_NOMOT | INV_MOD_GYRO_TC;
+    }
+    if (mods & (INV_MOD_COMPASS_BIAS_W_GYRO | INV_MOD_HEADING_FROM_GYRO)) {
+        mods |= INV_MOD_COMPASS_CAL;
+    }
+
+    return mods & mMplModulesAvail;
+}
+
+/**
+ *  Start and stop MPL modules so that exactly @a wanted is running.
+ *  Must be called from the thread that runs inv_execute_on_data().
+ */
+void MPLSensor::applyMplModules(uint32_t wanted)
+{
+    uint32_t on = wanted & ~mMplModules;
+    uint32_t off = mMplModules & ~wanted;
+    int i;
+
+    if (!on && !off)
+        return;
+
+#if MPL_MODULE_CPU_STATS
+    reportMplCpu();
+#endif
+    LOGV_IF(PROCESS_VERBOSE, "HAL:MPL modules 0x%04x -> 0x%04x",
+            mMplModules, wanted);
+
+    for (i = (int)ARRAY_SIZE(sMplModules) - 1; i >= 0; i--) {
+        if (!(off & sMplModules[i].mask))
+            continue;
+        if (sMplModules[i].stop())
+            LOGE("HAL:Cannot stop %s", sMplModules[i].name);
+        mMplModules &= ~sMplModules[i].mask;
+    }
+    for (i = 0; i < (int)ARRAY_SIZE(sMplModules); i++) {
+        if (!(on & sMplModules[i].mask))
+            continue;
+        if (sMplModules[i].start()) {
+            /* don't retry on every sample */
+            LOGE("HAL:Cannot start %s", sMplModules[i].name);
+            mMplModulesAvail &= ~sMplModules[i].mask;
+            continue;
+        }
+        mMplModules |= sMplModules[i].mask;
+    }
+
+    mFeatureActiveMask &= ~(INV_COMPASS_CAL | INV_COMPASS_FIT);
+    if (mMplModules & INV_MOD_COMPASS_CAL)
+        mFeatureActiveMask |= INV_COMPASS_CAL;
+    if (mMplModules & INV_MOD_9X_FUSION)
+        mFeatureActiveMask |= INV_COMPASS_FIT;
+}
+
+/**
+ *  Log the MPL CPU time per sample of the current module set and restart
+ *  the count.
+ */
+void MPLSensor::reportMplCpu()
+{
+    if (mMplCpuSamples) {
+        LOGI("HAL:MPL modules 0x%04x: %u samples, %lld ns cpu/sample",
+                mMplModules, mMplCpuSamples,
+                mMplCpuNs / mMplCpuSamples);
+    }
+    mMplCpuSamples = 0;
+    mMplCpuNs = 0;
+}
+
+/**
+ *  Delay to program for sensor @a i: the requested one, or the reduced
+ *  ODR while the governor holds the device still.
+ */
+int64_t MPLSensor::governedDelay(int i)
+{
+    int64_t ns = mDelays[i];
+
+    if (__atomic_load_n(&mOdrGovState, __ATOMIC_ACQUIRE) == ODR_GOV_REDUCED
+            && ns < ODR_GOV_DELAY_NS) {
+        ns = ODR_GOV_DELAY_NS;
+    }
+    return ns;
+}
+
+void MPLSensor::setOdrGovState(int state, int64_t now)
+{
+    if (state == mOdrGovState)
+        return;
+
+    mOdrGovTime[mOdrGovState] += now - mOdrGovSince;
+    mOdrGovSince = now;
+    mOdrGovSwitches++;
+    __atomic_store_n(&mOdrGovState, state, __ATOMIC_RELEASE);
+    LOGV_IF(PROCESS_VERBOSE, "HAL:ODR governor -> %s",
+            state == ODR_GOV_REDUCED ? "reduced" : "full");
+
+    /* held events continue from the last real sample */
+    for (int i = 0; i < NumSensors; i++) {
+        mHoldTs[i] = mRealTs[i];
+    }
+
+    /* the rates are programmed by odrGovThread(), not on the poll path */
+    pthread_mutex_lock(&mOdrGovLock);
+    mOdrGovPending = true;
+    pthread_cond_signal(&mOdrGovCond);
+    pthread_mutex_unlock(&mOdrGovLock);
+}
+
+/**
+ *  Applies governor state changes with update_delay(), serialized with
+ *  enable() and setDelay() by mHALMutex.
+ */
+void *MPLSensor::odrGovThread(void *arg)
+{
+    MPLSensor *self = (MPLSensor *)arg;
+
+    pthread_mutex_lock(&self->mOdrGovLock);
+    for (;;) {
+        while (!self->mOdrGovPending && !self->mOdrGovStop) {
+            pthread_cond_wait(&self->mOdrGovCond, &self->mOdrGovLock);
+        }
+        if (self->mOdrGovStop)
+            break;
+        self->mOdrGovPending = false;
+        pthread_mutex_unlock(&self->mOdrGovLock);
+
+        pthread_mutex_lock(&self->mHALMutex);
+        self->update_delay();
+        pthread_mutex_unlock(&self->mHALMutex);
+
+        pthread_mutex_lock(&self->mOdrGovLock);
+    }
+    pthread_mutex_unlock(&self->mOdrGovLock);
+    return NULL;
+}
+
+/**
+ *  Called from readEvents() with the MPL level 0 messages. Lowers the
+ *  ODRs once no-motion has been stable and restores them on the first
+ *  motion event. No-motion comes from fast_nomot, so the governor stays
+ *  at full rate while that module is stopped.
+ */
+void MPLSensor::updateOdrGovernor(long msg)
+{
+    int64_t now = getTimestamp();
+
+    if (msg & INV_MSG_MOTION_EVENT) {
+        mNoMotionSince = 0;
+    }
+    if (msg & INV_MSG_NO_MOTION_EVENT) {
+        mNoMotionSince = now;
+    }
+
+    if (!(mMplModules & INV_MOD_FAST_NOMOT) || !mEnabled) {
+        mNoMotionSince = 0;
+    }
+
+    if (mOdrGovState == ODR_GOV_REDUCED && !mNoMotionSince) {
+        setOdrGovState(ODR_GOV_FULL, now);
+    } else if (mOdrGovState == ODR_GOV_FULL && mNoMotionSince
+                && now - mNoMotionSince >= ODR_GOV_SETTLE_NS) {
+        setOdrGovState(ODR_GOV_REDUCED, now);
+    }
+
+    if (now - mOdrGovReported >= ODR_GOV_REPORT_NS) {
+        reportOdrGovernor(now);
+    }
+}
+
+void MPLSensor::reportOdrGovernor(int64_t now)
+{
+    int64_t t[ODR_GOV_NUM_STATES];
+
+    memcpy(t, mOdrGovTime, sizeof(t));
+    t[mOdrGovState] += now - mOdrGovSince;
+    LOGI("HAL:ODR governor: full %lld ms, reduced %lld ms, %u switches",
+            t[ODR_GOV_FULL] / 1000000LL, t[ODR_GOV_REDUCED] / 1000000LL,
+            mOdrGovSwitches);
+    mOdrGovReported = now;
+}
+
 /* TODO: create function pointers to calculate scale */
 void MPLSensor::inv_set_device_properties()
 {
@@ -951,6 +1278,20 @@ MPLSensor::~MPLSensor()
 {
     VFUNC_LOG;
 
+    mTempSampler.stop();
+    sample_gap_fini(&mGyroGap);
+    sample_gap_fini(&mAccelGap);
+    sample_gap_fini(&mCompassGap);
+
+    if (mOdrGovRunning) {
+        pthread_mutex_lock(&mOdrGovLock);
+        mOdrGovStop = true;
+        pthread_cond_signal(&mOdrGovCond);
+        pthread_mutex_unlock(&mOdrGovLock);
+        pthread_join(mOdrGovThread, NULL);
+        mOdrGovRunning = false;
+    }
+
     /* Close open fds */
     if (iio_fd > 0)
         close(iio_fd);
@@ -1281,9 +1622,12 @@ int MPLSensor::enableGyro(int en)
              mpu.gyro_enable, strerror(res), res);
     }
 
+    mTempSampler.setActive(en);
+
     if (!en) {
         LOGV_IF(EXTRA_VERBOSE, "HAL:MPL:inv_gyro_was_turned_off");
         inv_gyro_was_turned_off();
+        sample_gap_reset(&mGyroGap, 0);
     } else {
         LOGV_IF(SYSFS_VERBOSE, "HAL:sysfs:echo %d > %s (%lld)",
                 en, mpu.gyro_x_fifo_enable, getTimestamp());
@@ -1343,6 +1687,7 @@ int MPLSensor::enableAccel(int en)
     if (!en) {
         LOGV_IF(EXTRA_VERBOSE, "HAL:MPL:inv_accel_was_turned_off");
         inv_accel_was_turned_off();
+        sample_gap_reset(&mAccelGap, 0);
     } else {
         LOGV_IF(SYSFS_VERBOSE, "HAL:sysfs:echo %d > %s (%lld)",
                 en, mpu.accel_x_fifo_enable, getTimestamp());
@@ -1389,6 +1734,7 @@ int MPLSensor::enableCompass(int en)
     if (en == 0 || res != 0) {
         LOGV_IF(EXTRA_VERBOSE, "HAL:MPL:inv_compass_was_turned_off");
         inv_compass_was_turned_off();
+        sample_gap_reset(&mCompassGap, 0);
     }
     return res;
 }
@@ -1644,7 +1990,7 @@ int MPLSensor::gyroHandler(sensors_event_t* s)
     int update;
     update = inv_get_sensor_type_gyroscope(s->gyro.v, &s->gyro.status,
                                            &s->timestamp);
-    LOGV_IF(HANDLER_DATA, "HAL:gyro data : %+f %+f %+f -- %lld - %d",
+    HOT_LOGV("HAL:gyro data : %+f %+f %+f -- %lld - %d",
             s->gyro.v[0], s->gyro.v[1], s->gyro.v[2], s->timestamp, update);
     return update;
 }
@@ -1655,7 +2001,7 @@ int MPLSensor::rawGyroHandler(sensors_event_t* s)
     int update;
     update = inv_get_sensor_type_gyroscope_raw(s->gyro.v, &s->gyro.status,
                                                &s->timestamp);
-    LOGV_IF(HANDLER_DATA, "HAL:raw gyro data : %+f %+f %+f -- %lld - %d",
+    HOT_LOGV("HAL:raw gyro data : %+f %+f %+f -- %lld - %d",
             s->gyro.v[0], s->gyro.v[1], s->gyro.v[2], s->timestamp, update);
     return update;
 }
@@ -1666,7 +2012,7 @@ int MPLSensor::accelHandler(sensors_event_t* s)
     int update;
     update = inv_get_sensor_type_accelerometer(
         s->acceleration.v, &s->acceleration.status, &s->timestamp);
-    LOGV_IF(HANDLER_DATA, "HAL:accel data : %+f %+f %+f -- %lld - %d",
+    HOT_LOGV("HAL:accel data : %+f %+f %+f -- %lld - %d",
             s->acceleration.v[0], s->acceleration.v[1], s->acceleration.v[2],
             s->timestamp, update);
     mAccelAccuracy = s->acceleration.status;
@@ -1679,7 +2025,7 @@ int MPLSensor::compassHandler(sensors_event_t* s)
     int update;
     update = inv_get_sensor_type_magnetic_field(
         s->magnetic.v, &s->magnetic.status, &s->timestamp);
-    LOGV_IF(HANDLER_DATA, "HAL:compass data: %+f %+f %+f -- %lld - %d",
+    HOT_LOGV("HAL:compass data: %+f %+f %+f -- %lld - %d",
             s->magnetic.v[0], s->magnetic.v[1], s->magnetic.v[2],
             s->timestamp, update);
     mCompassAccuracy = s->magnetic.status;
@@ -1698,7 +2044,7 @@ int MPLSensor::rvHandler(sensors_event_t* s)
     update = 1;
 #endif
     update |= isCompassDisabled();
-    LOGV_IF(HANDLER_DATA, "HAL:rv data: %+f %+f %+f %+f - %+lld - %d",
+    HOT_LOGV("HAL:rv data: %+f %+f %+f %+f - %+lld - %d",
             s->data[0], s->data[1], s->data[2], s->data[3], s->timestamp,
             update);
     return update;
@@ -1714,7 +2060,7 @@ int MPLSensor::laHandler(sensors_event_t* s)
     update = 1;
 #endif    
     update |= isCompassDisabled();
-    LOGV_IF(HANDLER_DATA, "HAL:la data: %+f %+f %+f - %lld - %d",
+    HOT_LOGV("HAL:la data: %+f %+f %+f - %lld - %d",
             s->gyro.v[0], s->gyro.v[1], s->gyro.v[2], s->timestamp, update);
     return update;
 }
@@ -1726,7 +2072,7 @@ int MPLSensor::gravHandler(sensors_event_t* s)
     update = inv_get_sensor_type_gravity(s->gyro.v, &s->gyro.status,
                                          &s->timestamp);
     update |= isCompassDisabled();
-    LOGV_IF(HANDLER_DATA, "HAL:gr data: %+f %+f %+f - %lld - %d",
+    HOT_LOGV("HAL:gr data: %+f %+f %+f - %lld - %d",
             s->gyro.v[0], s->gyro.v[1], s->gyro.v[2], s->timestamp, update);
     return update;
 }
@@ -1741,7 +2087,7 @@ int MPLSensor::orienHandler(sensors_event_t* s)
     update = 1;
 #endif    
     update |= isCompassDisabled();
-    LOGV_IF(HANDLER_DATA, "HAL:or data: %f %f %f - %lld - %d",
+    HOT_LOGV("HAL:or data: %f %f %f - %lld - %d",
             s->orientation.v[0], s->orientation.v[1], s->orientation.v[2],
             s->timestamp, update);
     return update;
@@ -1825,7 +2171,7 @@ int MPLSensor::enable(int32_t handle, int en)
             "HAL:%s sensor state change what=%d", sname.string(), what);
 
     // pthread_mutex_lock(&mMplMutex);
-    // pthread_mutex_lock(&mHALMutex);
+    pthread_mutex_lock(&mHALMutex);
 
     if ((uint32_t(newState) << what) != (mEnabled & (1 << what))) {
         uint32_t sensor_type;
@@ -1854,6 +2200,9 @@ int MPLSensor::enable(int32_t handle, int en)
         sen_mask_old = mLocalSensorMask & mMasterSensorMask;
         computeLocalSensorMask(mEnabled);
         LOGV_IF(PROCESS_VERBOSE, "HAL:enable : mEnabled = %d", mEnabled);
+        /* picked up by the poll thread in readEvents() */
+        __atomic_store_n(&mMplModulesWanted, computeMplModules(mEnabled),
+                         __ATOMIC_RELEASE);
         sen_mask = mLocalSensorMask & mMasterSensorMask;
         mSensorMask = sen_mask;
         LOGV_IF(PROCESS_VERBOSE, "HAL:sen_mask= 0x%0lx", sen_mask);
@@ -1912,7 +2261,7 @@ int MPLSensor::enable(int32_t handle, int en)
     }
 
     // pthread_mutex_unlock(&mMplMutex);
-    // pthread_mutex_unlock(&mHALMutex);
+    pthread_mutex_unlock(&mHALMutex);
 
 #ifdef INV_PLAYBACK_DBG
     /* apparently the logging needs to go through this sequence
@@ -1935,8 +2284,12 @@ int MPLSensor::setDelay(int32_t handle, int64_t ns)
     int what = -1;
 
     switch (handle) {
-        case ID_SO:
-            return update_delay();
+        case ID_SO: {
+            pthread_mutex_lock(&mHALMutex);
+            int res = update_delay();
+            pthread_mutex_unlock(&mHALMutex);
+            return res;
+        }
         case ID_A:
             what = Accelerometer;
             sname = "Accelerometer";
@@ -2014,6 +2367,9 @@ int MPLSensor::setDelay(int32_t handle, int64_t ns)
         ns = MAX_RATE;
     }
 
+    /* mDelays and mEnabled are shared with enable() and odrGovThread() */
+    pthread_mutex_lock(&mHALMutex);
+
     /* store request rate to mDelays arrary for each sensor */
     mDelays[what] = ns;
 
@@ -2027,6 +2383,7 @@ int MPLSensor::setDelay(int32_t handle, int64_t ns)
                 if (i != what && (mEnabled & (1 << i)) && ns > mDelays[i]) {
                     LOGV_IF(PROCESS_VERBOSE,
                             "HAL:ignore delay set due to sensor %d", i);
+                    pthread_mutex_unlock(&mHALMutex);
                     return 0;
                 }
             }
@@ -2040,6 +2397,7 @@ int MPLSensor::setDelay(int32_t handle, int64_t ns)
                         ns > mDelays[Accelerometer]))) {
                  LOGV_IF(PROCESS_VERBOSE,
                          "HAL:ignore delay set due to gyro/accel");
+                 pthread_mutex_unlock(&mHALMutex);
                  return 0;
             }
             break;
@@ -2058,15 +2416,15 @@ int MPLSensor::setDelay(int32_t handle, int64_t ns)
                 if (i != what && (mEnabled & (1 << i)) && ns > mDelays[i]) {
                     LOGV_IF(PROCESS_VERBOSE,
                             "HAL:ignore delay set due to sensor %d", i);
+                    pthread_mutex_unlock(&mHALMutex);
                     return 0;
                 }
             }
             break;
     }
 
-    // pthread_mutex_lock(&mHALMutex);
     int res = update_delay();
-    // pthread_mutex_unlock(&mHALMutex);
+    pthread_mutex_unlock(&mHALMutex);
     return res;
 }
 
@@ -2076,6 +2434,11 @@ int MPLSensor::update_delay(void)
 
     int res = 0;
     int64_t got;
+    int64_t delays[NumSensors];
+
+    for (int i = 0; i < NumSensors; i++) {
+        delays[i] = governedDelay(i);
+    }
 
     if (mEnabled) {
         int64_t wanted = 1000000000LL;
@@ -2096,7 +2459,7 @@ int MPLSensor::update_delay(void)
         /* search the minimum delay requested across all enabled sensors */
         for (int i = 0; i < NumSensors; i++) {
             if (mEnabled & (1 << i)) {
-                int64_t ns = mDelays[i];
+                int64_t ns = delays[i];
                 wanted = wanted < ns ? wanted : ns;
             }
         }
@@ -2213,9 +2576,9 @@ int MPLSensor::update_delay(void)
         } else {
 
             if (GY_ENABLED) {
-                wanted = (mDelays[Gyro] <= mDelays[RawGyro]?
-                    (mEnabled & (1 << Gyro)? mDelays[Gyro]: mDelays[RawGyro]):
-                    (mEnabled & (1 << RawGyro)? mDelays[RawGyro]: mDelays[Gyro]));
+                wanted = (delays[Gyro] <= delays[RawGyro]?
+                    (mEnabled & (1 << Gyro)? delays[Gyro]: delays[RawGyro]):
+                    (mEnabled & (1 << RawGyro)? delays[RawGyro]: delays[Gyro]));
 
                 if (isDmpDisplayOrientationOn() 
                         && (mDmpOrientationEnabled 
@@ -2231,13 +2594,13 @@ int MPLSensor::update_delay(void)
             }
 
             if (A_ENABLED) { /* there is only 1 fifo rate for MPUxxxx */
-                if (GY_ENABLED && mDelays[Gyro] < mDelays[Accelerometer]) {
-                    wanted = mDelays[Gyro];
-                } else if (GY_ENABLED && mDelays[RawGyro] 
-                            < mDelays[Accelerometer]) {
-                    wanted = mDelays[RawGyro];
+                if (GY_ENABLED && delays[Gyro] < delays[Accelerometer]) {
+                    wanted = delays[Gyro];
+                } else if (GY_ENABLED && delays[RawGyro] 
+                            < delays[Accelerometer]) {
+                    wanted = delays[RawGyro];
                 } else {
-                    wanted = mDelays[Accelerometer];
+                    wanted = delays[Accelerometer];
                 }
 
                 if (isDmpDisplayOrientationOn() 
@@ -2266,19 +2629,19 @@ int MPLSensor::update_delay(void)
             /* Invensense compass calibration */
             if (M_ENABLED) {
                 if (!mCompassSensor->isIntegrated()) {
-                    wanted = mDelays[MagneticField];
+                    wanted = delays[MagneticField];
                 } else {
                     if (GY_ENABLED
-                        && mDelays[Gyro] < mDelays[MagneticField]) {
-                        wanted = mDelays[Gyro];
+                        && delays[Gyro] < delays[MagneticField]) {
+                        wanted = delays[Gyro];
                     } else if (GY_ENABLED
-                               && mDelays[RawGyro] < mDelays[MagneticField]) {
-                        wanted = mDelays[RawGyro];
-                    } else if (A_ENABLED && mDelays[Accelerometer] 
-                                < mDelays[MagneticField]) {
-                        wanted = mDelays[Accelerometer];
+                               && delays[RawGyro] < delays[MagneticField]) {
+                        wanted = delays[RawGyro];
+                    } else if (A_ENABLED && delays[Accelerometer] 
+                                < delays[MagneticField]) {
+                        wanted = delays[Accelerometer];
                     } else {
-                        wanted = mDelays[MagneticField];
+                        wanted = delays[MagneticField];
                     }
 
                     if (isDmpDisplayOrientationOn() 
@@ -2295,6 +2658,11 @@ int MPLSensor::update_delay(void)
 
         }
 
+        /* the fifo restarts at the new rate, learn it from the samples */
+        sample_gap_reset(&mGyroGap, 0);
+        sample_gap_reset(&mAccelGap, 0);
+        sample_gap_reset(&mCompassGap, 0);
+
         unsigned long sensors = mLocalSensorMask & mMasterSensorMask;
         if (sensors &
             (INV_THREE_AXIS_GYRO
@@ -2376,12 +2744,36 @@ int MPLSensor::readEvents(sensors_event_t* data, int count)
 {
     //VFUNC_LOG;
 
+    uint32_t wanted = __atomic_load_n(&mMplModulesWanted, __ATOMIC_ACQUIRE);
+    if (wanted != mMplModules) {
+        applyMplModules(wanted);
+    }
+
+#if MPL_MODULE_CPU_STATS
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t0);
+    inv_execute_on_data();
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t1);
+    mMplCpuNs += (t1.tv_sec - t0.tv_sec) * 1000000000LL
+            + (t1.tv_nsec - t0.tv_nsec);
+    if (++mMplCpuSamples >= MPL_MODULE_CPU_REPORT) {
+        reportMplCpu();
+    }
+#else
     inv_execute_on_data();
+#endif
+    for (int i = 0; i < mTraceBuiltCount; i++) {
+        SENSOR_TRACE_MARK(TRACE_FUSION, -1, mTraceBuilt[i]);
+    }
+    mTraceBuiltCount = 0;
 
     int numEventReceived = 0;
 
     long msg;
     msg = inv_get_message_level_0(1);
+    if (mOdrGovEnabled) {
+        updateOdrGovernor(msg);
+    }
     if (msg) {
         if (msg & INV_MSG_MOTION_EVENT) {
             LOGV_IF(PROCESS_VERBOSE, "HAL:**** Motion ****\n");
@@ -2405,6 +2797,9 @@ int MPLSensor::readEvents(sensors_event_t* data, int count)
             mPendingMask |= (1 << i);
 
             if (update && (count > 0)) {
+                SENSOR_TRACE_MARK(TRACE_OUTPUT, mPendingEvents[i].sensor,
+                                  mPendingEvents[i].timestamp);
+                mHoldTs[i] = mRealTs[i] = mPendingEvents[i].timestamp;
                 *data++ = mPendingEvents[i];
                 count--;
                 numEventReceived++;
@@ -2415,27 +2810,99 @@ int MPLSensor::readEvents(sensors_event_t* data, int count)
     return numEventReceived;
 }
 
-#if DEBUG_DELAY
-#define NSEC_PER_SEC            1000000000
-
-static inline int64_t timespec_to_ns(const struct timespec *ts)
+/**
+ *  While the governor runs the sensors below the requested rate, repeat
+ *  the last event of each sensor at its requested period. Held events
+ *  stop half a period short of the next real sample so timestamps stay
+ *  monotonic. Called when the poll times out, see getPollTime().
+ */
+int MPLSensor::readHeldEvents(sensors_event_t* data, int count)
 {
-	return ((int64_t) ts->tv_sec * NSEC_PER_SEC) + ts->tv_nsec;
+    int numEventReceived = 0;
+
+    if (mOdrGovState != ODR_GOV_REDUCED)
+        return 0;
+
+    int64_t now = getTimestamp();
+    for (int i = 0; i < NumSensors && count > 0; i++) {
+        if (!(mEnabled & (1 << i)) || !mRealTs[i])
+            continue;
+        int64_t limit = mRealTs[i] + governedDelay(i) - mDelays[i] / 2;
+        int64_t next = mHoldTs[i] + mDelays[i];
+        while (next <= now && next < limit && count > 0) {
+            *data = mPendingEvents[i];
+            data->timestamp = next;
+            data++;
+            count--;
+            numEventReceived++;
+            mHoldTs[i] = next;
+            next += mDelays[i];
+        }
+    }
+    return numEventReceived;
 }
 
-static int64_t get_time_ns(void)
+/*
+ * Compile the scan layout of iio_fd for the enables in @key from
+ * scan_elements.  Drivers without usable _type/_index attributes get the
+ * layout buildMpuEvent() always assumed: quaternion, accel, gyro, compass,
+ * timestamp.
+ */
+int MPLSensor::loadScanLayout(long key)
 {
-	struct timespec ts;
-	clock_gettime(CLOCK_MONOTONIC, &ts);
-	return timespec_to_ns(&ts);
-}
+    VFUNC_LOG;
 
-static int64_t tm_min=0;
-static int64_t tm_max=0;
-static int64_t tm_sum=0;
-static int64_t tm_last_print=0;
-static int64_t tm_count=0;
-#endif
+    char sysfs_path[MAX_SYSFS_NAME_LEN];
+    int rt;
+
+    memset(sysfs_path, 0, sizeof(sysfs_path));
+    inv_root_sysfs_path(sysfs_path, sizeof(sysfs_path));
+    rt = iio_scan_layout_load(&mScanLayout, sysfs_path);
+    if (rt < 0 || iio_scan_layout_find(&mScanLayout, "in_timestamp") < 0) {
+        static const char *const quat[] = {
+            "in_quaternion_r", "in_quaternion_x",
+            "in_quaternion_y", "in_quaternion_z",
+        };
+        static const char *const axes[][3] = {
+            { "in_accel_x", "in_accel_y", "in_accel_z" },
+            { "in_anglvel_x", "in_anglvel_y", "in_anglvel_z" },
+            { "in_magn_x", "in_magn_y", "in_magn_z" },
+        };
+        int sensors = (key >> 16) & 3, index = 0, i, j;
+        bool on[3];
+
+        on[0] = (key & INV_THREE_AXIS_ACCEL) != 0;
+        on[1] = (key & INV_THREE_AXIS_GYRO) != 0;
+        on[2] = sensors > on[0] + on[1];
+
+        LOGW("HAL:no usable scan_elements (%d), using the default layout",
+             rt);
+        iio_scan_layout_init(&mScanLayout);
+        for (i = 0; i < 4 && (key & (1 << 20)); i++) {
+            iio_scan_layout_add(&mScanLayout, quat[i], index++,
+                    "le:s32/32>>0");
+        }
+        for (i = 0; i < 3; i++) {
+            for (j = 0; j < 3 && on[i]; j++) {
+                iio_scan_layout_add(&mScanLayout, axes[i][j], index++,
+                        "le:s16/16>>0");
+            }
+        }
+        iio_scan_layout_add(&mScanLayout, "in_timestamp", index,
+                "le:s64/64>>0");
+        iio_scan_layout_compile(&mScanLayout);
+    }
+
+    mScanQuat = iio_scan_layout_find(&mScanLayout, "in_quaternion_r");
+    mScanAccel = iio_scan_layout_find(&mScanLayout, "in_accel_x");
+    mScanGyro = iio_scan_layout_find(&mScanLayout, "in_anglvel_x");
+    mScanCompass = iio_scan_layout_find(&mScanLayout, "in_magn_x");
+    mScanTs = iio_scan_layout_find(&mScanLayout, "in_timestamp");
+    mScanKey = key;
+    LOGV_IF(PROCESS_VERBOSE, "HAL:scan layout %d channels, %u bytes",
+            mScanLayout.num, mScanLayout.size);
+    return rt;
+}
 
 // collect data for MPL (but NOT sensor service currently), from driver layer
 void MPLSensor::buildMpuEvent(void)
@@ -2451,14 +2918,10 @@ void MPLSensor::buildMpuEvent(void)
             (((LocalSensorMask & INV_THREE_AXIS_COMPASS) 
                 && mCompassSensor->isIntegrated())? 1 : 0);
     char *rdata = mIIOBuffer;
-
-    nbyte= (8 * sensors + 8) * 1;
+    int64_t scan[IIO_SCAN_MAX_CHANNELS];
 
     if (isLowPowerQuatEnabled()) {
         lp_quaternion_on = checkLPQuaternion();
-        if (lp_quaternion_on == 1) {
-            nbyte += sizeof(mCachedQuaternionData); // 16 B for quat data
-        }
     }
 
     // pthread_mutex_lock(&mMplMutex);
@@ -2468,75 +2931,56 @@ void MPLSensor::buildMpuEvent(void)
     if (sensors == 0) {
         // read(iio_fd, rdata, nbyte);
         read(iio_fd, rdata, IIO_BUFFER_LENGTH);
-        LOGE("HAL:all sensors are disabled, clear buf and return");
+        HOT_LOGE("HAL:all sensors are disabled, clear buf and return");
         return;
     }
 
+    /* the scan layout only changes with the enables */
+    long key = (LocalSensorMask & (INV_THREE_AXIS_GYRO | INV_THREE_AXIS_ACCEL))
+            | ((sensors & 3) << 16) | ((lp_quaternion_on == 1) << 20);
+    if (key != mScanKey) {
+        loadScanLayout(key);
+    }
+    nbyte = mScanLayout.size;
+
     ssize_t rsize = read(iio_fd, rdata, nbyte);
+    if (rsize < nbyte
+            || iio_scan_decode(&mScanLayout, rdata, rsize, scan, 1) != 1) {
+        HOT_LOGE("HAL:ERR Full data packet was not read");
+        return;
+    }
 
 #ifdef TESTING
     LOGI("get one sample of IIO data with size: %d", rsize);
     LOGI("sensors: %d", sensors);
-
-    LOGI_IF(LocalSensorMask & INV_THREE_AXIS_GYRO, "gyro x/y/z: %d/%d/%d",
-        *((short *) (rdata + 0)), *((short *) (rdata + 2)),
-        *((short *) (rdata + 4)));
-    LOGI_IF(LocalSensorMask & INV_THREE_AXIS_ACCEL, "accel x/y/z: %d/%d/%d",
-        *((short *) (rdata + 0 + 
-            ((LocalSensorMask & INV_THREE_AXIS_GYRO)? 6 : 0))),
-        *((short *) (rdata + 2 + 
-            ((LocalSensorMask & INV_THREE_AXIS_GYRO)? 6 : 0))),
-        *((short *) (rdata + 4) + 
-            ((LocalSensorMask & INV_THREE_AXIS_GYRO)? 6 : 0)));
-
-    LOGI_IF(LocalSensorMask & INV_THREE_AXIS_COMPASS &
-        mCompassSensor->isIntegrated(), "compass x/y/z: %d/%d/%d",
-        *((short *) (rdata + 0 + 
-            ((LocalSensorMask & INV_THREE_AXIS_GYRO)? 6 : 0) +
-            ((LocalSensorMask & INV_THREE_AXIS_ACCEL)? 6 : 0))),
-        *((short *) (rdata + 2 + 
-            ((LocalSensorMask & INV_THREE_AXIS_GYRO)? 6 : 0) +
-            ((LocalSensorMask & INV_THREE_AXIS_ACCEL)? 6 : 0))),
-        *((short *) (rdata + 4) + 
-            ((LocalSensorMask & INV_THREE_AXIS_GYRO)? 6 : 0) +
-            ((LocalSensorMask & INV_THREE_AXIS_ACCEL)? 6 : 0)));
-#endif
-
-    if (rsize < (nbyte - 8)) {
-        LOGE("HAL:ERR Full data packet was not read");
-        // return -1;
-    }
-
-#if 0
-    if (sensors == 0) {
-        // read(iio_fd, rdata, nbyte);
-        read(iio_fd, rdata, IIO_BUFFER_LENGTH);
-    }
 #endif
 
-    if (isLowPowerQuatEnabled() && lp_quaternion_on == 1) {
-
-        for (i=0; i< 4; i++) {
-            mCachedQuaternionData[i]= *(long*)rdata;
-            rdata += sizeof(long);
+    if (lp_quaternion_on == 1 && mScanQuat >= 0) {
+        for (i = 0; i < 4; i++) {
+            mCachedQuaternionData[i] = (long)scan[mScanQuat + i];
         }
     }
 
     for (i = 0; i < 3; i++) {
-        if (LocalSensorMask & INV_THREE_AXIS_ACCEL) {
-            mCachedAccelData[i] = *((short *) (rdata + i * 2));
+        if ((LocalSensorMask & INV_THREE_AXIS_ACCEL) && mScanAccel >= 0) {
+            mCachedAccelData[i] = (long)scan[mScanAccel + i];
         }
-        if (LocalSensorMask & INV_THREE_AXIS_GYRO) {
-            mCachedGyroData[i] = *((short *) (rdata + i * 2 +
-                ((LocalSensorMask & INV_THREE_AXIS_ACCEL)? 6: 0)));
+        if ((LocalSensorMask & INV_THREE_AXIS_GYRO) && mScanGyro >= 0) {
+            mCachedGyroData[i] = (short)scan[mScanGyro + i];
         }
-        if ((LocalSensorMask & INV_THREE_AXIS_COMPASS) 
-                && mCompassSensor->isIntegrated()) {
-            mCachedCompassData[i] = 
-                *((short *)(rdata + i * 2 + 6 * (sensors - 1)));
+        if ((LocalSensorMask & INV_THREE_AXIS_COMPASS)
+                && mCompassSensor->isIntegrated() && mScanCompass >= 0) {
+            mCachedCompassData[i] = (long)scan[mScanCompass + i];
         }
     }
 
+#ifdef TESTING
+    LOGI_IF(LocalSensorMask & INV_THREE_AXIS_GYRO, "gyro x/y/z: %d/%d/%d",
+        mCachedGyroData[0], mCachedGyroData[1], mCachedGyroData[2]);
+    LOGI_IF(LocalSensorMask & INV_THREE_AXIS_ACCEL, "accel x/y/z: %ld/%ld/%ld",
+        mCachedAccelData[0], mCachedAccelData[1], mCachedAccelData[2]);
+#endif
+
     mask |= (((LocalSensorMask & INV_THREE_AXIS_GYRO)? 1 << Gyro: 0) +
         ((LocalSensorMask & INV_THREE_AXIS_ACCEL)? 1 << Accelerometer: 0));
     if ((LocalSensorMask & INV_THREE_AXIS_COMPASS) 
@@ -2546,29 +2990,9 @@ void MPLSensor::buildMpuEvent(void)
         mask |= 1 << MagneticField;
     }
 
-	mSensorTimestamp = *((long long *) (rdata + 8 * sensors));
-
-	#if DEBUG_DELAY
-	int64_t tm_cur = get_time_ns();
-	int64_t tm_delta = tm_cur - mSensorTimestamp;
-	if (tm_min==0 && tm_max==0)
-		tm_min = tm_max = tm_delta;
-	else if (tm_delta < tm_min)
-		tm_min = tm_delta;
-	else if (tm_delta > tm_max)
-		tm_max = tm_delta;
-	tm_sum += tm_delta;
-	tm_count++;
-	
-	if ((tm_cur-tm_last_print) > 1000000000) {
-		LOGD("HAL Time: [%lld] %lld,%lld,%lld\n", mSensorTimestamp, tm_min, (tm_sum/tm_count), tm_max);
-		tm_last_print = tm_cur;
-		tm_min = tm_max = tm_count = tm_sum = 0;
-	}
-	#endif
-
-//	  int64_t n = get_time_ns();
-//	  ALOGD("MPU HAL: tm=%lld, %lld, %lld\n", mSensorTimestamp, n, n-mSensorTimestamp);
+	mSensorTimestamp = scan[mScanTs];
+    SENSOR_TRACE_MARK(TRACE_READ, -1, mSensorTimestamp);
+    traceBuilt(mSensorTimestamp);
 
     if (mCompassSensor->isIntegrated()) {
         mCompassTimestamp = mSensorTimestamp;
@@ -2587,18 +3011,15 @@ void MPLSensor::buildMpuEvent(void)
     }
 #endif            
 
+    SENSOR_TRACE_MARK(TRACE_BUILD, -1, mSensorTimestamp);
     if (mask & (1 << Gyro)) {
-        // send down temperature every 0.5 seconds
+        // send down the latest temperature from mTempSampler
         // with timestamp measured in "driver" layer
-        if(mSensorTimestamp - mTempCurrentTime >= 500000000LL) {
-            mTempCurrentTime = mSensorTimestamp;
-            long long temperature[2];
-            if(inv_read_temperature(temperature) == 0) {
-                LOGV_IF(INPUT_DATA,
-                        "HAL:inv_read_temperature = %lld, timestamp= %lld",
-                        temperature[0], temperature[1]);
-                inv_build_temp(temperature[0], temperature[1]);
-            }
+        long long temperature[2];
+        if (mTempSampler.get(&temperature[0], &temperature[1])) {
+            HOT_LOGV("HAL:gyro temperature = %lld, timestamp= %lld",
+                    temperature[0], temperature[1]);
+            inv_build_temp(temperature[0], temperature[1]);
 #ifdef TESTING
             long bias[3], temp, temp_slope[3];
             inv_get_gyro_bias(bias, &temp);
@@ -2622,8 +3043,11 @@ void MPLSensor::buildMpuEvent(void)
         mPendingMask |= 1 << RawGyro;
 
         if (LocalSensorMask & INV_THREE_AXIS_GYRO) {
+            /* a fifo overflow breaks the integration, start it over */
+            if (sample_gap_check(&mGyroGap, mSensorTimestamp) > 0)
+                inv_gyro_was_turned_off();
             inv_build_gyro(mCachedGyroData, mSensorTimestamp);
-            LOGV_IF(INPUT_DATA,
+            HOT_LOGV(
                     "HAL:inv_build_gyro: %+8d %+8d %+8d - %lld",
                     mCachedGyroData[0], mCachedGyroData[1],
                     mCachedGyroData[2], mSensorTimestamp);
@@ -2633,8 +3057,10 @@ void MPLSensor::buildMpuEvent(void)
     if (mask & (1 << Accelerometer)) {
         mPendingMask |= 1 << Accelerometer;
         if (LocalSensorMask & INV_THREE_AXIS_ACCEL) {
+            if (sample_gap_check(&mAccelGap, mSensorTimestamp) > 0)
+                inv_accel_was_turned_off();
             inv_build_accel(mCachedAccelData, 0, mSensorTimestamp);
-             LOGV_IF(INPUT_DATA,
+             HOT_LOGV(
                     "HAL:inv_build_accel: %+8ld %+8ld %+8ld - %lld",
                     mCachedAccelData[0], mCachedAccelData[1],
                     mCachedAccelData[2], mSensorTimestamp);
@@ -2648,9 +3074,11 @@ void MPLSensor::buildMpuEvent(void)
             status |= INV_CALIBRATED;
         }
         if (LocalSensorMask & INV_THREE_AXIS_COMPASS) {
+            if (sample_gap_check(&mCompassGap, mCompassTimestamp) > 0)
+                inv_compass_was_turned_off();
             inv_build_compass(mCachedCompassData, status,
                               mCompassTimestamp);
-            LOGV_IF(INPUT_DATA,
+            HOT_LOGV(
                     "HAL:inv_build_compass: %+8ld %+8ld %+8ld - %lld",
                     mCachedCompassData[0], mCachedCompassData[1],
                     mCachedCompassData[2], mCompassTimestamp);
@@ -2661,7 +3089,7 @@ void MPLSensor::buildMpuEvent(void)
         inv_build_quat(mCachedQuaternionData, 
                        32 /* default 32 for now (16/32bits) */, 
                        mSensorTimestamp);
-        LOGV_IF(INPUT_DATA, 
+        HOT_LOGV(
                 "HAL:inv_build_quat: %+8ld %+8ld %+8ld %+8ld - %lld",
                 mCachedQuaternionData[0], mCachedQuaternionData[1],
                 mCachedQuaternionData[2], mCachedQuaternionData[3], 
@@ -2675,8 +3103,6 @@ void MPLSensor::buildMpuEvent(void)
 /* use for both MPUxxxx and third party compass */
 void MPLSensor::buildCompassEvent(void)
 {
-    VHANDLER_LOG;
-
     int done = 0;
 
     // pthread_mutex_lock(&mMplMutex);
@@ -2691,14 +3117,20 @@ void MPLSensor::buildCompassEvent(void)
 #endif
     if (done > 0) {
         int status = 0;
+
+        SENSOR_TRACE_MARK(TRACE_READ, ID_M, mCompassTimestamp);
+        traceBuilt(mCompassTimestamp);
         if (mCompassSensor->providesCalibration()) {
             status = mCompassSensor->getAccuracy();
             status |= INV_CALIBRATED;
         }
         if (mLocalSensorMask & INV_THREE_AXIS_COMPASS) {
+            if (sample_gap_check(&mCompassGap, mCompassTimestamp) > 0)
+                inv_compass_was_turned_off();
+            SENSOR_TRACE_MARK(TRACE_BUILD, ID_M, mCompassTimestamp);
             inv_build_compass(mCachedCompassData, status,
                               mCompassTimestamp);
-            LOGV_IF(INPUT_DATA, 
+            HOT_LOGV(
                     "HAL:inv_build_compass: %+8ld %+8ld %+8ld - %lld",
                     mCachedCompassData[0], mCachedCompassData[1],
                     mCachedCompassData[2], mCompassTimestamp);
@@ -2984,7 +3416,27 @@ int MPLSensor::getDmpRate(int64_t *wanted)
 int MPLSensor::getPollTime(void)
 {
     VHANDLER_LOG;
-    return mPollTime;
+
+    if (mOdrGovState != ODR_GOV_REDUCED)
+        return mPollTime;
+
+    /* wake up for the next held event */
+    int64_t now = getTimestamp();
+    int64_t first = 0;
+    for (int i = 0; i < NumSensors; i++) {
+        if (!(mEnabled & (1 << i)) || !mRealTs[i])
+            continue;
+        int64_t next = mHoldTs[i] + mDelays[i];
+        if (next >= mRealTs[i] + governedDelay(i) - mDelays[i] / 2)
+            continue;
+        if (!first || next < first)
+            first = next;
+    }
+    if (!first)
+        return mPollTime;
+    if (first <= now)
+        return 0;
+    return (int)((first - now + 999999LL) / 1000000LL);
 }
 
 bool MPLSensor::hasPendingEvents(void) const
@@ -3054,39 +3506,6 @@ int MPLSensor::inv_float_to_round2(float *fdata, short *ldata)
     return 0;
 }
 
-int MPLSensor::inv_read_temperature(long long *data)
-{
-    VHANDLER_LOG;
-
-    int count = 0;
-    char raw_buf[40];
-    long raw = 0;
-
-    long long timestamp = 0;
-
-    memset(raw_buf, 0, sizeof(raw_buf));
-    count = read_attribute_sensor(gyro_temperature_fd, raw_buf,
-                                  sizeof(raw_buf));
-    if(count < 1) {
-        LOGE("HAL:error reading gyro temperature");
-        return -1;
-    }
-
-    count = sscanf(raw_buf, "%ld%lld", &raw, &timestamp);
-
-    if(count < 0) {
-        return -1;
-    }
-
-    LOGV_IF(ENG_VERBOSE,
-            "HAL:temperature raw = %ld, timestamp = %lld, count = %d",
-            raw, timestamp, count);
-    data[0] = raw;
-    data[1] = timestamp;
-
-    return 0;
-}
-
 int MPLSensor::inv_read_dmp_state(int fd)
 {
     VFUNC_LOG;
@@ -3467,8 +3886,8 @@ int MPLSensor::inv_init_sysfs_attributes(void)
 
     // get proper (in absolute/relative) IIO path & build MPU's sysfs paths
     // inv_get_sysfs_abs_path(sysfs_path);
-    inv_get_sysfs_path(sysfs_path);
-    inv_get_iio_trigger_path(iio_trigger_path);
+    inv_root_sysfs_path(sysfs_path, sizeof(sysfs_path));
+    inv_root_iio_trigger_path(iio_trigger_path, sizeof(iio_trigger_path));
 
     if (strcmp(sysfs_path, "") == 0  || strcmp(iio_trigger_path, "") == 0)
         return 0;
@@ -27,6 +27,10 @@
 #include "sensors.h"
 #include "SensorBase.h"
 #include "InputEventReader.h"
+#include "GyroTempSampler.h"
+#include "iio_scan.h"
+#include "sample_gap.h"
+#include "sensor_trace.h"
 
 #if 1
 #ifdef INVENSENSE_COMPASS_CAL
@@ -77,6 +81,38 @@
 #define INV_DMP_QUATERNION           0x04
 #define INV_DMP_DISPL_ORIENTATION    0x08
 
+// MPL algorithm modules (mMplModules), started on demand from the set of
+// enabled sensors, see MPLSensor::computeMplModules()
+#define INV_MOD_QUATERNION           0x0001
+#define INV_MOD_FAST_NOMOT           0x0002
+#define INV_MOD_GYRO_TC              0x0004
+#define INV_MOD_HAL_OUTPUTS          0x0008
+#define INV_MOD_COMPASS_CAL          0x0010
+#define INV_MOD_COMPASS_BIAS_W_GYRO  0x0020
+#define INV_MOD_HEADING_FROM_GYRO    0x0040
+#define INV_MOD_MAG_DISTURB          0x0080
+#define INV_MOD_9X_FUSION            0x0100
+#define INV_MOD_NO_GYRO_FUSION       0x0200
+#define INV_MOD_QUAT_ACCURACY        0x0400
+
+/* Set to 1 to log the MPL CPU time per sample for each module set */
+#define MPL_MODULE_CPU_STATS         0
+#define MPL_MODULE_CPU_REPORT        (5000)  // samples between reports
+
+/* Motion-adaptive ODR governor, enabled with sensor.mpl.odr_governor=1.
+   After ODR_GOV_SETTLE_NS of no-motion the physical sensors are run at
+   ODR_GOV_DELAY_NS at most and the requested rates are filled in with
+   the last value; the first motion event restores the requested rates. */
+#define ODR_GOV_SETTLE_NS            (2000000000LL)
+#define ODR_GOV_DELAY_NS             (50000000LL)    // 20 Hz
+#define ODR_GOV_REPORT_NS            (60000000000LL) // time-in-state log
+
+enum {
+    ODR_GOV_FULL = 0,
+    ODR_GOV_REDUCED,
+    ODR_GOV_NUM_STATES
+};
+
 /* Uncomment to enable Low Power Quaternion */
 // #define ENABLE_LP_QUAT_FEAT
 
@@ -143,6 +179,7 @@ public:
     int32_t getEnableMask() { return mEnabled; }
 
     virtual int readEvents(sensors_event_t *data, int count);
+    int readHeldEvents(sensors_event_t *data, int count);
     virtual int getFd() const;
     virtual int getAccelFd() const;
     virtual int getCompassFd() const;
@@ -150,7 +187,7 @@ public:
     virtual bool hasPendingEvents() const;
     virtual void sleepEvent();
     virtual void wakeEvent();
-    int populateSensorList(struct sensor_t *list, int len);
+    virtual int populateSensorList(struct sensor_t *list, int len);
     void cbProcData();
 
     //static pointer to the object that will handle callbacks
@@ -159,6 +196,7 @@ public:
     int readAccelEvents(sensors_event_t* data, int count);
     void buildCompassEvent();
     void buildMpuEvent();
+    int loadScanLayout(long key);
 
     int turnOffAccelFifo();
     int enableDmpOrientation(int);
@@ -199,13 +237,20 @@ protected:
     int enableAccel(int en);
     int enableCompass(int en);
     void computeLocalSensorMask(int enabled_sensors);
+    uint32_t computeMplModules(uint32_t enabled);
+    void applyMplModules(uint32_t wanted);
+    void reportMplCpu();
+    int64_t governedDelay(int i);
+    void setOdrGovState(int state, int64_t now);
+    void updateOdrGovernor(long msg);
+    void reportOdrGovernor(int64_t now);
+    static void *odrGovThread(void *arg);
     int enableSensors(unsigned long sensors, int en, uint32_t changed);
     int inv_read_gyro_buffer(int fd, short *data, long long *timestamp);
     int inv_float_to_q16(float *fdata, long *ldata);
     int inv_long_to_q16(long *fdata, long *ldata);
     int inv_float_to_round(float *fdata, long *ldata);
     int inv_float_to_round2(float *fdata, short *sdata);
-    int inv_read_temperature(long long *data);
     int inv_read_dmp_state(int fd);
     int inv_read_sensor_bias(int fd, long *data);
     void inv_get_sensors_orientation(void);
@@ -232,14 +277,20 @@ protected:
     struct pollfd mPollFds[5];
     int mSampleCount;
     pthread_mutex_t mMplMutex;
-    pthread_mutex_t mHALMutex;
+    pthread_mutex_t mHALMutex;     // enable() and every update_delay() caller
 
     char mIIOBuffer[(16 + 8 * 3 + 8) * IIO_BUFFER_LENGTH];
 
+    /* scan layout of iio_fd for the enables in mScanKey, see loadScanLayout() */
+    struct iio_scan_layout mScanLayout;
+    long mScanKey;
+    int mScanQuat, mScanAccel, mScanGyro, mScanCompass, mScanTs;
+
     int iio_fd;
     int accel_fd;
     int mpufifo_fd;
     int gyro_temperature_fd;
+    GyroTempSampler mTempSampler;
 
     int dmp_orient_fd;
     int mDmpOrientationEnabled;
@@ -261,7 +312,6 @@ protected:
     bool mFirstRead;
     short mTempScale;
     short mTempOffset;
-    int64_t mTempCurrentTime;
 //#if CAL_DATA_AUTO_LOAD == 1
     int64_t mCalDataCurrentTime;
 //#endif    
@@ -279,6 +329,20 @@ protected:
     int64_t mSensorTimestamp;
     int64_t mCompassTimestamp;
 
+    /* dropped sample detection, see sample_gap.h */
+    struct sample_gap mGyroGap;
+    struct sample_gap mAccelGap;
+    struct sample_gap mCompassGap;
+
+    /* samples built since the last inv_execute_on_data(), for the fusion
+       trace mark; mpu and external compass */
+    int64_t mTraceBuilt[2];
+    int mTraceBuiltCount;
+    void traceBuilt(int64_t ts) {
+        if (g_sensor_trace_mode != SENSOR_TRACE_OFF && mTraceBuiltCount < 2)
+            mTraceBuilt[mTraceBuiltCount++] = ts;
+    }
+
     struct sysfs_attrbs {
        char *chip_enable;
        char *power_state;
@@ -328,6 +392,28 @@ protected:
     char *sysfs_names_ptr;
     int mFeatureActiveMask;
 
+    uint32_t mMplModules;       // modules currently started
+    uint32_t mMplModulesAvail;  // modules enabled in inv_constructor_init()
+    uint32_t mMplModulesWanted; // written by enable(), applied in readEvents()
+    uint32_t mMplCpuSamples;
+    int64_t mMplCpuNs;
+
+    bool mOdrGovEnabled;
+    int mOdrGovState;           // read by update_delay() on any thread
+    int64_t mNoMotionSince;     // 0 while moving
+    int64_t mOdrGovSince;
+    int64_t mOdrGovTime[ODR_GOV_NUM_STATES];
+    int64_t mOdrGovReported;
+    uint32_t mOdrGovSwitches;
+    pthread_t mOdrGovThread;
+    pthread_mutex_t mOdrGovLock;
+    pthread_cond_t mOdrGovCond;
+    bool mOdrGovPending;        // under mOdrGovLock
+    bool mOdrGovStop;           // under mOdrGovLock
+    bool mOdrGovRunning;
+    int64_t mHoldTs[NumSensors];    // last event delivered, real or held
+    int64_t mRealTs[NumSensors];    // last event built from sensor data
+
 private:
     /* added for dynamic get sensor list */
     void fillAccel(const char* accel, struct sensor_t *list);
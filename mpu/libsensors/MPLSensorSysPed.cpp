@@ -25,6 +25,7 @@
 #include <unistd.h>
 #include <dirent.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/select.h>
 #include <dlfcn.h>
 #include <pthread.h>
@@ -62,6 +63,16 @@ void step_cb_wrapper_fp(unsigned long val, double wtime)
 }
 } //end of extern C
 
+static struct sensor_t sPedSensorList[PED_NUM_SENSORS] =
+{
+    {"MPL Step Detector", "Invensense", 1,
+     ID_PED_SD,
+     SENSOR_TYPE_STEP_DETECTOR, 1.0f, 1.0f, 0.5f, 0, 0, 0, 0, 0,  0, 0, {}},
+    {"MPL Step Counter", "Invensense", 1,
+     ID_PED_SC,
+     SENSOR_TYPE_STEP_COUNTER, 1000000.0f, 1.0f, 0.5f, 0, 0, 0, 0, 0,  0, 0, {}},
+};
+
 MplSysPed_Interface* getSysPedInterfaceObject()
 {
     MPLSensorSysPed* s = static_cast<MPLSensorSysPed*>(MPLSensor::gMPLSensor);
@@ -78,6 +89,13 @@ MPLSensorSysPed::MPLSensorSysPed() : MPLSensorSysApi()
     mSysPedEnabled = false;
     mStartSysPed = false;
 
+    resetStepQueue();
+    mStepSensors = 0;
+    mPedByHandle = false;
+    mPedWakeups = 0;
+    mPedWakeSteps = 0;
+    mPedStatsStart = 0;
+
     mStepParams.threshold = 25000000L;
     mStepParams.minUpTime = 16*20;
     mStepParams.maxUpTime = 60*20;
@@ -180,10 +198,152 @@ void MPLSensorSysPed::shutdownFeatures()
     }
 }
 
+/* called from inv_update_data() in full power mode, once per step */
 void MPLSensorSysPed::onStepCb(unsigned long val, unsigned long wtime)
 {
     mPedSteps = val;
     mPedWt    = wtime;
+    queueSteps(val, wtime, now_ns());
+}
+
+void MPLSensorSysPed::resetStepQueue()
+{
+    memset(&mStepRing, 0, sizeof(mStepRing));
+    mQueuedSteps = 0;
+    mQueuedWt = 0;
+    mQueuedTs = 0;
+    mCounterPending = false;
+}
+
+/**
+ *  Queue one step detector event for every step between the last queued
+ *  count and @a steps. In full power mode this runs once per step, so the
+ *  event gets the time it was detected. After a standalone period the
+ *  pedometer only reports totals; the new steps happened during the walk
+ *  time that passed since the last event, so they are spread evenly over
+ *  that span, ending at @a now.
+ */
+void MPLSensorSysPed::queueSteps(unsigned long steps, double wt, int64_t now)
+{
+    unsigned long n, k;
+    int64_t span;
+
+    if (steps < mQueuedSteps) {
+        // counter was reset underneath us
+        mQueuedSteps = steps;
+        mQueuedWt = wt;
+        return;
+    }
+    if (steps == mQueuedSteps)
+        return;
+
+    n = steps - mQueuedSteps;
+    span = (int64_t)((wt - mQueuedWt) * 1000000.0);
+    if (span < 0)
+        span = 0;
+    if (mQueuedTs && span > now - mQueuedTs)
+        span = now - mQueuedTs;
+
+    for (k = 1; k <= n; k++) {
+        int idx;
+        if (mStepRing.count == PED_RING_SIZE) {
+            mStepRing.head = (mStepRing.head + 1) % PED_RING_SIZE;
+            mStepRing.count--;
+            mStepRing.dropped++;
+        }
+        idx = (mStepRing.head + mStepRing.count) % PED_RING_SIZE;
+        mStepRing.ts[idx] = now - span * (int64_t)(n - k) / (int64_t)n;
+        mStepRing.steps[idx] = mQueuedSteps + k;
+        mStepRing.count++;
+    }
+
+    mPedWakeSteps += n;
+    mQueuedSteps = steps;
+    mQueuedWt = wt;
+    mQueuedTs = now;
+    mCounterPending = true;
+}
+
+/**
+ *  Deliver queued step detector events, oldest first, followed by one
+ *  step counter event with the latest total. Events that don't fit in
+ *  @a count stay queued for the next call. Events of a disabled step
+ *  sensor are discarded.
+ */
+int MPLSensorSysPed::drainSteps(sensors_event_t* data, int count)
+{
+    int n = 0;
+
+    if (!mSysPedEnabled)
+        return 0;
+
+    if (mStepRing.dropped) {
+        LOGW("sys ped: %lu step events dropped while the host was asleep",
+             mStepRing.dropped);
+        mStepRing.dropped = 0;
+    }
+
+    if (!(mStepSensors & PED_SENSOR_BIT(ID_PED_SD))) {
+        mStepRing.head = 0;
+        mStepRing.count = 0;
+    }
+    if (!(mStepSensors & PED_SENSOR_BIT(ID_PED_SC)))
+        mCounterPending = false;
+
+    while (mStepRing.count && count - n > 1) {
+        int idx = mStepRing.head;
+        memset(data, 0, sizeof(*data));
+        data->version = sizeof(sensors_event_t);
+        data->sensor = ID_PED_SD;
+        data->type = SENSOR_TYPE_STEP_DETECTOR;
+        data->data[0] = 1.0f;
+        data->timestamp = mStepRing.ts[idx];
+        data++;
+        n++;
+        mStepRing.head = (mStepRing.head + 1) % PED_RING_SIZE;
+        mStepRing.count--;
+    }
+
+    // the counter goes out last, once its detector events are all out
+    if (mCounterPending && !mStepRing.count && count - n > 0) {
+        memset(data, 0, sizeof(*data));
+        data->version = sizeof(sensors_event_t);
+        data->sensor = ID_PED_SC;
+        data->type = SENSOR_TYPE_STEP_COUNTER;
+        data->u64.step_counter = mQueuedSteps;
+        data->timestamp = mQueuedTs;
+        n++;
+        mCounterPending = false;
+    }
+
+    return n;
+}
+
+/**
+ *  Count host wakeups and log how many of them happen per hour of walking.
+ *  Standalone mode should only wake the host on motion changes.
+ */
+void MPLSensorSysPed::pedWakeStats(int64_t now)
+{
+    if (!mSysPedEnabled)
+        return;
+
+    if (!mPedStatsStart)
+        mPedStatsStart = now;
+    mPedWakeups++;
+
+    if (now - mPedStatsStart >= PED_STATS_PERIOD_NS) {
+        double hours = (now - mPedStatsStart) / 3600e9;
+        if (mPedWakeSteps) {
+            LOGI("sys ped: %lu wakeups, %lu steps in %.0f s "
+                 "(%.0f wakeups/h while walking, state %d)",
+                 mPedWakeups, mPedWakeSteps, hours * 3600.0,
+                 mPedWakeups / hours, mPedState);
+        }
+        mPedWakeups = 0;
+        mPedWakeSteps = 0;
+        mPedStatsStart = now;
+    }
 }
 
 void MPLSensorSysPed::setupPedFp()
@@ -227,7 +387,6 @@ void MPLSensorSysPed::setupPedFp()
 int MPLSensorSysPed::readEvents(sensors_event_t* data, int count)
 {
     //VFUNC_LOG;
-    int i;
     bool irqSet[5] = {false, false, false, false, false};
     inv_error_t rv;
     if (count < 1)
@@ -236,7 +395,12 @@ int MPLSensorSysPed::readEvents(sensors_event_t* data, int count)
 
     clearIrqData(irqSet);
 
+    // the data was read when the interrupt woke us up; don't stamp it
+    // with the time processing finished
+    int64_t tt = now_ns();
+
     pthread_mutex_lock(&mMplMutex);
+    pedWakeStats(tt);
     if (mDmpStarted) {
         //LOGV_IF(EXTRA_VERBOSE, "Update Data");
         rv = inv_update_data();
@@ -265,6 +429,8 @@ int MPLSensorSysPed::readEvents(sensors_event_t* data, int count)
             inv_get_low_power_pedometer_walk_time(&curwt);
             mPedSteps = cursteps;
             mPedWt = curwt;
+            // steps counted by the DMP since the last wakeup
+            queueSteps(cursteps, curwt, tt);
             int idx = mIrqFds.indexOfKey(ACCELIRQ_FD);
             LOGE_IF(idx < 1, "ERROR -- accel irq not present.  pedometer will not function");
             inv_error_t e = inv_stop_low_power_pedometer();
@@ -277,37 +443,112 @@ int MPLSensorSysPed::readEvents(sensors_event_t* data, int count)
                 "MPLSensorSysPed::readEvents called, but there's nothing to do.");
     }
 
-    pthread_mutex_unlock(&mMplMutex);
+    if (mNewData) {
+        mNewData = 0;
+        for (int i = 0; i < numSensors; i++) {
+            if (mEnabled & (1 << i)) {
+                uint32_t was = mPendingMask & (1 << i);
+                mPendingMask &= ~(1 << i);
+                CALL_MEMBER_FN(this,mHandlers[i])(mPendingEvents + i,
+                                                  &mPendingMask, i);
+                if (mPendingMask & (1 << i))
+                    mPendingEvents[i].timestamp = tt;
+                else
+                    mPendingMask |= was;
+            }
+        }
 
-    if (!mNewData) {
+        for (int j = 0; count && mPendingMask && j < numSensors; j++) {
+            if (mPendingMask & (1 << j)) {
+                mPendingMask &= ~(1 << j);
+                if (mEnabled & (1 << j)) {
+                    *data++ = mPendingEvents[j];
+                    count--;
+                    numEventReceived++;
+                }
+            }
+        }
+    } else {
         LOGV_IF(EXTRA_VERBOSE, "no new data");
-        return 0;
     }
-    mNewData = 0;
-    int64_t tt = now_ns();
+
+    numEventReceived += drainSteps(data, count);
+
+    pthread_mutex_unlock(&mMplMutex);
+    return numEventReceived;
+}
+
+/**
+ *  The step sensors run on the system pedometer; enabling the first one
+ *  starts it unless the sys-ped interface already did, and disabling the
+ *  last one stops it again only if it was started here.
+ */
+int MPLSensorSysPed::enable(int32_t handle, int en)
+{
+    VFUNC_LOG;
+    uint32_t was, cur;
+
+    if (handle != ID_PED_SD && handle != ID_PED_SC)
+        return MPLSensor::enable(handle, en);
+
+    LOGV_IF(PROCESS_VERBOSE, "HAL:enable - sensor %s (handle %d) -> %s",
+            sPedSensorList[handle - ID_PED_SD].name, handle,
+            (en ? "en" : "dis"));
+
     pthread_mutex_lock(&mMplMutex);
-    for (int i = 0; i < numSensors; i++) {
-        if (mEnabled & (1 << i)) {
-            CALL_MEMBER_FN(this,mHandlers[i])(mPendingEvents + i,
-                                              &mPendingMask, i);
-            mPendingEvents[i].timestamp = tt;
+    was = mStepSensors;
+    if (en)
+        mStepSensors |= PED_SENSOR_BIT(handle);
+    else
+        mStepSensors &= ~PED_SENSOR_BIT(handle);
+    if (en && !(was & PED_SENSOR_BIT(handle))) {
+        // don't replay steps taken while the sensor was off
+        if (handle == ID_PED_SD) {
+            mStepRing.head = 0;
+            mStepRing.count = 0;
+            mStepRing.dropped = 0;
+        } else {
+            mCounterPending = true;
+            mQueuedTs = now_ns();
         }
     }
+    cur = mStepSensors;
+    pthread_mutex_unlock(&mMplMutex);
 
-    for (int j = 0; count && mPendingMask && j < numSensors; j++) {
-        if (mPendingMask & (1 << j)) {
-            mPendingMask &= ~(1 << j);
-            if (mEnabled & (1 << j)) {
-                *data++ = mPendingEvents[j];
-                count--;
-                numEventReceived++;
-            }
-        }
-
+    if (cur && !was && !mSysPedEnabled) {
+        mPedByHandle = true;
+        return rpcStartPed();
+    }
+    if (!cur && was && mPedByHandle) {
+        mPedByHandle = false;
+        return rpcStopPed();
     }
+    return 0;
+}
 
-    pthread_mutex_unlock(&mMplMutex);
-    return numEventReceived;
+int MPLSensorSysPed::setDelay(int32_t handle, int64_t ns)
+{
+    VFUNC_LOG;
+
+    // on-change sensors, reported as the pedometer counts steps
+    if (handle == ID_PED_SD || handle == ID_PED_SC)
+        return 0;
+    return MPLSensor::setDelay(handle, ns);
+}
+
+int MPLSensorSysPed::populateSensorList(struct sensor_t *list, int len)
+{
+    VFUNC_LOG;
+    int numsensors = MPLSensor::populateSensorList(list, len);
+
+    if (numsensors < 0)
+        return numsensors;
+    if (len < (int)((numsensors + PED_NUM_SENSORS) * sizeof(sensor_t))) {
+        LOGE("HAL:sensor list too small, step sensors not added.");
+        return numsensors;
+    }
+    memcpy(list + numsensors, sPedSensorList, sizeof(sPedSensorList));
+    return numsensors + PED_NUM_SENSORS;
 }
 
 /****************** RPC interface implementation ********************* */
@@ -377,14 +618,17 @@ int MPLSensorSysPed::rpcStopPed()
     }
 
     mSysPedEnabled = false;
+    resetStepQueue();
 
     mStartSysPed = false;
     setPowerStates(mEnabled);
 
     pthread_mutex_unlock(&mMplMutex);
 
-    //update delay locks the mutex, as it is callable from the sm context
+    //update_delay() callers hold mHALMutex, see MPLSensor.h
+    pthread_mutex_lock(&mHALMutex);
     update_delay();
+    pthread_mutex_unlock(&mHALMutex);
 
     return INV_SUCCESS;
 
@@ -399,8 +643,11 @@ int MPLSensorSysPed::rpcGetSteps()
     if(mPedState == PED_FULL) {
         steps = mPedSteps;
     } else if(mPedState == PED_STANDALONE) {
+        double wt;
         if(inv_get_low_power_pedometer_num_of_steps(&steps) == INV_SUCCESS) {
             mPedSteps = steps;
+            if (inv_get_low_power_pedometer_walk_time(&wt) == INV_SUCCESS)
+                queueSteps(steps, wt, now_ns());
         }
     } else if(mPedState == PED_SLEEP) {
         steps = mPedSteps; //if state is PED_SLEEP, just return the current count
@@ -443,6 +690,7 @@ int MPLSensorSysPed::rpcClearPedData()
     }
     mPedSteps = 0;
     mPedWt = 0;
+    resetStepQueue();
     pthread_mutex_unlock(&mMplMutex);
     return INV_SUCCESS;
 }
@@ -24,6 +24,26 @@
 #include "mlpedometer_fullpower.h"
 #include "mlpedometer_lowpower.h"
 
+/* step events kept for the host while it sleeps; the oldest are dropped
+   first, the step counter total is never lost */
+#define PED_RING_SIZE           (128)
+/* period of the wakeup statistics log */
+#define PED_STATS_PERIOD_NS     (600LL * 1000000000LL)
+
+/* step sensors added to the list by MPLSensorSysPed::populateSensorList() */
+#define ID_PED_SD               (ID_SO + 1)     /* step detector */
+#define ID_PED_SC               (ID_SO + 2)     /* step counter */
+#define PED_NUM_SENSORS         (2)
+#define PED_SENSOR_BIT(h)       (1 << ((h) - ID_PED_SD))
+
+struct pedStepRing {
+    int64_t ts[PED_RING_SIZE];
+    unsigned long steps[PED_RING_SIZE];
+    int head;
+    int count;
+    unsigned long dropped;
+};
+
 
 class MPLSensorSysPed : public MPLSensorSysApi, public MplSysPed_Interface {
 
@@ -45,6 +65,18 @@ public:
     bool mSysPedEnabled;  //flag indicating if the sys-api ped is enabled
     bool mStartSysPed;
 
+    struct pedStepRing mStepRing;  //step detector events not yet delivered
+    unsigned long mQueuedSteps;    //step count at the last queued event
+    double mQueuedWt;              //walk time (ms) at the last queued event
+    int64_t mQueuedTs;             //time of the last queued event
+    bool mCounterPending;          //step counter changed since last delivery
+    uint32_t mStepSensors;         //enabled step handles, bit (handle - ID_PED_SD)
+    bool mPedByHandle;             //pedometer started for the step handles
+
+    unsigned long mPedWakeups;     //readEvents() calls in this stats period
+    unsigned long mPedWakeSteps;   //steps counted in this stats period
+    int64_t mPedStatsStart;
+
     virtual void computeLocalSensorMask(int);
     virtual bool needStateChange(bool, bool);
     virtual bool needDMPStop();
@@ -53,7 +85,14 @@ public:
     virtual void shutdownFeatures();
     void onStepCb(unsigned long, unsigned long);
     void setupPedFp();
+    void queueSteps(unsigned long steps, double wt, int64_t now);
+    void resetStepQueue();
+    int drainSteps(sensors_event_t* data, int count);
+    void pedWakeStats(int64_t now);
     virtual int readEvents(sensors_event_t* data, int count);
+    virtual int enable(int32_t handle, int enabled);
+    virtual int setDelay(int32_t handle, int64_t ns);
+    virtual int populateSensorList(struct sensor_t *list, int len);
 
     virtual int rpcStartPed();
     virtual int rpcStopPed();
@@ -20,8 +20,12 @@
 #include "log.h"
 #include "SensorBase.h"
 #include <fcntl.h>
+#include <dirent.h>
+#include <ctype.h>
+#include <errno.h>
 
 #include "ml_sysfs_helper.h"
+#include "sysfs_root.h"
 
 int inv_read_data(char *fname, long *data)
 {
@@ -232,3 +236,111 @@ int fill_dev_full_name_by_prefix(const char* dev_prefix,
     return 1;
 }
 
+
+/* the chips ml_sysfs_helper looks for, by IIO device name */
+static const char *const root_chips[] = {
+    "ITG3500", "MPU6050", "MPU9150", "MPU3050",
+    "MPU6500", "MPU6515", "MPU9250", "MPU688X",
+};
+
+static int root_dev_num = -2;       /* -2 not looked up yet, -1 none */
+static int root_chip;
+
+int inv_root_find_device(const char *name)
+{
+    char path[MAX_SYSFS_NAME_LEN], this_name[32];
+    struct dirent *ent;
+    DIR *dp;
+    FILE *fp;
+    int num, found = -ENODEV;
+
+    if (!*sysfs_root())
+        return find_type_by_name(name, "iio:device");
+
+    if (sysfs_root_path(path, sizeof(path), "/sys/bus/iio/devices") < 0)
+        return -ENODEV;
+    dp = opendir(path);
+    if (dp == NULL)
+        return -ENODEV;
+    while (found < 0 && (ent = readdir(dp)) != NULL) {
+        if (sscanf(ent->d_name, "iio:device%d", &num) != 1)
+            continue;
+        if (sysfs_root_path(path, sizeof(path),
+                "/sys/bus/iio/devices/iio:device%d/name", num) < 0)
+            continue;
+        fp = fopen(path, "r");
+        if (fp == NULL)
+            continue;
+        if (fscanf(fp, "%31s", this_name) == 1 && !strcmp(this_name, name))
+            found = num;
+        fclose(fp);
+    }
+    closedir(dp);
+    return found;
+}
+
+/* ml_sysfs_helper's init_iio(), below the redirected root */
+static int find_root_device(void)
+{
+    char name[16];
+    size_t i, j;
+    int num;
+
+    if (root_dev_num != -2)
+        return root_dev_num;
+    root_dev_num = -1;
+    for (i = 0; i < sizeof(root_chips) / sizeof(root_chips[0]); i++) {
+        for (j = 0; root_chips[i][j] && j < sizeof(name) - 1; j++)
+            name[j] = tolower(root_chips[i][j]);
+        name[j] = 0;
+        num = inv_root_find_device(name);
+        if (num >= 0) {
+            root_dev_num = num;
+            root_chip = i;
+            break;
+        }
+    }
+    if (root_dev_num < 0)
+        LOGE("HAL:no InvenSense IIO device below %s", sysfs_root());
+    return root_dev_num;
+}
+
+int inv_root_sysfs_path(char *name, size_t size)
+{
+    if (!*sysfs_root())
+        return inv_get_sysfs_path(name) == INV_SUCCESS ? 0 : -1;
+    if (find_root_device() < 0)
+        return -1;
+    return sysfs_root_path(name, size, "/sys/bus/iio/devices/iio:device%d",
+                           root_dev_num) < 0 ? -1 : 0;
+}
+
+int inv_root_iio_trigger_path(char *name, size_t size)
+{
+    if (!*sysfs_root())
+        return inv_get_iio_trigger_path(name) == INV_SUCCESS ? 0 : -1;
+    if (find_root_device() < 0)
+        return -1;
+    return sysfs_root_path(name, size, "/sys/bus/iio/devices/trigger%d",
+                           root_dev_num) < 0 ? -1 : 0;
+}
+
+int inv_root_iio_device_node(char *name, size_t size)
+{
+    if (!*sysfs_root())
+        return inv_get_iio_device_node(name) == INV_SUCCESS ? 0 : -1;
+    if (find_root_device() < 0)
+        return -1;
+    return sysfs_root_path(name, size, "/dev/iio:device%d",
+                           root_dev_num) < 0 ? -1 : 0;
+}
+
+int inv_root_chip_name(char *name, size_t size)
+{
+    if (!*sysfs_root())
+        return inv_get_chip_name(name) == INV_SUCCESS ? 0 : -1;
+    if (find_root_device() < 0)
+        return -1;
+    snprintf(name, size, "%s", root_chips[root_chip]);
+    return 0;
+}
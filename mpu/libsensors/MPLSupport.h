@@ -17,6 +17,7 @@
 #ifndef ANDROID_MPL_SUPPORT_H
 #define ANDROID_MPL_SUPPORT_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 int inv_read_data(char *fname, long *data);
@@ -30,4 +31,17 @@ int write_sysfs_longlong(char*, long long);
 int fill_dev_full_name_by_prefix(const char* dev_prefix,
                                  char* dev_full_name, int len);
 
+/*
+ * The libmllite device lookups, inv_get_sysfs_path() and friends, but
+ * looked up below $SENSORS_SYSFS_ROOT when it is set (see
+ * common/sysfs_root.h).  The prebuilt libmllite only ever scans the real
+ * /sys.  inv_root_find_device() is find_type_by_name(name, "iio:device");
+ * the others return 0, or -1 if no InvenSense device was found.
+ */
+int inv_root_find_device(const char *name);
+int inv_root_sysfs_path(char *name, size_t size);
+int inv_root_iio_trigger_path(char *name, size_t size);
+int inv_root_iio_device_node(char *name, size_t size);
+int inv_root_chip_name(char *name, size_t size);
+
 #endif //  ANDROID_MPL_SUPPORT_H
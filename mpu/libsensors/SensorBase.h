@@ -49,9 +49,10 @@
 /* Note that enabling this logs may affect performance */
 #define HANDLER_ENTRY   (0) /* log entry in all handler functions */
 #define ENG_VERBOSE     (0) /* log some a lot more info about the internals */
-#define INPUT_DATA      (0) /* log the data input from the events */
-#define HANDLER_DATA    (0) /* log the data fetched from the handlers */
-#define DEBUG_DELAY		(0) /* log the data delay time */
+/* per-sample input and handler data go through HOT_LOGV(), see sensor_log.h,
+   and per-sample timing through SENSOR_TRACE_MARK(), see sensor_trace.h */
+/* delivery rate, jitter and latency are kept by sensor_stats, see
+   common/sensor_stats.h */
 
 #define FUNC_LOG \
             LOGD("%s", __PRETTY_FUNCTION__)
@@ -26,10 +26,17 @@
 
 #include "YamahaSensor.h"
 #include "yas_android_lib.h"
+#include "sample_gap.h"
+#include "sensor_trace.h"
+#include "sysfs_root.h"
 
 #define IIO_MAX_NAME_LENGTH 30
+/* a drain holds what the device produces in this long */
+#define DRAIN_WINDOW_NS     (500000000LL)
+#define DRAIN_MIN_SCANS     (4)
+#define DRAIN_MAX_SCANS     (128)
 
-static const char *iio_dir = "/sys/bus/iio/devices/";
+static char iio_dir[PATH_MAX / 2];
 
 static int chomp(char *buf, int len)
 {
@@ -194,16 +201,18 @@ static inline int find_type_by_name(const char *name, const char *type)
 
 YamahaSensor::YamahaSensor()
     : SensorBase(NULL, NULL), mEnabled(0), mDelayNs(50000000),
-    mCountToNotify(0), mCounter(0), mAccuracy(0)
+    mSampleNs(50000000), mNextEventNs(0), mScans(NULL), mCalScans(NULL),
+    mScanCapacity(0), mScanCount(0), mScanPos(0), mAccuracy(0)
 {
     char buffer_access[PATH_MAX];
     const char *device_name = YAS_MAG_NAME;
     int rate = 20, dev_num;
+    sysfs_root_path(iio_dir, sizeof(iio_dir), "/sys/bus/iio/devices/");
     dev_num = find_type_by_name(device_name, "iio:device");
     if (dev_num < 0) {
         dev_num = 0;
     }
-    snprintf(buffer_access, sizeof(buffer_access),
+    sysfs_root_path(buffer_access, sizeof(buffer_access),
             "/dev/iio:device%d", dev_num);
     dev_fd = open(buffer_access, O_RDONLY | O_NONBLOCK);
     snprintf(mDevPath, sizeof(mDevPath), "%siio:device%d", iio_dir, dev_num);
@@ -215,6 +224,7 @@ YamahaSensor::YamahaSensor()
             rate = 20;
         mDelayNs = (int64_t)(1000000000LL / rate);
     }
+    sample_gap_init(&mGap, "yamaha mag");
     /* read initial value */
     Magnetic_Initialize();
 }
@@ -222,25 +232,52 @@ YamahaSensor::YamahaSensor()
 YamahaSensor::~YamahaSensor() {
     if (mEnabled)
         enable(ID_M, 0);
+    sample_gap_fini(&mGap);
+    free(mScans);
+    free(mCalScans);
 }
 
 int YamahaSensor::updateDelay() {
-    int64_t ns = -1;
+    int64_t ns;
+    int scans, rate;
     if (!mEnabled)
         return 0;
+    /* 5Hz still samples at 20Hz for the calibration, every fourth scan
+       is picked out by timestamp in readEvents() */
     ns = mDelayNs;
-    if (ns == 200000000) {
-        mCountToNotify = 4;
-        mCounter = 0;
-    } else {
-        mCountToNotify = mDelayNs / ns;
-        mCounter = 0;
-    }
-    if (ns == 200000000) {
+    if (ns == 200000000)
         ns = 50000000;
+    rate = (int)((1000000000LL + ns / 2) / ns);
+    if (rate < 1)
+        rate = 1;
+    ns = 1000000000LL / rate;
+    mSampleNs = ns;
+    mNextEventNs = 0;
+    sample_gap_reset(&mGap, ns);
+
+    scans = (int)(DRAIN_WINDOW_NS / ns);
+    if (scans < DRAIN_MIN_SCANS)
+        scans = DRAIN_MIN_SCANS;
+    if (scans > DRAIN_MAX_SCANS)
+        scans = DRAIN_MAX_SCANS;
+    if (scans > mScanCapacity) {
+        MAGRAWDATA *s = (MAGRAWDATA *)realloc(mScans,
+                scans * sizeof(*mScans));
+        if (s != NULL) {
+            /* the old block is gone either way, only the capacity waits
+               for both */
+            mScans = s;
+            SENSORDATA *c = (SENSORDATA *)realloc(mCalScans,
+                    scans * sizeof(*mCalScans));
+            if (c != NULL) {
+                mCalScans = c;
+                mScanCapacity = scans;
+            }
+        }
     }
+
     if (sysfs_set_input_attr_by_int(mDevPath, "sampling_frequency",
-                (int)(1000000000LL / ns)) < 0)
+                rate) < 0)
         return -1;
     Magnetic_Set_Delay(ns);
     return 0;
@@ -270,7 +307,10 @@ int YamahaSensor::enable(int32_t handle, int active)
         Magnetic_Disable();
     updateDelay();
     if (active) {
-        if (sysfs_set_input_attr_by_int(mDevPath, "buffer/length", 2) < 0)
+        mScanCount = mScanPos = 0;
+        /* sized for the fastest rate, setDelay() doesn't stop the buffer */
+        if (sysfs_set_input_attr_by_int(mDevPath, "buffer/length",
+                    DRAIN_MAX_SCANS) < 0)
             return -1;
         if (sysfs_set_input_attr(mDevPath, "trigger/current_trigger",
                     mTriggerName, strlen(mTriggerName)) < 0)
@@ -297,48 +337,70 @@ int YamahaSensor::setDelay(int32_t handle, int64_t ns)
     YLOGD(("YamahaSensor::setDelay IN %d %lld\n", handle, ns));
     if (handle != ID_M)
         return -1;
-    if (ns == 66667000)
-        ns = 66666000;
     mDelayNs = ns;
     updateDelay();
     YLOGD(("YamahaSensor::setDelay OUT\n"));
     return 0;
 }
 
+/*
+ * Drain the IIO buffer in one read and run the calibration over every scan
+ * of it, whether or not it becomes an event.
+ */
+int YamahaSensor::fillScans()
+{
+    ssize_t nread;
+
+    mScanCount = mScanPos = 0;
+    if (mScanCapacity == 0)
+        return 0;
+    nread = read(dev_fd, mScans, mScanCapacity * sizeof(*mScans));
+    if (nread < 0)
+        return -errno;
+    mScanCount = (int)(nread / sizeof(*mScans));
+    /* a full buffer between two reads overflows in the kernel */
+    for (int i = 0; i < mScanCount; i++) {
+        SENSOR_TRACE_MARK(TRACE_READ, ID_M, mScans[i].timestamp);
+        sample_gap_check(&mGap, mScans[i].timestamp);
+    }
+    Magnetic_Calibrate_Batch(mScans, mCalScans, mScanCount);
+    return mScanCount;
+}
+
 int YamahaSensor::readEvents(sensors_event_t* data, int count)
 {
-    int32_t tmp[12], *p;
-    int numEventReceived = 0, nread, i;
-    SENSORDATA mag, calmag;
+    int numEventReceived = 0;
 
     YLOGD(("YamahaSensor::readEvents IN [%p] [%d]\n", data, count));
     if (count < 1 || dev_fd < 0)
         return -EINVAL;
-    nread = read(dev_fd, tmp, sizeof(tmp));
-    p = tmp;
-    for (i = 0; i < nread / 24; i++) {
-        mag.x = p[0];
-        mag.y = p[1];
-        mag.z = p[2];
-        Magnetic_Calibrate(&mag, &calmag);
-        if (mEnabled && mCountToNotify
-                <= ++mCounter) {
-            memset(&data[numEventReceived], 0, sizeof(sensors_event_t));
-            data[numEventReceived].version = sizeof(sensors_event_t);
-            data[numEventReceived].sensor = ID_M;
-            data[numEventReceived].type = SENSOR_TYPE_MAGNETIC_FIELD;
-            data[numEventReceived].magnetic.v[0] = calmag.vx;
-            data[numEventReceived].magnetic.v[1] = calmag.vy;
-            data[numEventReceived].magnetic.v[2] = calmag.vz;
-            data[numEventReceived].magnetic.status = calmag.accuracy;
-            data[numEventReceived].timestamp = *(int64_t *)(&p[4]);
-            mCounter = 0;
-            numEventReceived++;
-            count--;
-            if (count == 0)
-                break;
-        }
-        p += 6;
+    /* scans left over from a short @count are delivered first */
+    if (mScanPos == mScanCount && fillScans() <= 0)
+        return 0;
+
+    while (mScanPos < mScanCount && count > 0) {
+        const MAGRAWDATA *s = &mScans[mScanPos];
+        const SENSORDATA *calmag = &mCalScans[mScanPos];
+        mScanPos++;
+
+        /* emit on the requested period from the last event; half a
+           device period of slack absorbs the timestamp jitter */
+        if (!mEnabled || s->timestamp + mSampleNs / 2 < mNextEventNs)
+            continue;
+        mNextEventNs = s->timestamp + mDelayNs;
+
+        memset(&data[numEventReceived], 0, sizeof(sensors_event_t));
+        data[numEventReceived].version = sizeof(sensors_event_t);
+        data[numEventReceived].sensor = ID_M;
+        data[numEventReceived].type = SENSOR_TYPE_MAGNETIC_FIELD;
+        data[numEventReceived].magnetic.v[0] = calmag->vx;
+        data[numEventReceived].magnetic.v[1] = calmag->vy;
+        data[numEventReceived].magnetic.v[2] = calmag->vz;
+        data[numEventReceived].magnetic.status = calmag->accuracy;
+        data[numEventReceived].timestamp = s->timestamp;
+        SENSOR_TRACE_MARK(TRACE_OUTPUT, ID_M, s->timestamp);
+        numEventReceived++;
+        count--;
     }
     YLOGD(("YamahaSensor::readEvents OUT[%d]\n", numEventReceived));
 
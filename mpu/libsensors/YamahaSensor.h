@@ -26,6 +26,7 @@
 
 #include "SensorBase.h"
 #include "sensor_params.h"
+#include "sample_gap.h"
 #include "sensors.h"
 
 class YamahaSensor : public SensorBase {
@@ -42,13 +43,20 @@ class YamahaSensor : public SensorBase {
 
     private:
         int updateDelay();
+        int fillScans();
         int mEnabled;
         int64_t mDelayNs;
-        int mCountToNotify;
-        int mCounter;
+        int64_t mSampleNs;      /* device period, whole Hz; 50ms at 5Hz */
+        int64_t mNextEventNs;   /* earliest timestamp of the next event */
+        struct _MAGRAWDATAS *mScans;    /* one IIO buffer drain, MAGRAWDATA */
+        struct _SENSORDATAS *mCalScans; /* ... calibrated, SENSORDATA */
+        int mScanCapacity;
+        int mScanCount;
+        int mScanPos;
         char mDevPath[PATH_MAX];
         char mTriggerName[PATH_MAX];
         int mAccuracy;
+        struct sample_gap mGap;
 };
 
 #endif
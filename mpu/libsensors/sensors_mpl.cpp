@@ -32,6 +32,9 @@
 
 #include "sensors.h"
 #include "MPLSensor.h"
+#include "debug_config.h"
+#include "sensor_stats.h"
+#include "sensor_trace.h"
 
 /*****************************************************************************/
 /* The SENSORS Module */
@@ -123,6 +126,9 @@ sensors_poll_context_t::sensors_poll_context_t() {
     sensors =
             mplSensor->populateSensorList(sSensorList, sizeof(sSensorList));
 
+    for (int i = 0; i < sensors; i++)
+        sensor_stats_config(sSensorList[i].handle, sSensorList[i].name, -1);
+
     mSensor = mplSensor;
     mPollFds[mpl].fd = mSensor->getFd();
     mPollFds[mpl].events = POLLIN;
@@ -154,35 +160,103 @@ int sensors_poll_context_t::setDelay(int handle, int64_t ns)
     return mSensor->setDelay(handle, ns);
 }
 
-//#define _DEBUG_RATE
-#ifdef _DEBUG_RATE
-#define NSEC_PER_SEC            1000000000
-
-static inline int64_t timespec_to_ns(const struct timespec *ts)
-{
-	return ((int64_t) ts->tv_sec * NSEC_PER_SEC) + ts->tv_nsec;
-}
-
-static int64_t get_time_ns(void)
+/* the clock of the IIO timestamps, for sensor_stats and the warm-up */
+static int64_t hal_now_ns(void)
 {
-	struct timespec ts;
-	clock_gettime(CLOCK_MONOTONIC, &ts);
-	return timespec_to_ns(&ts);
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
 }
 
-static int64_t tm_min=0;
-static int64_t tm_max=0;
-static int64_t tm_sum=0;
-static int64_t tm_last_print=0;
-static int64_t tm_count=0;
-#endif
-
 #define SENSOR_KEEP_ALIVE       1
 
 #if SENSOR_KEEP_ALIVE
-static int sensor_activate[32];
 static int sensor_delay[32];
 static int64_t sensor_prev_time[32];
+
+/*
+ * Warm-up after activate: samples stamped within the settle time of the
+ * physical sensor behind a handle are marked SENSOR_STATUS_UNRELIABLE.
+ * Rotation vector and uncalibrated gyro have no status field, their
+ * settling samples are still dropped.
+ */
+#define WARMUP_GYRO_NS          (100000000LL)   // start-up + first TC update
+#define WARMUP_ACCEL_NS         (30000000LL)
+#define WARMUP_COMPASS_NS       (20000000LL)
+
+enum {
+    WARMUP_SETTLING = 0,
+    WARMUP_VALID,
+};
+
+static struct sensor_warmup {
+    int64_t activated;      // written by poll__activate(), 0 when off
+    int64_t epoch;          // activation the fields below belong to
+    int state;
+    int64_t first_sample;
+} sensor_warmup[32];
+
+static int64_t warmup_settle_ns(int handle)
+{
+    switch (handle) {
+    case ID_A:
+        return WARMUP_ACCEL_NS;
+    case ID_M:
+        return WARMUP_COMPASS_NS;
+    default:
+        /* gyro and everything fused from it */
+        return WARMUP_GYRO_NS;
+    }
+}
+
+/**
+ *  Runs the warm-up state machine for one event.
+ *  @return 0 to pass the event on, -1 to drop it.
+ */
+static int warmup_filter(sensors_event_t *ev)
+{
+    int handle = ev->sensor;
+    struct sensor_warmup *w;
+    int64_t activated, settle;
+
+    /* screen orientation and the step sensors are events, not streams */
+    if (handle < 0 || handle >= ID_SO)
+        return 0;
+    w = &sensor_warmup[handle];
+    activated = __atomic_load_n(&w->activated, __ATOMIC_ACQUIRE);
+    if (!activated)
+        return 0;
+
+    if (activated != w->epoch) {
+        w->epoch = activated;
+        w->state = WARMUP_SETTLING;
+        w->first_sample = 0;
+    }
+    if (w->state == WARMUP_VALID)
+        return 0;
+
+    if (!w->first_sample)
+        w->first_sample = ev->timestamp;
+    settle = warmup_settle_ns(handle);
+    if (ev->timestamp - activated >= settle) {
+        w->state = WARMUP_VALID;
+        LOGI("HAL:sensor %d valid %lld ms after activate "
+             "(first sample %lld ms, settle %lld ms)", handle,
+             (ev->timestamp - activated) / 1000000LL,
+             (w->first_sample - activated) / 1000000LL,
+             settle / 1000000LL);
+        return 0;
+    }
+
+    switch (handle) {
+    case ID_RV:
+    case ID_RG:
+        return -1;
+    default:
+        ev->acceleration.status = SENSOR_STATUS_UNRELIABLE;
+        return 0;
+    }
+}
 #endif
 
 /*
@@ -193,24 +267,32 @@ static int64_t sensor_prev_time[32];
     8 - 1000 - raw gyro data with uncalib and bias
  */
 static int debug_lvl = 0;
-#include <cutils/properties.h>
 #include "sensor_params.h"
 int sensors_poll_context_t::pollEvents(sensors_event_t *data, int count)
 {
-    VHANDLER_LOG;
-
     int nbEvents = 0;
     int nb, polltime = -1;
-    char propbuf[PROPERTY_VALUE_MAX];
     int i=0;
 
-    property_get("sensor.debug.level", propbuf, "0");
-    debug_lvl = atoi(propbuf);
+    sensor_debug_poll();
+    debug_lvl = sensor_debug_level();
 
-    // look for new events
+    // look for new events; the ODR governor sets a timeout to fill in
+    // held events while the sensors run below the requested rate
+    polltime = ((MPLSensor*) mSensor)->getPollTime();
     nb = poll(mPollFds, numSensorDrivers, polltime);
 
-    if (nb > 0) {
+    if (nb == 0) {
+        nbEvents = ((MPLSensor*) mSensor)->readHeldEvents(data, count);
+        if (nbEvents > 0) {
+            int64_t now = hal_now_ns();
+
+            for (i = 0; i < nbEvents; i++) {
+                sensor_stats_event(data[i].sensor, data[i].timestamp, now);
+                SENSOR_TRACE_MARK(TRACE_POLL, data[i].sensor, data[i].timestamp);
+            }
+        }
+    } else if (nb > 0) {
         for (int i = 0; count && i < numSensorDrivers; i++) {
             if (mPollFds[i].revents & (POLLIN | POLLPRI)) {
                 nb = 0;
@@ -235,9 +317,7 @@ int sensors_poll_context_t::pollEvents(sensors_event_t *data, int count)
 
 #if SENSOR_KEEP_ALIVE
 		for (i=0; i<nb; i++) {
-			if (data[i].sensor>=0 && sensor_activate[data[i].sensor]>0) {
-//				LOGD("Skip sensor data, %d, %d", data[i].sensor, sensor_activate[data[i].sensor]);
-				--sensor_activate[data[i].sensor];
+			if (warmup_filter(&data[i]) < 0) {
 				memset(data+i, 0, sizeof(sensors_event_t));
 				data[i].sensor = -1;
 			}
@@ -245,50 +325,38 @@ int sensors_poll_context_t::pollEvents(sensors_event_t *data, int count)
 #endif
 		if (debug_lvl > 0) {
 			for (i=0; i<nb; i++) {
-				if ((debug_lvl&1) && data[i].sensor==SENSORS_RAW_GYROSCOPE_HANDLE) {
+				if ((debug_lvl & SENSOR_DEBUG_GYRO) && data[i].sensor==SENSORS_RAW_GYROSCOPE_HANDLE) {
 					float gyro_data[3] = {0,0,0};
 					gyro_data[0] = data[i].uncalibrated_gyro.uncalib[0] - data[i].uncalibrated_gyro.bias[0];
 					gyro_data[1] = data[i].uncalibrated_gyro.uncalib[1] - data[i].uncalibrated_gyro.bias[1];
 					gyro_data[2] = data[i].uncalibrated_gyro.uncalib[2] - data[i].uncalibrated_gyro.bias[2];
-					if (debug_lvl&8)
+					if (debug_lvl & SENSOR_DEBUG_RAW_GYRO)
 						LOGD("RAW GYRO: %+f %+f %+f - %lld, uncalib: %+f %+f %+f, bias: %+f %+f %+f", gyro_data[0], gyro_data[1], gyro_data[2], data[i].timestamp,
 							data[i].uncalibrated_gyro.uncalib[0], data[i].uncalibrated_gyro.uncalib[1], data[i].uncalibrated_gyro.uncalib[2],
 							data[i].uncalibrated_gyro.bias[0], data[i].uncalibrated_gyro.bias[1], data[i].uncalibrated_gyro.bias[2]);
 					else
 						LOGD("RAW GYRO: %+f %+f %+f - %lld", gyro_data[0], gyro_data[1], gyro_data[2], data[i].timestamp);
 				}
-				if ((debug_lvl&1) && data[i].sensor==SENSORS_GYROSCOPE_HANDLE) {
+				if ((debug_lvl & SENSOR_DEBUG_GYRO) && data[i].sensor==SENSORS_GYROSCOPE_HANDLE) {
 					LOGD("GYRO: %+f %+f %+f - %lld", data[i].gyro.v[0], data[i].gyro.v[1], data[i].gyro.v[2], data[i].timestamp);
 				}
-				if ((debug_lvl&2) && data[i].sensor==SENSORS_ACCELERATION_HANDLE) {
+				if ((debug_lvl & SENSOR_DEBUG_ACCEL) && data[i].sensor==SENSORS_ACCELERATION_HANDLE) {
 					LOGD("ACCL: %+f %+f %+f - %lld", data[i].acceleration.v[0], data[i].acceleration.v[1], data[i].acceleration.v[2], data[i].timestamp);
 				}
-				if ((debug_lvl&4) && (data[i].sensor==SENSORS_MAGNETIC_FIELD_HANDLE)) {
+				if ((debug_lvl & SENSOR_DEBUG_MAG) && (data[i].sensor==SENSORS_MAGNETIC_FIELD_HANDLE)) {
 					LOGD("MAG: %+f %+f %+f - %lld", data[i].magnetic.v[0], data[i].magnetic.v[1], data[i].magnetic.v[2], data[i].timestamp);
 				}
 			}
 		}
 		
         if (nb > 0) {
-			#ifdef _DEBUG_RATE
-            int64_t tm_cur = get_time_ns();
-            int64_t tm_delta = tm_cur - data->timestamp;
-            if (tm_min==0 && tm_max==0)
-                tm_min = tm_max = tm_delta;
-            else if (tm_delta < tm_min)
-                tm_min = tm_delta;
-            else if (tm_delta > tm_max)
-                tm_max = tm_delta;
-            tm_sum += tm_delta;
-            tm_count++;
-            
-            if ((tm_cur-tm_last_print) > 1000000000) {
-                LOGD("poll end: [%lld] %lld,%lld,%lld\n", data->timestamp, tm_min, (tm_sum/tm_count), tm_max);
-                tm_last_print = tm_cur;
-                tm_min = tm_max = tm_count = tm_sum = 0;
+            int64_t now = hal_now_ns();
+
+            for (i = 0; i < nb; i++) {
+                sensor_stats_event(data[i].sensor, data[i].timestamp, now);
+                SENSOR_TRACE_MARK(TRACE_POLL, data[i].sensor, data[i].timestamp);
             }
-			#endif
-			
+
             count -= nb;
             nbEvents += nb;
             data += nb;
@@ -315,8 +383,12 @@ static int poll__activate(struct sensors_poll_device_t *dev,
 {
     sensors_poll_context_t *ctx = (sensors_poll_context_t *)dev;
 #if SENSOR_KEEP_ALIVE
-    sensor_activate[handle] = enabled?10:0;
+    if (handle >= 0 && handle < 32) {
+        __atomic_store_n(&sensor_warmup[handle].activated,
+                         enabled ? hal_now_ns() : 0, __ATOMIC_RELEASE);
+    }
 #endif	
+    sensor_stats_config(handle, NULL, -1);
     return ctx->activate(handle, enabled);
 }
 
@@ -332,6 +404,7 @@ static int poll__setDelay(struct sensors_poll_device_t *dev,
 	sensor_delay[handle] = ns;
 #endif
 
+    sensor_stats_config(handle, NULL, ns);
     sensors_poll_context_t *ctx = (sensors_poll_context_t *)dev;
     int s= ctx->setDelay(handle, ns);
     return s;
@@ -379,9 +452,10 @@ static int open_sensors(const struct hw_module_t* module, const char* id,
     *device = &dev->device.common;
     status = 0;
 	ert = false;
+    sensor_stats_start(SENSOR_STATS_FIFO);
 
 #if SENSOR_KEEP_ALIVE
-	memset(sensor_activate, 0, 32*sizeof(int));
+	memset(sensor_warmup, 0, sizeof(sensor_warmup));
 	memset(sensor_delay, 0, 32*sizeof(int));
 	memset(sensor_prev_time, 0, 32*sizeof(int64_t));
 #endif
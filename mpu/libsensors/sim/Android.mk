@@ -0,0 +1,81 @@
+#
+# Virtual MPU IIO device and HAL bench, see iio_sim.h.
+#   mpu_iio_sim -t 30 &
+#   SENSORS_SYSFS_ROOT=<printed root> sensors_hal_bench \
+#       -l /system/lib/hw/sensors.rk30board.so -d 5 -t 20
+# The HAL links against bionic, so both run on the target; mpu_iio_sim is
+# also built for the host to generate trees and streams from scripts.
+# mllite_bench, sensor_stats_bench and sensor_trace_report are host tools,
+# see their sources.
+#
+LOCAL_PATH:= $(call my-dir)
+
+IIO_SIM_CFLAGS := -Wall -Wextra -O2
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := mpu_iio_sim
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := $(IIO_SIM_CFLAGS)
+LOCAL_SRC_FILES := iio_sim.c iio_sim_main.c
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := mpu_iio_sim
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := $(IIO_SIM_CFLAGS)
+LOCAL_SRC_FILES := iio_sim.c iio_sim_main.c
+LOCAL_LDLIBS := -lrt
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := sensors_hal_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := $(IIO_SIM_CFLAGS)
+LOCAL_SRC_FILES := hal_bench.c
+LOCAL_SHARED_LIBRARIES := libdl
+include $(BUILD_EXECUTABLE)
+
+# mllite micro-benchmarks, the mllite sources are built into the benchmark
+MLLITE_BENCH_DIR := ../inv_32/core/mllite
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := mllite_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Wall -O2 -DLINUX
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/$(MLLITE_BENCH_DIR)
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/$(MLLITE_BENCH_DIR)/linux
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../inv_32/core/driver/include
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../inv_32/core/driver/include/linux
+LOCAL_SRC_FILES := mllite_bench.c
+LOCAL_SRC_FILES += $(MLLITE_BENCH_DIR)/data_builder.c
+LOCAL_SRC_FILES += $(MLLITE_BENCH_DIR)/hal_outputs.c
+LOCAL_SRC_FILES += $(MLLITE_BENCH_DIR)/message_layer.c
+LOCAL_SRC_FILES += $(MLLITE_BENCH_DIR)/ml_math_func.c
+LOCAL_SRC_FILES += $(MLLITE_BENCH_DIR)/mpl.c
+LOCAL_SRC_FILES += $(MLLITE_BENCH_DIR)/results_holder.c
+LOCAL_SRC_FILES += $(MLLITE_BENCH_DIR)/start_manager.c
+LOCAL_SRC_FILES += $(MLLITE_BENCH_DIR)/storage_manager.c
+LOCAL_SRC_FILES += $(MLLITE_BENCH_DIR)/linux/mlos_linux.c
+LOCAL_LDLIBS := -lm -lrt
+include $(BUILD_HOST_EXECUTABLE)
+
+# cost of the shared poll path statistics, see common/sensor_stats.h
+include $(CLEAR_VARS)
+LOCAL_MODULE := sensor_stats_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := $(IIO_SIM_CFLAGS)
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../../../common
+LOCAL_SRC_FILES := stats_bench.c
+LOCAL_SRC_FILES += ../../../common/sensor_stats.c
+LOCAL_SRC_FILES += ../../../common/sysfs_root.c
+LOCAL_STATIC_LIBRARIES := liblog
+LOCAL_LDLIBS := -lpthread -lrt
+include $(BUILD_HOST_EXECUTABLE)
+
+# per stage latencies from a sensor_trace capture, see common/sensor_trace.h
+include $(CLEAR_VARS)
+LOCAL_MODULE := sensor_trace_report
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := $(IIO_SIM_CFLAGS)
+LOCAL_SRC_FILES := trace_report.c
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,262 @@
+/*
+ * Loads a sensors HAL, activates sensors and measures what comes out of
+ * poll(): events per second and delivery latency (poll return time minus
+ * event timestamp) per sensor.
+ *
+ * usage: sensors_hal_bench [-l hal.so] [-s handle[,handle...]] [-d delay_ms]
+ *                          [-t seconds] [-v] [-T trace.txt]
+ *
+ * Run it against mpu_iio_sim by exporting the SENSORS_SYSFS_ROOT the
+ * simulator prints.
+ *
+ * HALs built with common/sample_gap.c and common/sensor_stats.c also get
+ * their dropped sample counters and their own period, jitter and latency
+ * histograms printed at the end.  With sensor.trace set to 2 before the
+ * run, -T writes the in-memory trace of common/sensor_trace.c to a file
+ * for sensor_trace_report.
+ */
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <hardware/hardware.h>
+#include <hardware/sensors.h>
+
+#define MAX_HANDLES		(32)
+#define POLL_EVENTS		(16)
+
+/* latency histogram, 100 us buckets up to 100 ms */
+#define LAT_BUCKET_NS		(100000LL)
+#define LAT_BUCKETS		(1000)
+
+struct sensor_stats {
+	int active;
+	const char *name;
+	uint64_t events;
+	int64_t first_ts;
+	int64_t last_ts;
+	int64_t lat_sum;
+	int64_t lat_max;
+	uint32_t backwards;	/* timestamps going back */
+	uint32_t hist[LAT_BUCKETS + 1];
+};
+
+static struct sensor_stats stats[MAX_HANDLES];
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-l hal.so] [-s handle[,handle...]] [-d delay_ms] "
+		"[-t seconds] [-v] [-T trace.txt]\n"
+		"  -l  HAL to load (default ./sensors.rk30board.so)\n"
+		"  -s  handles to activate (default all)\n"
+		"  -d  sampling period in msec (default 5)\n"
+		"  -t  run time in seconds (default 10)\n"
+		"  -v  print every event\n"
+		"  -T  write the HAL trace to this file\n",
+		name);
+}
+
+static int64_t percentile(const struct sensor_stats *s, int pct)
+{
+	uint64_t want = (s->events * (uint64_t)pct + 99) / 100, n = 0;
+	int i;
+
+	for (i = 0; i <= LAT_BUCKETS; i++) {
+		n += s->hist[i];
+		if (n >= want)
+			return (int64_t)i * LAT_BUCKET_NS;
+	}
+	return s->lat_max;
+}
+
+int main(int argc, char **argv)
+{
+	const char *lib = "./sensors.rk30board.so", *handles = NULL;
+	const char *trace = NULL;
+	struct sensors_module_t *module;
+	struct sensors_poll_device_t *dev;
+	struct sensor_t const *list;
+	sensors_event_t buf[POLL_EVENTS];
+	int delay = 5, seconds = 10, verbose = 0;
+	int opt, num, i, n;
+	int64_t t0, t, polls = 0;
+	void (*gap_dump)(int), (*stats_dump)(int), (*trace_dump)(int);
+	void *dl;
+
+	while ((opt = getopt(argc, argv, "l:s:d:t:vT:h")) != -1) {
+		switch (opt) {
+		case 'l':
+			lib = optarg;
+			break;
+		case 's':
+			handles = optarg;
+			break;
+		case 'd':
+			delay = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		case 'T':
+			trace = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (delay < 0 || seconds <= 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	dl = dlopen(lib, RTLD_NOW);
+	if (dl == NULL) {
+		fprintf(stderr, "%s\n", dlerror());
+		return 1;
+	}
+	module = (struct sensors_module_t *)dlsym(dl, HAL_MODULE_INFO_SYM_AS_STR);
+	if (module == NULL) {
+		fprintf(stderr, "%s has no %s\n", lib, HAL_MODULE_INFO_SYM_AS_STR);
+		return 1;
+	}
+
+	t = now_ns();
+	if (sensors_open(&module->common, &dev) != 0) {
+		fprintf(stderr, "cannot open the sensors device\n");
+		return 1;
+	}
+	num = module->get_sensors_list(module, &list);
+	printf("open: %.1f ms, %d sensors\n", (now_ns() - t) / 1e6, num);
+
+	for (i = 0; i < num; i++) {
+		int h = list[i].handle;
+
+		if (h < 0 || h >= MAX_HANDLES)
+			continue;
+		stats[h].name = list[i].name;
+		if (handles != NULL) {
+			const char *p = handles;
+			while (p && atoi(p) != h) {
+				p = strchr(p, ',');
+				if (p)
+					p++;
+			}
+			if (p == NULL)
+				continue;
+		}
+		t = now_ns();
+		dev->setDelay(dev, h, (int64_t)delay * 1000000LL);
+		if (dev->activate(dev, h, 1) == 0)
+			stats[h].active = 1;
+		printf("activate %2d %-32s %s, %.1f ms\n", h, list[i].name,
+				stats[h].active ? "ok" : "failed",
+				(now_ns() - t) / 1e6);
+	}
+
+	t0 = now_ns();
+	while ((t = now_ns()) - t0 < (int64_t)seconds * 1000000000LL) {
+		n = dev->poll(dev, buf, POLL_EVENTS);
+		t = now_ns();
+		polls++;
+		for (i = 0; i < n; i++) {
+			sensors_event_t *ev = &buf[i];
+			struct sensor_stats *s;
+			int64_t lat;
+			int b;
+
+			if (ev->sensor < 0 || ev->sensor >= MAX_HANDLES)
+				continue;
+			s = &stats[ev->sensor];
+			lat = t - ev->timestamp;
+			if (!s->events)
+				s->first_ts = ev->timestamp;
+			else if (ev->timestamp < s->last_ts)
+				s->backwards++;
+			s->last_ts = ev->timestamp;
+			s->events++;
+			s->lat_sum += lat;
+			if (lat > s->lat_max)
+				s->lat_max = lat;
+			b = lat < 0 ? 0 : (int)(lat / LAT_BUCKET_NS);
+			s->hist[b < LAT_BUCKETS ? b : LAT_BUCKETS]++;
+			if (verbose)
+				printf("%d %lld %+f %+f %+f\n", ev->sensor,
+						(long long)ev->timestamp,
+						ev->data[0], ev->data[1],
+						ev->data[2]);
+		}
+	}
+
+	for (i = 0; i < MAX_HANDLES; i++)
+		if (stats[i].active)
+			dev->activate(dev, i, 0);
+
+	printf("\n%-4s %-28s %8s %9s %9s %9s %9s %5s\n", "hdl", "sensor",
+			"events", "rate Hz", "lat avg", "lat p99", "lat max",
+			"back");
+	for (i = 0; i < MAX_HANDLES; i++) {
+		struct sensor_stats *s = &stats[i];
+		double span;
+
+		if (!s->active && !s->events)
+			continue;
+		span = (s->last_ts - s->first_ts) / 1e9;
+		printf("%-4d %-28.28s %8llu %9.1f %7.3fms %7.3fms %7.3fms %5u\n",
+				i, s->name ? s->name : "?",
+				(unsigned long long)s->events,
+				s->events > 1 && span > 0 ?
+					(s->events - 1) / span : 0.0,
+				s->events ? s->lat_sum / (double)s->events / 1e6
+					: 0.0,
+				s->events ? percentile(s, 99) / 1e6 : 0.0,
+				s->lat_max / 1e6, s->backwards);
+	}
+	printf("%lld polls in %d s\n", (long long)polls, seconds);
+
+	gap_dump = (void (*)(int))dlsym(dl, "sample_gap_dump");
+	if (gap_dump) {
+		printf("\n");
+		fflush(stdout);
+		gap_dump(STDOUT_FILENO);
+	}
+	stats_dump = (void (*)(int))dlsym(dl, "sensor_stats_dump");
+	if (stats_dump) {
+		printf("\n");
+		fflush(stdout);
+		stats_dump(STDOUT_FILENO);
+	}
+	trace_dump = (void (*)(int))dlsym(dl, "sensor_trace_dump");
+	if (trace && trace_dump) {
+		int fd = open(trace, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+		if (fd < 0) {
+			perror(trace);
+		} else {
+			trace_dump(fd);
+			close(fd);
+		}
+	} else if (trace) {
+		fprintf(stderr, "%s has no sensor_trace_dump()\n", lib);
+	}
+
+	sensors_close(dev);
+	dlclose(dl);
+	return 0;
+}
@@ -0,0 +1,544 @@
+/*
+ * Virtual MPU IIO device, see iio_sim.h
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "iio_sim.h"
+
+#define NSEC_PER_SEC		1000000000LL
+#define NSEC_PER_MSEC		1000000LL
+
+/* attributes are re-read at most this often while streaming */
+#define ATTR_REFRESH_NS		(20 * NSEC_PER_MSEC)
+/* sleep while the buffer is disabled */
+#define IDLE_NS			(10 * NSEC_PER_MSEC)
+
+#define SCAN_AXES		(6)	/* s16 x/y/z */
+#define SCAN_MAX		(3 * SCAN_AXES + 6 + 8)
+
+static const struct {
+	const char *name;
+	const char *value;
+} attrs[] = {
+	{ "power_state",		"1" },
+	{ "sampling_frequency",		"200" },
+	{ "buffer/enable",		"0" },
+	{ "buffer/length",		"0" },
+	{ "trigger/current_trigger",	"" },
+	{ "key",	"00000000000000000000000000000000" },
+	{ "gyro_enable",		"0" },
+	{ "accl_enable",		"0" },
+	{ "gyro_matrix",		"1,0,0,0,1,0,0,0,1" },
+	{ "accl_matrix",		"1,0,0,0,1,0,0,0,1" },
+	{ "in_anglvel_scale",		"2000" },
+	{ "in_accel_scale",		"2" },
+	{ "accl_bias",			"0,0,0" },
+	{ "temperature",		"0 0" },
+	{ "firmware_loaded",		"0" },
+	{ "dmp_firmware",		"" },
+	{ "dmp_on",			"0" },
+	{ "dmp_int_on",			"0" },
+	{ "dmp_event_int_on",		"0" },
+	{ "dmp_output_rate",		"200" },
+	{ "tap_on",			"0" },
+	{ "self_test",			"0" },
+	{ "quaternion_on",		"0" },
+	{ "display_orientation_on",	"0" },
+	{ "event_display_orientation",	"0" },
+};
+
+/* scan elements in scan order; quaternion is accepted but not streamed */
+static const char * const scan_elements[] = {
+	"in_anglvel_x", "in_anglvel_y", "in_anglvel_z",
+	"in_accel_x", "in_accel_y", "in_accel_z",
+	"in_quaternion_r", "in_quaternion_x", "in_quaternion_y",
+	"in_quaternion_z", "in_timestamp",
+};
+
+static const struct iio_sim_event default_script[] = {
+	{    0, IIO_SIM_EVENT_ACCEL, {    0,     0, 1000 } },
+	{    0, IIO_SIM_EVENT_NOISE, {    4,     0,    0 } },
+	/* still, then a 90 dps turn about z, then still again */
+	{ 2000, IIO_SIM_EVENT_GYRO,  {    0,     0, 90000 } },
+	{ 3000, IIO_SIM_EVENT_GYRO,  {    0,     0,    0 } },
+	/* tilt 45 degrees about x */
+	{ 4000, IIO_SIM_EVENT_GYRO,  { 45000,    0,    0 } },
+	{ 4000, IIO_SIM_EVENT_ACCEL, {    0,  707,  707 } },
+	{ 5000, IIO_SIM_EVENT_GYRO,  {    0,     0,    0 } },
+};
+
+static struct {
+	char root[PATH_MAX / 2];
+	char dev[PATH_MAX / 2];	/* sysfs directory of iio:device0 */
+	char node[PATH_MAX / 2];	/* /dev/iio:device0 FIFO */
+	int fifo;
+
+	struct iio_sim_event *script;
+	int script_num;
+	int script_pos;
+
+	int32_t gyro[3];	/* mdps */
+	int32_t accel[3];	/* mg */
+	int32_t noise;		/* LSB */
+	uint32_t seed;
+
+	/* mirrored from the attributes */
+	int enable;
+	int rate;
+	int gyro_on;
+	int accel_on;
+	int gyro_fsr;		/* dps */
+	int accel_fsr;		/* g */
+
+	struct iio_sim_stats stats;
+} sim = { .fifo = -1 };
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static int mkdirs(const char *path)
+{
+	char tmp[PATH_MAX], *p;
+
+	snprintf(tmp, sizeof(tmp), "%s", path);
+	for (p = tmp + 1; *p; p++) {
+		if (*p != '/')
+			continue;
+		*p = 0;
+		if (mkdir(tmp, 0755) < 0 && errno != EEXIST)
+			return -errno;
+		*p = '/';
+	}
+	if (mkdir(tmp, 0755) < 0 && errno != EEXIST)
+		return -errno;
+	return 0;
+}
+
+static int put_file(const char *dir, const char *name, const char *value)
+{
+	char path[PATH_MAX];
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	fp = fopen(path, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "cannot create %s: %s\n", path,
+				strerror(errno));
+		return -errno;
+	}
+	fprintf(fp, "%s\n", value);
+	fclose(fp);
+	return 0;
+}
+
+static int get_attr(const char *name, int def)
+{
+	char path[PATH_MAX], buf[32];
+	ssize_t n;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", sim.dev, name);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return def;
+	n = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (n <= 0)
+		return def;
+	buf[n] = 0;
+	/* sampling_frequency may have been written as a float */
+	return (int)strtod(buf, NULL);
+}
+
+/**
+ * Builds the device tree below @root for a chip called @chip (e.g.
+ * "mpu6050"; inv_root_chip_name() matches the lower case chip names).
+ * @return 0 or a negative errno
+ */
+int iio_sim_create(const char *root, const char *chip)
+{
+	char dir[PATH_MAX], name[64];
+	size_t i;
+	int rt;
+
+	snprintf(sim.root, sizeof(sim.root), "%s", root);
+	snprintf(sim.dev, sizeof(sim.dev), "%s/sys/bus/iio/devices/iio:device0",
+			root);
+	snprintf(sim.node, sizeof(sim.node), "%s/dev/iio:device0", root);
+
+	snprintf(dir, sizeof(dir), "%s/proc/bus/input", root);
+	if ((rt = mkdirs(dir)) < 0 || (rt = put_file(dir, "devices", "")) < 0)
+		return rt;
+
+	snprintf(dir, sizeof(dir), "%s/buffer", sim.dev);
+	if ((rt = mkdirs(dir)) < 0)
+		return rt;
+	snprintf(dir, sizeof(dir), "%s/trigger", sim.dev);
+	if ((rt = mkdirs(dir)) < 0)
+		return rt;
+	snprintf(dir, sizeof(dir), "%s/scan_elements", sim.dev);
+	if ((rt = mkdirs(dir)) < 0)
+		return rt;
+
+	if ((rt = put_file(sim.dev, "name", chip)) < 0)
+		return rt;
+	for (i = 0; i < sizeof(attrs) / sizeof(attrs[0]); i++)
+		if ((rt = put_file(sim.dev, attrs[i].name, attrs[i].value)) < 0)
+			return rt;
+
+	for (i = 0; i < sizeof(scan_elements) / sizeof(scan_elements[0]); i++) {
+		const char *el = scan_elements[i];
+		int ts = strcmp(el, "in_timestamp") == 0;
+		char idx[8];
+
+		snprintf(idx, sizeof(idx), "%u", (unsigned)i);
+		snprintf(name, sizeof(name), "%s_en", el);
+		if ((rt = put_file(dir, name, "0")) < 0)
+			return rt;
+		snprintf(name, sizeof(name), "%s_index", el);
+		if ((rt = put_file(dir, name, idx)) < 0)
+			return rt;
+		snprintf(name, sizeof(name), "%s_type", el);
+		rt = put_file(dir, name, ts ? "le:s64/64>>0" : "le:s16/16>>0");
+		if (rt < 0)
+			return rt;
+	}
+
+	snprintf(dir, sizeof(dir), "%s/sys/bus/iio/devices/trigger0", root);
+	snprintf(name, sizeof(name), "%s-dev0", chip);
+	if ((rt = mkdirs(dir)) < 0 || (rt = put_file(dir, "name", name)) < 0)
+		return rt;
+
+	snprintf(dir, sizeof(dir), "%s/dev", root);
+	if ((rt = mkdirs(dir)) < 0)
+		return rt;
+	unlink(sim.node);
+	if (mkfifo(sim.node, 0666) < 0) {
+		fprintf(stderr, "cannot create %s: %s\n", sim.node,
+				strerror(errno));
+		return -errno;
+	}
+	/* O_RDWR never blocks on a FIFO, the HAL may open it any time */
+	sim.fifo = open(sim.node, O_RDWR | O_NONBLOCK);
+	if (sim.fifo < 0)
+		return -errno;
+
+	memset(&sim.stats, 0, sizeof(sim.stats));
+	sim.seed = 1;
+	if (sim.script == NULL)
+		iio_sim_load_script(NULL);
+	return 0;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag,
+		struct FTW *ftw)
+{
+	(void)st;
+	(void)flag;
+	(void)ftw;
+	return remove(path);
+}
+
+void iio_sim_destroy(int remove_tree)
+{
+	if (sim.fifo >= 0)
+		close(sim.fifo);
+	sim.fifo = -1;
+	if (remove_tree && sim.root[0])
+		nftw(sim.root, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+	free(sim.script);
+	sim.script = NULL;
+	sim.script_num = 0;
+}
+
+static int set_script(const struct iio_sim_event *ev, int num)
+{
+	struct iio_sim_event *s = malloc(sizeof(*ev) * (size_t)(num ? num : 1));
+
+	if (s == NULL)
+		return -ENOMEM;
+	memcpy(s, ev, sizeof(*ev) * (size_t)num);
+	free(sim.script);
+	sim.script = s;
+	sim.script_num = num;
+	sim.script_pos = 0;
+	memset(sim.gyro, 0, sizeof(sim.gyro));
+	memset(sim.accel, 0, sizeof(sim.accel));
+	sim.noise = 0;
+	return 0;
+}
+
+static int add_event(struct iio_sim_event **ev, int *num, int *cap,
+		const struct iio_sim_event *e)
+{
+	if (*num == *cap) {
+		int n = *cap ? *cap * 2 : 256;
+		struct iio_sim_event *p = realloc(*ev, sizeof(*e) * (size_t)n);
+		if (p == NULL)
+			return -ENOMEM;
+		*ev = p;
+		*cap = n;
+	}
+	(*ev)[(*num)++] = *e;
+	return 0;
+}
+
+/**
+ * Loads a motion script, NULL for the built-in one. Each line is
+ * "<msec> <command> <args>", where command is one of
+ *   gyro <x> <y> <z>	angular rate in mdps, sensor frame
+ *   accel <x> <y> <z>	acceleration in mg, sensor frame
+ *   noise <n>		noise amplitude in LSB
+ * Values hold until changed.  Lines starting with '#' are ignored.
+ * @return 0, or -1 if the file cannot be read or has a bad line
+ */
+int iio_sim_load_script(const char *path)
+{
+	static const char * const names[] = { "gyro", "accel", "noise" };
+	struct iio_sim_event *ev = NULL, e;
+	char line[256], cmd[32];
+	int num = 0, cap = 0, ln = 0, i, n;
+	unsigned int time;
+	FILE *fp;
+
+	if (path == NULL)
+		return set_script(default_script, sizeof(default_script)
+				/ sizeof(default_script[0]));
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return -1;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		ln++;
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		memset(&e, 0, sizeof(e));
+		n = sscanf(line, "%u %31s %d %d %d", &time, cmd,
+				&e.v[0], &e.v[1], &e.v[2]);
+		if (n < 3)
+			goto bad_line;
+		e.time = time;
+		e.type = -1;
+		for (i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++)
+			if (strcmp(cmd, names[i]) == 0)
+				e.type = i;
+		if (e.type < 0 || (num && e.time < ev[num - 1].time))
+			goto bad_line;
+		if (add_event(&ev, &num, &cap, &e) < 0)
+			goto bad_line;
+	}
+	fclose(fp);
+	i = set_script(ev, num);
+	free(ev);
+	return i;
+
+bad_line:
+	fprintf(stderr, "%s:%d: bad line\n", path, ln);
+	free(ev);
+	fclose(fp);
+	return -1;
+}
+
+/**
+ * Loads recorded motion, one sample per line:
+ *   <msec>,<gx>,<gy>,<gz>,<ax>,<ay>,<az>
+ * in mdps and mg.  Lines that do not parse (e.g. a header) are skipped.
+ * @return 0, or -1 if the file cannot be read
+ */
+int iio_sim_load_recording(const char *path)
+{
+	struct iio_sim_event *ev = NULL, e;
+	int num = 0, cap = 0, rt;
+	unsigned int time;
+	int32_t v[6];
+	char line[256];
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return -1;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "%u,%d,%d,%d,%d,%d,%d", &time, &v[0], &v[1],
+				&v[2], &v[3], &v[4], &v[5]) != 7)
+			continue;
+		if (num && time < ev[num - 1].time)
+			continue;
+		e.time = time;
+		e.type = IIO_SIM_EVENT_GYRO;
+		memcpy(e.v, &v[0], sizeof(e.v));
+		if (add_event(&ev, &num, &cap, &e) < 0)
+			break;
+		e.type = IIO_SIM_EVENT_ACCEL;
+		memcpy(e.v, &v[3], sizeof(e.v));
+		if (add_event(&ev, &num, &cap, &e) < 0)
+			break;
+	}
+	fclose(fp);
+	rt = set_script(ev, num);
+	free(ev);
+	return rt;
+}
+
+static void run_script(uint32_t msec)
+{
+	const struct iio_sim_event *ev;
+
+	while (sim.script_pos < sim.script_num) {
+		ev = &sim.script[sim.script_pos];
+		if (msec < ev->time)
+			break;
+		switch (ev->type) {
+		case IIO_SIM_EVENT_GYRO:
+			memcpy(sim.gyro, ev->v, sizeof(sim.gyro));
+			break;
+		case IIO_SIM_EVENT_ACCEL:
+			memcpy(sim.accel, ev->v, sizeof(sim.accel));
+			break;
+		case IIO_SIM_EVENT_NOISE:
+			sim.noise = ev->v[0];
+			break;
+		}
+		sim.script_pos++;
+	}
+}
+
+static int16_t to_lsb(int32_t milli, int fsr)
+{
+	int64_t v = (int64_t)milli * 32768 / ((int64_t)fsr * 1000);
+
+	if (sim.noise) {
+		sim.seed = sim.seed * 1103515245u + 12345u;
+		v += (int32_t)((sim.seed >> 16) % (2u * sim.noise + 1)) - sim.noise;
+	}
+	if (v > 32767)
+		v = 32767;
+	if (v < -32768)
+		v = -32768;
+	return (int16_t)v;
+}
+
+static void refresh_attrs(void)
+{
+	int enable = get_attr("buffer/enable", 0);
+	int rate = get_attr("sampling_frequency", 200);
+
+	if (enable && !sim.enable)
+		sim.stats.enables++;
+	if (rate != sim.rate && sim.rate)
+		sim.stats.rate_changes++;
+	sim.enable = enable;
+	sim.rate = rate > 0 ? rate : 1;
+	sim.gyro_on = get_attr("scan_elements/in_anglvel_x_en", 0);
+	sim.accel_on = get_attr("scan_elements/in_accel_x_en", 0);
+	sim.gyro_fsr = get_attr("in_anglvel_scale", 2000);
+	sim.accel_fsr = get_attr("in_accel_scale", 2);
+	if (sim.gyro_fsr <= 0)
+		sim.gyro_fsr = 2000;
+	if (sim.accel_fsr <= 0)
+		sim.accel_fsr = 2;
+}
+
+/*
+ * gyro, accel, timestamp in scan element index order, packed the way the
+ * IIO core does it: each element aligned to its own size
+ */
+static size_t build_scan(uint8_t *buf, int64_t ts)
+{
+	size_t n = 0;
+	int16_t v[3];
+	int i;
+
+	if (sim.gyro_on) {
+		for (i = 0; i < 3; i++)
+			v[i] = to_lsb(sim.gyro[i], sim.gyro_fsr);
+		memcpy(buf + n, v, SCAN_AXES);
+		n += SCAN_AXES;
+	}
+	if (sim.accel_on) {
+		for (i = 0; i < 3; i++)
+			v[i] = to_lsb(sim.accel[i], sim.accel_fsr);
+		memcpy(buf + n, v, SCAN_AXES);
+		n += SCAN_AXES;
+	}
+	n = (n + sizeof(ts) - 1) & ~(sizeof(ts) - 1);
+	memcpy(buf + n, &ts, sizeof(ts));
+	return n + sizeof(ts);
+}
+
+/**
+ * Streams scans for @msec milli-seconds (0: until *stop is set). The
+ * script clock starts when this is called.
+ * @return 0 or a negative errno
+ */
+int iio_sim_run(uint32_t msec, volatile int *stop)
+{
+	uint8_t scan[SCAN_MAX];
+	int64_t t0, next, now, refresh = 0, late;
+	struct timespec ts;
+	size_t len;
+
+	if (sim.fifo < 0)
+		return -EBADF;
+
+	t0 = next = now_ns();
+	while (!(stop && *stop)) {
+		now = now_ns();
+		if (msec && now - t0 >= (int64_t)msec * NSEC_PER_MSEC)
+			break;
+		if (now >= refresh) {
+			refresh_attrs();
+			refresh = now + ATTR_REFRESH_NS;
+		}
+		if (!sim.enable || !(sim.gyro_on || sim.accel_on)) {
+			next = now + IDLE_NS;
+			ts.tv_sec = next / NSEC_PER_SEC;
+			ts.tv_nsec = next % NSEC_PER_SEC;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+					NULL);
+			continue;
+		}
+
+		next += NSEC_PER_SEC / sim.rate;
+		if (next < now - NSEC_PER_SEC)
+			next = now;	/* resync after a long stall */
+		ts.tv_sec = next / NSEC_PER_SEC;
+		ts.tv_nsec = next % NSEC_PER_SEC;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+		late = now_ns() - next;
+		if (late > NSEC_PER_SEC / sim.rate)
+			sim.stats.late++;
+		if (late > (int64_t)sim.stats.max_late_ns)
+			sim.stats.max_late_ns = (uint64_t)late;
+
+		run_script((uint32_t)((next - t0) / NSEC_PER_MSEC));
+		len = build_scan(scan, next);
+		/* a full FIFO drops the scan, like the driver's kfifo */
+		if (write(sim.fifo, scan, len) == (ssize_t)len)
+			sim.stats.scans++;
+		else
+			sim.stats.dropped++;
+	}
+	return 0;
+}
+
+void iio_sim_get_stats(struct iio_sim_stats *stats)
+{
+	*stats = sim.stats;
+}
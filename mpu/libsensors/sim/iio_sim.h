@@ -0,0 +1,50 @@
+/*
+ * Virtual MPU IIO device for running the InvenSense HAL without hardware
+ *
+ * iio_sim_create() builds the part of sysfs, procfs and /dev that MPLSensor
+ * looks at below a root directory:
+ *
+ *   <root>/proc/bus/input/devices		empty
+ *   <root>/sys/bus/iio/devices/iio:device0/	attributes, scan_elements
+ *   <root>/sys/bus/iio/devices/trigger0/name
+ *   <root>/dev/iio:device0			FIFO carrying the scans
+ *
+ * The HAL is pointed at it with SENSORS_SYSFS_ROOT=<root> (see
+ * common/sysfs_root.h).  Attributes are plain files, so whatever the HAL
+ * writes is read back by iio_sim_run(), which follows buffer/enable,
+ * sampling_frequency and the scan element enables the way the driver does,
+ * and writes gyro/accel scans with CLOCK_MONOTONIC timestamps.
+ */
+
+#ifndef __IIO_SIM_H__
+#define __IIO_SIM_H__
+
+#include <stdint.h>
+
+#define IIO_SIM_EVENT_GYRO		(0) /*!< v: rate in mdps */
+#define IIO_SIM_EVENT_ACCEL		(1) /*!< v: acceleration in mg */
+#define IIO_SIM_EVENT_NOISE		(2) /*!< v[0]: noise in LSB */
+
+struct iio_sim_event {
+	uint32_t time;		/*!< msec from the start of the stream */
+	int type;		/*!< IIO_SIM_EVENT_xxx */
+	int32_t v[3];
+};
+
+struct iio_sim_stats {
+	uint64_t scans;		/*!< scans written to the FIFO */
+	uint64_t dropped;	/*!< scans lost because the FIFO was full */
+	uint64_t late;		/*!< scans written over one period late */
+	uint64_t max_late_ns;
+	uint32_t rate_changes;	/*!< sampling_frequency writes seen */
+	uint32_t enables;	/*!< buffer/enable 0 -> 1 transitions */
+};
+
+int iio_sim_create(const char *root, const char *chip);
+void iio_sim_destroy(int remove_tree);
+int iio_sim_load_script(const char *path);
+int iio_sim_load_recording(const char *path);
+int iio_sim_run(uint32_t msec, volatile int *stop);
+void iio_sim_get_stats(struct iio_sim_stats *stats);
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * Serves a virtual MPU IIO device until interrupted or for -t seconds.
+ *
+ * usage: mpu_iio_sim [-r root] [-c chip] [-f script | -p recording]
+ *                    [-t seconds] [-k]
+ *
+ * Then run the HAL (or sensors_hal_bench) with the printed
+ * SENSORS_SYSFS_ROOT.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "iio_sim.h"
+
+static volatile int stop;
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop = 1;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-r root] [-c chip] [-f script | -p recording] "
+		"[-t seconds] [-k]\n"
+		"  -r  directory to build the tree in (default: mkdtemp)\n"
+		"  -c  chip name, default mpu6050\n"
+		"  -f  motion script, see iio_sim.c\n"
+		"  -p  recorded motion, msec,gx,gy,gz,ax,ay,az per line\n"
+		"  -t  stop after this many seconds\n"
+		"  -k  keep the tree on exit\n",
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	char tmp[] = "/tmp/mpu_iio_sim.XXXXXX";
+	const char *root = NULL, *chip = "mpu6050";
+	const char *script = NULL, *recording = NULL;
+	struct iio_sim_stats st;
+	int seconds = 0, keep = 0, opt, rt;
+
+	while ((opt = getopt(argc, argv, "r:c:f:p:t:kh")) != -1) {
+		switch (opt) {
+		case 'r':
+			root = optarg;
+			break;
+		case 'c':
+			chip = optarg;
+			break;
+		case 'f':
+			script = optarg;
+			break;
+		case 'p':
+			recording = optarg;
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'k':
+			keep = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (seconds < 0 || (script && recording)) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (root == NULL) {
+		root = mkdtemp(tmp);
+		if (root == NULL) {
+			perror("mkdtemp");
+			return 1;
+		}
+	}
+
+	if (script && iio_sim_load_script(script) < 0) {
+		fprintf(stderr, "cannot load %s\n", script);
+		return 1;
+	}
+	if (recording && iio_sim_load_recording(recording) < 0) {
+		fprintf(stderr, "cannot load %s\n", recording);
+		return 1;
+	}
+	rt = iio_sim_create(root, chip);
+	if (rt < 0) {
+		fprintf(stderr, "cannot build the tree in %s (%d)\n", root, rt);
+		iio_sim_destroy(!keep);
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	printf("export SENSORS_SYSFS_ROOT=%s\n", root);
+	fflush(stdout);
+
+	iio_sim_run((uint32_t)seconds * 1000, &stop);
+
+	iio_sim_get_stats(&st);
+	iio_sim_destroy(!keep);
+	fprintf(stderr, "scans %llu, dropped %llu, late %llu (max %.3f ms), "
+			"%u enables, %u rate changes\n",
+			(unsigned long long)st.scans,
+			(unsigned long long)st.dropped,
+			(unsigned long long)st.late,
+			st.max_late_ns / 1e6, st.enables, st.rate_changes);
+	return 0;
+}
@@ -0,0 +1,462 @@
+/*
+ * Micro-benchmarks of the mllite hot paths: the fixed point quaternion
+ * math and the biquad of ml_math_func.c, the frame conversion and
+ * calibration of data_builder.c, inv_generate_hal_outputs() and one
+ * complete sample, inv_build_accel/compass/gyro() followed by
+ * inv_execute_on_data() with the results holder and HAL outputs enabled.
+ *
+ * The mllite sources are compiled into the benchmark (inv_32/core/mllite),
+ * so it measures whatever CFLAGS it is built with.  Inputs come from a
+ * fixed seed, every run sees the same data.
+ *
+ * Each benchmark runs -r rounds of -n calls after one warm-up round and
+ * reports the median, mean, standard deviation and minimum time per call
+ * over the rounds, plus CPU cycles per call where perf events are
+ * available.  -m prints CSV instead, to diff runs across commits and
+ * compiler flags.
+ *
+ * usage: mllite_bench [-n calls] [-r rounds] [-s seed] [-f name] [-m] [-l]
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdarg.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#include "ml_math_func.h"
+#include "data_builder.h"
+#include "hal_outputs.h"
+#include "results_holder.h"
+#include "start_manager.h"
+#include "mpl.h"
+
+/* exported by data_builder.c and hal_outputs.c, not in their headers */
+void inv_apply_calibration(struct inv_single_sensor_t *sensor,
+		const long *bias);
+inv_error_t inv_generate_hal_outputs(struct inv_sensor_cal_t *sensor_cal);
+
+#define NUM_INPUTS		(1024)	/* power of two */
+#define MAX_ROUNDS		(101)
+
+struct bench {
+	const char *name;
+	void (*run)(unsigned calls);
+};
+
+/* keeps the compiler from dropping the calls */
+static volatile long sink;
+
+static long quat_a[NUM_INPUTS][4], quat_b[NUM_INPUTS][4];
+static long vec[NUM_INPUTS][3];
+static short raw[NUM_INPUTS][3];
+static long raw_long[NUM_INPUTS][3];
+static float samples[NUM_INPUTS];
+
+/* the MPU HAL mounting, see g_compass_orientation of the playback tool */
+static const signed char mount[9] = { -1, 0, 0, 0, 1, 0, 0, 0, -1 };
+static unsigned short orientation;
+
+#ifndef ANDROID
+/* log.h sends MPL_LOGx here off Android */
+int _MLPrintLog(int priority, const char *tag, const char *fmt, ...)
+{
+	va_list ap;
+
+	(void)priority;
+	fprintf(stderr, "%s: ", tag ? tag : "");
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	return 0;
+}
+#endif
+
+static uint32_t seed;
+
+static uint32_t rnd(void)
+{
+	/* xorshift32 */
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+/* uniform in [-1, 1) */
+static double rnd_unit(void)
+{
+	return (double)rnd() / 2147483648.0 - 1.0;
+}
+
+static void random_quat(long *q)
+{
+	double v[4], n = 0;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		v[i] = rnd_unit();
+		n += v[i] * v[i];
+	}
+	n = sqrt(n);
+	if (n == 0) {
+		v[0] = n = 1;
+	}
+	for (i = 0; i < 4; i++)
+		q[i] = (long)(v[i] / n * 1073741823.0);
+}
+
+static void make_inputs(void)
+{
+	int i, j;
+
+	for (i = 0; i < NUM_INPUTS; i++) {
+		random_quat(quat_a[i]);
+		random_quat(quat_b[i]);
+		for (j = 0; j < 3; j++) {
+			/* +-1.0 in q30 */
+			vec[i][j] = (long)(rnd_unit() * 1073741823.0);
+			raw[i][j] = (short)(rnd() >> 16);
+			raw_long[i][j] = (long)raw[i][j] << 15;
+		}
+		/* a compass axis in q16 uT, 45 uT plus noise */
+		samples[i] = (float)((45.0 + rnd_unit()) * 65536.0);
+	}
+	orientation = inv_orientation_matrix_to_scalar(mount);
+}
+
+/*
+    ml_math_func.c
+*/
+static void run_q_mult(unsigned calls)
+{
+	long out[4];
+	unsigned i;
+
+	for (i = 0; i < calls; i++) {
+		unsigned k = i & (NUM_INPUTS - 1);
+		inv_q_mult(quat_a[k], quat_b[k], out);
+		sink += out[0];
+	}
+}
+
+static void run_q_rotate(unsigned calls)
+{
+	long out[3];
+	unsigned i;
+
+	for (i = 0; i < calls; i++) {
+		unsigned k = i & (NUM_INPUTS - 1);
+		inv_q_rotate(quat_a[k], vec[k], out);
+		sink += out[0];
+	}
+}
+
+static void run_quaternion_to_rotation(unsigned calls)
+{
+	long rot[9];
+	unsigned i;
+
+	for (i = 0; i < calls; i++) {
+		inv_quaternion_to_rotation(quat_a[i & (NUM_INPUTS - 1)], rot);
+		sink += rot[0];
+	}
+}
+
+static void run_biquad(unsigned calls)
+{
+	/* the compass low pass filter of hal_outputs.c */
+	float coeff[5] = { +2.000000000000f, +1.000000000000f,
+		-1.279632424998f, +0.477592250073f, +0.049489956269f };
+	inv_biquad_filter_t filter;
+	float out = 0;
+	unsigned i;
+
+	inv_init_biquad_filter(&filter, coeff);
+	inv_calc_state_to_match_output(&filter, samples[0]);
+	for (i = 0; i < calls; i++)
+		out += inv_biquad_filter_process(&filter,
+				samples[i & (NUM_INPUTS - 1)]);
+	sink += (long)out;
+}
+
+/*
+    data_builder.c
+*/
+static void run_convert_to_body(unsigned calls)
+{
+	long out[3];
+	unsigned i;
+
+	for (i = 0; i < calls; i++) {
+		inv_convert_to_body_with_scale(orientation, 2097152L << 1,
+				raw_long[i & (NUM_INPUTS - 1)], out);
+		sink += out[0];
+	}
+}
+
+static void run_apply_calibration(unsigned calls)
+{
+	static const long bias[3] = { 12L << 16, -(7L << 16), 3L << 16 };
+	struct inv_single_sensor_t s;
+	unsigned i;
+
+	memset(&s, 0, sizeof(s));
+	s.orientation = orientation;
+	s.sensitivity = 2097152L;
+	for (i = 0; i < calls; i++) {
+		memcpy(s.raw, raw[i & (NUM_INPUTS - 1)], sizeof(s.raw));
+		inv_apply_calibration(&s, bias);
+		sink += s.calibrated[0];
+	}
+}
+
+/*
+    hal_outputs.c and the whole sample, on the MPL set up by mpl_setup()
+*/
+#define SENSOR_ON_NEW	(INV_SENSOR_ON | INV_NEW_DATA | INV_RAW_DATA \
+			 | INV_CALIBRATED | INV_CONTIGUOUS)
+
+static void run_generate_hal_outputs(unsigned calls)
+{
+	struct inv_sensor_cal_t cal;
+	unsigned i;
+
+	memset(&cal, 0, sizeof(cal));
+	cal.gyro.status = cal.accel.status = cal.compass.status = SENSOR_ON_NEW;
+	cal.gyro.sample_rate_ms = cal.accel.sample_rate_ms = 5;
+	cal.compass.sample_rate_ms = 10;
+	for (i = 0; i < calls; i++) {
+		cal.gyro.timestamp += 5000000;
+		inv_generate_hal_outputs(&cal);
+	}
+	sink += cal.gyro.status;
+}
+
+static inv_time_t sample_ts;
+
+static void run_full_sample(unsigned calls)
+{
+	unsigned i;
+
+	for (i = 0; i < calls; i++) {
+		unsigned k = i & (NUM_INPUTS - 1);
+
+		sample_ts += 5000000;
+		inv_build_accel(raw_long[k], 0, sample_ts);
+		/* compass at half the rate, as on the MPU HAL */
+		if (i & 1)
+			inv_build_compass(raw_long[(k + 1) & (NUM_INPUTS - 1)],
+					0, sample_ts);
+		inv_build_gyro(raw[(k + 2) & (NUM_INPUTS - 1)], sample_ts);
+		inv_execute_on_data();
+	}
+	sink += (long)sample_ts;
+}
+
+static int mpl_setup(void)
+{
+	if (inv_init_mpl() || inv_enable_hal_outputs())
+		return -1;
+	inv_set_gyro_orientation_and_scale(orientation, 2000L << 15);
+	inv_set_accel_orientation_and_scale(orientation, 2L << 15);
+	inv_set_compass_orientation_and_scale(orientation, 9830L << 15);
+	inv_set_gyro_sample_rate(5000);
+	inv_set_accel_sample_rate(5000);
+	inv_set_compass_sample_rate(10000);
+	return inv_start_mpl() ? -1 : 0;
+}
+
+static const struct bench benches[] = {
+	{ "inv_q_mult",				run_q_mult },
+	{ "inv_q_rotate",			run_q_rotate },
+	{ "inv_quaternion_to_rotation",		run_quaternion_to_rotation },
+	{ "inv_biquad_filter_process",		run_biquad },
+	{ "inv_convert_to_body_with_scale",	run_convert_to_body },
+	{ "inv_apply_calibration",		run_apply_calibration },
+	{ "inv_generate_hal_outputs",		run_generate_hal_outputs },
+	{ "full_sample",			run_full_sample },
+};
+
+/*
+    measurement
+*/
+static int cycles_fd = -1;
+
+static void cycles_open(void)
+{
+#if defined(__linux__) && defined(__NR_perf_event_open)
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	cycles_fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+static uint64_t cycles_read(void)
+{
+	uint64_t v = 0;
+
+	if (cycles_fd < 0 || read(cycles_fd, &v, sizeof(v)) != sizeof(v))
+		return 0;
+	return v;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return x < y ? -1 : x > y;
+}
+
+struct result {
+	double median, mean, sd, min;
+	double cycles;		/* median cycles per call, 0 if unknown */
+};
+
+static void measure(const struct bench *b, unsigned calls, int rounds,
+		struct result *res)
+{
+	double ns[MAX_ROUNDS], cyc[MAX_ROUNDS];
+	double sum = 0, sum2 = 0;
+	uint64_t t0, c0;
+	int r;
+
+	b->run(calls);
+	for (r = 0; r < rounds; r++) {
+		c0 = cycles_read();
+		t0 = now_ns();
+		b->run(calls);
+		ns[r] = (double)(now_ns() - t0) / calls;
+		cyc[r] = (double)(cycles_read() - c0) / calls;
+		sum += ns[r];
+		sum2 += ns[r] * ns[r];
+	}
+	res->mean = sum / rounds;
+	res->sd = sqrt(fmax(sum2 / rounds - res->mean * res->mean, 0));
+	qsort(ns, rounds, sizeof(ns[0]), cmp_double);
+	qsort(cyc, rounds, sizeof(cyc[0]), cmp_double);
+	res->median = ns[rounds / 2];
+	res->min = ns[0];
+	res->cycles = cycles_fd < 0 ? 0 : cyc[rounds / 2];
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-n calls] [-r rounds] [-s seed] [-f name] [-m] "
+		"[-l]\n"
+		"  -n  calls per round (default 200000)\n"
+		"  -r  rounds, at most %d (default 15)\n"
+		"  -s  input seed (default 1)\n"
+		"  -f  only the benchmarks whose name contains this\n"
+		"  -m  machine readable output, CSV\n"
+		"  -l  list the benchmarks\n",
+		name, MAX_ROUNDS);
+}
+
+int main(int argc, char **argv)
+{
+	const char *filter = NULL;
+	unsigned calls = 200000;
+	uint32_t seed_arg = 1;
+	int rounds = 15, csv = 0, opt;
+	unsigned i;
+	struct result res;
+
+	while ((opt = getopt(argc, argv, "n:r:s:f:mlh")) != -1) {
+		switch (opt) {
+		case 'n':
+			calls = (unsigned)strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 's':
+			seed_arg = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			filter = optarg;
+			break;
+		case 'm':
+			csv = 1;
+			break;
+		case 'l':
+			for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+				printf("%s\n", benches[i].name);
+			return 0;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (calls == 0 || rounds <= 0 || rounds > MAX_ROUNDS || seed_arg == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	seed = seed_arg;
+	make_inputs();
+	if (mpl_setup()) {
+		fprintf(stderr, "MPL setup failed\n");
+		return 1;
+	}
+	cycles_open();
+
+	if (csv) {
+		printf("# mllite_bench calls=%u rounds=%d seed=%u "
+				"compiler=\"%s\"\n", calls, rounds,
+				(unsigned)seed_arg, __VERSION__);
+		printf("name,ns_median,ns_mean,ns_sd,ns_min,cycles\n");
+	} else {
+		printf("%u calls x %d rounds, seed %u, cycles %s\n",
+				calls, rounds, (unsigned)seed_arg,
+				cycles_fd < 0 ? "not available" : "from perf");
+		printf("%-32s %10s %10s %8s %10s %10s\n", "", "ns median",
+				"ns mean", "sd %", "ns min", "cycles");
+	}
+	for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+		const struct bench *b = &benches[i];
+
+		if (filter && !strstr(b->name, filter))
+			continue;
+		measure(b, calls, rounds, &res);
+		if (csv) {
+			printf("%s,%.3f,%.3f,%.3f,%.3f,", b->name,
+					res.median, res.mean, res.sd, res.min);
+			/* empty when there are no cycle counts */
+			if (res.cycles > 0)
+				printf("%.1f", res.cycles);
+			printf("\n");
+		} else {
+			printf("%-32s %10.2f %10.2f %8.1f %10.2f ", b->name,
+					res.median, res.mean,
+					res.mean > 0 ? res.sd / res.mean * 100
+					: 0.0, res.min);
+			if (res.cycles > 0)
+				printf("%10.1f\n", res.cycles);
+			else
+				printf("%10s\n", "-");
+		}
+	}
+	return 0;
+}
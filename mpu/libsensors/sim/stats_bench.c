@@ -0,0 +1,157 @@
+/*
+ * Cost of sensor_stats_event() (common/sensor_stats.c) per event, the
+ * price every HAL pays in its poll path.
+ *
+ * Feeds -n events of -k handles with a jittered period around -d usec,
+ * the way a poll loop delivers them, and reports the mean time per call
+ * of the fastest of -r rounds, with a second thread dumping snapshots
+ * all along when -w is given.  -v prints the last snapshot.
+ *
+ * usage: sensor_stats_bench [-n events] [-r rounds] [-k handles]
+ *                           [-d period_us] [-w] [-v]
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "sensor_stats.h"
+
+static volatile int dumping;
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static uint32_t xorshift(uint32_t *s)
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 17;
+	*s ^= *s << 5;
+	return *s;
+}
+
+static void *dumper(void *arg)
+{
+	int fd = open("/dev/null", O_WRONLY);
+	long *dumps = arg;
+
+	while (dumping) {
+		sensor_stats_dump(fd);
+		(*dumps)++;
+	}
+	close(fd);
+	return NULL;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-n events] [-r rounds] [-k handles] "
+		"[-d period_us] [-w] [-v]\n"
+		"  -n  events per round (default 1000000)\n"
+		"  -r  rounds (default 5)\n"
+		"  -k  handles fed in turn (default 4)\n"
+		"  -d  nominal period in usec (default 5000)\n"
+		"  -w  dump snapshots from a second thread meanwhile\n"
+		"  -v  print the final snapshot\n",
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	int events = 1000000, rounds = 5, handles = 4, period_us = 5000;
+	int concurrent = 0, verbose = 0;
+	int64_t *ts, *dl, best = INT64_MAX, t;
+	uint32_t seed = 0x5eed;
+	pthread_t thread;
+	long dumps = 0;
+	int opt, r, i, h;
+
+	while ((opt = getopt(argc, argv, "n:r:k:d:wvh")) != -1) {
+		switch (opt) {
+		case 'n':
+			events = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 'k':
+			handles = atoi(optarg);
+			break;
+		case 'd':
+			period_us = atoi(optarg);
+			break;
+		case 'w':
+			concurrent = 1;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (events < 1 || rounds < 1 || handles < 1
+			|| handles > SENSOR_STATS_HANDLES || period_us < 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	/* precomputed, so the loop times the statistics only */
+	ts = malloc(events * sizeof(*ts));
+	dl = malloc(events * sizeof(*dl));
+	if (!ts || !dl)
+		return 1;
+	t = 1000000000LL;
+	for (i = 0; i < events; i++) {
+		if (i % handles == 0)
+			t += period_us * 1000LL
+				+ (int64_t)(xorshift(&seed) % 200000) - 100000;
+		if (xorshift(&seed) % 1000 == 0)
+			t += period_us * 3000LL;	/* a dropped sample */
+		ts[i] = t;
+		dl[i] = t + 200000 + xorshift(&seed) % 3000000;
+	}
+	for (h = 0; h < handles; h++)
+		sensor_stats_config(h, "bench", period_us * 1000LL);
+
+	if (concurrent) {
+		dumping = 1;
+		pthread_create(&thread, NULL, dumper, &dumps);
+	}
+	for (r = 0; r < rounds; r++) {
+		int64_t t0 = now_ns();
+
+		for (i = 0; i < events; i++)
+			sensor_stats_event(i % handles, ts[i], dl[i]);
+		t0 = now_ns() - t0;
+		if (t0 < best)
+			best = t0;
+		for (h = 0; h < handles; h++)
+			sensor_stats_config(h, NULL, period_us * 1000LL);
+	}
+	if (concurrent) {
+		dumping = 0;
+		pthread_join(thread, NULL);
+	}
+
+	printf("sensor_stats_event: %.1f ns/event, %d handles, %d events"
+		" x %d rounds", (double)best / events, handles, events, rounds);
+	if (concurrent)
+		printf(", %ld concurrent dumps", dumps);
+	printf("\n");
+	if (verbose)
+		sensor_stats_dump(STDOUT_FILENO);
+	free(ts);
+	free(dl);
+	return 0;
+}
@@ -0,0 +1,326 @@
+/*
+ * Per stage latency distributions from a sensor HAL trace, see
+ * common/sensor_trace.h.
+ *
+ * Reads an ftrace buffer (cat /sys/kernel/debug/tracing/trace) or the
+ * output of sensor_trace_dump(), picks the "sns" marks out of it and
+ * matches the marks of each sample by its hardware timestamp.  For every
+ * pair of consecutive stages, and from read to poll, it prints the number
+ * of samples and the minimum, median, 90th, 99th percentile and maximum
+ * delay in usec.  Marks whose earlier stage is not in the trace, because
+ * the trace starts in the middle of a sample or the event was held back
+ * by the ODR governor, are counted as unmatched.
+ *
+ * With -c the trace clock is taken to be the clock of the hardware
+ * timestamps (echo mono > trace_clock for the MPU HAL, boot for the ST
+ * HAL, whose in-memory trace only qualifies while the device does not
+ * suspend), which adds the delay from the sample timestamp to the read
+ * and to poll.
+ *
+ * usage: sensor_trace_report [-c] [-s handle] [trace.txt]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_OUTPUTS		(8)	/* events made from one sample */
+
+struct sample {
+	int64_t ts;			/* hardware timestamp, the key */
+	int64_t read, build, fusion;	/* first mark of each, 0 if none */
+	int nout;
+	struct {
+		int handle;
+		int64_t t;
+	} out[MAX_OUTPUTS];
+};
+
+enum {
+	M_READ_BUILD,
+	M_BUILD_FUSION,
+	M_FUSION_OUTPUT,
+	M_OUTPUT_POLL,
+	M_READ_POLL,
+	M_SAMPLE_READ,
+	M_SAMPLE_POLL,
+	M_COUNT,
+};
+
+static const char *const metric_names[M_COUNT] = {
+	"read -> build",
+	"build -> fusion",
+	"fusion -> output",
+	"output -> poll",
+	"read -> poll",
+	"sample -> read",
+	"sample -> poll",
+};
+
+struct metric {
+	int64_t *v;
+	size_t n, cap;
+	uint64_t unmatched;
+};
+
+static struct metric metrics[M_COUNT];
+
+static struct sample *table;
+static size_t table_size, table_used;
+
+static void add(int m, int64_t v)
+{
+	struct metric *x = &metrics[m];
+
+	if (x->n == x->cap) {
+		x->cap = x->cap ? x->cap * 2 : 4096;
+		x->v = realloc(x->v, x->cap * sizeof(*x->v));
+		if (!x->v) {
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+	}
+	x->v[x->n++] = v;
+}
+
+static size_t slot(int64_t ts, size_t size)
+{
+	uint64_t h = (uint64_t)ts * 0x9e3779b97f4a7c15ULL;
+	return (size_t)(h >> 20) & (size - 1);
+}
+
+static void grow(void)
+{
+	struct sample *old = table;
+	size_t old_size = table_size, i, j;
+
+	table_size = table_size ? table_size * 2 : 65536;
+	table = calloc(table_size, sizeof(*table));
+	if (!table) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+	for (i = 0; i < old_size; i++) {
+		if (!old[i].ts)
+			continue;
+		for (j = slot(old[i].ts, table_size); table[j].ts;
+				j = (j + 1) & (table_size - 1))
+			;
+		table[j] = old[i];
+	}
+	free(old);
+}
+
+/* the sample stamped @ts, created if @create */
+static struct sample *lookup(int64_t ts, int create)
+{
+	size_t j;
+
+	if (ts == 0)
+		return NULL;
+	if (create && (table_used + 1) * 2 > table_size)
+		grow();
+	if (!table_size)
+		return NULL;
+	for (j = slot(ts, table_size); table[j].ts;
+			j = (j + 1) & (table_size - 1))
+		if (table[j].ts == ts)
+			return &table[j];
+	if (!create)
+		return NULL;
+	table[j].ts = ts;
+	table_used++;
+	return &table[j];
+}
+
+/*
+ * "<task>-<pid> [cpu] flags 1234.567890: tracing_mark_write: sns R 3 123"
+ * Returns 1 with the mark in the arguments, 0 for any other line.
+ */
+static int parse(const char *line, int64_t *t, char *stage, int *handle,
+		int64_t *ts)
+{
+	const char *m = strstr(line, ": tracing_mark_write: sns ");
+	const char *p;
+	long long sec, frac, hw;
+	int digits = 0;
+
+	if (!m)
+		return 0;
+	if (sscanf(m + 26, "%c %d %lld", stage, handle, &hw) != 3)
+		return 0;
+	/* back to the start of the time stamp */
+	for (p = m; p > line && p[-1] != ' '; p--)
+		;
+	if (sscanf(p, "%lld.", &sec) != 1)
+		return 0;
+	p = strchr(p, '.');
+	if (!p || p > m)
+		return 0;
+	frac = 0;
+	for (p++; p < m && *p >= '0' && *p <= '9'; p++, digits++)
+		frac = frac * 10 + (*p - '0');
+	for (; digits < 9; digits++)
+		frac *= 10;
+	*t = sec * 1000000000LL + frac;
+	*ts = hw;
+	return 1;
+}
+
+static void account(int64_t t, char stage, int handle, int64_t ts,
+		int filter, int same_clock)
+{
+	struct sample *s;
+	int i;
+
+	switch (stage) {
+	case 'R':
+		s = lookup(ts, 1);
+		if (s && !s->read) {
+			s->read = t;
+			if (same_clock)
+				add(M_SAMPLE_READ, t - ts);
+		}
+		break;
+	case 'B':
+		s = lookup(ts, 1);
+		if (!s || s->build)
+			break;
+		s->build = t;
+		if (s->read)
+			add(M_READ_BUILD, t - s->read);
+		else
+			metrics[M_READ_BUILD].unmatched++;
+		break;
+	case 'F':
+		s = lookup(ts, 1);
+		if (!s || s->fusion)
+			break;
+		s->fusion = t;
+		if (s->build)
+			add(M_BUILD_FUSION, t - s->build);
+		else
+			metrics[M_BUILD_FUSION].unmatched++;
+		break;
+	case 'O':
+		if (filter >= 0 && handle != filter)
+			break;
+		s = lookup(ts, 1);
+		if (!s)
+			break;
+		if (s->fusion)
+			add(M_FUSION_OUTPUT, t - s->fusion);
+		else
+			metrics[M_FUSION_OUTPUT].unmatched++;
+		if (s->nout < MAX_OUTPUTS) {
+			s->out[s->nout].handle = handle;
+			s->out[s->nout].t = t;
+			s->nout++;
+		}
+		break;
+	case 'P':
+		if (filter >= 0 && handle != filter)
+			break;
+		if (same_clock)
+			add(M_SAMPLE_POLL, t - ts);
+		s = lookup(ts, 0);
+		for (i = 0; s && i < s->nout; i++)
+			if (s->out[i].handle == handle)
+				break;
+		if (s && i < s->nout)
+			add(M_OUTPUT_POLL, t - s->out[i].t);
+		else
+			metrics[M_OUTPUT_POLL].unmatched++;
+		if (s && s->read)
+			add(M_READ_POLL, t - s->read);
+		else
+			metrics[M_READ_POLL].unmatched++;
+		break;
+	}
+}
+
+static int cmp64(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+static double pct(const struct metric *x, int p)
+{
+	size_t i = (x->n - 1) * p / 100;
+	return x->v[i] / 1000.0;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-c] [-s handle] [trace.txt]\n"
+		"  -c  trace clock is the clock of the sample timestamps\n"
+		"  -s  only the output and poll marks of this handle\n",
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	int same_clock = 0, filter = -1, opt, handle, m;
+	uint64_t marks = 0;
+	char line[512], stage;
+	int64_t t, ts;
+	FILE *f = stdin;
+
+	while ((opt = getopt(argc, argv, "cs:h")) != -1) {
+		switch (opt) {
+		case 'c':
+			same_clock = 1;
+			break;
+		case 's':
+			filter = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc) {
+		f = fopen(argv[optind], "r");
+		if (!f) {
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		if (!parse(line, &t, &stage, &handle, &ts))
+			continue;
+		marks++;
+		account(t, stage, handle, ts, filter, same_clock);
+	}
+	if (f != stdin)
+		fclose(f);
+
+	printf("%llu marks, %zu samples\n\n", (unsigned long long)marks,
+			table_used);
+	printf("%-18s %8s %10s %10s %10s %10s %10s %9s\n", "stage (us)",
+			"samples", "min", "p50", "p90", "p99", "max",
+			"unmatched");
+	for (m = 0; m < M_COUNT; m++) {
+		struct metric *x = &metrics[m];
+
+		if (!x->n && !x->unmatched)
+			continue;
+		if (!x->n) {
+			printf("%-18s %8d %54s %9llu\n", metric_names[m], 0, "",
+					(unsigned long long)x->unmatched);
+			continue;
+		}
+		qsort(x->v, x->n, sizeof(*x->v), cmp64);
+		printf("%-18s %8zu %10.1f %10.1f %10.1f %10.1f %10.1f %9llu\n",
+				metric_names[m], x->n, x->v[0] / 1000.0,
+				pct(x, 50), pct(x, 90), pct(x, 99),
+				x->v[x->n - 1] / 1000.0,
+				(unsigned long long)x->unmatched);
+	}
+	return 0;
+}
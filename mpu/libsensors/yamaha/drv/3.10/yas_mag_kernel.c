@@ -19,14 +19,17 @@
 
 #include <linux/delay.h>
 #include <linux/err.h>
+#include <linux/hrtimer.h>
 #include <linux/i2c.h>
 #include <linux/interrupt.h>
 #include <linux/irq.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
+#include <linux/kthread.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/poll.h>
+#include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/sysfs.h>
@@ -41,6 +44,7 @@
 #include <linux/iio/trigger.h>
 #include <linux/iio/trigger_consumer.h>
 #include "yas.h"
+#include "yas_mag_sched.h"
 
 static struct i2c_client *this_client;
 
@@ -56,10 +60,19 @@ struct yas_state {
 	struct yas_mag_driver mag;
 	struct i2c_client *client;
 	struct iio_trigger  *trig;
-	struct delayed_work work;
+	struct hrtimer timer;
+	struct kthread_worker worker;
+	struct task_struct *worker_task;
+	struct kthread_work measure_work;
+	struct yas_mag_sched sched;
+	bool running;
 	int16_t sampling_frequency;
 	atomic_t pseudo_irq_enable;
 	int32_t compass_data[3];
+	s64 timestamp;
+	/* x, y, z and the timestamp, filled by yas_trigger_handler() */
+	u8 scan[ALIGN(3 * sizeof(int32_t), sizeof(s64)) + sizeof(s64)]
+		__aligned(sizeof(s64));
 #ifdef CONFIG_HAS_EARLYSUSPEND
 	struct early_suspend sus;
 #endif
@@ -121,14 +134,44 @@ static uint32_t yas_current_time(void)
 	return jiffies_to_msecs(jiffies);
 }
 
+static int64_t yas_monotonic_ns(void)
+{
+	return ktime_to_ns(ktime_get());
+}
+
+/* Called with st->lock held */
+static void yas_measure_start(struct yas_state *st)
+{
+	st->mag.set_enable(1);
+	st->running = true;
+	yas_mag_sched_start(&st->sched, yas_monotonic_ns());
+	hrtimer_start(&st->timer, ns_to_ktime(st->sched.deadline),
+			HRTIMER_MODE_ABS);
+}
+
+/*
+ * Once running is clear under the lock the worker no longer re-arms the
+ * timer, so after the cancel and the flush nothing is left in flight.
+ */
+static void yas_measure_stop(struct yas_state *st)
+{
+	mutex_lock(&st->lock);
+	st->running = false;
+	mutex_unlock(&st->lock);
+	hrtimer_cancel(&st->timer);
+	flush_kthread_work(&st->measure_work);
+	mutex_lock(&st->lock);
+	st->mag.set_enable(0);
+	mutex_unlock(&st->lock);
+}
+
 static int yas_pseudo_irq_enable(struct iio_dev *indio_dev)
 {
 	struct yas_state *st = iio_priv(indio_dev);
 	if (!atomic_cmpxchg(&st->pseudo_irq_enable, 0, 1)) {
 		mutex_lock(&st->lock);
-		st->mag.set_enable(1);
+		yas_measure_start(st);
 		mutex_unlock(&st->lock);
-		schedule_delayed_work(&st->work, 0);
 	}
 	return 0;
 }
@@ -136,12 +179,8 @@ static int yas_pseudo_irq_enable(struct iio_dev *indio_dev)
 static int yas_pseudo_irq_disable(struct iio_dev *indio_dev)
 {
 	struct yas_state *st = iio_priv(indio_dev);
-	if (atomic_cmpxchg(&st->pseudo_irq_enable, 1, 0)) {
-		cancel_delayed_work_sync(&st->work);
-		mutex_lock(&st->lock);
-		st->mag.set_enable(0);
-		mutex_unlock(&st->lock);
-	}
+	if (atomic_cmpxchg(&st->pseudo_irq_enable, 1, 0))
+		yas_measure_stop(st);
 	return 0;
 }
 
@@ -169,12 +208,11 @@ static irqreturn_t yas_trigger_handler(int irq, void *p)
 	struct iio_poll_func *pf = p;
 	struct iio_dev *indio_dev = pf->indio_dev;
 	struct yas_state *st = iio_priv(indio_dev);
+	int32_t *mag = (int32_t *)st->scan;
+	unsigned long flags;
 	int len = 0, i, j;
-	int32_t *mag;
 
-	mag = (int32_t *) kmalloc(indio_dev->scan_bytes, GFP_KERNEL);
-	if (mag == NULL)
-		goto done;
+	spin_lock_irqsave(&st->spin_lock, flags);
 	if (!bitmap_empty(indio_dev->active_scan_mask, indio_dev->masklength)) {
 		j = 0;
 		for (i = 0; i < 3; i++) {
@@ -188,10 +226,9 @@ static irqreturn_t yas_trigger_handler(int irq, void *p)
 
 	/* Guaranteed to be aligned with 8 byte boundary */
 	if (indio_dev->scan_timestamp)
-		*(s64 *)((u8 *)mag + ALIGN(len, sizeof(s64))) = pf->timestamp;
-	iio_push_to_buffers(indio_dev, (u8 *)mag);
-	kfree(mag);
-done:
+		*(s64 *)(st->scan + ALIGN(len, sizeof(s64))) = st->timestamp;
+	spin_unlock_irqrestore(&st->spin_lock, flags);
+	iio_push_to_buffers(indio_dev, st->scan);
 	iio_trigger_notify_done(indio_dev->trig);
 	return IRQ_HANDLED;
 }
@@ -344,6 +381,7 @@ static ssize_t yas_sampling_frequency_store(struct device *dev,
 		return -EINVAL;
 	mutex_lock(&st->lock);
 	st->sampling_frequency = data;
+	yas_mag_sched_set_rate(&st->sched, data);
 	delay = MSEC_PER_SEC / st->sampling_frequency;
 	st->mag.set_delay(delay);
 	mutex_unlock(&st->lock);
@@ -605,33 +643,47 @@ static int yas_read_raw(struct iio_dev *indio_dev,
 	return ret;
 }
 
-static void yas_work_func(struct work_struct *work)
+static int64_t yas_iio_time_ns(void)
+{
+	return iio_get_time_ns();
+}
+
+static void yas_measure_work_func(struct kthread_work *work)
 {
 	struct yas_data mag[1];
 	struct yas_state *st =
-		container_of((struct delayed_work *)work,
-				struct yas_state, work);
+		container_of(work, struct yas_state, measure_work);
 	struct iio_dev *indio_dev = iio_priv_to_dev(st);
-	uint32_t time_before, time_after;
-	int32_t delay;
+	unsigned long flags;
+	int64_t timestamp, next;
 	int ret, i;
 
-	time_before = jiffies_to_msecs(jiffies);
 	mutex_lock(&st->lock);
-	ret = st->mag.measure(mag, 1);
+	if (!st->running) {
+		mutex_unlock(&st->lock);
+		return;
+	}
+	ret = yas_mag_sched_measure(&st->mag, yas_iio_time_ns, mag,
+			&timestamp);
 	if (ret == 1) {
+		spin_lock_irqsave(&st->spin_lock, flags);
 		for (i = 0; i < 3; i++)
 			st->compass_data[i] = mag[0].xyz.v[i];
+		st->timestamp = timestamp;
+		spin_unlock_irqrestore(&st->spin_lock, flags);
 	}
+	next = yas_mag_sched_next(&st->sched, yas_monotonic_ns());
+	hrtimer_start(&st->timer, ns_to_ktime(next), HRTIMER_MODE_ABS);
 	mutex_unlock(&st->lock);
 	if (ret == 1)
 		yas_data_rdy_trig_poll(indio_dev);
-	time_after = jiffies_to_msecs(jiffies);
-	delay = MSEC_PER_SEC / st->sampling_frequency
-		- (time_after - time_before);
-	if (delay <= 0)
-		delay = 1;
-	schedule_delayed_work(&st->work, msecs_to_jiffies(delay));
+}
+
+static enum hrtimer_restart yas_timer_func(struct hrtimer *timer)
+{
+	struct yas_state *st = container_of(timer, struct yas_state, timer);
+	queue_kthread_work(&st->worker, &st->measure_work);
+	return HRTIMER_NORESTART;
 }
 
 #define YAS_MAGN_INFO_SHARED_MASK	(BIT(IIO_CHAN_INFO_SCALE))
@@ -708,10 +760,8 @@ static void yas_early_suspend(struct early_suspend *h)
 {
 	struct yas_state *st = container_of(h,
 			struct yas_state, sus);
-	if (atomic_read(&st->pseudo_irq_enable)) {
-		cancel_delayed_work_sync(&st->work);
-		st->mag.set_enable(0);
-	}
+	if (atomic_read(&st->pseudo_irq_enable))
+		yas_measure_stop(st);
 }
 
 
@@ -720,14 +770,16 @@ static void yas_late_resume(struct early_suspend *h)
 	struct yas_state *st = container_of(h,
 			struct yas_state, sus);
 	if (atomic_read(&st->pseudo_irq_enable)) {
-		st->mag.set_enable(1);
-		schedule_delayed_work(&st->work, 0);
+		mutex_lock(&st->lock);
+		yas_measure_start(st);
+		mutex_unlock(&st->lock);
 	}
 }
 #endif
 
 static int yas_probe(struct i2c_client *i2c, const struct i2c_device_id *id)
 {
+	struct sched_param param = { .sched_priority = 1 };
 	struct yas_state *st;
 	struct iio_dev *indio_dev;
 	int ret, i;
@@ -756,8 +808,21 @@ static int yas_probe(struct i2c_client *i2c, const struct i2c_device_id *id)
 	st->mag.callback.device_write = yas_device_write;
 	st->mag.callback.usleep = yas_usleep;
 	st->mag.callback.current_time = yas_current_time;
-	INIT_DELAYED_WORK(&st->work, yas_work_func);
+	yas_mag_sched_set_rate(&st->sched, st->sampling_frequency);
+	hrtimer_init(&st->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	st->timer.function = yas_timer_func;
+	init_kthread_worker(&st->worker);
+	init_kthread_work(&st->measure_work, yas_measure_work_func);
+	st->worker_task = kthread_run(kthread_worker_fn, &st->worker,
+			"%s", YAS_MAG_NAME);
+	if (IS_ERR(st->worker_task)) {
+		ret = PTR_ERR(st->worker_task);
+		iio_device_free(indio_dev);
+		goto error_ret;
+	}
+	sched_setscheduler(st->worker_task, SCHED_FIFO, &param);
 	mutex_init(&st->lock);
+	spin_lock_init(&st->spin_lock);
 #ifdef CONFIG_HAS_EARLYSUSPEND
 	st->sus.level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN + 1;
 	st->sus.suspend = yas_early_suspend;
@@ -769,7 +834,7 @@ static int yas_probe(struct i2c_client *i2c, const struct i2c_device_id *id)
 
 	ret = yas_probe_buffer(indio_dev);
 	if (ret)
-		goto error_free_dev;
+		goto error_stop_worker;
 	ret = yas_probe_trigger(indio_dev);
 	if (ret)
 		goto error_remove_buffer;
@@ -786,7 +851,6 @@ static int yas_probe(struct i2c_client *i2c, const struct i2c_device_id *id)
 		ret = -EFAULT;
 		goto error_unregister_iio;
 	}
-	spin_lock_init(&st->spin_lock);
 	return 0;
 
 error_unregister_iio:
@@ -795,6 +859,8 @@ error_remove_trigger:
 	yas_remove_trigger(indio_dev);
 error_remove_buffer:
 	yas_remove_buffer(indio_dev);
+error_stop_worker:
+	kthread_stop(st->worker_task);
 error_free_dev:
 #ifdef CONFIG_HAS_EARLYSUSPEND
 	unregister_early_suspend(&st->sus);
@@ -816,6 +882,7 @@ static int yas_remove(struct i2c_client *i2c)
 		unregister_early_suspend(&st->sus);
 #endif
 		yas_pseudo_irq_disable(indio_dev);
+		kthread_stop(st->worker_task);
 		st->mag.term();
 		iio_device_unregister(indio_dev);
 		yas_remove_trigger(indio_dev);
@@ -831,10 +898,8 @@ static int yas_suspend(struct device *dev)
 {
 	struct iio_dev *indio_dev = dev_get_drvdata(dev);
 	struct yas_state *st = iio_priv(indio_dev);
-	if (atomic_read(&st->pseudo_irq_enable)) {
-		cancel_delayed_work_sync(&st->work);
-		st->mag.set_enable(0);
-	}
+	if (atomic_read(&st->pseudo_irq_enable))
+		yas_measure_stop(st);
 	return 0;
 }
 
@@ -843,8 +908,9 @@ static int yas_resume(struct device *dev)
 	struct iio_dev *indio_dev = dev_get_drvdata(dev);
 	struct yas_state *st = iio_priv(indio_dev);
 	if (atomic_read(&st->pseudo_irq_enable)) {
-		st->mag.set_enable(1);
-		schedule_delayed_work(&st->work, 0);
+		mutex_lock(&st->lock);
+		yas_measure_start(st);
+		mutex_unlock(&st->lock);
 	}
 	return 0;
 }
@@ -0,0 +1,99 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA  02110-1301, USA.
+ */
+
+/*
+ * Measurement pacing of yas_mag_kernel.c, kept free of kernel APIs so the
+ * same code runs in the host simulation (../../sim/yas_sched_sim.c) with a
+ * virtual clock and the register model behind yas_driver_callback.
+ *
+ * Deadlines are absolute: every sample is due one period after the
+ * previous deadline, not one period after the previous sample finished,
+ * so the time spent in measure() and the wake-up latency do not add up
+ * into a rate error.  A deadline that has already passed when the next
+ * one is computed is dropped and the schedule restarts from now, which
+ * keeps a stall (suspend, a long bus error) from being followed by a
+ * burst of back to back measurements.
+ *
+ * All times are in nanoseconds.
+ */
+
+#ifndef __YAS_MAG_SCHED_H__
+#define __YAS_MAG_SCHED_H__
+
+#include "yas.h"
+
+struct yas_mag_sched {
+	int64_t period;		/*!< ns between two deadlines */
+	int64_t deadline;	/*!< absolute time the next sample is due */
+	uint32_t late;		/*!< deadlines dropped because they had passed */
+};
+
+/**
+ * Starts a schedule whose first sample is due right away
+ * @param[in] now Current time of the clock the deadlines are armed on
+ */
+static inline void yas_mag_sched_start(struct yas_mag_sched *s, int64_t now)
+{
+	s->deadline = now;
+	s->late = 0;
+}
+
+/**
+ * Changes the period, from the deadline after the one already armed
+ * @param[in] hz Sampling frequency, must be positive
+ */
+static inline void yas_mag_sched_set_rate(struct yas_mag_sched *s, int32_t hz)
+{
+	s->period = 1000000000 / hz;
+}
+
+/**
+ * Advances to the next deadline once the current sample is done
+ * @param[in] now Current time of the clock the deadlines are armed on
+ * @return The absolute time to arm the timer for
+ */
+static inline int64_t yas_mag_sched_next(struct yas_mag_sched *s, int64_t now)
+{
+	s->deadline += s->period;
+	if (s->deadline <= now) {
+		s->late++;
+		s->deadline = now + s->period;
+	}
+	return s->deadline;
+}
+
+/**
+ * Takes one sample and timestamps it with the middle of the measure() call,
+ * which brackets the conversion, rather than with the time it is pushed.
+ * @param[in] now Clock the timestamp is reported in
+ * @param[out] timestamp Midpoint of the measurement, valid if 1 is returned
+ * @return The return value of measure()
+ */
+static inline int yas_mag_sched_measure(struct yas_mag_driver *mag,
+		int64_t (*now)(void), struct yas_data *data, int64_t *timestamp)
+{
+	int64_t before, after;
+	int ret;
+
+	before = now();
+	ret = mag->measure(data, 1);
+	after = now();
+	*timestamp = before + ((after - before) >> 1);
+	return ret;
+}
+
+#endif
@@ -95,6 +95,15 @@ typedef struct _SENSORDATAS {
 	};
 } SENSORDATA;
 
+/* one scan of the IIO buffer: x, y, z and the timestamp in nsec */
+typedef struct _MAGRAWDATAS {
+	int32_t x;
+	int32_t y;
+	int32_t z;
+	int32_t reserved;
+	int64_t timestamp;
+} MAGRAWDATA;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -103,7 +112,10 @@ int Magnetic_Initialize(void);
 int Magnetic_Enable(void);
 int Magnetic_Disable(void);
 int Magnetic_Set_Delay(uint64_t delay);
+int Magnetic_Set_Orientation_Filter_Len(int len);
 int Magnetic_Calibrate(SENSORDATA *raw, SENSORDATA *cal);
+int Magnetic_Calibrate_Batch(const MAGRAWDATA *raw, SENSORDATA *cal,
+		int num);
 int Magnetic_Get_Euler(SENSORDATA *acccal, SENSORDATA *magcal,
 		SENSORDATA *orientation);
 int Magnetic_Get_Quaternion(SENSORDATA *acccal, SENSORDATA *magcal,
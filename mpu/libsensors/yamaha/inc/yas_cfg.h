@@ -82,7 +82,9 @@
  *----------------------------------------------------------------------------*/
 
 #define YAS_ACC_DRIVER				(YAS_ACC_DRIVER_NONE)
+#ifndef YAS_MAG_DRIVER
 #define YAS_MAG_DRIVER				(YAS_MAG_DRIVER_YAS537)
+#endif
 #define YAS_GYRO_DRIVER				(YAS_GYRO_DRIVER_NONE)
 
 /*! Magnetic driver interrupt enable (0:Disable, 1: Enable) */
@@ -150,7 +152,9 @@
 #define YAS_MAG_VCORE				(1800)
 
 /*! No sleep version of YAS532 driver */
+#ifndef YAS532_DRIVER_NO_SLEEP
 #define YAS532_DRIVER_NO_SLEEP			(0)
+#endif
 
 /* ----------------------------------------------------------------------------
  *                            Driver Configuration
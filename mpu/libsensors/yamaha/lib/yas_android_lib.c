@@ -17,6 +17,8 @@
 #define MAX_ATTR_PATH	(256)
 #define ORIENTATION_FILTER_ENABLE	(1)
 #define ORIENTATION_FILTER_LEN		(10)
+#define ORIENTATION_FILTER_LEN_MAX	(64)
+#define ORIENTATION_FILTER_RENORM	(1024)
 
 #define MAG_INTENSITY_MIN		(15000) /* nT */
 #define MAG_INTENSITY_MAX		(90000) /* nT */
@@ -86,48 +88,87 @@ static struct yas_mag_param default_mag_param = {
 };
 
 #if ORIENTATION_FILTER_ENABLE
+/*
+ * Circular mean over the last orientation_len azimuths. The sums are kept
+ * running, so an update costs the same whatever the window length; they are
+ * recomputed from the log every ORIENTATION_FILTER_RENORM updates so that
+ * float rounding cannot pile up.
+ */
 struct azimuth_vector {
 	int azimuth;
 	float x;
 	float y;
 };
-static struct azimuth_vector orientation_log[ORIENTATION_FILTER_LEN];
+static struct azimuth_vector orientation_log[ORIENTATION_FILTER_LEN_MAX];
 static int orientation_index;
 static int orientation_num;
+static int orientation_len = ORIENTATION_FILTER_LEN;
+static volatile int orientation_len_req = ORIENTATION_FILTER_LEN;
+static int orientation_renorm;
+static int64_t orientation_sum_azimuth;
+static float orientation_sum_x;
+static float orientation_sum_y;
 
-static int orientation_filter_update(int azimuth)
+static void orientation_filter_init(void)
+{
+	orientation_len = orientation_len_req;
+	orientation_index = 0;
+	orientation_num = 0;
+	orientation_renorm = 0;
+	orientation_sum_azimuth = 0;
+	orientation_sum_x = 0;
+	orientation_sum_y = 0;
+}
+
+static void orientation_filter_resum(void)
 {
 	int i;
+	orientation_sum_azimuth = 0;
+	orientation_sum_x = 0;
+	orientation_sum_y = 0;
+	for (i = 0; i < orientation_num; i++) {
+		orientation_sum_azimuth += orientation_log[i].azimuth;
+		orientation_sum_x += orientation_log[i].x;
+		orientation_sum_y += orientation_log[i].y;
+	}
+	orientation_renorm = 0;
+}
+
+static int orientation_filter_update(int azimuth)
+{
+	struct azimuth_vector *v;
 	float theta = azimuth / 180000.0f * M_PI;
-	float sum_x, sum_y, sum_azimuth, avg_x, avg_y, avg_azimuth, result;
+	float avg_x, avg_y, result;
 
-	orientation_log[orientation_index].azimuth = azimuth;
-	orientation_log[orientation_index].x = cosf(theta);
-	orientation_log[orientation_index].y = sinf(theta);
+	if (orientation_len != orientation_len_req)
+		orientation_filter_init();
+
+	v = &orientation_log[orientation_index];
+	if (orientation_num == orientation_len) {
+		orientation_sum_azimuth -= v->azimuth;
+		orientation_sum_x -= v->x;
+		orientation_sum_y -= v->y;
+	} else
+		orientation_num++;
+	v->azimuth = azimuth;
+	v->x = cosf(theta);
+	v->y = sinf(theta);
+	orientation_sum_azimuth += v->azimuth;
+	orientation_sum_x += v->x;
+	orientation_sum_y += v->y;
 	orientation_index++;
-	if (ORIENTATION_FILTER_LEN <= orientation_index)
+	if (orientation_len <= orientation_index)
 		orientation_index = 0;
-	orientation_num++;
-	if (ORIENTATION_FILTER_LEN <= orientation_num)
-		orientation_num = ORIENTATION_FILTER_LEN;
+	if (ORIENTATION_FILTER_RENORM <= ++orientation_renorm)
+		orientation_filter_resum();
 
-	sum_x = 0;
-	sum_y = 0;
-	sum_azimuth = 0;
-	for (i = 0; i < orientation_num; i++) {
-		sum_azimuth += orientation_log[i].azimuth;
-		sum_x += orientation_log[i].x;
-		sum_y += orientation_log[i].y;
-	}
-	avg_x = sum_x / orientation_num;
-	avg_y = sum_y / orientation_num;
-	avg_azimuth = sum_azimuth / (float)orientation_num;
-	if (fabs(avg_x) < 0.001f && fabs(avg_y) < 0.001f) {
-		result = avg_azimuth;
+	avg_x = orientation_sum_x / orientation_num;
+	avg_y = orientation_sum_y / orientation_num;
+	if (fabsf(avg_x) < 0.001f && fabsf(avg_y) < 0.001f) {
+		result = orientation_sum_azimuth / (float)orientation_num;
 	} else {
-		avg_x = avg_x / sqrtf(avg_x * avg_x + avg_y * avg_y);
-		avg_y = avg_y / sqrtf(avg_x * avg_x + avg_y * avg_y);
-		result = atan2(avg_y, avg_x) / M_PI * 180.0 * 1000;
+		/* atan2 does not care about the length of (avg_x, avg_y) */
+		result = atan2f(avg_y, avg_x) / M_PI * 180.0f * 1000;
 	}
 	if (result < 0)
 		result += 360000.0;
@@ -135,12 +176,6 @@ static int orientation_filter_update(int azimuth)
 		result = 0;
 	return (int)result;
 }
-
-static void orientation_filter_init(void)
-{
-	orientation_index = 0;
-	orientation_num = 0;
-}
 #endif
 
 static uint32_t calc_intensity(int32_t *v)
@@ -152,21 +187,6 @@ static uint32_t calc_intensity(int32_t *v)
 	return (uint32_t)(yas_sqrt32(sum) * 100);
 }
 
-static void
-apply_matrix(struct yas_vector *xyz, struct yas_matrix *m)
-{
-	int32_t tmp[3];
-	int i;
-	if (m == NULL)
-		return;
-	for (i = 0; i < 3; i++)
-		tmp[i] = ((m->m[i*3]/10) * (xyz->v[0]/10)
-				+ (m->m[i*3+1]/10) * (xyz->v[1]/10)
-				+ (m->m[i*3+2]/10) * (xyz->v[2]/10)) / 100;
-	for (i = 0; i < 3; i++)
-		xyz->v[i] = tmp[i];
-}
-
 static int
 file_load(void)
 {
@@ -298,6 +318,25 @@ Magnetic_Set_Delay(uint64_t delay)
 	return 0;
 }
 
+int
+Magnetic_Set_Orientation_Filter_Len(int len)
+{
+	YASLOGD(("Magnetic_Set_Orientation_Filter_Len IN [%d]\n", len));
+#if ORIENTATION_FILTER_ENABLE
+	if (len < 1 || ORIENTATION_FILTER_LEN_MAX < len) {
+		YASLOGD(("Magnetic_Set_Orientation_Filter_Len OUT [%d]\n",
+					YAS_ERROR_ARG));
+		return YAS_ERROR_ARG;
+	}
+	/* picked up by the next orientation_filter_update() */
+	orientation_len_req = len;
+#else
+	(void) len;
+#endif
+	YASLOGD(("Magnetic_Set_Orientation_Filter_Len OUT\n"));
+	return 0;
+}
+
 int
 Magnetic_Get_Euler(SENSORDATA *acccal, SENSORDATA *magcal,
 		SENSORDATA *orientation)
@@ -473,51 +512,117 @@ int Magnetic_Get_Filtered_Quaternion(SENSORDATA *acccal, SENSORDATA *magcal,
 }
 #endif
 
+#define CALIBRATE_BLOCK		(32)
+
+/*
+ * Offset and matrix stage over raw[0..num), with the offset and the matrix
+ * that were current when the samples went through the calibration.  The
+ * matrix coefficients are divided once instead of once per sample; the
+ * result is the same as apply_matrix().
+ */
+static void
+calibrate_block(const MAGRAWDATA *raw, SENSORDATA *cal, int num)
+{
+	int32_t v[CALIBRATE_BLOCK][3];
+	int32_t o[3], m[9];
+	int i, j, use_matrix = 0;
+
+	for (j = 0; j < 3; j++)
+		o[j] = algo.param.calib_offset.v[j];
+#if YAS_MAG_CALIB_ELLIPSOID_ENABLE
+	use_matrix = algo.param.config.mode == YAS_MAG_CALIB_MODE_ELLIPSOID
+		|| algo.param.config.mode
+		== YAS_MAG_CALIB_MODE_ELLIPSOID_WITH_GYRO;
+	for (j = 0; j < 9; j++)
+		m[j] = algo.param.dynamic_matrix.m[j] / 10;
+#else
+	memset(m, 0, sizeof(m));
+#endif
+
+	for (i = 0; i < num; i++) {
+		v[i][0] = raw[i].x - o[0];
+		v[i][1] = raw[i].y - o[1];
+		v[i][2] = raw[i].z - o[2];
+	}
+	if (use_matrix) {
+		for (i = 0; i < num; i++) {
+			int32_t x = v[i][0] / 10, y = v[i][1] / 10,
+				z = v[i][2] / 10;
+			v[i][0] = (m[0] * x + m[1] * y + m[2] * z) / 100;
+			v[i][1] = (m[3] * x + m[4] * y + m[5] * z) / 100;
+			v[i][2] = (m[6] * x + m[7] * y + m[8] * z) / 100;
+		}
+	}
+	for (i = 0; i < num; i++) {
+		struct yas_vector xyz;
+		xyz.v[0] = v[i][0];
+		xyz.v[1] = v[i][1];
+		xyz.v[2] = v[i][2];
+		if (algo.param.filter_enable)
+			algo.mfilter.update(&xyz, &xyz);
+		cal[i].vx = (float)xyz.v[0] / 1000.0f;
+		cal[i].vy = (float)xyz.v[1] / 1000.0f;
+		cal[i].vz = (float)xyz.v[2] / 1000.0f;
+		cal[i].ox = (float)o[0] / 1000.0f;
+		cal[i].oy = (float)o[1] / 1000.0f;
+		cal[i].oz = (float)o[2] / 1000.0f;
+		cal[i].accuracy = algo.param.accuracy;
+		YASLOGD(("Magnetic_Calibrate OUT [%d] [%f %f %f] [%f %f %f]\n",
+					cal[i].accuracy, cal[i].vx, cal[i].vy,
+					cal[i].vz, cal[i].ox, cal[i].oy,
+					cal[i].oz));
+	}
+}
+
 int
-Magnetic_Calibrate(SENSORDATA *raw, SENSORDATA *cal)
+Magnetic_Calibrate_Batch(const MAGRAWDATA *raw, SENSORDATA *cal, int num)
 {
 	struct yas_data mag;
-	int rt, i;
+	int rt, i, start = 0;
+	if (num <= 0)
+		return 0;
 	pthread_mutex_lock(&algo.mutex);
-	YASLOGD(("Magnetic_Calibrate IN [%d %d %d]\n", raw->x, raw->y, raw->z));
-	memset(cal, 0, sizeof(*cal));
 	mag.type = YAS_TYPE_MAG;
-	mag.timestamp = 0;
-	mag.xyz.v[0] = raw->x;
-	mag.xyz.v[1] = raw->y;
-	mag.xyz.v[2] = raw->z;
-	rt = algo.mcalib.update(&mag, 1);
-	if (0 < rt) {
-		algo.mcalib.get_offset(YAS_TYPE_MAG, &algo.param.calib_offset,
-				&algo.param.accuracy);
+	for (i = 0; i < num; i++) {
+		YASLOGD(("Magnetic_Calibrate IN [%d %d %d]\n",
+					raw[i].x, raw[i].y, raw[i].z));
+		mag.timestamp = (uint32_t)(raw[i].timestamp / 1000000);
+		mag.xyz.v[0] = raw[i].x;
+		mag.xyz.v[1] = raw[i].y;
+		mag.xyz.v[2] = raw[i].z;
+		rt = algo.mcalib.update(&mag, 1);
+		/* a new offset applies from the sample that produced it on */
+		if (0 < rt || i - start == CALIBRATE_BLOCK) {
+			calibrate_block(&raw[start], &cal[start], i - start);
+			start = i;
+		}
+		if (0 < rt) {
+			algo.mcalib.get_offset(YAS_TYPE_MAG,
+					&algo.param.calib_offset,
+					&algo.param.accuracy);
 #if YAS_MAG_CALIB_ELLIPSOID_ENABLE
-		algo.mcalib.get_dynamic_matrix(&algo.param.dynamic_matrix);
+			algo.mcalib.get_dynamic_matrix(
+					&algo.param.dynamic_matrix);
 #endif
 #if YAS_MSM_PLATFORM
-		file_save();
+			file_save();
 #endif
+		}
 	}
-	for (i = 0; i < 3; i++)
-		mag.xyz.v[i] -= algo.param.calib_offset.v[i];
-#if YAS_MAG_CALIB_ELLIPSOID_ENABLE
-	if (algo.param.config.mode == YAS_MAG_CALIB_MODE_ELLIPSOID
-		|| algo.param.config.mode
-		== YAS_MAG_CALIB_MODE_ELLIPSOID_WITH_GYRO)
-		apply_matrix(&mag.xyz, &algo.param.dynamic_matrix);
-#endif
-	if (algo.param.filter_enable)
-		algo.mfilter.update(&mag.xyz, &mag.xyz);
-	cal->vx = (float)mag.xyz.v[0] / 1000.0f;
-	cal->vy = (float)mag.xyz.v[1] / 1000.0f;
-	cal->vz = (float)mag.xyz.v[2] / 1000.0f;
-	cal->ox = (float)algo.param.calib_offset.v[0] / 1000.0f;
-	cal->oy = (float)algo.param.calib_offset.v[1] / 1000.0f;
-	cal->oz = (float)algo.param.calib_offset.v[2] / 1000.0f;
-	cal->accuracy = algo.param.accuracy;
-	YASLOGD(("Magnetic_Calibrate OUT [%d] [%f %f %f] [%f %f %f]\n",
-				cal->accuracy, cal->vx, cal->vy, cal->vz,
-				cal->ox, cal->oy, cal->oz));
+	calibrate_block(&raw[start], &cal[start], num - start);
 	pthread_mutex_unlock(&algo.mutex);
+	return num;
+}
+
+int
+Magnetic_Calibrate(SENSORDATA *raw, SENSORDATA *cal)
+{
+	MAGRAWDATA r;
+	memset(&r, 0, sizeof(r));
+	r.x = raw->x;
+	r.y = raw->y;
+	r.z = raw->z;
+	Magnetic_Calibrate_Batch(&r, cal, 1);
 	return 0;
 }
 
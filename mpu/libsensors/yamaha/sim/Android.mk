@@ -0,0 +1,77 @@
+#
+# Host-side simulation of the YAS532/YAS537 drivers, see yas_sim.h.
+# Build with "mmm" from this directory, then run e.g.
+#   out/host/linux-x86/bin/yas537_sim -a 3 -n 100000
+#
+LOCAL_PATH:= $(call my-dir)
+
+YAS_SIM_CFLAGS := -Wall -Wextra -O2
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := yas532_sim
+LOCAL_MODULE_TAGS := optional
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../inc
+LOCAL_CFLAGS := $(YAS_SIM_CFLAGS) -DYAS_MAG_DRIVER=YAS_MAG_DRIVER_YAS532
+LOCAL_SRC_FILES := yas_sim.c yas_sim_bench.c \
+	../drv/3.10/yas_mag_drv-yas532.c
+LOCAL_LDLIBS := -lm -lrt
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := yas532_nosleep_sim
+LOCAL_MODULE_TAGS := optional
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../inc
+LOCAL_CFLAGS := $(YAS_SIM_CFLAGS) -DYAS_MAG_DRIVER=YAS_MAG_DRIVER_YAS532 \
+	-DYAS532_DRIVER_NO_SLEEP=1
+LOCAL_SRC_FILES := yas_sim.c yas_sim_bench.c \
+	../drv/3.10/yas_mag_drv-yas532.c
+LOCAL_LDLIBS := -lm -lrt
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := yas537_sim
+LOCAL_MODULE_TAGS := optional
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../inc
+LOCAL_CFLAGS := $(YAS_SIM_CFLAGS) -DYAS_MAG_DRIVER=YAS_MAG_DRIVER_YAS537
+LOCAL_SRC_FILES := yas_sim.c yas_sim_bench.c \
+	../drv/3.10/yas_mag_drv-yas537.c
+LOCAL_LDLIBS := -lm -lrt
+include $(BUILD_HOST_EXECUTABLE)
+
+#
+# Pacing of yas_mag_kernel.c on a virtual clock, see yas_sched_sim.c.
+#
+include $(CLEAR_VARS)
+LOCAL_MODULE := yas532_sched_sim
+LOCAL_MODULE_TAGS := optional
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../inc $(LOCAL_PATH)/../drv/3.10
+LOCAL_CFLAGS := $(YAS_SIM_CFLAGS) -DYAS_MAG_DRIVER=YAS_MAG_DRIVER_YAS532
+LOCAL_SRC_FILES := yas_sim.c yas_sched_sim.c \
+	../drv/3.10/yas_mag_drv-yas532.c
+LOCAL_LDLIBS := -lm -lrt
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := yas537_sched_sim
+LOCAL_MODULE_TAGS := optional
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../inc $(LOCAL_PATH)/../drv/3.10
+LOCAL_CFLAGS := $(YAS_SIM_CFLAGS) -DYAS_MAG_DRIVER=YAS_MAG_DRIVER_YAS537
+LOCAL_SRC_FILES := yas_sim.c yas_sched_sim.c \
+	../drv/3.10/yas_mag_drv-yas537.c
+LOCAL_LDLIBS := -lm -lrt
+include $(BUILD_HOST_EXECUTABLE)
+
+#
+# Magnetic_Calibrate() against Magnetic_Calibrate_Batch(), see
+# yas_calib_bench.c.  Needs the prebuilt calibration, so it is built for
+# the target:
+#   adb shell /system/bin/yas_calib_bench -b 32
+#
+include $(CLEAR_VARS)
+LOCAL_MODULE := yas_calib_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../inc
+LOCAL_CFLAGS := $(YAS_SIM_CFLAGS) -DYAS_MAG_DRIVER=YAS_MAG_DRIVER_YAS532
+LOCAL_SRC_FILES := yas_calib_bench.c
+LOCAL_SHARED_LIBRARIES := libyasalgo
+include $(BUILD_EXECUTABLE)
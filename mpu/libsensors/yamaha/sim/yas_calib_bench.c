@@ -0,0 +1,125 @@
+/*
+ * Compares Magnetic_Calibrate() one sample at a time with
+ * Magnetic_Calibrate_Batch() over blocks of the same samples, and checks
+ * that both give bit identical results.  The calibration itself is the
+ * prebuilt libyas_mag_algo, so this runs on the target, not on the host.
+ *
+ * usage: yas_calib_bench [-n samples] [-b block] [-r rounds]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "yas_android_lib.h"
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* a 45uT field turning about a tilted axis, plus a hard iron offset */
+static void make_samples(MAGRAWDATA *raw, int num)
+{
+	int i;
+	for (i = 0; i < num; i++) {
+		double a = i * 0.013, b = i * 0.0021;
+		raw[i].x = (int32_t)(45000.0 * cos(a) * cos(b)) + 12000;
+		raw[i].y = (int32_t)(45000.0 * sin(a) * cos(b)) - 30000;
+		raw[i].z = (int32_t)(45000.0 * sin(b)) + 5000;
+		raw[i].reserved = 0;
+		/* Magnetic_Calibrate() has no timestamp, it passes 0 */
+		raw[i].timestamp = 0;
+	}
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-n samples] [-b block] [-r rounds]\n"
+		"  -n  samples per round (default 20000)\n"
+		"  -b  samples per Magnetic_Calibrate_Batch() call "
+		"(default 16)\n"
+		"  -r  rounds, each from a fresh calibration (default 5)\n",
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	MAGRAWDATA *raw;
+	SENSORDATA *single, *batch, in;
+	uint64_t t0, t_single = 0, t_batch = 0;
+	int samples = 20000, block = 16, rounds = 5;
+	int opt, i, r, n, diff = 0;
+
+	while ((opt = getopt(argc, argv, "n:b:r:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			samples = atoi(optarg);
+			break;
+		case 'b':
+			block = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (samples <= 0 || block <= 0 || rounds <= 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	raw = malloc(samples * sizeof(*raw));
+	single = malloc(samples * sizeof(*single));
+	batch = malloc(samples * sizeof(*batch));
+	if (raw == NULL || single == NULL || batch == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	make_samples(raw, samples);
+
+	for (r = 0; r < rounds; r++) {
+		/* each pass starts from the same calibration state */
+		Magnetic_Initialize();
+		t0 = now_ns();
+		for (i = 0; i < samples; i++) {
+			in.x = raw[i].x;
+			in.y = raw[i].y;
+			in.z = raw[i].z;
+			Magnetic_Calibrate(&in, &single[i]);
+		}
+		t_single += now_ns() - t0;
+
+		Magnetic_Initialize();
+		t0 = now_ns();
+		for (i = 0; i < samples; i += n) {
+			n = samples - i < block ? samples - i : block;
+			Magnetic_Calibrate_Batch(&raw[i], &batch[i], n);
+		}
+		t_batch += now_ns() - t0;
+	}
+
+	for (i = 0; i < samples; i++)
+		if (memcmp(&single[i], &batch[i], sizeof(single[i])) != 0)
+			diff++;
+
+	printf("%d samples x %d rounds, block %d\n", samples, rounds, block);
+	printf("Magnetic_Calibrate():       %.0f samples/s\n",
+			(double)samples * rounds * 1e9 / (double)t_single);
+	printf("Magnetic_Calibrate_Batch(): %.0f samples/s\n",
+			(double)samples * rounds * 1e9 / (double)t_batch);
+	printf("samples that differ:        %d\n", diff);
+	free(raw);
+	free(single);
+	free(batch);
+	return 0;
+}
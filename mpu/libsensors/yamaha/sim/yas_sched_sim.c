@@ -0,0 +1,246 @@
+/*
+ * Runs the measurement pacing of yas_mag_kernel.c (drv/3.10/yas_mag_sched.h)
+ * against the register level model, on a virtual clock, and reports the
+ * sample rate and interval jitter it produces.  With -o the old pacing is
+ * modelled instead: a delayed work re-armed with "period minus the time
+ * measure() took" in jiffies, timestamped when the trigger is polled.
+ *
+ * Every wake-up is late by a random scheduling latency of up to -j usec.
+ *
+ * usage: yas532_sched_sim|yas537_sched_sim [-n samples] [-r hz]
+ *                                          [-j latency_us] [-z HZ] [-o] [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "yas_sim.h"
+#include "yas_mag_sched.h"
+
+#if YAS_MAG_DRIVER == YAS_MAG_DRIVER_YAS532 \
+	|| YAS_MAG_DRIVER == YAS_MAG_DRIVER_YAS533
+#define SIM_CHIP		YAS_SIM_YAS532
+#define SIM_NAME		"yas532"
+#elif YAS_MAG_DRIVER == YAS_MAG_DRIVER_YAS537
+#define SIM_CHIP		YAS_SIM_YAS537
+#define SIM_NAME		"yas537"
+#else
+#error "yas_sim supports YAS532/533 and YAS537 only"
+#endif
+
+static uint32_t seed = 1;
+static int latency_us;
+
+static int64_t sim_now_ns(void)
+{
+	return (int64_t)yas_sim_time_us() * 1000;
+}
+
+static void sleep_until(int64_t t)
+{
+	int64_t now = sim_now_ns();
+	int lat = 0;
+
+	if (latency_us > 0) {
+		seed = seed * 1103515245 + 12345;
+		lat = (int)((seed >> 8) % (uint32_t)(latency_us + 1));
+	}
+	if (now < t)
+		yas_sim_advance((uint32_t)((t - now + 999) / 1000));
+	yas_sim_advance((uint32_t)lat);
+}
+
+struct run_stats {
+	int samples;
+	int errors;
+	uint32_t late;
+	int64_t first, last;
+	int64_t min, max;
+	double sum, sum2;
+	double lag;		/* timestamp minus measurement midpoint */
+};
+
+static void account(struct run_stats *r, int64_t ts, int64_t mid)
+{
+	int64_t d;
+
+	if (r->samples > 0) {
+		d = ts - r->last;
+		if (r->samples == 1 || d < r->min)
+			r->min = d;
+		if (r->samples == 1 || d > r->max)
+			r->max = d;
+		r->sum += (double)d;
+		r->sum2 += (double)d * (double)d;
+	} else {
+		r->first = ts;
+	}
+	r->last = ts;
+	r->lag += (double)(ts - mid);
+	r->samples++;
+}
+
+static void run_sched(struct yas_mag_driver *drv, int samples, int hz,
+		int verbose, struct run_stats *r)
+{
+	struct yas_mag_sched s;
+	struct yas_data data;
+	int64_t ts, before;
+	int i, ret;
+
+	yas_mag_sched_set_rate(&s, hz);
+	yas_mag_sched_start(&s, sim_now_ns());
+	for (i = 0; i < samples; i++) {
+		sleep_until(s.deadline);
+		before = sim_now_ns();
+		ret = yas_mag_sched_measure(drv, sim_now_ns, &data, &ts);
+		if (ret != 1) {
+			r->errors++;
+		} else {
+			account(r, ts, before + (sim_now_ns() - before) / 2);
+			if (verbose)
+				printf("%lld,%d,%d,%d\n", (long long)ts,
+						data.xyz.v[0], data.xyz.v[1],
+						data.xyz.v[2]);
+		}
+		yas_mag_sched_next(&s, sim_now_ns());
+	}
+	r->late = s.late;
+}
+
+static void run_jiffies(struct yas_mag_driver *drv, int samples, int hz,
+		int tick_hz, int verbose, struct run_stats *r)
+{
+	int64_t tick = 1000000000LL / tick_hz, before, after, wake;
+	int32_t delay, jdelay;
+	struct yas_data data;
+	int i, ret;
+
+	for (i = 0; i < samples; i++) {
+		before = sim_now_ns();
+		ret = drv->measure(&data, 1);
+		after = sim_now_ns();
+		if (ret != 1) {
+			r->errors++;
+		} else {
+			account(r, after, before + (after - before) / 2);
+			if (verbose)
+				printf("%lld,%d,%d,%d\n", (long long)after,
+						data.xyz.v[0], data.xyz.v[1],
+						data.xyz.v[2]);
+		}
+		/* jiffies_to_msecs() of both ends, as yas_work_func() did */
+		delay = 1000 / hz - (int32_t)((after / tick - before / tick)
+				* (tick / 1000000));
+		if (delay <= 0)
+			delay = 1;
+		jdelay = (int32_t)(((int64_t)delay * 1000000 + tick - 1) / tick);
+		wake = (after / tick + jdelay) * tick;
+		sleep_until(wake);
+	}
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-n samples] [-r hz] [-j latency_us] [-z HZ] "
+		"[-o] [-v]\n"
+		"  -n  number of samples (default 2000)\n"
+		"  -r  sampling frequency in Hz (default 20)\n"
+		"  -j  worst case wake-up latency in usec (default 500)\n"
+		"  -z  kernel tick rate for -o (default 100)\n"
+		"  -o  model the old jiffies based delayed work\n"
+		"  -v  print every sample as CSV\n",
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	struct yas_mag_driver drv;
+	struct run_stats r;
+	int samples = 2000, hz = 20, tick_hz = 100, old = 0, verbose = 0;
+	int opt, rt;
+	double n, mean, sd, span;
+
+	latency_us = 500;
+	while ((opt = getopt(argc, argv, "n:r:j:z:ovh")) != -1) {
+		switch (opt) {
+		case 'n':
+			samples = atoi(optarg);
+			break;
+		case 'r':
+			hz = atoi(optarg);
+			break;
+		case 'j':
+			latency_us = atoi(optarg);
+			break;
+		case 'z':
+			tick_hz = atoi(optarg);
+			break;
+		case 'o':
+			old = 1;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (samples < 2 || hz <= 0 || hz > 1000 || latency_us < 0
+			|| tick_hz <= 0 || tick_hz > 1000) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	yas_sim_init(SIM_CHIP);
+	memset(&drv, 0, sizeof(drv));
+	yas_sim_get_callback(&drv.callback);
+	rt = yas_mag_driver_init(&drv);
+	if (rt == YAS_NO_ERROR)
+		rt = drv.init();
+	if (rt == YAS_NO_ERROR)
+		rt = drv.set_delay(1000 / hz);
+	if (rt == YAS_NO_ERROR)
+		rt = drv.set_enable(1);
+	if (rt != YAS_NO_ERROR) {
+		fprintf(stderr, "driver setup failed (%d)\n", rt);
+		return 1;
+	}
+
+	memset(&r, 0, sizeof(r));
+	if (verbose)
+		printf("timestamp,x,y,z\n");
+	if (old)
+		run_jiffies(&drv, samples, hz, tick_hz, verbose, &r);
+	else
+		run_sched(&drv, samples, hz, verbose, &r);
+	drv.term();
+
+	if (r.samples < 2) {
+		fprintf(stderr, "too few samples (%d errors)\n", r.errors);
+		return 1;
+	}
+	n = (double)(r.samples - 1);
+	mean = r.sum / n;
+	sd = sqrt(r.sum2 / n - mean * mean);
+	span = (double)(r.last - r.first);
+	printf(SIM_NAME " %s pacing: %d samples at %d Hz, latency <= %d us",
+			old ? "jiffies" : "hrtimer", r.samples, hz, latency_us);
+	if (old)
+		printf(", HZ=%d", tick_hz);
+	printf("\n");
+	printf("rate:            %.3f Hz (%+.2f%%)\n", n * 1e9 / span,
+			(n * 1e9 / span / hz - 1.0) * 100.0);
+	printf("interval:        mean %.3f ms, sd %.3f ms, "
+			"min %.3f ms, max %.3f ms\n",
+			mean / 1e6, sd / 1e6, r.min / 1e6, r.max / 1e6);
+	printf("timestamp lag:   %.1f us after the measurement midpoint\n",
+			r.lag / r.samples / 1e3);
+	printf("late deadlines:  %u, errors %d\n", r.late, r.errors);
+	return 0;
+}
@@ -0,0 +1,555 @@
+/*
+ * Register level simulation of the YAS532 and YAS537 magnetometers
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "yas_sim.h"
+
+#define YAS532_REG_DEVID		(0x80)
+#define YAS532_REG_RCOILR		(0x81)
+#define YAS532_REG_CMDR			(0x82)
+#define YAS532_REG_OXR			(0x85)
+#define YAS532_REG_CALR			(0x90)
+#define YAS532_REG_DATAR		(0xB0)
+#define YAS532_DEVICE_ID		(0x02)
+#define YAS532_DATA_OVERFLOW		(8190)
+#define YAS532_CONVERSION_TIME		(1100)	/* usec */
+#define YAS532_TEMPERATURE		(390)
+
+#define YAS537_REG_DIDR			(0x80)
+#define YAS537_REG_CMDR			(0x81)
+#define YAS537_REG_CONFR		(0x82)
+#define YAS537_REG_AVRR			(0x87)
+#define YAS537_REG_SRSTR		(0x90)
+#define YAS537_REG_DATAR		(0xb0)
+#define YAS537_REG_CALR			(0xc0)
+#define YAS537_DEVICE_ID		(0x07)
+#define YAS537_DATA_OVERFLOW		(16383)
+#define YAS537_TEMPERATURE		(8120)
+
+/* 400 kHz I2C, 9 clocks per byte, plus address and register bytes */
+#define YAS_SIM_BUS_BYTE_US		(23)
+#define bus_time(len)			((uint32_t)((len) + 2) * YAS_SIM_BUS_BYTE_US)
+
+/*
+ * Calibration registers. The coefficients are chosen so that the driver's
+ * correction is a plain scale: YAS532 k = 15, a5 = a9 = 70 and every other
+ * coefficient 0; YAS537 version 1 with k = 64, a5 = a9 = 128.
+ */
+static const uint8_t yas532_calr[14] = {
+	128, 128, 128, 130, 32, 130, 8, 16, 35, 60, 0, 0, 0, 0,
+};
+static const uint8_t yas537_calr[17] = {
+	128, 64, 32, 16, 32, 64, 60, 32, 64, 64, 120, 64, 0, 0, 0, 0x88,
+	0x40 | 0x20,
+};
+#define YAS532_K			(15)
+#define YAS532_A5			(70)
+#define YAS532_A9			(70)
+static const int yas532_coef[3] = {850, 750, 750};
+#define YAS532_CVAL			(3721)
+
+/* conversion time for AVRR 8, 16, ..., 256 samples, about 80% of worst */
+static const uint32_t yas537_conversion_time[] = {
+	640, 880, 1200, 2400, 4800, 9600
+};
+
+struct yas_sim {
+	int chip;
+	int open;
+	uint8_t reg[256];
+	uint64_t now;			/* usec */
+	uint64_t conversion_end;	/* usec */
+	int continuous;
+
+	struct yas_sim_event script[YAS_SIM_MAX_EVENTS];
+	int script_num;
+	int script_pos;
+
+	int32_t base[3];		/* nT */
+	uint32_t rotate_period;		/* msec */
+	uint64_t rotate_start;		/* usec */
+	int overflow;			/* conversions left */
+	int32_t magnetize[3];		/* ADC codes, cleared by coil reset */
+	int32_t noise;			/* ADC codes at the lowest averaging */
+	uint32_t seed;
+
+	uint16_t raw[3];		/* last conversion */
+	struct yas_sim_stats stats;
+};
+
+static struct yas_sim sim;
+
+static const struct yas_sim_event default_script[] = {
+	{0,	YAS_SIM_EVENT_FIELD,	{30000, 0, -30000} },
+	{0,	YAS_SIM_EVENT_ROTATE,	{4000, 0, 0} },
+	{0,	YAS_SIM_EVENT_NOISE,	{4, 0, 0} },
+	{2000,	YAS_SIM_EVENT_OVERFLOW,	{3, 0, 0} },
+	{5000,	YAS_SIM_EVENT_MAGNETIZE, {4000, 0, 0} },
+};
+
+static int32_t noise(int32_t amp)
+{
+	/* triangular noise in [-amp, amp] from a plain LCG */
+	int32_t a, b;
+	if (amp <= 0)
+		return 0;
+	sim.seed = sim.seed * 1103515245 + 12345;
+	a = (int32_t)((sim.seed >> 16) % (uint32_t)(amp + 1));
+	sim.seed = sim.seed * 1103515245 + 12345;
+	b = (int32_t)((sim.seed >> 16) % (uint32_t)(amp + 1));
+	return a - b;
+}
+
+static void run_script(void)
+{
+	struct yas_sim_event *ev;
+	int i;
+	while (sim.script_pos < sim.script_num) {
+		ev = &sim.script[sim.script_pos];
+		if (sim.now < (uint64_t)ev->time * 1000)
+			break;
+		switch (ev->type) {
+		case YAS_SIM_EVENT_FIELD:
+			for (i = 0; i < 3; i++)
+				sim.base[i] = ev->v[i];
+			sim.rotate_start = sim.now;
+			break;
+		case YAS_SIM_EVENT_ROTATE:
+			sim.rotate_period = (uint32_t)ev->v[0];
+			sim.rotate_start = sim.now;
+			break;
+		case YAS_SIM_EVENT_OVERFLOW:
+			sim.overflow = ev->v[0];
+			break;
+		case YAS_SIM_EVENT_MAGNETIZE:
+			for (i = 0; i < 3; i++)
+				sim.magnetize[i] = ev->v[i];
+			break;
+		case YAS_SIM_EVENT_NOISE:
+			sim.noise = ev->v[0];
+			break;
+		default:
+			break;
+		}
+		sim.script_pos++;
+	}
+}
+
+static void field_at(uint64_t now, int32_t *field)
+{
+	double th, c, s;
+	if (sim.rotate_period == 0) {
+		field[0] = sim.base[0];
+		field[1] = sim.base[1];
+		field[2] = sim.base[2];
+		return;
+	}
+	th = 2.0 * M_PI * (double)(now - sim.rotate_start)
+		/ ((double)sim.rotate_period * 1000.0);
+	c = cos(th);
+	s = sin(th);
+	field[0] = (int32_t)lrint(c * sim.base[0] - s * sim.base[1]);
+	field[1] = (int32_t)lrint(s * sim.base[0] + c * sim.base[1]);
+	field[2] = sim.base[2];
+}
+
+static uint16_t clamp(int32_t v, int32_t max)
+{
+	if (v < 0)
+		return 0;
+	if (max < v)
+		return (uint16_t)max;
+	return (uint16_t)v;
+}
+
+static void convert_yas532(void)
+{
+	int32_t b[3];
+	double sx, sy, sz, l[3];
+	int i;
+	field_at(sim.now, b);
+	/* inverse of the driver's xy1y2 -> xyz with the cal data above */
+	sx = b[0] / (10.0 * YAS532_K);
+	sy = 10.0 * b[1] / (YAS532_K * YAS532_A5);
+	sz = 10.0 * b[2] / (YAS532_K * YAS532_A9);
+	l[0] = sx;
+	l[1] = (sy - sz) / 2;
+	l[2] = (-sy - sz) / 2;
+	for (i = 0; i < 3; i++) {
+		int32_t v = (int32_t)lrint(l[i]) + YAS532_CVAL
+			- (int8_t)sim.reg[YAS532_REG_OXR + i] * yas532_coef[i]
+			+ sim.magnetize[i] + noise(sim.noise);
+		sim.raw[i] = clamp(v, YAS532_DATA_OVERFLOW);
+	}
+	if (sim.overflow > 0) {
+		sim.overflow--;
+		sim.raw[0] = YAS532_DATA_OVERFLOW;
+	}
+	for (i = 0; i < 3; i++)
+		if (sim.raw[i] == YAS532_DATA_OVERFLOW || sim.raw[i] == 0) {
+			sim.stats.overflows++;
+			break;
+		}
+}
+
+static int yas537_average(void)
+{
+	uint8_t avrr = sim.reg[YAS537_REG_AVRR];
+	int idx;
+	if ((avrr & 0x70) == 0x50)
+		idx = 0;
+	else if ((avrr & 0x70) == 0x60)
+		idx = 1;
+	else
+		idx = 2 + (avrr & 0x0f);
+	if (5 < idx)
+		idx = 5;
+	return idx;
+}
+
+static void convert_yas537(void)
+{
+	int32_t b[3], amp;
+	double l[3];
+	int i, avg;
+	field_at(sim.now, b);
+	l[0] = b[0] / 300.0;
+	l[1] = (b[1] / 173.2 - b[2] / 300.0) / 2;
+	l[2] = (-b[1] / 173.2 - b[2] / 300.0) / 2;
+	/* averaging 8 << avg samples lowers the noise by sqrt(1 << avg) */
+	avg = yas537_average();
+	amp = (int32_t)(sim.noise / sqrt((double)(1 << avg)));
+	for (i = 0; i < 3; i++) {
+		int32_t v = (int32_t)lrint(l[i]) + 8192
+			+ sim.magnetize[i] + noise(amp);
+		sim.raw[i] = clamp(v, YAS537_DATA_OVERFLOW);
+	}
+	if (sim.overflow > 0) {
+		sim.overflow--;
+		sim.raw[0] = YAS537_DATA_OVERFLOW;
+	}
+	for (i = 0; i < 3; i++)
+		if (sim.raw[i] == YAS537_DATA_OVERFLOW || sim.raw[i] == 0) {
+			sim.stats.overflows++;
+			break;
+		}
+}
+
+static void start_conversion(void)
+{
+	uint32_t t;
+	run_script();
+	sim.stats.conversions++;
+	if (sim.chip == YAS_SIM_YAS532) {
+		t = YAS532_CONVERSION_TIME;
+		convert_yas532();
+	} else {
+		t = yas537_conversion_time[yas537_average()];
+		convert_yas537();
+	}
+	sim.conversion_end = sim.now + t;
+}
+
+static void read_data_yas532(uint8_t *d)
+{
+	int busy = sim.now < sim.conversion_end;
+	uint16_t t = YAS532_TEMPERATURE;
+	int i;
+	d[0] = (uint8_t)((busy << 7) | ((t >> 3) & 0x7f));
+	d[1] = (uint8_t)((t & 0x07) << 5);
+	for (i = 0; i < 3; i++) {
+		d[2+i*2] = (uint8_t)((sim.raw[i] >> 6) & 0x7f);
+		d[3+i*2] = (uint8_t)((sim.raw[i] & 0x3f) << 2);
+	}
+	if (busy)
+		sim.stats.busy_reads++;
+}
+
+static void read_data_yas537(uint8_t *d)
+{
+	int busy;
+	int i;
+	/* continuous mode: every read sees a fresh conversion */
+	if (sim.continuous && sim.conversion_end <= sim.now)
+		start_conversion();
+	busy = sim.now < sim.conversion_end && !sim.continuous;
+	d[0] = (uint8_t)(YAS537_TEMPERATURE >> 8);
+	d[1] = (uint8_t)(YAS537_TEMPERATURE & 0xff);
+	for (i = 0; i < 3; i++) {
+		d[2+i*2] = (uint8_t)(sim.raw[i] >> 8);
+		d[3+i*2] = (uint8_t)(sim.raw[i] & 0xff);
+	}
+	d[2] = (uint8_t)((busy << 7) | (d[2] & 0x3f));
+	if (busy)
+		sim.stats.busy_reads++;
+}
+
+static void write_reg(uint8_t addr, uint8_t data)
+{
+	sim.reg[addr] = data;
+	if (sim.chip == YAS_SIM_YAS532) {
+		switch (addr) {
+		case YAS532_REG_RCOILR:
+			sim.stats.coil_resets++;
+			memset(sim.magnetize, 0, sizeof(sim.magnetize));
+			break;
+		case YAS532_REG_CMDR:
+			if (data & 0x01)
+				start_conversion();
+			break;
+		default:
+			break;
+		}
+		return;
+	}
+	switch (addr) {
+	case YAS537_REG_CMDR:
+		if (data & 0x01) {
+			sim.continuous = !!(data & 0x20);
+			start_conversion();
+		}
+		break;
+	case YAS537_REG_CONFR:
+		if (data & 0x08) {
+			sim.stats.coil_resets++;
+			memset(sim.magnetize, 0, sizeof(sim.magnetize));
+		}
+		break;
+	case YAS537_REG_SRSTR:
+		if (data & 0x02) {
+			sim.stats.soft_resets++;
+			sim.continuous = 0;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static int sim_device_open(int32_t type)
+{
+	(void) type;
+	if (sim.open)
+		return -1;
+	sim.open = 1;
+	return 0;
+}
+
+static int sim_device_close(int32_t type)
+{
+	(void) type;
+	if (!sim.open)
+		return -1;
+	sim.open = 0;
+	return 0;
+}
+
+static int sim_device_write(int32_t type, uint8_t addr, const uint8_t *buf,
+		int len)
+{
+	int i;
+	(void) type;
+	if (!sim.open || len <= 0)
+		return -1;
+	sim.stats.writes++;
+	sim.stats.write_bytes += (uint32_t)len;
+	sim.stats.bus_us += bus_time(len);
+	sim.now += bus_time(len);
+	for (i = 0; i < len; i++)
+		write_reg((uint8_t)(addr + i), buf[i]);
+	return 0;
+}
+
+static int sim_device_read(int32_t type, uint8_t addr, uint8_t *buf, int len)
+{
+	uint8_t data[8];
+	int i;
+	(void) type;
+	if (!sim.open || len <= 0)
+		return -1;
+	sim.stats.reads++;
+	sim.stats.read_bytes += (uint32_t)len;
+	sim.stats.bus_us += bus_time(len);
+	sim.now += bus_time(len);
+	if (sim.chip == YAS_SIM_YAS532 && addr == YAS532_REG_DATAR) {
+		read_data_yas532(data);
+		for (i = 0; i < len; i++)
+			buf[i] = i < 8 ? data[i] : 0;
+		return 0;
+	}
+	if (sim.chip == YAS_SIM_YAS537 && addr == YAS537_REG_DATAR) {
+		read_data_yas537(data);
+		for (i = 0; i < len; i++)
+			buf[i] = i < 8 ? data[i] : 0;
+		return 0;
+	}
+	for (i = 0; i < len; i++)
+		buf[i] = sim.reg[(uint8_t)(addr + i)];
+	return 0;
+}
+
+static void sim_usleep(int usec)
+{
+	if (usec <= 0)
+		return;
+	sim.stats.sleep_us += (uint64_t)usec;
+	sim.now += (uint64_t)usec;
+}
+
+static uint32_t sim_current_time(void)
+{
+	return (uint32_t)(sim.now / 1000);
+}
+
+/**
+ * Resets the model to power-on state and loads the default script
+ * @param[in] chip #YAS_SIM_YAS532 or #YAS_SIM_YAS537
+ * @retval #YAS_NO_ERROR Success
+ * @retval #YAS_ERROR_ARG Unknown chip
+ */
+int yas_sim_init(int chip)
+{
+	memset(&sim, 0, sizeof(sim));
+	sim.seed = 1;
+	if (chip == YAS_SIM_YAS532) {
+		sim.reg[YAS532_REG_DEVID] = YAS532_DEVICE_ID;
+		memcpy(&sim.reg[YAS532_REG_CALR], yas532_calr,
+				sizeof(yas532_calr));
+	} else if (chip == YAS_SIM_YAS537) {
+		sim.reg[YAS537_REG_DIDR] = YAS537_DEVICE_ID;
+		memcpy(&sim.reg[YAS537_REG_CALR], yas537_calr,
+				sizeof(yas537_calr));
+	} else
+		return YAS_ERROR_ARG;
+	sim.chip = chip;
+	yas_sim_set_script(default_script,
+			sizeof(default_script) / sizeof(default_script[0]));
+	return YAS_NO_ERROR;
+}
+
+/**
+ * Replaces the script. Events must be sorted by time.
+ */
+void yas_sim_set_script(const struct yas_sim_event *ev, int num)
+{
+	if (YAS_SIM_MAX_EVENTS < num)
+		num = YAS_SIM_MAX_EVENTS;
+	memcpy(sim.script, ev, sizeof(*ev) * (size_t)num);
+	sim.script_num = num;
+	sim.script_pos = 0;
+	run_script();
+}
+
+/**
+ * Loads a script file. Each line is "<msec> <command> <args>", where
+ * command is one of
+ *   field <x> <y> <z>		field in nT, sensor frame
+ *   rotate <period>		rotate the field about z, 0 stops
+ *   overflow <n>		force the next n conversions to overflow
+ *   magnetize <x> <y> <z>	ADC offset that lasts until a coil reset
+ *   noise <n>			noise amplitude in ADC codes
+ * Lines starting with '#' are ignored.
+ * @retval #YAS_NO_ERROR Success
+ * @retval #YAS_ERROR_ARG The file cannot be read or has a bad line
+ */
+int yas_sim_load_script(const char *path)
+{
+	static const char * const names[] = {
+		"field", "rotate", "overflow", "magnetize", "noise",
+	};
+	struct yas_sim_event ev[YAS_SIM_MAX_EVENTS];
+	char line[256], cmd[32];
+	unsigned int time;
+	int n, num = 0, i, ln = 0;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return YAS_ERROR_ARG;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		ln++;
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		if (YAS_SIM_MAX_EVENTS <= num)
+			break;
+		memset(&ev[num], 0, sizeof(ev[num]));
+		n = sscanf(line, "%u %31s %d %d %d", &time, cmd,
+				&ev[num].v[0], &ev[num].v[1], &ev[num].v[2]);
+		if (n < 3)
+			goto bad_line;
+		ev[num].time = time;
+		ev[num].type = -1;
+		for (i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++)
+			if (strcmp(cmd, names[i]) == 0)
+				ev[num].type = i;
+		if (ev[num].type < 0)
+			goto bad_line;
+		if (0 < num && ev[num].time < ev[num-1].time)
+			goto bad_line;
+		num++;
+	}
+	fclose(fp);
+	yas_sim_set_script(ev, num);
+	return YAS_NO_ERROR;
+
+bad_line:
+	fprintf(stderr, "%s:%d: bad line\n", path, ln);
+	fclose(fp);
+	return YAS_ERROR_ARG;
+}
+
+/**
+ * Lets time pass without any bus activity, e.g. between two measure() calls
+ */
+void yas_sim_advance(uint32_t usec)
+{
+	sim.now += usec;
+	run_script();
+}
+
+/**
+ * @return The simulated time in milli-seconds
+ */
+uint32_t yas_sim_time(void)
+{
+	return sim_current_time();
+}
+
+/**
+ * @return The simulated time in micro-seconds
+ */
+uint64_t yas_sim_time_us(void)
+{
+	return sim.now;
+}
+
+/**
+ * Obtains the field applied right now, in nT and in the sensor frame
+ */
+void yas_sim_get_field(int32_t *field)
+{
+	field_at(sim.now, field);
+}
+
+void yas_sim_get_stats(struct yas_sim_stats *stats)
+{
+	*stats = sim.stats;
+}
+
+/**
+ * Fills in the callbacks to pass to yas_mag_driver_init()
+ */
+void yas_sim_get_callback(struct yas_driver_callback *cbk)
+{
+	cbk->device_open = sim_device_open;
+	cbk->device_close = sim_device_close;
+	cbk->device_write = sim_device_write;
+	cbk->device_read = sim_device_read;
+	cbk->usleep = sim_usleep;
+	cbk->current_time = sim_current_time;
+}
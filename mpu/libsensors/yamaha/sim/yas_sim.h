@@ -0,0 +1,60 @@
+/*
+ * Register level simulation of the YAS532 and YAS537 magnetometers
+ *
+ * The MS-x drivers do all of their I/O through struct yas_driver_callback,
+ * so they can be linked into a host program and run against this model
+ * instead of a real I2C bus.  The model keeps a register file, converts a
+ * scripted magnetic field into raw ADC codes the same way the driver
+ * converts them back, and counts every bus transaction.
+ *
+ * Time is virtual: the usleep callback only advances the simulated clock,
+ * and current_time reports that clock in milli-seconds.
+ */
+
+#ifndef __YAS_SIM_H__
+#define __YAS_SIM_H__
+
+#include "yas.h"
+
+#define YAS_SIM_YAS532			(532)
+#define YAS_SIM_YAS537			(537)
+
+#define YAS_SIM_MAX_EVENTS		(256)
+
+#define YAS_SIM_EVENT_FIELD		(0) /*!< v: field in nT */
+#define YAS_SIM_EVENT_ROTATE		(1) /*!< v[0]: period in msec, 0: stop */
+#define YAS_SIM_EVENT_OVERFLOW		(2) /*!< v[0]: number of conversions */
+#define YAS_SIM_EVENT_MAGNETIZE		(3) /*!< v: offset in ADC codes */
+#define YAS_SIM_EVENT_NOISE		(4) /*!< v[0]: noise in ADC codes */
+
+struct yas_sim_event {
+	uint32_t time;		/*!< msec from the start of the script */
+	int type;		/*!< YAS_SIM_EVENT_xxx */
+	int32_t v[3];
+};
+
+struct yas_sim_stats {
+	uint32_t reads;		/*!< device_read calls */
+	uint32_t read_bytes;
+	uint32_t writes;	/*!< device_write calls */
+	uint32_t write_bytes;
+	uint32_t conversions;	/*!< measurements started */
+	uint32_t busy_reads;	/*!< data reads before conversion end */
+	uint32_t coil_resets;	/*!< RCOIL (532) or CONFR.RCOIL (537) */
+	uint32_t soft_resets;	/*!< SRSTR (537) */
+	uint32_t overflows;	/*!< conversions that returned overflow */
+	uint64_t sleep_us;	/*!< total time passed to usleep */
+	uint64_t bus_us;	/*!< total time spent on the bus */
+};
+
+int yas_sim_init(int chip);
+int yas_sim_load_script(const char *path);
+void yas_sim_set_script(const struct yas_sim_event *ev, int num);
+void yas_sim_advance(uint32_t usec);
+uint32_t yas_sim_time(void);
+uint64_t yas_sim_time_us(void);
+void yas_sim_get_field(int32_t *field);
+void yas_sim_get_stats(struct yas_sim_stats *stats);
+void yas_sim_get_callback(struct yas_driver_callback *cbk);
+
+#endif
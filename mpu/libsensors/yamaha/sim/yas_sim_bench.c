@@ -0,0 +1,194 @@
+/*
+ * Runs the YAS532 or YAS537 driver against the register level model and
+ * reports measure() throughput, bus traffic per sample and accuracy.
+ *
+ * usage: yas532_sim|yas537_sim [-n samples] [-d delay_ms] [-a average]
+ *                              [-f script] [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "yas_sim.h"
+
+#if YAS_MAG_DRIVER == YAS_MAG_DRIVER_YAS532 \
+	|| YAS_MAG_DRIVER == YAS_MAG_DRIVER_YAS533
+#define SIM_CHIP		YAS_SIM_YAS532
+#define SIM_NAME		"yas532"
+#elif YAS_MAG_DRIVER == YAS_MAG_DRIVER_YAS537
+#define SIM_CHIP		YAS_SIM_YAS537
+#define SIM_NAME		"yas537"
+#else
+#error "yas_sim supports YAS532/533 and YAS537 only"
+#endif
+
+/* low digit of each axis carries the driver's overflow/invalid flags */
+#define FLAG_DIGIT(v)		((((v) % 10) + 10) % 10)
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-n samples] [-d delay_ms] [-a average] "
+		"[-f script] [-v]\n"
+		"  -n  number of measure() calls (default 10000)\n"
+		"  -d  sampling period in msec (default %d)\n"
+		"  -a  YAS537 averaging, 0:8 ... 5:256 samples\n"
+		"  -f  field script, see yas_sim.c\n"
+		"  -v  print every sample as CSV\n",
+		name, YAS_DEFAULT_SENSOR_DELAY);
+}
+
+int main(int argc, char **argv)
+{
+	struct yas_mag_driver drv;
+	struct yas_sim_stats st, base;
+	struct yas_data data;
+	const char *script = NULL;
+	int samples = 10000, delay = YAS_DEFAULT_SENSOR_DELAY, average = -1;
+	int verbose = 0, opt, i, j, rt;
+	int ok = 0, flagged = 0, errors = 0;
+	int32_t field[3];
+	uint64_t t0, elapsed, err_sum = 0;
+	double n;
+
+	while ((opt = getopt(argc, argv, "n:d:a:f:vh")) != -1) {
+		switch (opt) {
+		case 'n':
+			samples = atoi(optarg);
+			break;
+		case 'd':
+			delay = atoi(optarg);
+			break;
+		case 'a':
+			average = atoi(optarg);
+			break;
+		case 'f':
+			script = optarg;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (samples <= 0 || delay < 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	yas_sim_init(SIM_CHIP);
+	if (script != NULL && yas_sim_load_script(script) < 0) {
+		fprintf(stderr, "cannot load %s\n", script);
+		return 1;
+	}
+	memset(&drv, 0, sizeof(drv));
+	yas_sim_get_callback(&drv.callback);
+	rt = yas_mag_driver_init(&drv);
+	if (rt == YAS_NO_ERROR)
+		rt = drv.init();
+	if (rt == YAS_NO_ERROR)
+		rt = drv.set_delay(delay);
+	if (rt == YAS_NO_ERROR)
+		rt = drv.set_enable(1);
+#if SIM_CHIP == YAS_SIM_YAS537
+	if (rt == YAS_NO_ERROR && 0 <= average) {
+		int8_t avr = (int8_t)average;
+		rt = drv.ext(YAS537_SET_AVERAGE_SAMPLE, &avr);
+	}
+#else
+	if (0 <= average)
+		fprintf(stderr, "-a is ignored on " SIM_NAME "\n");
+#endif
+	if (rt != YAS_NO_ERROR) {
+		fprintf(stderr, "driver setup failed (%d)\n", rt);
+		return 1;
+	}
+#if SIM_CHIP == YAS_SIM_YAS537
+	if (average < 0) {
+		int8_t avr = 0;
+		drv.ext(YAS537_GET_AVERAGE_SAMPLE, &avr);
+		average = avr;
+	}
+#endif
+
+	/* only the measure() calls are counted from here on */
+	yas_sim_get_stats(&base);
+
+	if (verbose)
+		printf("time,x,y,z,fx,fy,fz,ret\n");
+	elapsed = 0;
+	for (i = 0; i < samples; i++) {
+		yas_sim_advance((uint32_t)delay * 1000);
+		t0 = now_ns();
+		rt = drv.measure(&data, 1);
+		elapsed += now_ns() - t0;
+		yas_sim_get_field(field);
+		if (verbose)
+			printf("%u,%d,%d,%d,%d,%d,%d,%d\n", yas_sim_time(),
+					data.xyz.v[0], data.xyz.v[1],
+					data.xyz.v[2], field[0], field[1],
+					field[2], rt);
+		if (rt < 0) {
+			errors++;
+			continue;
+		}
+		if (FLAG_DIGIT(data.xyz.v[0]) || FLAG_DIGIT(data.xyz.v[1])
+				|| FLAG_DIGIT(data.xyz.v[2])) {
+			flagged++;
+			continue;
+		}
+		ok++;
+		for (j = 0; j < 3; j++)
+			err_sum += (uint64_t)abs(data.xyz.v[j] - field[j]);
+	}
+	yas_sim_get_stats(&st);
+	st.reads -= base.reads;
+	st.read_bytes -= base.read_bytes;
+	st.writes -= base.writes;
+	st.write_bytes -= base.write_bytes;
+	st.conversions -= base.conversions;
+	st.busy_reads -= base.busy_reads;
+	st.coil_resets -= base.coil_resets;
+	st.soft_resets -= base.soft_resets;
+	st.overflows -= base.overflows;
+	st.sleep_us -= base.sleep_us;
+	st.bus_us -= base.bus_us;
+	drv.term();
+
+	n = (double)samples;
+	printf(SIM_NAME " sim: %d samples, delay %d ms", samples, delay);
+#if SIM_CHIP == YAS_SIM_YAS537
+	printf(", average %d", average);
+#endif
+	printf("\n");
+	printf("measure():       %.0f calls/s (%.3f us/call)\n",
+			elapsed ? n * 1e9 / (double)elapsed : 0.0,
+			(double)elapsed / n / 1000.0);
+	printf("bus per sample:  %.2f reads (%.2f bytes), "
+			"%.2f writes (%.2f bytes), %.1f us\n",
+			st.reads / n, st.read_bytes / n,
+			st.writes / n, st.write_bytes / n, st.bus_us / n);
+	printf("sleep per sample: %.1f us, conversions %.2f, busy reads %u\n",
+			st.sleep_us / n, st.conversions / n, st.busy_reads);
+	printf("events:          %u overflows, %u coil resets, "
+			"%u soft resets\n",
+			st.overflows, st.coil_resets, st.soft_resets);
+	printf("samples:         %d ok, %d flagged, %d errors\n",
+			ok, flagged, errors);
+	if (ok)
+		printf("mean abs error:  %.1f nT\n",
+				(double)err_sum / (3.0 * ok));
+	return 0;
+}
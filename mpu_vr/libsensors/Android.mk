@@ -206,6 +206,12 @@ else    # eng, userdebug & user builds
 LOCAL_SRC_FILES := sensors_mpl.cpp
 endif   # eng, userdebug & user builds
 LOCAL_SRC_FILES += SamsungSensorBase.cpp LightSensor.cpp
+LOCAL_SRC_FILES += ../../common/debug_config.c
+LOCAL_SRC_FILES += ../../common/sensor_log.c
+LOCAL_SRC_FILES += ../../common/sensor_stats.c
+LOCAL_SRC_FILES += ../../common/sensor_trace.c
+LOCAL_SRC_FILES += ../../common/sysfs_root.c
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../../common
 LOCAL_SHARED_LIBRARIES := libinvensense_hal
 LOCAL_SHARED_LIBRARIES += libcutils
 LOCAL_SHARED_LIBRARIES += libutils
@@ -298,9 +298,7 @@ MPLSensor::MPLSensor(CompassSensor *compass, int (*m_pt2AccelCalLoadFunc)(long *
                          mAccelAccuracy(0),
                          mCompassAccuracy(0),
                          mSampleCount(0),
-                         dmp_orient_fd(-1),
                          mDmpOrientationEnabled(0),
-                         dmp_sign_motion_fd(-1),
                          mDmpSignificantMotionEnabled(0),
                          mEnabled(0),
                          mOldEnabledMask(0),
@@ -328,6 +326,9 @@ MPLSensor::MPLSensor(CompassSensor *compass, int (*m_pt2AccelCalLoadFunc)(long *
     FILE *fptr;
 
     mCompassSensor = compass;
+    /* the orientation changes with every event, SMD always reads 1 */
+    sysfs_event_init(&mDmpOrientEvent, "dmpOrient", 1);
+    sysfs_event_init(&mDmpSignMotionEvent, "dmp_sign_motion", 0);
 
     LOGV_IF(EXTRA_VERBOSE,
             "HAL:MPLSensor constructor : NumSensors = %d", NumSensors);
@@ -336,6 +337,7 @@ MPLSensor::MPLSensor(CompassSensor *compass, int (*m_pt2AccelCalLoadFunc)(long *
     pthread_mutex_init(&mHALMutex, NULL);
     memset(mGyroOrientation, 0, sizeof(mGyroOrientation));
     memset(mAccelOrientation, 0, sizeof(mAccelOrientation));
+    mTraceBuiltCount = 0;
 
     /* setup sysfs paths */
     inv_init_sysfs_attributes();
@@ -431,12 +433,7 @@ MPLSensor::MPLSensor(CompassSensor *compass, int (*m_pt2AccelCalLoadFunc)(long *
     }
 
     if (!isMpu3050()) {
-		dmp_sign_motion_fd = open(mpu.event_smd, O_RDONLY | O_NONBLOCK);
-		if (dmp_sign_motion_fd < 0) {
-			LOGE("HAL:ERR couldn't open dmp_sign_motion node");
-		} else {
-			LOGV_IF(PROCESS_VERBOSE, "HAL:dmp_sign_motion_fd opened : %d", dmp_sign_motion_fd);
-		}
+		sysfs_event_open(&mDmpSignMotionEvent, mpu.event_smd);
 	}
 
     /* initialize sensor data */
@@ -921,6 +918,7 @@ MPLSensor::~MPLSensor()
 
     //if (isDmpDisplayOrientationOn()) {
         closeDmpOrientFd();
+        sysfs_event_close(&mDmpSignMotionEvent);
 
         if (accel_x_offset_fd > 0) {
             close(accel_x_offset_fd);
@@ -2444,6 +2442,10 @@ int MPLSensor::readEvents(sensors_event_t* data, int count)
     VFUNC_LOG;
 
     inv_execute_on_data();
+    for (int i = 0; i < mTraceBuiltCount; i++) {
+        SENSOR_TRACE_MARK(TRACE_FUSION, -1, mTraceBuilt[i]);
+    }
+    mTraceBuiltCount = 0;
 
     int numEventReceived = 0;
 
@@ -2481,6 +2483,8 @@ int MPLSensor::readEvents(sensors_event_t* data, int count)
             mPendingMask |= (1 << i);
 
             if (update && (count > 0)) {
+                SENSOR_TRACE_MARK(TRACE_OUTPUT, mPendingEvents[i].sensor,
+                                  mPendingEvents[i].timestamp);
                 *data++ = mPendingEvents[i];
                 count--;
                 numEventReceived++;
@@ -2491,26 +2495,6 @@ int MPLSensor::readEvents(sensors_event_t* data, int count)
     return numEventReceived;
 }
 
-#define NSEC_PER_SEC            1000000000
-
-static inline int64_t timespec_to_ns(const struct timespec *ts)
-{
-	return ((int64_t) ts->tv_sec * NSEC_PER_SEC) + ts->tv_nsec;
-}
-
-static int64_t get_time_ns(void)
-{
-	struct timespec ts;
-	clock_gettime(CLOCK_MONOTONIC, &ts);
-	return timespec_to_ns(&ts);
-}
-
-static int64_t tm_min=0;
-static int64_t tm_max=0;
-static int64_t tm_sum=0;
-static int64_t tm_last_print=0;
-static int64_t tm_count=0;
-
 // collect data for MPL (but NOT sensor service currently), from driver layer
 void MPLSensor::buildMpuEvent(void)
 {
@@ -2609,30 +2593,14 @@ void MPLSensor::buildMpuEvent(void)
         mask |= 1 << MagneticField;
     }
 
-    int64_t tm_cur = get_time_ns();
-    int64_t tm_delta = tm_cur - mSensorTimestamp;
-    if (tm_min==0 && tm_max==0)
-        tm_min = tm_max = tm_delta;
-    else if (tm_delta < tm_min)
-        tm_min = tm_delta;
-    else if (tm_delta > tm_max)
-        tm_max = tm_delta;
-    tm_sum += tm_delta;
-    tm_count++;
-    
-    if ((tm_cur-tm_last_print) > 1000000000) {
-        LOGD_IF(DEBUG_DELAY, "HAL Time: [%lld] %lld,%lld,%lld\n", mSensorTimestamp, tm_min, (tm_sum/tm_count), tm_max);
-        tm_last_print = tm_cur;
-        tm_min = tm_max = tm_count = tm_sum = 0;
-    }
-
-//    int64_t n = get_time_ns();
-//    ALOGD("MPU HAL: tm=%lld, %lld, %lld\n", mSensorTimestamp, n, n-mSensorTimestamp);
+    SENSOR_TRACE_MARK(TRACE_READ, -1, mSensorTimestamp);
+    traceBuilt(mSensorTimestamp);
 
     if (mCompassSensor->isIntegrated()) {
         mCompassTimestamp = mSensorTimestamp;
     }
 
+    SENSOR_TRACE_MARK(TRACE_BUILD, -1, mSensorTimestamp);
     if (mask & (1 << Gyro)) {
         // send down temperature every 0.5 seconds
         // with timestamp measured in "driver" layer
@@ -2721,8 +2689,6 @@ void MPLSensor::buildMpuEvent(void)
 /* use for both MPUxxxx and third party compass */
 void MPLSensor::buildCompassEvent(void)
 {
-    VHANDLER_LOG;
-
     int done = 0;
 
     // pthread_mutex_lock(&mMplMutex);
@@ -2739,11 +2705,15 @@ void MPLSensor::buildCompassEvent(void)
     }
     if (done > 0) {
         int status = 0;
+
+        SENSOR_TRACE_MARK(TRACE_READ, ID_M, mCompassTimestamp);
+        traceBuilt(mCompassTimestamp);
         if (mCompassSensor->providesCalibration()) {
             status = mCompassSensor->getAccuracy();
             status |= INV_CALIBRATED;
         }
         if (mLocalSensorMask & INV_THREE_AXIS_COMPASS) {
+            SENSOR_TRACE_MARK(TRACE_BUILD, ID_M, mCompassTimestamp);
             inv_build_compass(mCachedCompassData, status,
                               mCompassTimestamp);
             LOGV_IF(INPUT_DATA,
@@ -2919,28 +2889,21 @@ int MPLSensor::openDmpOrientFd(void)
 {
     VFUNC_LOG;
 
-    if (!isDmpDisplayOrientationOn() || dmp_orient_fd >= 0) {
+    if (!isDmpDisplayOrientationOn() || mDmpOrientEvent.fd >= 0) {
         LOGV_IF(PROCESS_VERBOSE,
                 "HAL:DMP display orientation disabled or file desc opened");
         return 0;
     }
 
-    dmp_orient_fd = open(mpu.event_display_orientation, O_RDONLY| O_NONBLOCK);
-    if (dmp_orient_fd < 0) {
-        LOGE("HAL:ERR couldn't open dmpOrient node");
+    if (sysfs_event_open(&mDmpOrientEvent, mpu.event_display_orientation) < 0)
         return -1;
-    } else {
-        LOGV_IF(PROCESS_VERBOSE,
-                "HAL:dmp_orient_fd opened : %d", dmp_orient_fd);
-        return 0;
-    }
+    return 0;
 }
 
 int MPLSensor::closeDmpOrientFd(void)
 {
     VFUNC_LOG;
-    if (dmp_orient_fd >= 0)
-        close(dmp_orient_fd);
+    sysfs_event_close(&mDmpOrientEvent);
     return 0;
 }
 
@@ -2956,20 +2919,11 @@ int MPLSensor::readDmpOrientEvents(sensors_event_t* data, int count)
 {
     VFUNC_LOG;
 
-    char dummy[4];
-    int screen_orientation = 0;
-    FILE *fp;
+    long screen_orientation = 0;
 
-    fp = fopen(mpu.event_display_orientation, "r");
-    if (fp == NULL) {
-        LOGE("HAL:cannot open event_display_orientation");
+    /* the pread also re-arms the notification */
+    if (sysfs_event_read(&mDmpOrientEvent, &screen_orientation) < 0)
         return 0;
-    } else {
-        if (fscanf(fp, "%d\n", &screen_orientation) < 0 || fclose(fp) < 0)
-        {
-            LOGE("HAL:cannot write event_display_orientation");
-        }
-    }
 
     int numEventReceived = 0;
 
@@ -2996,9 +2950,7 @@ int MPLSensor::readDmpOrientEvents(sensors_event_t* data, int count)
         numEventReceived++;
     }
 
-    // read dummy data per driver's request
     dmpOrientHandler(screen_orientation);
-    read(dmp_orient_fd, dummy, 4);
 
     return numEventReceived;
 }
@@ -3008,8 +2960,8 @@ int MPLSensor::getDmpOrientFd(void)
     VFUNC_LOG;
 
     LOGV_IF(EXTRA_VERBOSE,
-            "MPLSensor::getDmpOrientFd returning %d", dmp_orient_fd);
-    return dmp_orient_fd;
+            "MPLSensor::getDmpOrientFd returning %d", mDmpOrientEvent.fd);
+    return mDmpOrientEvent.fd;
 
 }
 
@@ -3876,32 +3828,23 @@ int MPLSensor::getDmpSignificantMotionFd()
 {
     LOGV_IF(EXTRA_VERBOSE,
             "MPLSensor::getDmpSignificantMotionFd returning %d",
-            dmp_sign_motion_fd);
-    return dmp_sign_motion_fd;
+            mDmpSignMotionEvent.fd);
+    return mDmpSignMotionEvent.fd;
 }
 
 int MPLSensor::readDmpSignificantMotionEvents(sensors_event_t* data, int count) {
     VFUNC_LOG;
 
     int res = 0;
-    char dummy[4];
-    int significantMotion;
-    FILE *fp;
+    long significantMotion;
     int sensors = mEnabled;
     int numEventReceived = 0;
     int update = 0;
 
-    /* Technically this step is not necessary for now  */
-    /* In the future, we may have meaningful values */
-    fp = fopen(mpu.event_smd, "r");
-    if (fp == NULL) {
-        LOGE("HAL:cannot open event_smd");
+    /* Technically the value is not needed for now, but the pread */
+    /* re-arms the notification. In the future, we may have meaningful values */
+    if (sysfs_event_read(&mDmpSignMotionEvent, &significantMotion) < 0)
         return 0;
-    } else {
-        if (fscanf(fp, "%d\n", &significantMotion) < 0 || fclose(fp) < 0) {
-            LOGE("HAL:cannot read event_smd");
-        }
-    }
 
     if(mDmpSignificantMotionEnabled && count > 0) {
        /* By implementation, smd is disabled once an event is triggered */
@@ -3940,9 +3883,6 @@ int MPLSensor::readDmpSignificantMotionEvents(sensors_event_t* data, int count)
         }
     }
 
-    // read dummy data per driver's request
-    read(dmp_sign_motion_fd, dummy, 4);
-
     return numEventReceived;
 }
 
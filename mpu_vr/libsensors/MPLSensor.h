@@ -28,6 +28,8 @@
 #include "sensors.h"
 #include "SensorBase.h"
 #include "InputEventReader.h"
+#include "MPLSupport.h"
+#include "sensor_trace.h"
 
 #ifndef INVENSENSE_COMPASS_CAL
 #pragma message("unified HAL for AKM")
@@ -265,10 +267,10 @@ protected:
     int accel_y_offset_fd;
     int accel_z_offset_fd;
 
-    int dmp_orient_fd;
+    struct sysfs_event mDmpOrientEvent;
     int mDmpOrientationEnabled;
 
-    int dmp_sign_motion_fd;
+    struct sysfs_event mDmpSignMotionEvent;
     int mDmpSignificantMotionEnabled;
 
     uint32_t mEnabled;
@@ -308,6 +310,15 @@ protected:
     int64_t mSensorTimestamp;
     int64_t mCompassTimestamp;
 
+    /* samples built since the last inv_execute_on_data(), for the fusion
+       trace mark; mpu and external compass */
+    int64_t mTraceBuilt[2];
+    int mTraceBuiltCount;
+    void traceBuilt(int64_t ts) {
+        if (g_sensor_trace_mode != SENSOR_TRACE_OFF && mTraceBuiltCount < 2)
+            mTraceBuilt[mTraceBuiltCount++] = ts;
+    }
+
     struct sysfs_attrbs {
        char *chip_enable;
        char *power_state;
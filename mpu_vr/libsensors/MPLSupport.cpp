@@ -19,7 +19,9 @@
 #include <stdio.h>
 #include "log.h"
 #include "SensorBase.h"
+#include <errno.h>
 #include <fcntl.h>
+#include <unistd.h>
 
 #include "ml_sysfs_helper.h"
 
@@ -186,6 +188,102 @@ int write_sysfs_longlong(char *filename, int64_t var)
     return -res;
 }
 
+/**
+ *  Parse a decimal integer as printed by a sysfs show() handler.
+ *  Leading blanks and a trailing newline are accepted.
+ *  @return 0 on success, -EINVAL if @a buf holds no number.
+ */
+int parse_sysfs_long(const char *buf, int len, long *value)
+{
+    const char *p = buf, *end = buf + len;
+    unsigned long v = 0;
+    int neg = 0;
+
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    if (p < end && (*p == '-' || *p == '+'))
+        neg = (*p++ == '-');
+    if (p == end || *p < '0' || *p > '9')
+        return -EINVAL;
+    while (p < end && *p >= '0' && *p <= '9')
+        v = v * 10 + (unsigned long)(*p++ - '0');
+
+    *value = neg ? -(long)v : (long)v;
+    return 0;
+}
+
+void sysfs_event_init(struct sysfs_event *ev, const char *name, int edge)
+{
+    memset(ev, 0, sizeof(*ev));
+    ev->fd = -1;
+    ev->edge = edge;
+    ev->name = name;
+}
+
+int sysfs_event_open(struct sysfs_event *ev, const char *path)
+{
+    VFUNC_LOG;
+
+    if (ev->fd >= 0)
+        return 0;
+
+    ev->fd = open(path, O_RDONLY | O_NONBLOCK);
+    if (ev->fd < 0) {
+        LOGE("HAL:ERR couldn't open %s node", ev->name);
+        return -errno;
+    }
+    /* an initial read arms the first notification */
+    pread(ev->fd, ev->buf, sizeof(ev->buf) - 1, 0);
+    ev->wakeups = ev->reads = ev->missed = 0;
+    LOGV_IF(PROCESS_VERBOSE, "HAL:%s fd opened : %d", ev->name, ev->fd);
+    return 0;
+}
+
+void sysfs_event_close(struct sysfs_event *ev)
+{
+    VFUNC_LOG;
+
+    if (ev->fd >= 0) {
+        LOGV_IF(PROCESS_VERBOSE,
+                "HAL:%s closed, %lu wakeups %lu reads %lu missed",
+                ev->name, ev->wakeups, ev->reads, ev->missed);
+        close(ev->fd);
+    }
+    ev->fd = -1;
+}
+
+/**
+ *  Consume one POLLPRI wakeup. Must be called once per wakeup.
+ *  @return 0 and the attribute value, or a negative errno; the
+ *          notification is re-armed in both cases.
+ */
+int sysfs_event_read(struct sysfs_event *ev, long *value)
+{
+    VHANDLER_LOG;
+
+    ssize_t count;
+    long v;
+
+    ev->wakeups++;
+    count = pread(ev->fd, ev->buf, sizeof(ev->buf) - 1, 0);
+    if (count < 1 || parse_sysfs_long(ev->buf, count, &v) < 0) {
+        ev->missed++;
+        LOGW("HAL:%s unreadable, %lu of %lu events missed",
+             ev->name, ev->missed, ev->wakeups);
+        return count < 0 ? -errno : -EINVAL;
+    }
+
+    if (ev->edge && ev->reads && v == ev->value) {
+        ev->missed++;
+        LOGW("HAL:%s events merged, %lu missed in %lu wakeups",
+             ev->name, ev->missed, ev->wakeups);
+    }
+    ev->reads++;
+    ev->value = v;
+    *value = v;
+    return 0;
+}
+
 int fill_dev_full_name_by_prefix(const char* dev_prefix, 
                                  char *dev_full_name, int len)
 {
@@ -19,6 +19,27 @@
 
 #include <stdint.h>
 
+#define SYSFS_EVENT_BUF_LEN     (24)
+
+/*
+ * A sysfs attribute signalled with sysfs_notify() and polled for POLLPRI.
+ * The fd stays open for the life of the reader; every wakeup is consumed
+ * with a single pread() at offset 0, which also re-arms the notification.
+ * A notification that lands before the previous one was read is merged
+ * by sysfs, so for attributes whose value changes on every event (edge)
+ * an unchanged value is counted as a missed event.
+ */
+struct sysfs_event {
+    int fd;
+    int edge;
+    const char *name;
+    long value;
+    unsigned long wakeups;
+    unsigned long reads;
+    unsigned long missed;
+    char buf[SYSFS_EVENT_BUF_LEN];
+};
+
 int inv_read_data(char *fname, long *data);
 int read_attribute_sensor(int fd, char* data, unsigned int size);
 int enable_sysfs_sensor(int fd, int en);
@@ -27,6 +48,11 @@ int write_attribute_sensor_continuous(int fd, long data);
 int read_sysfs_int(char*, int*);
 int write_sysfs_int(char*, int);
 int write_sysfs_longlong(char*, long long);
+int parse_sysfs_long(const char *buf, int len, long *value);
+void sysfs_event_init(struct sysfs_event *ev, const char *name, int edge);
+int sysfs_event_open(struct sysfs_event *ev, const char *path);
+void sysfs_event_close(struct sysfs_event *ev);
+int sysfs_event_read(struct sysfs_event *ev, long *value);
 int fill_dev_full_name_by_prefix(const char* dev_prefix,
                                  char* dev_full_name, int len);
 
@@ -42,7 +42,6 @@ bool SensorBase::ENG_VERBOSE = false;
 bool SensorBase::INPUT_DATA = false;
 bool SensorBase::HANDLER_DATA = false;
 bool SensorBase::DEBUG_BATCHING = false;
-bool SensorBase::DEBUG_DELAY = false;
 
 SensorBase::SensorBase(const char* dev_name,
                        const char* data_name) 
@@ -70,7 +70,8 @@ public:
     static bool INPUT_DATA;        /* log the data input from the events */
     static bool HANDLER_DATA;      /* log the data fetched from the handlers */
     static bool DEBUG_BATCHING;    /* log the data for debugging batching */
-    static bool DEBUG_DELAY;       /* log the data delay time */
+    /* delivery rate, jitter and latency are kept by sensor_stats, see
+       common/sensor_stats.h */
 
 protected:
     const char *dev_name;
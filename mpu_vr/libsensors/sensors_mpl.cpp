@@ -32,6 +32,9 @@
 
 #include "sensors.h"
 #include "MPLSensor.h"
+#include "debug_config.h"
+#include "sensor_stats.h"
+#include "sensor_trace.h"
 
 /*****************************************************************************/
 /* The SENSORS Module */
@@ -153,6 +156,9 @@ sensors_poll_context_t::sensors_poll_context_t() {
 //    sSensorList[LOCAL_SENSORS-1] = {"Light sensor", "Invensense", 1, SENSORS_LIGHT_HANDLE, SENSOR_TYPE_LIGHT, 10240.0f, 1.0f, 0.5f, 20000, {}};
     sensors += 1;
 
+    for (int i = 0; i < sensors; i++)
+        sensor_stats_config(sSensorList[i].handle, sSensorList[i].name, -1);
+
     mSensor = mplSensor;
     mPollFds[mpl].fd = mSensor->getFd();
     mPollFds[mpl].events = POLLIN;
@@ -248,22 +254,20 @@ static int debug_lvl = 0;
 
 /* print sensor data latency */
 static int debug_time = 0;
-#include <cutils/properties.h>
 
 int sensors_poll_context_t::pollEvents(sensors_event_t *data, int count)
 {
-    VHANDLER_LOG;
-
+    sensors_event_t *events = data;
     int nbEvents = 0;
     int nb, polltime = -1;
-    char propbuf[PROPERTY_VALUE_MAX];
     int i=0;
 
     // look for new events
     nb = poll(mPollFds, numSensorDrivers, polltime);
 
-    property_get("sensor.debug.level", propbuf, "0");
-    debug_lvl = atoi(propbuf);
+    sensor_debug_poll();
+    debug_lvl = sensor_debug_level();
+    debug_time = sensor_debug_time();
 
     if (nb > 0) {
         for (int i = 0; count && i < numSensorDrivers; i++) {
@@ -315,12 +319,12 @@ int sensors_poll_context_t::pollEvents(sensors_event_t *data, int count)
 
         if (debug_lvl > 0) {
             for (i=0; i<nb; i++) {
-                if ((debug_lvl&1) && data[i].sensor==SENSORS_RAW_GYROSCOPE_HANDLE) {
+                if ((debug_lvl & SENSOR_DEBUG_GYRO) && data[i].sensor==SENSORS_RAW_GYROSCOPE_HANDLE) {
                     float gyro_data[3] = {0,0,0};
                     gyro_data[0] = data[i].uncalibrated_gyro.uncalib[0] - data[i].uncalibrated_gyro.bias[0];
                     gyro_data[1] = data[i].uncalibrated_gyro.uncalib[1] - data[i].uncalibrated_gyro.bias[1];
                     gyro_data[2] = data[i].uncalibrated_gyro.uncalib[2] - data[i].uncalibrated_gyro.bias[2];
-                    if (debug_lvl&8) {
+                    if (debug_lvl & SENSOR_DEBUG_RAW_GYRO) {
                         LOGD("RAW GYRO: %+f %+f %+f, %+f %+f %+f, %+f %+f %+f - %lld",
                             gyro_data[0], gyro_data[1], gyro_data[2],
                             data[i].uncalibrated_gyro.uncalib[0], data[i].uncalibrated_gyro.uncalib[1], data[i].uncalibrated_gyro.uncalib[2],
@@ -330,13 +334,13 @@ int sensors_poll_context_t::pollEvents(sensors_event_t *data, int count)
                         LOGD("RAW GYRO: %+f %+f %+f - %lld", gyro_data[0], gyro_data[1], gyro_data[2], data[i].timestamp);
                     }
                 }
-                if ((debug_lvl&1) && data[i].sensor==SENSORS_GYROSCOPE_HANDLE) {
+                if ((debug_lvl & SENSOR_DEBUG_GYRO) && data[i].sensor==SENSORS_GYROSCOPE_HANDLE) {
                     LOGD("GYRO: %+f %+f %+f - %lld", data[i].gyro.v[0], data[i].gyro.v[1], data[i].gyro.v[2], data[i].timestamp);
                 }
-                if ((debug_lvl&2) && data[i].sensor==SENSORS_ACCELERATION_HANDLE) {
+                if ((debug_lvl & SENSOR_DEBUG_ACCEL) && data[i].sensor==SENSORS_ACCELERATION_HANDLE) {
                     LOGD("ACCL: %+f %+f %+f - %lld", data[i].acceleration.v[0], data[i].acceleration.v[1], data[i].acceleration.v[2], data[i].timestamp);
                 }
-                if ((debug_lvl&4) && (data[i].sensor==SENSORS_MAGNETIC_FIELD_HANDLE)) {
+                if ((debug_lvl & SENSOR_DEBUG_MAG) && (data[i].sensor==SENSORS_MAGNETIC_FIELD_HANDLE)) {
                     LOGD("MAG: %+f %+f %+f - %lld", data[i].magnetic.v[0], data[i].magnetic.v[1], data[i].magnetic.v[2], data[i].timestamp);
                 }
             }
@@ -367,6 +371,14 @@ int sensors_poll_context_t::pollEvents(sensors_event_t *data, int count)
         }
     }
 
+    if (nbEvents > 0) {
+        int64_t now = get_time_ns();
+
+        for (i = 0; i < nbEvents; i++) {
+            sensor_stats_event(events[i].sensor, events[i].timestamp, now);
+            SENSOR_TRACE_MARK(TRACE_POLL, events[i].sensor, events[i].timestamp);
+        }
+    }
 
     return nbEvents;
 }
@@ -397,6 +409,7 @@ static int poll__activate(struct sensors_poll_device_t *dev,
 #if SENSOR_KEEP_ALIVE
     sensor_activate[handle] = enabled?10:0;
 #endif
+    sensor_stats_config(handle, NULL, -1);
 
     return ctx->activate(handle, enabled);
 }
@@ -412,6 +425,7 @@ static int poll__setDelay(struct sensors_poll_device_t *dev,
     sensor_delay[handle] = ns;
 #endif
 
+    sensor_stats_config(handle, NULL, ns);
     sensors_poll_context_t *ctx = (sensors_poll_context_t *)dev;
     int s= ctx->setDelay(handle, ns);
     return s;
@@ -454,7 +468,6 @@ static int open_sensors(const struct hw_module_t* module, const char* id,
     LOGD("Sensor HAL %s", VERSION);
 
     int status = -EINVAL;
-    char propbuf[PROPERTY_VALUE_MAX];
 
     sensors_poll_context_t *dev = new sensors_poll_context_t();
 
@@ -474,6 +487,7 @@ static int open_sensors(const struct hw_module_t* module, const char* id,
     *device = &dev->device.common;
     status = 0;
     ert = false;
+    sensor_stats_start(SENSOR_STATS_FIFO);
 
 #if SENSOR_KEEP_ALIVE
     memset(sensor_activate, 0, 32*sizeof(int));
@@ -481,9 +495,6 @@ static int open_sensors(const struct hw_module_t* module, const char* id,
     memset(sensor_prev_time, 0, 32*sizeof(int64_t));
 #endif
 
-    property_get("sensor.debug.time", propbuf, "0");
-    debug_time = atoi(propbuf);
-
     return status;
 }
 
@@ -7,6 +7,12 @@ HEADERS += $(APP_DIR)/iio_utils.h
 # sources
 SOURCES := $(APP_DIR)/mpu_iio.c
 
+# scan layout decoder shared with the HAL, common/iio_scan.h
+IIO_SCAN_DIR = $(APP_DIR)/../../../../../common
+HEADERS += $(IIO_SCAN_DIR)/iio_scan.h
+SOURCES += $(IIO_SCAN_DIR)/iio_scan.c
+INV_INCLUDES += -I$(IIO_SCAN_DIR)
+
 INV_SOURCES += $(SOURCES)
 
-VPATH += $(APP_DIR) $(COMMON_DIR) $(HAL_DIR)/linux
+VPATH += $(APP_DIR) $(COMMON_DIR) $(HAL_DIR)/linux $(IIO_SCAN_DIR)
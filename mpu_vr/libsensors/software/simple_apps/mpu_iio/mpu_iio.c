@@ -19,6 +19,7 @@
 #include <termios.h>
 
 #include "iio_utils.h"
+#include "iio_scan.h"
 #include "ml_load_dmp.h"
 #include "ml_sysfs_helper.h"
 #include "authenticate.h"
@@ -88,99 +89,52 @@ int _kbhit(void)
 }
 
 /**
- * size_from_channelarray() - calculate the storage size of a scan
- * @channels: the channel info array
- * @num_channels: size of the channel info array
- *
- * Has the side effect of filling the channels[i].location values used
- * in processing the buffer output.
+ * process_scans() - print out decoded scans in SI units
+ * @values:        iio_scan_decode() output, num_channels values per scan
+ * @num_scans:     the number of scans in @values
+ * @infoarray:     information about the channels, in index order like
+ *  the scan layout the values were decoded with.
+ * @num_channels:  the number of active channels
  */
-int size_from_channelarray(struct iio_channel_info *channels, int num_channels)
+void process_scans(const int64_t *values, size_t num_scans,
+          struct iio_channel_info *infoarray, int num_channels)
 {
-    int bytes = 0;
-    int i = 0;
-    while (i < num_channels) {
-        if (bytes % channels[i].bytes == 0)
-            channels[i].location = bytes;
-        else
-            channels[i].location = bytes - bytes%channels[i].bytes
-                + channels[i].bytes;
-        bytes = channels[i].location + channels[i].bytes;
-        i++;
-    }
-    return bytes;
-}
+    size_t s;
+    int k;
 
-void print2byte(int input, struct iio_channel_info *info)
-{
-    /* shift before conversion to avoid sign extension
-       of left aligned data */
-    input = input >> info->shift;
-    if (info->is_signed) {
-        int16_t val = input;
-        val &= (1 << info->bits_used) - 1;
-        val = (int16_t)(val << (16 - info->bits_used)) >>
-            (16 - info->bits_used);
-        /*printf("%d, %05f, scale=%05f", val,
-               (float)(val + info->offset)*info->scale, info->scale);*/
-        printf("%d, ", val);
+    for (s = 0; s < num_scans; s++, values += num_channels) {
+        for (k = 0; k < num_channels; k++) {
+            struct iio_channel_info *info = &infoarray[k];
 
-    } else {
-        uint16_t val = input;
-        val &= (1 << info->bits_used) - 1;
-        printf("%05f ", ((float)val + info->offset)*info->scale);
-    }
-}
-
-/**
- * process_scan() - print out the values in SI units
- * @data:        pointer to the start of the scan
- * @infoarray:        information about the channels. Note
- *  size_from_channelarray must have been called first to fill the
- *  location offsets.
- * @num_channels:    the number of active channels
- */
-void process_scan(char *data, struct iio_channel_info *infoarray, 
-          int num_channels)
-{
-    int k;
-    //char *tmp;
-    for (k = 0; k < num_channels; k++) {
-        switch (infoarray[k].bytes) {
-            /* only a few cases implemented so far */
-        case 2:
-            print2byte(*(uint16_t *)(data + infoarray[k].location),
-                   &infoarray[k]);
-            //tmp = data + infoarray[k].location;
-            break;
-        case 4:
-            if (infoarray[k].is_signed) {
-                int32_t val = *(int32_t *)(data + infoarray[k].location);
-                if ((val >> infoarray[k].bits_used) & 1)
-                    val = (val & infoarray[k].mask) | ~infoarray[k].mask;
-                /* special case for timestamp */
-                printf(" %d ", val);
-            }
-            break;
-        case 8:
-            if (infoarray[k].is_signed) {
-                int64_t val = *(int64_t *)(data + infoarray[k].location);
-                if ((val >> infoarray[k].bits_used) & 1)
-                    val = (val & infoarray[k].mask) | ~infoarray[k].mask;
+            switch (info->bytes) {
+                /* only a few cases implemented so far */
+            case 2:
+                if (info->is_signed)
+                    printf("%d, ", (int)values[k]);
+                else
+                    printf("%05f ", ((float)values[k] + info->offset)
+                            * info->scale);
+                break;
+            case 4:
+                if (info->is_signed)
+                    printf(" %d ", (int)values[k]);
+                break;
+            case 8:
+                if (!info->is_signed)
+                    break;
                 /* special case for timestamp */
-                if (infoarray[k].scale == 1.0f &&
-                    infoarray[k].offset == 0.0f)
-                    printf(" %lld", val);
+                if (info->scale == 1.0f && info->offset == 0.0f)
+                    printf(" %lld", (long long)values[k]);
                 else
-                    printf("%05f ", ((float)val + infoarray[k].offset)
-                            * infoarray[k].scale);
+                    printf("%05f ", ((float)values[k] + info->offset)
+                            * info->scale);
+                break;
+            default:
+                break;
             }
-            break;
-        default:
-            break;
         }
+        printf("\n");
     }
-    printf("\n");
 }
 
 /*
@@ -572,6 +526,7 @@ int main(int argc, char **argv)
 
     int datardytrigger = 1;
     char *data;
+    int64_t *values;
     int read_size;
     int dev_num, trig_num;
     char *buffer_access;
@@ -584,6 +539,7 @@ int main(int argc, char **argv)
     char sysfs[100];
 
     struct iio_channel_info *infoarray;
+    struct iio_scan_layout layout;
 
     // all output to stdout must be delivered immediately, no buffering
     setvbuf(stdout, NULL, _IONBF, 0);
@@ -856,12 +812,23 @@ int main(int argc, char **argv)
     ret = write_sysfs_int_and_verify("enable", buf_dir_name, 1);
     if (ret < 0)
         goto exit_here;
-    scan_size = size_from_channelarray(infoarray, num_channels);
+    ret = iio_scan_layout_load(&layout, dev_dir_name);
+    if (ret < 0 || layout.num != num_channels) {
+        printf("Problem compiling the scan layout\n");
+        goto exit_here;
+    }
+    scan_size = layout.size;
     data = malloc(scan_size * buf_len);
     if (!data) {
         ret = -ENOMEM;
         goto exit_here;
     }
+    values = malloc(sizeof(*values) * layout.num * buf_len);
+    if (!values) {
+        free(data);
+        ret = -ENOMEM;
+        goto exit_here;
+    }
 
     if (p_event) {
 
@@ -893,22 +860,22 @@ int main(int argc, char **argv)
                     .events = POLLIN,
                 };
                 poll(&pfd, 1, -1);
-                toread = 1;
+                toread = buf_len;
                 if (j % 128 == 0)
                     usleep(timedelay);
 
             } else {
                 usleep(timedelay);
-                toread = 1;
+                toread = buf_len;
             }
             read_size = read(fp, data, toread * scan_size);
             if (read_size == -EAGAIN) {
                 printf("nothing available\n");
                 continue;
             }
-            if (!p_event) {
-                for (i = 0; i < read_size / scan_size; i++)
-                    process_scan(data + scan_size * i, infoarray, num_channels);
+            if (!p_event && read_size > 0) {
+                process_scans(values, iio_scan_decode(&layout, data,
+                        read_size, values, buf_len), infoarray, num_channels);
             }
         }
         close(fp);
@@ -917,6 +884,7 @@ int main(int argc, char **argv)
 error_free_buffer_access:
     free(buffer_access);
 error_free_data:
+    free(values);
     free(data);
 exit_here:
     /* stop the ring buffer */
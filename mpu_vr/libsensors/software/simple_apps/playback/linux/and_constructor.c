@@ -22,6 +22,7 @@
 #define MPL_LOG_TAG "MPL-playback"
 
 #include "and_constructor.h"
+#include "mpl_trace.h"
 #include "mlos.h"
 #include "invensense.h"
 #include "invensense_adv.h"
@@ -50,6 +51,7 @@ struct inv_construct_t {
 static struct inv_construct_t inv_construct = {0};
 static void (*s_func_cb)(void);
 static char playback_filename[101] = "/data/playback.bin";
+static inv_time_t playback_start;
 struct fifo_dmp_config fifo_dmp_cfg = {0};
 
 /*
@@ -64,6 +66,11 @@ void inv_set_playback_filename(char *filename, int length)
     strncpy(playback_filename, filename, length);
 }
 
+void inv_set_playback_start(inv_time_t ts)
+{
+    playback_start = ts;
+}
+
 inv_error_t inv_constructor_setup(void)
 {
     unsigned short orient;
@@ -106,15 +113,155 @@ void int32_to_long(int32_t in[], long out[], int length)
         out[ii] = (long)in[ii];
 }
 
+/* feed one recorded record to the MPL */
+static inv_error_t playback_record(const struct mpl_trace_rec *rec)
+{
+    const int32_t *v = rec->v;
+    inv_time_t ts = rec->ts;
+
+    switch (rec->type) {
+    case PLAYBACK_DBG_TYPE_GYRO:
+    {
+        short gyro[3];
+        gyro[0] = (short)v[0];
+        gyro[1] = (short)v[1];
+        gyro[2] = (short)v[2];
+        inv_build_gyro(gyro, ts);
+        MPL_LOGV("PLAYBACK_DBG_TYPE_GYRO, %+d, %+d, %+d, %+lld\n",
+                 gyro[0], gyro[1], gyro[2], ts);
+        break;
+    }
+    case PLAYBACK_DBG_TYPE_ACCEL:
+    {
+        long accel[3];
+        int32_to_long((int32_t *)v, accel, 3);
+        inv_build_accel(accel, 0, ts);
+        MPL_LOGV("PLAYBACK_DBG_TYPE_ACCEL, %+d, %+d, %+d, %lld\n",
+                 v[0], v[1], v[2], ts);
+        break;
+    }
+    case PLAYBACK_DBG_TYPE_COMPASS:
+    {
+        long compass[3];
+        int32_to_long((int32_t *)v, compass, 3);
+        inv_build_compass(compass, 0, ts);
+        MPL_LOGV("PLAYBACK_DBG_TYPE_COMPASS, %+d, %+d, %+d, %lld\n",
+                 v[0], v[1], v[2], ts);
+        break;
+    }
+    case PLAYBACK_DBG_TYPE_TEMPERATURE:
+        inv_build_temp(v[0], ts);
+        MPL_LOGV("PLAYBACK_DBG_TYPE_TEMPERATURE, %+d, %lld\n", v[0], ts);
+        break;
+    case PLAYBACK_DBG_TYPE_QUAT:
+    {
+        long quat[4];
+        int32_to_long((int32_t *)v, quat, 4);
+        inv_build_quat(quat, INV_BIAS_APPLIED, ts);
+        MPL_LOGV("PLAYBACK_DBG_TYPE_QUAT, %+d, %+d, %+d, %+d, %lld\n",
+                 v[0], v[1], v[2], v[3], ts);
+        break;
+    }
+    case PLAYBACK_DBG_TYPE_EXECUTE:
+        MPL_LOGV("PLAYBACK_DBG_TYPE_EXECUTE\n");
+        inv_execute_on_data();
+        if (s_func_cb)
+            s_func_cb();
+        break;
+
+    case PLAYBACK_DBG_TYPE_G_ORIENT:
+        MPL_LOGV("PLAYBACK_DBG_TYPE_G_ORIENT\n");
+        inv_set_gyro_orientation_and_scale(v[0], v[1]);
+        break;
+    case PLAYBACK_DBG_TYPE_A_ORIENT:
+        MPL_LOGV("PLAYBACK_DBG_TYPE_A_ORIENT\n");
+        inv_set_accel_orientation_and_scale(v[0], v[1]);
+        break;
+    case PLAYBACK_DBG_TYPE_C_ORIENT:
+        MPL_LOGV("PLAYBACK_DBG_TYPE_C_ORIENT\n");
+        inv_set_compass_orientation_and_scale(v[0], v[1]);
+        break;
+
+    case PLAYBACK_DBG_TYPE_G_SAMPLE_RATE:
+        inv_set_gyro_sample_rate(v[0]);
+        MPL_LOGV("PLAYBACK_DBG_TYPE_G_SAMPLE_RATE => %d\n", v[0]);
+        break;
+    case PLAYBACK_DBG_TYPE_A_SAMPLE_RATE:
+        inv_set_accel_sample_rate(v[0]);
+        MPL_LOGV("PLAYBACK_DBG_TYPE_A_SAMPLE_RATE => %d\n", v[0]);
+        break;
+    case PLAYBACK_DBG_TYPE_C_SAMPLE_RATE:
+        inv_set_compass_sample_rate(v[0]);
+        MPL_LOGV("PLAYBACK_DBG_TYPE_C_SAMPLE_RATE => %d\n", v[0]);
+        break;
+
+    case PLAYBACK_DBG_TYPE_GYRO_OFF:
+        MPL_LOGV("PLAYBACK_DBG_TYPE_GYRO_OFF\n");
+        inv_gyro_was_turned_off();
+        break;
+    case PLAYBACK_DBG_TYPE_ACCEL_OFF:
+        MPL_LOGV("PLAYBACK_DBG_TYPE_ACCEL_OFF\n");
+        inv_accel_was_turned_off();
+        break;
+    case PLAYBACK_DBG_TYPE_COMPASS_OFF:
+        MPL_LOGV("PLAYBACK_DBG_TYPE_COMPASS_OFF\n");
+        inv_compass_was_turned_off();
+        break;
+    case PLAYBACK_DBG_TYPE_QUAT_OFF:
+        MPL_LOGV("PLAYBACK_DBG_TYPE_QUAT_OFF\n");
+        inv_quaternion_sensor_was_turned_off();
+        break;
+
+    case PLAYBACK_DBG_TYPE_Q_SAMPLE_RATE:
+        MPL_LOGV("PLAYBACK_DBG_TYPE_Q_SAMPLE_RATE\n");
+        inv_set_quat_sample_rate(v[0]);
+        break;
+    default:
+        MPL_LOGE("%s|%s|%d error: unrecognized log type '%d'\n",
+                 __FILE__, __func__, __LINE__, rec->type);
+        return INV_ERROR;
+    }
+    return INV_SUCCESS;
+}
+
+static void playback_config(const struct mpl_trace_rec *rec, void *arg)
+{
+    (void)arg;
+    playback_record(rec);
+}
+
+/* replay a columnar trace, see mpl_trace.h */
+static inv_error_t inv_playback_trace(void)
+{
+    struct mpl_trace_reader rd;
+    struct mpl_trace_rec rec;
+    inv_error_t result = INV_SUCCESS;
+
+    if (mpl_trace_open(&rd, playback_filename) < 0) {
+        MPL_LOGE("Error : cannot map playback trace '%s'\n",
+                 playback_filename);
+        inv_construct.debug_mode = RD_NO_DEBUG;
+        return INV_ERROR_FILE_OPEN;
+    }
+    if (playback_start &&
+            mpl_trace_seek(&rd, playback_start, playback_config, NULL) < 0) {
+        MPL_LOGE("Error : nothing recorded after %lld\n", playback_start);
+        result = INV_ERROR;
+    }
+    while (result == INV_SUCCESS && mpl_trace_next(&rd, &rec))
+        result = playback_record(&rec);
+
+    mpl_trace_close(&rd);
+    inv_construct.debug_mode = RD_NO_DEBUG;
+    return result;
+}
+
 inv_error_t inv_playback(void)
 {
-    inv_rd_dbg_states type;
-    inv_time_t ts;
+    struct mpl_trace_rec rec;
     int32_t buffer[4];
-    short gyro[3];
-    size_t r = 1;
-    int32_t orientation;
-    int32_t sensitivity, sample_rate_us = 0;
+    int64_t ts = 0;
+    int type, r;
 
     // Check to make sure we were request to playback
     if (inv_construct.debug_mode != RD_PLAYBACK) {
@@ -123,6 +270,9 @@ inv_error_t inv_playback(void)
         return INV_ERROR;
     }
 
+    if (inv_construct.file == NULL && mpl_trace_is_trace(playback_filename))
+        return inv_playback_trace();
+
     if (inv_construct.file == NULL) {
         inv_construct.file = fopen(playback_filename, "rb");
         if (!inv_construct.file) {
@@ -132,141 +282,29 @@ inv_error_t inv_playback(void)
         }
     }
 
+    rec.v = buffer;
     while (1) {
-        r = fread(&type, sizeof(type), 1, inv_construct.file);
+        r = mpl_trace_read_record(inv_construct.file, &type, buffer, &ts);
         if (r == 0) {
             MPL_LOGV("read 0 bytes, PLAYBACK file closed\n");
-            inv_construct.debug_mode = RD_NO_DEBUG;
-            fclose(inv_construct.file);
-            break;
-        }
-        //MPL_LOGV("TYPE : %d, %d\n", type);
-        switch (type) {
-        case PLAYBACK_DBG_TYPE_GYRO:
-            r = fread(gyro, sizeof(gyro[0]), 3, inv_construct.file);
-            r = fread(&ts, sizeof(ts), 1, inv_construct.file);
-            inv_build_gyro(gyro, ts);
-            MPL_LOGV("PLAYBACK_DBG_TYPE_GYRO, %+d, %+d, %+d, %+lld\n",
-                     gyro[0], gyro[1], gyro[2], ts);
-            break;
-        case PLAYBACK_DBG_TYPE_ACCEL:
-        {
-            long accel[3];
-            r = fread(buffer, sizeof(buffer[0]), 3, inv_construct.file);
-            r = fread(&ts, sizeof(ts), 1, inv_construct.file);
-            int32_to_long(buffer, accel, 3);
-            inv_build_accel(accel, 0, ts);
-            MPL_LOGV("PLAYBACK_DBG_TYPE_ACCEL, %+d, %+d, %+d, %lld\n",
-                     buffer[0], buffer[1], buffer[2], ts);
             break;
         }
-        case PLAYBACK_DBG_TYPE_COMPASS:
-        {
-            long compass[3];
-            r = fread(buffer, sizeof(buffer[0]), 3, inv_construct.file);
-            r = fread(&ts, sizeof(ts), 1, inv_construct.file);
-            int32_to_long(buffer, compass, 3);
-            inv_build_compass(compass, 0, ts);
-            MPL_LOGV("PLAYBACK_DBG_TYPE_COMPASS, %+d, %+d, %+d, %lld\n",
-                     buffer[0], buffer[1], buffer[2], ts);
-            break;
-        }
-        case PLAYBACK_DBG_TYPE_TEMPERATURE:
-            r = fread(buffer, sizeof(buffer[0]), 1, inv_construct.file);
-            r = fread(&ts, sizeof(ts), 1, inv_construct.file);
-            inv_build_temp(buffer[0], ts);
-            MPL_LOGV("PLAYBACK_DBG_TYPE_TEMPERATURE, %+d, %lld\n",
-                     buffer[0], ts);
-            break;
-        case PLAYBACK_DBG_TYPE_QUAT:
-        {
-            long quat[4];
-            r = fread(buffer, sizeof(buffer[0]), 4, inv_construct.file);
-            r = fread(&ts, sizeof(ts), 1, inv_construct.file);
-            int32_to_long(buffer, quat, 4);
-            inv_build_quat(quat, INV_BIAS_APPLIED, ts);
-            MPL_LOGV("PLAYBACK_DBG_TYPE_QUAT, %+d, %+d, %+d, %+d, %lld\n",
-                     buffer[0], buffer[1], buffer[2], buffer[3], ts);
-            break;
+        /* the record stream cannot seek, skip data up to the start */
+        if (r > 0 && playback_start) {
+            if (mpl_trace_type_timed(type) && ts >= playback_start)
+                playback_start = 0;
+            else if (mpl_trace_type_timed(type) ||
+                     type == PLAYBACK_DBG_TYPE_EXECUTE)
+                continue;
         }
-        case PLAYBACK_DBG_TYPE_EXECUTE:
-            MPL_LOGV("PLAYBACK_DBG_TYPE_EXECUTE\n");
-            inv_execute_on_data();
-            if (s_func_cb)
-                s_func_cb();
-            //done = 1;
-            break;
-
-        case PLAYBACK_DBG_TYPE_G_ORIENT:
-            MPL_LOGV("PLAYBACK_DBG_TYPE_G_ORIENT\n");
-            r = fread(&orientation, sizeof(orientation), 1, inv_construct.file);
-            r = fread(&sensitivity, sizeof(sensitivity), 1, inv_construct.file);
-            inv_set_gyro_orientation_and_scale(orientation, sensitivity);
-            break;
-        case PLAYBACK_DBG_TYPE_A_ORIENT:
-            MPL_LOGV("PLAYBACK_DBG_TYPE_A_ORIENT\n");
-            r = fread(&orientation, sizeof(orientation), 1, inv_construct.file);
-            r = fread(&sensitivity, sizeof(sensitivity), 1, inv_construct.file);
-            inv_set_accel_orientation_and_scale(orientation, sensitivity);
-            break;
-        case PLAYBACK_DBG_TYPE_C_ORIENT:
-            MPL_LOGV("PLAYBACK_DBG_TYPE_C_ORIENT\n");
-            r = fread(&orientation, sizeof(orientation), 1, inv_construct.file);
-            r = fread(&sensitivity, sizeof(sensitivity), 1, inv_construct.file);
-            inv_set_compass_orientation_and_scale(orientation, sensitivity);
-            break;
-
-        case PLAYBACK_DBG_TYPE_G_SAMPLE_RATE:
-            r = fread(&sample_rate_us, sizeof(sample_rate_us), 
-                      1, inv_construct.file);
-            inv_set_gyro_sample_rate(sample_rate_us);
-            MPL_LOGV("PLAYBACK_DBG_TYPE_G_SAMPLE_RATE => %d\n",
-                     sample_rate_us);
-            break;
-        case PLAYBACK_DBG_TYPE_A_SAMPLE_RATE:
-            r = fread(&sample_rate_us, sizeof(sample_rate_us), 
-                      1, inv_construct.file);
-            inv_set_accel_sample_rate(sample_rate_us);
-            MPL_LOGV("PLAYBACK_DBG_TYPE_A_SAMPLE_RATE => %d\n",
-                     sample_rate_us);
-            break;
-        case PLAYBACK_DBG_TYPE_C_SAMPLE_RATE:
-            r = fread(&sample_rate_us, sizeof(sample_rate_us), 
-                      1, inv_construct.file);
-            inv_set_compass_sample_rate(sample_rate_us);
-            MPL_LOGV("PLAYBACK_DBG_TYPE_C_SAMPLE_RATE => %d\n",
-                     sample_rate_us);
-            break;
-
-        case PLAYBACK_DBG_TYPE_GYRO_OFF:
-            MPL_LOGV("PLAYBACK_DBG_TYPE_GYRO_OFF\n");
-            inv_gyro_was_turned_off();
-            break;
-        case PLAYBACK_DBG_TYPE_ACCEL_OFF:
-            MPL_LOGV("PLAYBACK_DBG_TYPE_ACCEL_OFF\n");
-            inv_accel_was_turned_off();
-            break;
-        case PLAYBACK_DBG_TYPE_COMPASS_OFF:
-            MPL_LOGV("PLAYBACK_DBG_TYPE_COMPASS_OFF\n");
-            inv_compass_was_turned_off();
-            break;
-        case PLAYBACK_DBG_TYPE_QUAT_OFF:
-            MPL_LOGV("PLAYBACK_DBG_TYPE_QUAT_OFF\n");
-            inv_quaternion_sensor_was_turned_off();
-            break;
-
-        case PLAYBACK_DBG_TYPE_Q_SAMPLE_RATE:
-            MPL_LOGV("PLAYBACK_DBG_TYPE_Q_SAMPLE_RATE\n");
-            r = fread(&sample_rate_us, sizeof(sample_rate_us), 
-                      1, inv_construct.file);
-            inv_set_quat_sample_rate(sample_rate_us);
-            break;
-        default:
-            //MPL_LOGV("PLAYBACK file closed\n");
+        rec.type = type;
+        rec.num = mpl_trace_type_values(type);
+        rec.ts = ts;
+        if (r < 0 || playback_record(&rec) != INV_SUCCESS) {
             fclose(inv_construct.file);
-            MPL_LOGE("%s|%s|%d error: unrecognized log type '%d', "
-                     "PLAYBACK file closed\n",
-                     __FILE__, __func__, __LINE__, type);
+            inv_construct.file = NULL;
+            MPL_LOGE("%s|%s|%d error: bad record, PLAYBACK file closed\n",
+                     __FILE__, __func__, __LINE__);
             return INV_ERROR;
         }
     }
@@ -274,6 +312,7 @@ inv_error_t inv_playback(void)
 
     inv_construct.debug_mode = RD_NO_DEBUG;
     fclose(inv_construct.file);
+    inv_construct.file = NULL;
 
     return INV_SUCCESS;
 }
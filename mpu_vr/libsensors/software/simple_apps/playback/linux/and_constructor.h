@@ -45,6 +45,7 @@ inv_error_t inv_constructor_default_enable();
 void inv_set_debug_mode(rd_dbg_mode mode);
 inv_error_t inv_playback();
 void inv_set_playback_filename(char *filename, int length);
+void inv_set_playback_start(inv_time_t ts);
 inv_error_t wait_for_and_process_interrupt();
 
 inv_error_t inv_set_interrupt_word(unsigned long word);
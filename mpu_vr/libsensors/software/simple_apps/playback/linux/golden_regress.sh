@@ -0,0 +1,87 @@
+#!/bin/sh
+
+# Golden output regression run of inv_playback over a corpus of traces.
+#
+# Every recorded trace in CORPUS (playback.bin streams or columnar traces
+# made with -x, any name but *.golden) is played back in its own process,
+# so each one starts from a freshly initialized MPL, and its outputs are
+# compared with TRACE.golden.  With -u the golden files are rewritten
+# from the current build instead; review the change before committing
+# them.
+#
+# The per trace results, with the processing time, go to CORPUS/results.txt
+# and the exit status is non zero if any trace failed.
+#
+# usage: golden_regress.sh [-u] [-p inv_playback] [-e STREAM=TOL]... CORPUS
+
+PLAYBACK=inv_playback
+UPDATE=0
+TOLS=""
+
+while getopts "up:e:" opt; do
+	case $opt in
+	u) UPDATE=1 ;;
+	p) PLAYBACK=$OPTARG ;;
+	e) TOLS="$TOLS -e $OPTARG" ;;
+	*) echo "usage: $0 [-u] [-p inv_playback] [-e STREAM=TOL]... CORPUS"
+	   exit 2 ;;
+	esac
+done
+shift $((OPTIND - 1))
+CORPUS=$1
+if [ -z "$CORPUS" ] || [ ! -d "$CORPUS" ]; then
+	echo "usage: $0 [-u] [-p inv_playback] [-e STREAM=TOL]... CORPUS"
+	exit 2
+fi
+
+RESULTS=$CORPUS/results.txt
+pass=0
+fail=0
+: > "$RESULTS"
+
+for trace in "$CORPUS"/*; do
+	case $trace in
+	*.golden|*.log|"$RESULTS") continue ;;
+	esac
+	[ -f "$trace" ] || continue
+	name=$(basename "$trace")
+
+	if [ $UPDATE -eq 1 ]; then
+		if "$PLAYBACK" -i "$trace" -w "$trace.golden" \
+				> "$trace.log" 2>&1; then
+			echo "UPDATED $name" | tee -a "$RESULTS"
+		else
+			echo "ERROR   $name, see $trace.log" | tee -a "$RESULTS"
+			fail=$((fail + 1))
+		fi
+		continue
+	fi
+
+	if [ ! -f "$trace.golden" ]; then
+		echo "MISSING $name.golden" | tee -a "$RESULTS"
+		fail=$((fail + 1))
+		continue
+	fi
+	"$PLAYBACK" -i "$trace" -g "$trace.golden" $TOLS > "$trace.log" 2>&1
+	status=$?
+	# GOLDEN PASS|FAIL <trace> <samples> <seconds>
+	line=$(grep '^GOLDEN ' "$trace.log")
+	if [ $status -eq 0 ] && [ -n "$line" ]; then
+		pass=$((pass + 1))
+	else
+		fail=$((fail + 1))
+		[ -n "$line" ] || line="GOLDEN ERROR $trace"
+	fi
+	echo "$line" | awk -v n="$name" '{
+		if (NF >= 5 && $5 > 0)
+			printf "%-5s %-40s %8d samples %8.3f s %10.1f samples/s\n",
+				$2, n, $4, $5, $4 / $5
+		else
+			printf "%-5s %-40s\n", $2, n
+	}' | tee -a "$RESULTS"
+done
+
+if [ $UPDATE -eq 0 ]; then
+	echo "$pass passed, $fail failed" | tee -a "$RESULTS"
+fi
+[ $fail -eq 0 ]
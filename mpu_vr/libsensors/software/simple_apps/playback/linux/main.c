@@ -17,6 +17,9 @@
 #include "and_constructor.h"
 #include "ml_math_func.h"
 #include "datalogger_outputs.h"
+#include "mpl_trace.h"
+#include "playback_output.h"
+#include "playback_golden.h"
 
 #include "console_helper.h"
 
@@ -32,69 +35,9 @@
 /*
     Defines & Macros
 */
-#define UNPACK_3ELM_ARRAY(a)    (a)[0], (a)[1], (a)[2]
-#define UNPACK_4ELM_ARRAY(a)    UNPACK_3ELM_ARRAY(a), (a)[3]
 #define COMPONENT_NAME_MAX_LEN  (30)
 #define DEF_NAME(x)             (#x)
 
-#define PRINT_ON_CONSOLE(...)                   \
-    if (print_on_screen)                        \
-        printf(__VA_ARGS__)
-#define PRINT_ON_FILE(...)                      \
-    if(stream_file)                             \
-        fprintf(stream_file, __VA_ARGS__)
-
-#define PRINT(...)                              \
-    PRINT_ON_CONSOLE(__VA_ARGS__);              \
-    PRINT_ON_FILE(__VA_ARGS__)
-#define PRINT_FLOAT(width, prec, data)          \
-    PRINT_ON_CONSOLE("%+*.*f",                  \
-                     width, prec, data);        \
-    PRINT_ON_FILE("%+f", data)
-#define PRINT_INT(width, data)                  \
-    PRINT_ON_CONSOLE("%+*d", width, data);      \
-    PRINT_ON_FILE("%+d", data);
-#define PRINT_LONG(width, data)                 \
-    PRINT_ON_CONSOLE("%+*ld", width, data);     \
-    PRINT_ON_FILE("%+ld", data);
-
-#define PRINT_3ELM_ARRAY_FLOAT(w, p, data)      \
-    PRINT_FLOAT(w, p, data[0]);                 \
-    PRINT(", ");                                \
-    PRINT_FLOAT(w, p, data[1]);                 \
-    PRINT(", ");                                \
-    PRINT_FLOAT(w, p, data[2]);                 \
-    PRINT(", ");
-#define PRINT_4ELM_ARRAY_FLOAT(w, p, data)      \
-    PRINT_3ELM_ARRAY_FLOAT(w, p, data);         \
-    PRINT_FLOAT(w, p, data[3]);                 \
-    PRINT(", ");
-
-#define PRINT_3ELM_ARRAY_LONG(w, data)          \
-    PRINT_LONG(w, data[0]);                     \
-    PRINT(", ");                                \
-    PRINT_LONG(w, data[1]);                     \
-    PRINT(", ");                                \
-    PRINT_LONG(w, data[2]);                     \
-    PRINT(", ");
-#define PRINT_4ELM_ARRAY_LONG(w, data)          \
-    PRINT_3ELM_ARRAY_LONG(w, data);             \
-    PRINT_LONG(w, data[3]);                     \
-    PRINT(", ");
-
-#define PRINT_3ELM_ARRAY_INT(w, data)           \
-    PRINT_INT(w, data[0]);                      \
-    PRINT(", ");                                \
-    PRINT_INT(w, data[1]);                      \
-    PRINT(", ");                                \
-    PRINT_INT(w, data[2]);                      \
-    PRINT(", ");
-#define PRINT_4ELM_ARRAY_INT(w, data)           \
-    PRINT_3ELM_ARRAY_LONG(w, data);             \
-    PRINT_INT(w, data[3]);                      \
-    PRINT(", ");
-
-
 #define CASE_NAME(CODE)                         \
     case CODE:                                  \
         return #CODE
@@ -149,6 +92,7 @@ enum comp_ids {
     LINEAR_ACCELERATION,
     ROTATION_VECTOR,
     MOTION_STATE,
+    ORIENTATION,
 
     NUM_OF_IDS
 };
@@ -158,12 +102,66 @@ struct component_list {
     int order;
 };
 
+/* output columns, in comp_ids order */
+static const struct playback_column columns[NUM_OF_IDS] = {
+    { "TIME,", PLAYBACK_TIME, 1, 6, 0, ",   " },
+    { "CALIBRATED_GYROSCOPE_X,"
+      "CALIBRATED_GYROSCOPE_Y,"
+      "CALIBRATED_GYROSCOPE_Z,", PLAYBACK_FLOAT, 3, 10, 5, "  " },
+    { "CALIBRATED_ACCELEROMETER_X,"
+      "CALIBRATED_ACCELEROMETER_Y,"
+      "CALIBRATED_ACCELEROMETER_Z,", PLAYBACK_FLOAT, 3, 10, 5, "  " },
+    { "CALIBRATED_COMPASS_X,"
+      "CALIBRATED_COMPASS_Y,"
+      "CALIBRATED_COMPASS_Z,", PLAYBACK_FLOAT, 3, 10, 5, "  " },
+    { "RAW_GYROSCOPE_X,"
+      "RAW_GYROSCOPE_Y,"
+      "RAW_GYROSCOPE_Z,", PLAYBACK_INT, 3, 6, 0, "  " },
+    { "RAW_GYROSCOPE_BODY_X,"
+      "RAW_GYROSCOPE_BODY_Y,"
+      "RAW_GYROSCOPE_BODY_Z,", PLAYBACK_FLOAT, 3, 10, 5, "  " },
+    { "RAW_ACCELEROMETER_X,"
+      "RAW_ACCELEROMETER_Y,"
+      "RAW_ACCELEROMETER_Z,", PLAYBACK_INT, 3, 6, 0, "  " },
+    { "RAW_COMPASS_X,"
+      "RAW_COMPASS_Y,"
+      "RAW_COMPASS_Z,", PLAYBACK_INT, 3, 6, 0, "  " },
+    { "QUATERNION_9_AXIS_X,"
+      "QUATERNION_9_AXIS_Y,"
+      "QUATERNION_9_AXIS_Z,"
+      "QUATERNION_9_AXIS_w,", PLAYBACK_FLOAT, 4, 10, 5, "  " },
+    { "QUATERNION_6_AXIS_X,"
+      "QUATERNION_6_AXIS_Y,"
+      "QUATERNION_6_AXIS_Z,"
+      "QUATERNION_6_AXIS_w,", PLAYBACK_FLOAT, 4, 10, 5, "  " },
+    { "GRAVITY_X,"
+      "GRAVITY_Y,"
+      "GRAVITY_Z,", PLAYBACK_FLOAT, 3, 10, 5, "  " },
+    { "HEADING,", PLAYBACK_FLOAT, 1, 10, 5, ",   " },
+    { "COMPASS_BIAS_ERROR_X,"
+      "COMPASS_BIAS_ERROR_Y,"
+      "COMPASS_BIAS_ERROR_Z,", PLAYBACK_INT, 3, 6, 0, "" },
+    { "COMPASS_STATE,"
+      "GOT_COARSE_HEADING,", PLAYBACK_INT, 2, 1, 0, "" },
+    { "TEMPERATURE,", PLAYBACK_FLOAT, 1, 8, 4, ",   " },
+    { "TEMP_COMP_SLOPE_X,"
+      "TEMP_COMP_SLOPE_Y,"
+      "TEMP_COMP_SLOPE_Z,", PLAYBACK_FLOAT, 3, 10, 5, "  " },
+    { "LINEAR_ACCELERATION_X,"
+      "LINEAR_ACCELERATION_Y,"
+      "LINEAR_ACCELERATION_Z,", PLAYBACK_FLOAT, 3, 10, 5, "  " },
+    { "ROTATION_VECTOR_X,"
+      "ROTATION_VECTOR_Y,"
+      "ROTATION_VECTOR_Z,", PLAYBACK_FLOAT, 3, 10, 5, "  " },
+    { "MOTION_STATE,", PLAYBACK_INT, 1, 1, 0, ",   " },
+    { "ORIENTATION_X,"
+      "ORIENTATION_Y,"
+      "ORIENTATION_Z,", PLAYBACK_FLOAT, 3, 10, 5, "  " },
+};
+
 /*
     Globals
 */
-static int print_on_screen = true;
-static int one_time_print = true;
-static FILE *stream_file = NULL;
 static unsigned long sample_count = 0;
 static int enabled_9x = true;
 
@@ -179,6 +177,11 @@ static inv_time_t counter_start;
 #endif
 
 struct component_list components[NUM_OF_IDS];
+/* enabled components in output order */
+static int component_order[NUM_OF_IDS];
+static int num_components;
+/* compare against a golden file, see playback_golden.h */
+static int golden_check;
 
 /*
     Prototypes
@@ -245,6 +248,7 @@ char *component_name(char *out, int comp_id)
     CASE_NAME(LINEAR_ACCELERATION);
     CASE_NAME(ROTATION_VECTOR);
     CASE_NAME(MOTION_STATE);
+    CASE_NAME(ORIENTATION);
     }
 
     return "UNKNOWN";
@@ -296,289 +300,132 @@ void start_counter(void)
 /* processed data callback */
 void fifo_callback(void)
 {
-    int print_on_screen_saved = print_on_screen;
-    int i;
-
-    /* one_time_print causes the data labels to be printed on screen */
-    if (one_time_print) {
-        print_on_screen = true;
-    }
-    for (i = 0; i < NUM_OF_IDS; i++) {
-        if (components[TIME].order == i) {
-            if (one_time_print) {
-                PRINT("TIME,");
-            } else {
+    struct playback_row row;
+    int i, j;
+
+    row.num = num_components;
+    for (i = 0; i < num_components; i++) {
+        int id = component_order[i];
+        struct playback_group *g = &row.g[i];
+        float *f = g->v.f;
+        long *l = g->v.l;
+
+        g->col = &columns[id];
+        switch (id) {
+        case TIME: {
 #ifdef WIN32
-                double time_ms;
-                static int first_value = 0;
-                if(first_value == 0){
-                    first_value = 1;
-                    start_counter(&pc_freq, &counter_start);
-                    time_ms = 0;
-                } else {
-                    time_ms = get_counter(&counter_start, &pc_freq);
-                }
-                PRINT("%6.0f,   ", time_ms);
-#else
-                unsigned long time_ms;
-                static int first_value = 0;
-                if(first_value == 0){
-                    first_value = 1;
-                    start_counter();
-                    time_ms = 0;
-                } else {
-                    time_ms = get_counter();
-                }
-                PRINT("%6ld,   ", time_ms);
-#endif
-            }
-        } else if (components[CALIBRATED_GYROSCOPE].order == i) {
-            if (one_time_print) {
-                PRINT("CALIBRATED_GYROSCOPE_X,"
-                      "CALIBRATED_GYROSCOPE_Y,"
-                      "CALIBRATED_GYROSCOPE_Z,");
-                /*
-                PRINT("CALIBRATED_GYROSCOPE_X_AVERAGE,"
-                      "CALIBRATED_GYROSCOPE_Y_AVERAGE,"
-                      "CALIBRATED_GYROSCOPE_Z_AVERAGE,");
-                */
-            } else {
-                /*
-                #define window 20
-                static int cnt = 0;
-                static int valid = 0;
-                static float gyro_keep[window][3];
-                int kk, jj;
-                float avg[3];
-                */
-                float gyro[3];
-                inv_get_gyro_float(gyro);
-                PRINT_3ELM_ARRAY_FLOAT(10, 5, gyro);
-                PRINT("  ");
-                /*
-                memcpy(gyro_keep[cnt], gyro, sizeof(float) * 3);
-                cnt= (cnt + 1) % window;
-                if (cnt == window - 1)
-                    valid = 1;
-                if (valid) {
-                    memset(avg, 0, sizeof(float) * 3);
-                    jj = (cnt + 1) % window;
-                    for (kk = 0; kk < window; kk++) {
-                        avg[0] += gyro_keep[jj][0] / window;
-                        avg[1] += gyro_keep[jj][1] / window;
-                        avg[2] += gyro_keep[jj][2] / window;
-                        jj = (jj + 1) % window;
-                    }
-                    PRINT("%+f, %+f, %+f,   ",
-                          UNPACK_3ELM_ARRAY(avg));
-                    PRINT_3ELM_ARRAY_FLOAT(10, 5, avg);
-                    PRINT("  ");
-                }
-                */
-            }
-        } else if (components[CALIBRATED_ACCELEROMETER].order == i) {
-            if (one_time_print) {
-                PRINT("CALIBRATED_ACCELEROMETER_X,"
-                      "CALIBRATED_ACCELEROMETER_Y,"
-                      "CALIBRATED_ACCELEROMETER_Z,");
-            } else {
-                float accel[3];
-                inv_get_accel_float(accel);
-                PRINT_3ELM_ARRAY_FLOAT(10, 5, accel);
-                PRINT("  ");
-            }
-        } else if (components[CALIBRATED_COMPASS].order == i) {
-            if (one_time_print) {
-                PRINT("CALIBRATED_COMPASS_X,"
-                      "CALIBRATED_COMPASS_Y,"
-                      "CALIBRATED_COMPASS_Z,");
-            } else {
-                long lcompass[3];
-                float compass[3];
-                inv_get_compass_set(lcompass, 0, 0);
-                compass[0] = inv_q16_to_float(lcompass[0]);
-                compass[1] = inv_q16_to_float(lcompass[1]);
-                compass[2] = inv_q16_to_float(lcompass[2]);
-                PRINT_3ELM_ARRAY_FLOAT(10, 5, compass);
-                PRINT("  ");
-            }
-        } else if (components[RAW_GYROSCOPE].order == i) {
-            if (one_time_print) {
-                PRINT("RAW_GYROSCOPE_X,"
-                      "RAW_GYROSCOPE_Y,"
-                      "RAW_GYROSCOPE_Z,");
-            } else {
-                short raw[3];
-                inv_get_sensor_type_gyro_raw_short(raw, NULL);
-                PRINT_3ELM_ARRAY_INT(6, raw);
-                PRINT("  ");
-            }
-        } else if (components[RAW_GYROSCOPE_BODY].order == i) {
-            if (one_time_print) {
-                PRINT("RAW_GYROSCOPE_BODY_X,"
-                      "RAW_GYROSCOPE_BODY_Y,"
-                      "RAW_GYROSCOPE_BODY_Z,");
-            } else {
-                float raw_body[3];
-                inv_get_sensor_type_gyro_raw_body_float(raw_body, NULL);
-                PRINT_3ELM_ARRAY_FLOAT(10, 5, raw_body);
-                PRINT("  ");
-            }
-        } else if (components[RAW_ACCELEROMETER].order == i) {
-            if (one_time_print) {
-                PRINT("RAW_ACCELEROMETER_X,"
-                      "RAW_ACCELEROMETER_Y,"
-                      "RAW_ACCELEROMETER_Z,");
-            } else {
-                short raw[3];
-                inv_get_sensor_type_accel_raw_short(raw, NULL);
-                PRINT_3ELM_ARRAY_INT(6, raw);
-                PRINT("  ");
-            }
-        } else if (components[RAW_COMPASS].order == i) {
-            if (one_time_print) {
-                PRINT("RAW_COMPASS_X,"
-                      "RAW_COMPASS_Y,"
-                      "RAW_COMPASS_Z,");
-            } else {
-                short raw[3];
-                inv_get_sensor_type_compass_raw_short(raw, NULL);
-                PRINT_3ELM_ARRAY_INT(6, raw);
-                PRINT("  ");
-            }
-        } else if (components[QUATERNION_9_AXIS].order == i) {
-            if (one_time_print) {
-                PRINT("QUATERNION_9_AXIS_X,"
-                      "QUATERNION_9_AXIS_Y,"
-                      "QUATERNION_9_AXIS_Z,"
-                      "QUATERNION_9_AXIS_w,");
-            } else {
-                float quat[4];
-                inv_get_quaternion_float(quat);
-                PRINT_4ELM_ARRAY_FLOAT(10, 5, quat);
-                PRINT("  ");
-            }
-        } else if (components[QUATERNION_6_AXIS].order == i) {
-            if (one_time_print) {
-                PRINT("QUATERNION_6_AXIS_X,"
-                      "QUATERNION_6_AXIS_Y,"
-                      "QUATERNION_6_AXIS_Z,"
-                      "QUATERNION_6_AXIS_w,");
-            } else {
-                float quat[4];
-                long temp[4];
-                int j;
-                inv_get_6axis_quaternion(temp);
-                for (j = 0; j < 4; j++)
-                    quat[j] = (float)temp[j] / (1 << 30);
-                PRINT_4ELM_ARRAY_FLOAT(10, 5, quat);
-                PRINT("  ");
-            }
-        } else if (components[HEADING].order == i) {
-            if (one_time_print) {
-                PRINT("HEADING,");
-            } else {
-                float heading[1];
-                inv_get_sensor_type_compass_float(heading, NULL, NULL,
-                                                  NULL, NULL);
-                PRINT_FLOAT(10, 5, heading[0]);
-                PRINT(",   ");
-            }
-        } else if (components[GRAVITY].order == i) {
-            if (one_time_print) {
-                PRINT("GRAVITY_X,"
-                      "GRAVITY_Y,"
-                      "GRAVITY_Z,");
-            } else {
-                float gravity[3];
-                inv_get_sensor_type_gravity_float(gravity, NULL, NULL);
-                PRINT_3ELM_ARRAY_FLOAT(10, 5, gravity);
-                PRINT("  ");
-            }
-        } else if (components[COMPASS_STATE].order == i) {
-            if (one_time_print) {
-                PRINT("COMPASS_STATE,"
-                      "GOT_COARSE_HEADING,");
-            } else {
-                PRINT_INT(1, inv_get_compass_state());
-                PRINT(", ");
-                PRINT_INT(1, inv_got_compass_bias());
-                PRINT(", ");
-            }
-        } else if (components[COMPASS_BIAS_ERROR].order == i) {
-            if (one_time_print) {
-                PRINT("COMPASS_BIAS_ERROR_X,"
-                      "COMPASS_BIAS_ERROR_Y,"
-                      "COMPASS_BIAS_ERROR_Z,");
-            } else {
-                long mbe[3];
-                inv_get_compass_bias_error(mbe);
-                PRINT_3ELM_ARRAY_LONG(6, mbe);
-            }
-        } else if (components[TEMPERATURE].order == i) {
-            if (one_time_print) {
-                PRINT("TEMPERATURE,");
-            } else {
-                float temp;
-                inv_get_sensor_type_temperature_float(&temp, NULL);
-                PRINT_FLOAT(8, 4, temp);
-                PRINT(",   ");
-            }
-        } else if (components[TEMP_COMP_SLOPE].order == i) {
-            if (one_time_print) {
-                PRINT("TEMP_COMP_SLOPE_X,"
-                      "TEMP_COMP_SLOPE_Y,"
-                      "TEMP_COMP_SLOPE_Z,");
-            } else {
-                long temp_slope[3];
-                float temp_slope_f[3];
-                (void)inv_get_gyro_ts(temp_slope);
-                temp_slope_f[0] = inv_q16_to_float(temp_slope[0]);
-                temp_slope_f[1] = inv_q16_to_float(temp_slope[1]);
-                temp_slope_f[2] = inv_q16_to_float(temp_slope[2]);
-                PRINT_3ELM_ARRAY_FLOAT(10, 5, temp_slope_f);
-                PRINT("  ");
-            }
-        } else if (components[LINEAR_ACCELERATION].order == i) {
-            if (one_time_print) {
-                PRINT("LINEAR_ACCELERATION_X,"
-                      "LINEAR_ACCELERATION_Y,"
-                      "LINEAR_ACCELERATION_Z,");
+            static int first_value = 0;
+            if(first_value == 0){
+                first_value = 1;
+                start_counter(&pc_freq, &counter_start);
+                l[0] = 0;
             } else {
-                float lin_acc[3];
-                inv_get_linear_accel_float(lin_acc);
-                PRINT_3ELM_ARRAY_FLOAT(10, 5, lin_acc);
-                PRINT("  ");
+                l[0] = (long)get_counter(&counter_start, &pc_freq);
             }
-        } else if (components[ROTATION_VECTOR].order == i) {
-            if (one_time_print) {
-                PRINT("ROTATION_VECTOR_X,"
-                      "ROTATION_VECTOR_Y,"
-                      "ROTATION_VECTOR_Z,");
-            } else {
-                float rot_vec[3];
-                inv_get_sensor_type_rotation_vector_float(rot_vec, NULL, NULL);
-                PRINT_3ELM_ARRAY_FLOAT(10, 5, rot_vec);
-                PRINT("  ");
-            }
-        } else if (components[MOTION_STATE].order == i) {
-            if (one_time_print) {
-                PRINT("MOTION_STATE,");
+#else
+            static int first_value = 0;
+            if(first_value == 0){
+                first_value = 1;
+                start_counter();
+                l[0] = 0;
             } else {
-                unsigned int counter;
-                PRINT_INT(1, inv_get_motion_state(&counter));
-                PRINT(",   ");
+                l[0] = (long)get_counter();
             }
-        } else {
-            ;
+#endif
+            break;
+        }
+        case CALIBRATED_GYROSCOPE:
+            inv_get_gyro_float(f);
+            break;
+        case CALIBRATED_ACCELEROMETER:
+            inv_get_accel_float(f);
+            break;
+        case CALIBRATED_COMPASS: {
+            long lcompass[3];
+            inv_get_compass_set(lcompass, 0, 0);
+            for (j = 0; j < 3; j++)
+                f[j] = inv_q16_to_float(lcompass[j]);
+            break;
+        }
+        case RAW_GYROSCOPE: {
+            short raw[3];
+            inv_get_sensor_type_gyro_raw_short(raw, NULL);
+            for (j = 0; j < 3; j++)
+                l[j] = raw[j];
+            break;
+        }
+        case RAW_GYROSCOPE_BODY:
+            inv_get_sensor_type_gyro_raw_body_float(f, NULL);
+            break;
+        case RAW_ACCELEROMETER: {
+            short raw[3];
+            inv_get_sensor_type_accel_raw_short(raw, NULL);
+            for (j = 0; j < 3; j++)
+                l[j] = raw[j];
+            break;
+        }
+        case RAW_COMPASS: {
+            short raw[3];
+            inv_get_sensor_type_compass_raw_short(raw, NULL);
+            for (j = 0; j < 3; j++)
+                l[j] = raw[j];
+            break;
+        }
+        case QUATERNION_9_AXIS:
+            inv_get_quaternion_float(f);
+            break;
+        case QUATERNION_6_AXIS: {
+            long temp[4];
+            inv_get_6axis_quaternion(temp);
+            for (j = 0; j < 4; j++)
+                f[j] = (float)temp[j] / (1 << 30);
+            break;
+        }
+        case HEADING:
+            inv_get_sensor_type_compass_float(f, NULL, NULL, NULL, NULL);
+            break;
+        case GRAVITY:
+            inv_get_sensor_type_gravity_float(f, NULL, NULL);
+            break;
+        case COMPASS_STATE:
+            l[0] = inv_get_compass_state();
+            l[1] = inv_got_compass_bias();
+            break;
+        case COMPASS_BIAS_ERROR:
+            inv_get_compass_bias_error(l);
+            break;
+        case TEMPERATURE:
+            inv_get_sensor_type_temperature_float(f, NULL);
+            break;
+        case TEMP_COMP_SLOPE: {
+            long temp_slope[3];
+            (void)inv_get_gyro_ts(temp_slope);
+            for (j = 0; j < 3; j++)
+                f[j] = inv_q16_to_float(temp_slope[j]);
+            break;
+        }
+        case LINEAR_ACCELERATION:
+            inv_get_linear_accel_float(f);
+            break;
+        case ROTATION_VECTOR:
+            inv_get_sensor_type_rotation_vector_float(f, NULL, NULL);
+            break;
+        case MOTION_STATE: {
+            unsigned int counter;
+            l[0] = inv_get_motion_state(&counter);
+            break;
+        }
+        case ORIENTATION: {
+            int8_t accuracy;
+            inv_time_t timestamp;
+            inv_get_sensor_type_orientation(f, &accuracy, &timestamp);
+            break;
+        }
         }
     }
-    PRINT("\n");
-
-    if (one_time_print) {
-        one_time_print = false;
-        print_on_screen = print_on_screen_saved;
-    }
+    playback_output_row(&row);
+    if (golden_check)
+        playback_golden_row(&row);
     sample_count++;
 }
 
@@ -594,7 +441,18 @@ void print_help(char *exename)
         "        [-o|--output PREFIX] = to dump data on csv file whose file\n"
         "                               prefix is specified by the parameter,\n"
         "                               e.g. '<PREFIX>-<timestamp>.csv'\n"
+        "        [-f|--format F]      = output backend:\n"
+        "                                 text = console and -o file (default)\n"
+        "                                 csv  = compact csv, needs -o\n"
+        "                                 bin  = binary records, needs -o,\n"
+        "                                        see playback_output.h\n"
+        "                                 null = no output, for timing\n"
         "        [-i|--input NAME]    = to read the provided playback.bin file\n"
+        "                               or trace (see -x)\n"
+        "        [-x|--convert NAME]  = convert the input to a columnar\n"
+        "                               trace file NAME and exit\n"
+        "        [-s|--start TS]      = start playing back at the first\n"
+        "                               sample recorded at or after TS\n"
         "        [-c|--comp C]        = enable the following components in the\n"
         "                               given order:\n"
         "                                 t = TIME\n"
@@ -615,7 +473,17 @@ void print_help(char *exename)
         "                                 H = HEADING,\n"
         "                                 E = COMPASS_BIAS_ERROR,\n"
         "                                 S = COMPASS_STATE,\n"
-        "                                 M = MOTION_STATE.\n"
+        "                                 M = MOTION_STATE,\n"
+        "                                 O = ORIENTATION.\n"
+        "        [-w|--write-golden NAME] = record the golden outputs\n"
+        "                               (" PLAYBACK_GOLDEN_COMPONENTS " in -c notation) of the input\n"
+        "                               to NAME, in the bin format\n"
+        "        [-g|--golden NAME]   = compare the golden outputs of the\n"
+        "                               input with NAME, see\n"
+        "                               playback_golden.h; the exit\n"
+        "                               status is non zero on a mismatch\n"
+        "        [-e|--tolerance S=V] = absolute tolerance V of stream S\n"
+        "                               for -g, e.g. GRAVITY=0.01\n"
         "\n"
         "Note on compass state values:\n"
         "    SF_NORMAL         = 0\n"
@@ -636,9 +504,10 @@ char *output_filename_datetimestamp(char *out)
     now = localtime(&t);
 
     sprintf(out,
-            "%02d%02d%02d_%02d%02d%02d.csv",
+            "%02d%02d%02d_%02d%02d%02d%s",
             now->tm_year - 100, now->tm_mon + 1, now->tm_mday,
-            now->tm_hour, now->tm_min, now->tm_sec);
+            now->tm_hour, now->tm_min, now->tm_sec,
+            playback_output_ext());
     return out;
 }
 
@@ -709,6 +578,9 @@ int components_parser(char pname[], char requested[], int length)
         case 'M':
             components[MOTION_STATE].order = j;
             break;
+        case 'O':
+            components[ORIENTATION].order = j;
+            break;
 
         default:
             MPL_LOGI("Error : unrecognized component '%c'\n",
@@ -718,6 +590,18 @@ int components_parser(char pname[], char requested[], int length)
             break;
         }
     }
+
+    /* output order, the same positions as the component letters */
+    num_components = 0;
+    for (j = 0; j < NUM_OF_IDS; j++) {
+        int id;
+        for (id = 0; id < NUM_OF_IDS; id++) {
+            if (components[id].order == j) {
+                component_order[num_components++] = id;
+                break;
+            }
+        }
+    }
     return 0;
 }
 
@@ -736,6 +620,12 @@ int main(int argc, char *argv[])
     double total_time;
     char req_component_list[50] = "tQGACH";
     char input_filename[101] = "/data/playback.bin";
+    char *convert_filename = NULL;
+    char *output_prefix = NULL;
+    char *golden_filename = NULL;
+    char *write_golden_filename = NULL;
+    int golden_failed = 0;
+    FILE *output_file = NULL;
     int i = 0;
     char *ver_str;
     /* flags */
@@ -764,18 +654,17 @@ int main(int argc, char *argv[])
 
         } else if(strcmp(argv[i], "-o") == 0
             || strcmp(argv[i], "--output") == 0) {
-            char output_filename[200];
-            char end[50] = "";
             i++;
+            output_prefix = argv[i];
 
-            snprintf(output_filename, sizeof(output_filename), "%s-%s",
-                    argv[i], output_filename_datetimestamp(end));
-            stream_file = fopen(output_filename, "w+");
-            if (!stream_file) {
-                printf("Unable to open file '%s'\n", output_filename);
-                return INV_ERROR;
+        } else if(strcmp(argv[i], "-f") == 0
+            || strcmp(argv[i], "--format") == 0) {
+            i++;
+            if (playback_output_select(argv[i])) {
+                MPL_LOGI("Error : unrecognized output format '%s'\n",
+                         argv[i]);
+                return INV_ERROR_INVALID_PARAMETER;
             }
-            MPL_LOGI("-- Output on file '%s'\n", output_filename);
 
         } else if(strcmp(argv[i], "-i") == 0
             || strcmp(argv[i], "--input") == 0) {
@@ -783,6 +672,16 @@ int main(int argc, char *argv[])
             strncpy(input_filename, argv[i], sizeof(input_filename));
             MPL_LOGI("-- Playing back file '%s'\n", input_filename);
 
+        } else if(strcmp(argv[i], "-x") == 0
+            || strcmp(argv[i], "--convert") == 0) {
+            i++;
+            convert_filename = argv[i];
+
+        } else if(strcmp(argv[i], "-s") == 0
+            || strcmp(argv[i], "--start") == 0) {
+            i++;
+            inv_set_playback_start(strtoll(argv[i], NULL, 0));
+
         } else if(strcmp(argv[i], "-n") == 0
             || strcmp(argv[i], "--nm") == 0) {
             i++;
@@ -810,12 +709,93 @@ int main(int argc, char *argv[])
             i++;
             strcpy(req_component_list, argv[i]);
 
+        } else if(strcmp(argv[i], "-g") == 0
+            || strcmp(argv[i], "--golden") == 0) {
+            i++;
+            golden_filename = argv[i];
+
+        } else if(strcmp(argv[i], "-w") == 0
+            || strcmp(argv[i], "--write-golden") == 0) {
+            i++;
+            write_golden_filename = argv[i];
+
+        } else if(strcmp(argv[i], "-e") == 0
+            || strcmp(argv[i], "--tolerance") == 0) {
+            i++;
+            if (playback_golden_tolerance(argv[i])) {
+                MPL_LOGI("Error : bad tolerance '%s'\n", argv[i]);
+                return INV_ERROR_INVALID_PARAMETER;
+            }
+
         } else {
             MPL_LOGI("Unrecognized command-line parameter '%s'\n", argv[i]);
             return INV_ERROR_INVALID_PARAMETER;
         }
     }
 
+    if (convert_filename) {
+        FILE *in = fopen(input_filename, "rb");
+        long records;
+
+        if (!in) {
+            MPL_LOGE("Error : cannot open playback file '%s'\n",
+                     input_filename);
+            return INV_ERROR_FILE_OPEN;
+        }
+        records = mpl_trace_convert(in, convert_filename);
+        fclose(in);
+        if (records < 0) {
+            MPL_LOGE("Error : conversion to '%s' failed (%ld)\n",
+                     convert_filename, records);
+            return INV_ERROR;
+        }
+        MPL_LOGI("-- Converted %ld records to '%s'\n",
+                 records, convert_filename);
+        return INV_SUCCESS;
+    }
+
+    if (golden_filename || write_golden_filename) {
+        /* the golden streams, with nothing on the console */
+        strcpy(req_component_list, PLAYBACK_GOLDEN_COMPONENTS);
+        if (golden_filename && write_golden_filename) {
+            MPL_LOGI("Error : -g and -w are exclusive\n");
+            return INV_ERROR_INVALID_PARAMETER;
+        }
+    }
+    if (write_golden_filename) {
+        playback_output_select("bin");
+        output_file = fopen(write_golden_filename, "wb");
+        if (!output_file) {
+            printf("Unable to open file '%s'\n", write_golden_filename);
+            return INV_ERROR;
+        }
+        MPL_LOGI("-- Golden output on file '%s'\n", write_golden_filename);
+    } else if (golden_filename) {
+        if (playback_golden_open(golden_filename)) {
+            MPL_LOGE("Error : cannot read golden file '%s'\n",
+                     golden_filename);
+            return INV_ERROR_FILE_OPEN;
+        }
+        golden_check = 1;
+        playback_output_select("null");
+    } else if (output_prefix) {
+        char output_filename[200];
+        char end[50] = "";
+
+        snprintf(output_filename, sizeof(output_filename), "%s-%s",
+                output_prefix, output_filename_datetimestamp(end));
+        output_file = fopen(output_filename, "w+");
+        if (!output_file) {
+            printf("Unable to open file '%s'\n", output_filename);
+            return INV_ERROR;
+        }
+        MPL_LOGI("-- Output on file '%s'\n", output_filename);
+    } else if (playback_output_needs_file()) {
+        MPL_LOGI("Error : '%s' output needs -o\n", playback_output_name());
+        return INV_ERROR_INVALID_PARAMETER;
+    }
+    playback_output_open(output_file);
+
     CALL_CHECK_N_RETURN_ERROR(
         components_parser(
             argv[0],
@@ -882,14 +862,23 @@ int main(int argc, char *argv[])
     inv_set_debug_mode(RD_PLAYBACK);
     CALL_N_CHECK(inv_playback());
 
+    /* the buffered backends still hold the tail of the output */
+    playback_output_close();
     total_time = (1.0 * inv_get_tick_count() - start_time) / 1000;
     if (total_time > 0) {
-        MPL_LOGI("\nPlayed back %ld samples in %.2f s (%.1f Hz)\n",
-                 sample_count, total_time , 1.0 * sample_count / total_time);
+        MPL_LOGI("\nPlayed back %ld samples in %.2f s (%.1f samples/s, "
+                 "%s output)\n",
+                 sample_count, total_time, 1.0 * sample_count / total_time,
+                 playback_output_name());
+    }
+    if (golden_check) {
+        golden_failed = playback_golden_report();
+        /* one line per trace for the corpus runner, golden_regress.sh */
+        printf("GOLDEN %s %s %lu %.3f\n", golden_failed ? "FAIL" : "PASS",
+               input_filename, sample_count, total_time);
+        if (golden_failed)
+            return INV_ERROR;
     }
-
-    if (stream_file)
-        fclose(stream_file);
 
     return INV_SUCCESS;
 }
@@ -0,0 +1,443 @@
+/*
+ * Columnar, memory-mapped container for MPL playback traces, see
+ * mpl_trace.h for the layout.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "data_builder.h"
+#include "mpl_trace.h"
+
+#define ALIGN8(x)   (((x) + 7) & ~(uint64_t)7)
+
+/* payload of every record type, in int32 values */
+static const signed char type_values[MPL_TRACE_NUM_TYPES] = {
+    [PLAYBACK_DBG_TYPE_GYRO]            = 3,
+    [PLAYBACK_DBG_TYPE_ACCEL]           = 3,
+    [PLAYBACK_DBG_TYPE_COMPASS]         = 3,
+    [PLAYBACK_DBG_TYPE_TEMPERATURE]     = 1,
+    [PLAYBACK_DBG_TYPE_EXECUTE]         = 0,
+    [PLAYBACK_DBG_TYPE_A_ORIENT]        = 2,
+    [PLAYBACK_DBG_TYPE_G_ORIENT]        = 2,
+    [PLAYBACK_DBG_TYPE_C_ORIENT]        = 2,
+    [PLAYBACK_DBG_TYPE_A_SAMPLE_RATE]   = 1,
+    [PLAYBACK_DBG_TYPE_C_SAMPLE_RATE]   = 1,
+    [PLAYBACK_DBG_TYPE_G_SAMPLE_RATE]   = 1,
+    [PLAYBACK_DBG_TYPE_GYRO_OFF]        = 0,
+    [PLAYBACK_DBG_TYPE_ACCEL_OFF]       = 0,
+    [PLAYBACK_DBG_TYPE_COMPASS_OFF]     = 0,
+    [PLAYBACK_DBG_TYPE_Q_SAMPLE_RATE]   = 1,
+    [PLAYBACK_DBG_TYPE_QUAT]            = 4,
+    [PLAYBACK_DBG_TYPE_QUAT_OFF]        = 0,
+};
+
+int mpl_trace_type_values(int type)
+{
+    if (type < 0 || type >= MPL_TRACE_NUM_TYPES)
+        return -1;
+    return type_values[type];
+}
+
+int mpl_trace_type_timed(int type)
+{
+    switch (type) {
+    case PLAYBACK_DBG_TYPE_GYRO:
+    case PLAYBACK_DBG_TYPE_ACCEL:
+    case PLAYBACK_DBG_TYPE_COMPASS:
+    case PLAYBACK_DBG_TYPE_TEMPERATURE:
+    case PLAYBACK_DBG_TYPE_QUAT:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static int type_is_config(int type)
+{
+    return !mpl_trace_type_timed(type) && type != PLAYBACK_DBG_TYPE_EXECUTE;
+}
+
+/*
+    Reader
+*/
+
+int mpl_trace_is_trace(const char *filename)
+{
+    char magic[8];
+    FILE *fp = fopen(filename, "rb");
+    int is_trace;
+
+    if (fp == NULL)
+        return 0;
+    is_trace = fread(magic, sizeof(magic), 1, fp) == 1 &&
+               memcmp(magic, MPL_TRACE_MAGIC, sizeof(MPL_TRACE_MAGIC)) == 0;
+    fclose(fp);
+    return is_trace;
+}
+
+static int column_ok(const struct mpl_trace_reader *rd, uint64_t off,
+                     uint64_t len)
+{
+    return (off & 7) == 0 && off <= rd->size && len <= rd->size - off;
+}
+
+static int check_index(const struct mpl_trace_reader *rd)
+{
+    uint32_t i, t;
+
+    for (i = 0; i < rd->hdr->num_chunks; i++) {
+        const struct mpl_trace_chunk *c = &rd->index[i];
+        uint32_t rows = 0;
+
+        if (c->records > MPL_TRACE_CHUNK_RECORDS ||
+                !column_ok(rd, c->type_offset, c->records))
+            return -EINVAL;
+        for (t = 0; t < MPL_TRACE_NUM_TYPES; t++) {
+            rows += c->rows[t];
+            if (!column_ok(rd, c->data_offset[t],
+                           (uint64_t)c->rows[t] * type_values[t] * 4))
+                return -EINVAL;
+            if (mpl_trace_type_timed(t) &&
+                    !column_ok(rd, c->ts_offset[t], (uint64_t)c->rows[t] * 8))
+                return -EINVAL;
+        }
+        if (rows != c->records)
+            return -EINVAL;
+    }
+    return 0;
+}
+
+int mpl_trace_open(struct mpl_trace_reader *rd, const char *filename)
+{
+    struct stat st;
+    void *base;
+    int fd, rt;
+
+    memset(rd, 0, sizeof(*rd));
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return -errno;
+    if (fstat(fd, &st) < 0) {
+        rt = -errno;
+        close(fd);
+        return rt;
+    }
+    if ((size_t)st.st_size < sizeof(*rd->hdr)) {
+        close(fd);
+        return -EINVAL;
+    }
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    rt = -errno;
+    close(fd);
+    if (base == MAP_FAILED)
+        return rt;
+    /* playback reads front to back */
+    madvise(base, st.st_size, MADV_SEQUENTIAL);
+
+    rd->base = base;
+    rd->size = st.st_size;
+    rd->hdr = (const struct mpl_trace_file_header *)base;
+    if (memcmp(rd->hdr->magic, MPL_TRACE_MAGIC, sizeof(MPL_TRACE_MAGIC)) ||
+            rd->hdr->version != MPL_TRACE_VERSION ||
+            !column_ok(rd, rd->hdr->index_offset, (uint64_t)
+                       rd->hdr->num_chunks * sizeof(struct mpl_trace_chunk))) {
+        mpl_trace_close(rd);
+        return -EINVAL;
+    }
+    rd->index = (const struct mpl_trace_chunk *)
+                (rd->base + rd->hdr->index_offset);
+    if (check_index(rd) < 0) {
+        mpl_trace_close(rd);
+        return -EINVAL;
+    }
+    return 0;
+}
+
+void mpl_trace_close(struct mpl_trace_reader *rd)
+{
+    if (rd->base)
+        munmap((void *)rd->base, rd->size);
+    memset(rd, 0, sizeof(*rd));
+}
+
+int mpl_trace_next(struct mpl_trace_reader *rd, struct mpl_trace_rec *rec)
+{
+    while (rd->chunk < rd->hdr->num_chunks) {
+        const struct mpl_trace_chunk *c = &rd->index[rd->chunk];
+        uint32_t r;
+        int type;
+
+        if (rd->record == c->records) {
+            rd->chunk++;
+            rd->record = 0;
+            memset(rd->row, 0, sizeof(rd->row));
+            continue;
+        }
+        type = rd->base[c->type_offset + rd->record++];
+        if (type >= MPL_TRACE_NUM_TYPES || rd->row[type] >= c->rows[type])
+            return 0;   /* corrupt type column */
+        r = rd->row[type]++;
+        rec->type = type;
+        rec->num = type_values[type];
+        rec->v = (const int32_t *)(rd->base + c->data_offset[type]) +
+                 (size_t)r * rec->num;
+        rec->ts = mpl_trace_type_timed(type) ?
+                  ((const int64_t *)(rd->base + c->ts_offset[type]))[r] : 0;
+        return 1;
+    }
+    return 0;
+}
+
+int mpl_trace_seek(struct mpl_trace_reader *rd, int64_t ts,
+                   void (*config)(const struct mpl_trace_rec *rec, void *arg),
+                   void *arg)
+{
+    struct mpl_trace_rec rec;
+    uint32_t lo = 0, hi = rd->hdr->num_chunks, target;
+
+    /* last_ts never decreases, first chunk that reaches @ts */
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (rd->index[mid].last_ts < ts)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    target = lo;
+
+    rd->chunk = 0;
+    rd->record = 0;
+    memset(rd->row, 0, sizeof(rd->row));
+    while (rd->chunk < target) {
+        const struct mpl_trace_chunk *c = &rd->index[rd->chunk];
+        const uint8_t *types = rd->base + c->type_offset;
+        uint32_t i;
+
+        /* only the one byte type column of skipped chunks is read */
+        for (i = 0; i < c->records; i++) {
+            if (types[i] >= MPL_TRACE_NUM_TYPES)
+                return -EINVAL;
+            if (config && type_is_config(types[i])) {
+                rd->record = i;
+                if (mpl_trace_next(rd, &rec))
+                    config(&rec, arg);
+            } else {
+                rd->row[types[i]]++;
+            }
+        }
+        rd->chunk++;
+        rd->record = 0;
+        memset(rd->row, 0, sizeof(rd->row));
+    }
+
+    while (rd->chunk < rd->hdr->num_chunks) {
+        uint32_t chunk = rd->chunk, record = rd->record;
+        uint32_t row[MPL_TRACE_NUM_TYPES];
+
+        memcpy(row, rd->row, sizeof(row));
+        if (!mpl_trace_next(rd, &rec))
+            break;
+        if (mpl_trace_type_timed(rec.type) && rec.ts >= ts) {
+            /* leave it for the next mpl_trace_next() */
+            rd->chunk = chunk;
+            rd->record = record;
+            memcpy(rd->row, row, sizeof(row));
+            return 0;
+        }
+        if (config && type_is_config(rec.type))
+            config(&rec, arg);
+    }
+    return -ENOENT;
+}
+
+/*
+    Writer
+*/
+
+struct trace_writer {
+    FILE *fp;
+    uint64_t offset;
+    struct mpl_trace_file_header hdr;
+    struct mpl_trace_chunk *index;
+    uint32_t index_size;
+    int64_t last_ts;
+    /* chunk being filled */
+    uint32_t records;
+    uint32_t rows[MPL_TRACE_NUM_TYPES];
+    int64_t first_ts;
+    uint8_t *types;
+    int32_t *data[MPL_TRACE_NUM_TYPES];
+    int64_t *ts[MPL_TRACE_NUM_TYPES];
+};
+
+static int put(struct trace_writer *w, const void *p, size_t len)
+{
+    static const uint8_t zero[8];
+    size_t pad = ALIGN8(w->offset) - w->offset;
+
+    if (pad && fwrite(zero, 1, pad, w->fp) != pad)
+        return -EIO;
+    w->offset += pad;
+    if (len && fwrite(p, 1, len, w->fp) != len)
+        return -EIO;
+    w->offset += len;
+    return 0;
+}
+
+static int flush_chunk(struct trace_writer *w)
+{
+    struct mpl_trace_chunk c;
+    int t, rt;
+
+    if (w->records == 0)
+        return 0;
+    if (w->hdr.num_chunks == w->index_size) {
+        uint32_t size = w->index_size ? w->index_size * 2 : 64;
+        void *p = realloc(w->index, size * sizeof(*w->index));
+        if (p == NULL)
+            return -ENOMEM;
+        w->index = p;
+        w->index_size = size;
+    }
+
+    memset(&c, 0, sizeof(c));
+    c.records = w->records;
+    c.first_ts = w->first_ts;
+    c.last_ts = w->last_ts;
+    rt = put(w, NULL, 0);
+    c.type_offset = w->offset;
+    rt |= put(w, w->types, w->records);
+    for (t = 0; t < MPL_TRACE_NUM_TYPES && rt == 0; t++) {
+        c.rows[t] = w->rows[t];
+        rt |= put(w, NULL, 0);
+        c.data_offset[t] = w->offset;
+        rt |= put(w, w->data[t], (size_t)w->rows[t] * type_values[t] * 4);
+        if (mpl_trace_type_timed(t)) {
+            rt |= put(w, NULL, 0);
+            c.ts_offset[t] = w->offset;
+            rt |= put(w, w->ts[t], (size_t)w->rows[t] * 8);
+        }
+    }
+    if (rt)
+        return rt;
+
+    w->index[w->hdr.num_chunks++] = c;
+    w->hdr.num_records += w->records;
+    w->records = 0;
+    memset(w->rows, 0, sizeof(w->rows));
+    w->first_ts = INT64_MAX;
+    return 0;
+}
+
+static int add_record(struct trace_writer *w, int type, const int32_t *v,
+                      int64_t ts)
+{
+    uint32_t r = w->rows[type]++;
+
+    w->types[w->records++] = (uint8_t)type;
+    memcpy(w->data[type] + (size_t)r * type_values[type], v,
+           type_values[type] * sizeof(*v));
+    if (mpl_trace_type_timed(type)) {
+        w->ts[type][r] = ts;
+        if (ts < w->first_ts)
+            w->first_ts = ts;
+        if (ts > w->last_ts)
+            w->last_ts = ts;
+    }
+    if (w->records == MPL_TRACE_CHUNK_RECORDS)
+        return flush_chunk(w);
+    return 0;
+}
+
+int mpl_trace_read_record(FILE *in, int *type, int32_t *v, int64_t *ts)
+{
+    inv_rd_dbg_states t;
+    int16_t gyro[3];
+    int i, n;
+
+    if (fread(&t, sizeof(t), 1, in) != 1)
+        return 0;
+    *type = t;
+    n = mpl_trace_type_values(t);
+    if (n < 0)
+        return -EINVAL;
+    if (t == PLAYBACK_DBG_TYPE_GYRO) {
+        if (fread(gyro, sizeof(gyro), 1, in) != 1)
+            return -EIO;
+        for (i = 0; i < 3; i++)
+            v[i] = gyro[i];
+    } else if (n && fread(v, sizeof(*v), n, in) != (size_t)n) {
+        return -EIO;
+    }
+    if (mpl_trace_type_timed(t) && fread(ts, sizeof(*ts), 1, in) != 1)
+        return -EIO;
+    return 1;
+}
+
+long mpl_trace_convert(FILE *in, const char *out)
+{
+    struct trace_writer w;
+    int32_t v[4];
+    int64_t ts = 0;
+    int t, type, rt;
+
+    memset(&w, 0, sizeof(w));
+    w.first_ts = INT64_MAX;
+    w.last_ts = INT64_MIN;
+    w.types = malloc(MPL_TRACE_CHUNK_RECORDS);
+    rt = w.types ? 0 : -ENOMEM;
+    for (t = 0; t < MPL_TRACE_NUM_TYPES && rt == 0; t++) {
+        if (type_values[t]) {
+            w.data[t] = malloc((size_t)MPL_TRACE_CHUNK_RECORDS *
+                               type_values[t] * sizeof(int32_t));
+            if (w.data[t] == NULL)
+                rt = -ENOMEM;
+        }
+        if (mpl_trace_type_timed(t)) {
+            w.ts[t] = malloc((size_t)MPL_TRACE_CHUNK_RECORDS *
+                             sizeof(int64_t));
+            if (w.ts[t] == NULL)
+                rt = -ENOMEM;
+        }
+    }
+    if (rt == 0) {
+        w.fp = fopen(out, "wb");
+        if (w.fp == NULL)
+            rt = -errno;
+    }
+
+    if (rt == 0) {
+        memcpy(w.hdr.magic, MPL_TRACE_MAGIC, sizeof(MPL_TRACE_MAGIC));
+        w.hdr.version = MPL_TRACE_VERSION;
+        /* placeholder, rewritten once the index is known */
+        rt = put(&w, &w.hdr, sizeof(w.hdr));
+    }
+    while (rt == 0 && (rt = mpl_trace_read_record(in, &type, v, &ts)) == 1)
+        rt = add_record(&w, type, v, ts);
+    if (rt == 0)
+        rt = flush_chunk(&w);
+    if (rt == 0) {
+        rt = put(&w, NULL, 0);
+        w.hdr.index_offset = w.offset;
+        rt |= put(&w, w.index, (size_t)w.hdr.num_chunks * sizeof(*w.index));
+    }
+    if (rt == 0 && (fseek(w.fp, 0, SEEK_SET) < 0 ||
+            fwrite(&w.hdr, sizeof(w.hdr), 1, w.fp) != 1))
+        rt = -EIO;
+    if (w.fp && fclose(w.fp) != 0 && rt == 0)
+        rt = -EIO;
+
+    free(w.types);
+    for (t = 0; t < MPL_TRACE_NUM_TYPES; t++) {
+        free(w.data[t]);
+        free(w.ts[t]);
+    }
+    free(w.index);
+    return rt < 0 ? rt : (long)w.hdr.num_records;
+}
@@ -0,0 +1,118 @@
+/*
+ * Columnar, memory-mapped container for MPL playback traces.
+ *
+ * The record stream written by the MPL in RD_RECORD mode is a sequence of
+ * (inv_rd_dbg_states, payload) pairs that can only be read front to back,
+ * one field at a time.  A trace keeps the same records, but cut into
+ * chunks of MPL_TRACE_CHUNK_RECORDS, and inside each chunk stores:
+ *
+ *   - the record types, one byte each, in recorded order
+ *   - per record type, the payloads as rows of int32
+ *   - per timestamped type, the timestamps as an int64 column
+ *
+ * followed at the end of the file by an index holding, for every chunk,
+ * the column offsets and the first and last timestamp.  The reader maps
+ * the file and walks the columns in place; mpl_trace_seek() binary
+ * searches the index, so any point of an hours long capture is reached
+ * without touching the data before it, apart from the type column of
+ * earlier chunks, which is scanned for configuration records
+ * (orientation, sample rates, sensor off) so the MPL state is right.
+ *
+ * All fields are little endian and every column starts 8 byte aligned.
+ */
+
+#ifndef MPL_TRACE_H__
+#define MPL_TRACE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MPL_TRACE_MAGIC             "MPLTRC1"
+#define MPL_TRACE_VERSION           (1)
+#define MPL_TRACE_CHUNK_RECORDS     (65536)
+/* one past the last inv_rd_dbg_states, PLAYBACK_DBG_TYPE_QUAT_OFF */
+#define MPL_TRACE_NUM_TYPES         (17)
+
+struct mpl_trace_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_chunks;
+    uint64_t num_records;
+    uint64_t index_offset;      /* num_chunks struct mpl_trace_chunk */
+};
+
+struct mpl_trace_chunk {
+    uint32_t records;
+    uint32_t rows[MPL_TRACE_NUM_TYPES];
+    int64_t first_ts;           /* INT64_MAX if no timestamped record */
+    int64_t last_ts;
+    uint64_t type_offset;
+    uint64_t data_offset[MPL_TRACE_NUM_TYPES];
+    uint64_t ts_offset[MPL_TRACE_NUM_TYPES];   /* 0 if untimed */
+};
+
+/* one record, pointing into the mapping */
+struct mpl_trace_rec {
+    int type;                   /* inv_rd_dbg_states */
+    int num;                    /* values in v */
+    const int32_t *v;
+    int64_t ts;                 /* 0 for untimed records */
+};
+
+struct mpl_trace_reader {
+    const uint8_t *base;
+    size_t size;
+    const struct mpl_trace_file_header *hdr;
+    const struct mpl_trace_chunk *index;
+    /* position */
+    uint32_t chunk;
+    uint32_t record;
+    uint32_t row[MPL_TRACE_NUM_TYPES];
+};
+
+/* values per record of @type, -1 for an unknown type */
+int mpl_trace_type_values(int type);
+/* whether records of @type carry a timestamp */
+int mpl_trace_type_timed(int type);
+
+int mpl_trace_is_trace(const char *filename);
+
+int mpl_trace_open(struct mpl_trace_reader *rd, const char *filename);
+void mpl_trace_close(struct mpl_trace_reader *rd);
+
+/*
+ * Next record, 1 if one was returned, 0 at the end of the trace.
+ */
+int mpl_trace_next(struct mpl_trace_reader *rd, struct mpl_trace_rec *rec);
+
+/*
+ * Move to the first timestamped record at or after @ts.  Configuration
+ * records before it are passed to @config, if given, in recorded order;
+ * data and execute records are skipped.
+ */
+int mpl_trace_seek(struct mpl_trace_reader *rd, int64_t ts,
+                   void (*config)(const struct mpl_trace_rec *rec, void *arg),
+                   void *arg);
+
+/*
+ * Read one record of the RD_RECORD stream, gyro widened to int32 and @ts
+ * left alone for untimed types.
+ * @return 1, 0 at the end of the stream, or a negative errno.
+ */
+int mpl_trace_read_record(FILE *in, int *type, int32_t *v, int64_t *ts);
+
+/*
+ * Convert the record stream in @in to a trace at @out.
+ * @return the number of records, or a negative errno.
+ */
+long mpl_trace_convert(FILE *in, const char *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MPL_TRACE_H__ */
@@ -0,0 +1,337 @@
+/*
+ * Golden output regression check of the playback tool, see
+ * playback_golden.h.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "playback_golden.h"
+
+#define GOLDEN_MAX_COLUMNS      (PLAYBACK_MAX_GROUPS * PLAYBACK_MAX_VALUES)
+#define GOLDEN_NAME_LEN         (64)
+#define GOLDEN_MAX_OVERRIDES    (16)
+/* streams that have no entry in default_tolerances[] */
+#define GOLDEN_DEFAULT_TOL      (1e-4)
+
+struct tolerance {
+    char name[GOLDEN_NAME_LEN];
+    double tol;
+};
+
+/*
+ * Loose enough for a different compiler or optimization level to reorder
+ * the float arithmetic, tight enough to catch a change of the algorithms.
+ */
+static const struct tolerance default_tolerances[] = {
+    { "CALIBRATED_GYROSCOPE",   1e-3 },     /* deg/s */
+    { "CALIBRATED_ACCELEROMETER", 1e-3 },   /* g */
+    { "CALIBRATED_COMPASS",     1e-2 },     /* uT */
+    { "GRAVITY",                1e-3 },     /* m/s^2 */
+    { "LINEAR_ACCELERATION",    1e-3 },     /* m/s^2 */
+    { "ROTATION_VECTOR",        1e-4 },
+    { "QUATERNION_9_AXIS",      1e-4 },
+    { "QUATERNION_6_AXIS",      1e-4 },
+    { "ORIENTATION",            1e-2 },     /* deg */
+};
+
+struct golden_stream {
+    char name[GOLDEN_NAME_LEN];
+    double tol;
+    int angle;                  /* compared modulo 360 */
+    double max_err;
+    unsigned long max_at;       /* sample of max_err */
+    unsigned long over;         /* samples out of tolerance */
+    int out;                    /* out of tolerance in the current sample */
+    int compared;               /* not TIME */
+};
+
+struct golden_column {
+    char name[GOLDEN_NAME_LEN];
+    int type;
+    int stream;
+};
+
+static struct tolerance overrides[GOLDEN_MAX_OVERRIDES];
+static int num_overrides;
+
+static char golden_path[256];
+static unsigned char *golden;
+static const unsigned char *records;
+static unsigned long num_records;
+static size_t record_size;
+
+static struct golden_column cols[GOLDEN_MAX_COLUMNS];
+static int num_cols;
+static struct golden_stream streams[GOLDEN_MAX_COLUMNS];
+static int num_streams;
+
+static unsigned long rows;
+static int layout_checked, layout_bad;
+
+int playback_golden_tolerance(const char *spec)
+{
+    const char *eq = strchr(spec, '=');
+    struct tolerance *t;
+    char *end;
+    size_t len;
+
+    if (!eq || eq == spec || num_overrides >= GOLDEN_MAX_OVERRIDES)
+        return -1;
+    len = eq - spec;
+    if (len >= GOLDEN_NAME_LEN)
+        return -1;
+    t = &overrides[num_overrides];
+    memcpy(t->name, spec, len);
+    t->name[len] = '\0';
+    t->tol = strtod(eq + 1, &end);
+    if (end == eq + 1 || *end || t->tol < 0)
+        return -1;
+    num_overrides++;
+    return 0;
+}
+
+static double stream_tolerance(const char *name)
+{
+    unsigned i;
+    int j;
+
+    for (j = num_overrides - 1; j >= 0; j--)
+        if (strcmp(overrides[j].name, name) == 0)
+            return overrides[j].tol;
+    for (i = 0; i < sizeof(default_tolerances) / sizeof(default_tolerances[0]);
+            i++)
+        if (strcmp(default_tolerances[i].name, name) == 0)
+            return default_tolerances[i].tol;
+    return GOLDEN_DEFAULT_TOL;
+}
+
+/* "GRAVITY_X" and "QUATERNION_9_AXIS_w" belong to "GRAVITY" and
+   "QUATERNION_9_AXIS", "HEADING" is a stream of its own */
+static void stream_name(const char *col, char *name)
+{
+    const char *us = strrchr(col, '_');
+    size_t len = strlen(col);
+
+    if (us && us[1] && !us[2])
+        len = us - col;
+    memcpy(name, col, len);
+    name[len] = '\0';
+}
+
+static void add_column(const char *name, int type)
+{
+    struct golden_column *c = &cols[num_cols++];
+    char sname[GOLDEN_NAME_LEN];
+    struct golden_stream *s;
+
+    strcpy(c->name, name);
+    c->type = type;
+    stream_name(name, sname);
+    if (num_streams && strcmp(streams[num_streams - 1].name, sname) == 0) {
+        c->stream = num_streams - 1;
+        return;
+    }
+    c->stream = num_streams;
+    s = &streams[num_streams++];
+    memset(s, 0, sizeof(*s));
+    strcpy(s->name, sname);
+    s->tol = stream_tolerance(sname);
+    s->angle = strcmp(sname, "ORIENTATION") == 0;
+}
+
+static int parse_header(size_t size)
+{
+    const unsigned char *p = golden, *end = golden + size;
+    uint32_t version, columns, i;
+    size_t len;
+
+    if (size < 16 || memcmp(p, PLAYBACK_OUTPUT_MAGIC, 8) != 0)
+        return -1;
+    memcpy(&version, p + 8, 4);
+    memcpy(&columns, p + 12, 4);
+    if (version != PLAYBACK_OUTPUT_VERSION
+            || columns == 0 || columns > GOLDEN_MAX_COLUMNS)
+        return -1;
+    p += 16;
+    for (i = 0; i < columns; i++) {
+        if (p >= end)
+            return -1;
+        len = strnlen((const char *)p + 1, end - p - 1);
+        if (p + 1 + len >= end || len >= GOLDEN_NAME_LEN)
+            return -1;
+        add_column((const char *)p + 1, *p);
+        p += len + 2;
+    }
+    records = p;
+    record_size = columns * 4;
+    num_records = (end - p) / record_size;
+    return 0;
+}
+
+int playback_golden_open(const char *path)
+{
+    FILE *f;
+    long size;
+
+    num_cols = num_streams = 0;
+    rows = 0;
+    layout_checked = layout_bad = 0;
+    snprintf(golden_path, sizeof(golden_path), "%s", path);
+
+    f = fopen(path, "rb");
+    if (!f)
+        return -1;
+    if (fseek(f, 0, SEEK_END) || (size = ftell(f)) < 0
+            || fseek(f, 0, SEEK_SET)) {
+        fclose(f);
+        return -1;
+    }
+    golden = malloc(size ? size : 1);
+    if (!golden || fread(golden, 1, size, f) != (size_t)size
+            || parse_header(size)) {
+        fclose(f);
+        free(golden);
+        golden = NULL;
+        return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+/* the row must hold the golden columns, in the same order */
+static int check_layout(const struct playback_row *row)
+{
+    char name[GOLDEN_NAME_LEN];
+    int i, j, n = 0;
+
+    for (i = 0; i < row->num; i++) {
+        const struct playback_column *c = row->g[i].col;
+        const char *label = c->labels;
+
+        for (j = 0; j < c->num; j++, n++) {
+            const char *comma = strchr(label, ',');
+            size_t len = comma ? (size_t)(comma - label) : strlen(label);
+
+            if (len >= sizeof(name))
+                len = sizeof(name) - 1;
+            memcpy(name, label, len);
+            name[len] = '\0';
+            label = comma ? comma + 1 : label + len;
+            if (n >= num_cols || cols[n].type != c->type
+                    || strcmp(cols[n].name, name) != 0) {
+                printf("golden: column %d is %s, '%s' has %s\n", n, name,
+                       golden_path, n < num_cols ? cols[n].name : "none");
+                return -1;
+            }
+        }
+    }
+    if (n != num_cols) {
+        printf("golden: %d columns, '%s' has %d\n", n, golden_path, num_cols);
+        return -1;
+    }
+    return 0;
+}
+
+static double float_error(const struct golden_stream *s, float got,
+                          float want)
+{
+    double err;
+
+    if (isnan(got) || isnan(want))
+        return isnan(got) && isnan(want) ? 0 : INFINITY;
+    err = fabs((double)got - (double)want);
+    if (s->angle) {
+        err = fmod(err, 360.0);
+        if (err > 180.0)
+            err = 360.0 - err;
+    }
+    return err;
+}
+
+void playback_golden_row(const struct playback_row *row)
+{
+    const unsigned char *rec;
+    int i, j, n = 0;
+
+    if (!golden)
+        return;
+    if (!layout_checked) {
+        layout_bad = check_layout(row);
+        layout_checked = 1;
+    }
+    if (layout_bad || rows >= num_records) {
+        rows++;
+        return;
+    }
+
+    rec = records + rows * record_size;
+    for (i = 0; i < row->num; i++) {
+        const struct playback_group *g = &row->g[i];
+
+        for (j = 0; j < g->col->num; j++, n++) {
+            struct golden_stream *s = &streams[cols[n].stream];
+            double err, tol = s->tol;
+            float want;
+            int32_t lwant;
+
+            switch (g->col->type) {
+            case PLAYBACK_FLOAT:
+                memcpy(&want, rec + n * 4, 4);
+                err = float_error(s, g->v.f[j], want);
+                break;
+            case PLAYBACK_INT:
+                memcpy(&lwant, rec + n * 4, 4);
+                err = fabs((double)g->v.l[j] - (double)lwant);
+                tol = 0;
+                break;
+            default:
+                continue;
+            }
+            s->compared = 1;
+            if (err > s->max_err) {
+                s->max_err = err;
+                s->max_at = rows;
+            }
+            if (err > tol)
+                s->out = 1;
+        }
+    }
+    /* one count per sample, whichever axis is out */
+    for (i = 0; i < num_streams; i++) {
+        streams[i].over += streams[i].out;
+        streams[i].out = 0;
+    }
+    rows++;
+}
+
+int playback_golden_report(void)
+{
+    int i, fail = 0;
+
+    if (!golden)
+        return 1;
+    printf("golden: '%s', %lu samples played back, %lu in the golden file\n",
+           golden_path, rows, num_records);
+    if (layout_bad)
+        fail = 1;
+    if (rows != num_records)
+        fail = 1;
+    for (i = 0; !layout_bad && i < num_streams; i++) {
+        const struct golden_stream *s = &streams[i];
+
+        if (!s->compared)
+            continue;
+        printf("  %-26s max err %.3e at %-7lu tol %.1e  %lu over  %s\n",
+               s->name, s->max_err, s->max_at, s->tol, s->over,
+               s->over ? "FAIL" : "ok");
+        if (s->over)
+            fail = 1;
+    }
+    printf("golden: %s\n", fail ? "FAIL" : "PASS");
+    free(golden);
+    golden = NULL;
+    return fail;
+}
@@ -0,0 +1,56 @@
+/*
+ * Golden output regression check of the playback tool.
+ *
+ * A golden file is the bin output (playback_output.h) of a known good
+ * build for one recorded trace, written with --write-golden.  --golden
+ * plays the same trace back and compares every sample of every stream
+ * against it:
+ *
+ *   - float values must stay within the absolute tolerance of their
+ *     stream, ORIENTATION is compared modulo 360 degrees
+ *   - int values must match exactly
+ *   - TIME columns are not compared, they are the host's wall clock
+ *
+ * A stream is the set of columns sharing a name up to a one letter
+ * suffix, e.g. GRAVITY_X, GRAVITY_Y and GRAVITY_Z.  The check fails if
+ * any value is out of tolerance, if the columns differ from the golden
+ * file, or if the number of samples differs.
+ */
+
+#ifndef PLAYBACK_GOLDEN_H__
+#define PLAYBACK_GOLDEN_H__
+
+#include "playback_output.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the components the golden files hold, in -c notation */
+#define PLAYBACK_GOLDEN_COMPONENTS  "VRGCO"
+
+/*
+ * Override the tolerance of a stream, "NAME=VALUE", before
+ * playback_golden_open().
+ * @return 0, or -1 for a malformed spec or too many overrides.
+ */
+int playback_golden_tolerance(const char *spec);
+
+/*
+ * Load the golden file @path.
+ * @return 0, or -1 if it cannot be read or is not a bin output file.
+ */
+int playback_golden_open(const char *path);
+/* compare the next sample */
+void playback_golden_row(const struct playback_row *row);
+/*
+ * Print the per stream results and release the golden file.
+ * @return 0 if the playback matched, 1 otherwise.
+ */
+int playback_golden_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLAYBACK_GOLDEN_H__ */
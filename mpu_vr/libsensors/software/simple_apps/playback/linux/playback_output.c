@@ -0,0 +1,364 @@
+/*
+ * Output backends of the playback tool, see playback_output.h.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "playback_output.h"
+
+#define OUT_BUF_SIZE        (1 << 20)
+/* a row never gets near this: 32 groups of 4 values of 24 characters */
+#define OUT_ROW_MAX         (PLAYBACK_MAX_GROUPS * PLAYBACK_MAX_VALUES * 24)
+
+struct backend {
+    const char *name;
+    const char *ext;
+    int needs_file;
+    void (*header)(const struct playback_row *row);
+    void (*row)(const struct playback_row *row);
+};
+
+static const struct backend *backend;
+static FILE *out_file;
+static int header_done;
+static char out_buf[OUT_BUF_SIZE];
+static size_t out_len;
+
+static void out_flush(void)
+{
+    if (out_len && out_file)
+        fwrite(out_buf, 1, out_len, out_file);
+    out_len = 0;
+}
+
+/* room for one more row */
+static char *out_reserve(void)
+{
+    if (out_len > sizeof(out_buf) - OUT_ROW_MAX)
+        out_flush();
+    return out_buf + out_len;
+}
+
+/* copy label @i of @labels, "A,B,C,", without the comma */
+static int label_at(const char *labels, int i, char *name, size_t size)
+{
+    const char *end;
+    size_t len;
+
+    for (; i > 0 && labels; i--) {
+        labels = strchr(labels, ',');
+        if (labels)
+            labels++;
+    }
+    if (!labels || !*labels)
+        return -1;
+    end = strchr(labels, ',');
+    len = end ? (size_t)(end - labels) : strlen(labels);
+    if (len >= size)
+        len = size - 1;
+    memcpy(name, labels, len);
+    name[len] = '\0';
+    return 0;
+}
+
+/*
+    text: what the tool has always printed
+*/
+static void text_header(const struct playback_row *row)
+{
+    int i;
+
+    for (i = 0; i < row->num; i++) {
+        printf("%s", row->g[i].col->labels);
+        if (out_file)
+            fprintf(out_file, "%s", row->g[i].col->labels);
+    }
+    printf("\n");
+    if (out_file)
+        fprintf(out_file, "\n");
+}
+
+static void text_row(const struct playback_row *row)
+{
+    int i, j;
+
+    for (i = 0; i < row->num; i++) {
+        const struct playback_group *g = &row->g[i];
+        const struct playback_column *c = g->col;
+
+        for (j = 0; j < c->num; j++) {
+            switch (c->type) {
+            case PLAYBACK_FLOAT:
+                printf("%+*.*f", c->width, c->prec, g->v.f[j]);
+                if (out_file)
+                    fprintf(out_file, "%+f", g->v.f[j]);
+                break;
+            case PLAYBACK_INT:
+                printf("%+*ld", c->width, g->v.l[j]);
+                if (out_file)
+                    fprintf(out_file, "%+ld", g->v.l[j]);
+                break;
+            default:
+                printf("%*lu", c->width, (unsigned long)g->v.l[j]);
+                if (out_file)
+                    fprintf(out_file, "%*lu", c->width,
+                            (unsigned long)g->v.l[j]);
+                break;
+            }
+            if (c->num > 1) {
+                printf(", ");
+                if (out_file)
+                    fprintf(out_file, ", ");
+            }
+        }
+        printf("%s", c->trailer);
+        if (out_file)
+            fprintf(out_file, "%s", c->trailer);
+    }
+    printf("\n");
+    if (out_file)
+        fprintf(out_file, "\n");
+}
+
+/*
+    csv
+*/
+static char *put_ulong(char *p, unsigned long long v)
+{
+    char tmp[24];
+    int n = 0;
+
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n)
+        *p++ = tmp[--n];
+    return p;
+}
+
+/*
+ * Six decimals with the rounding of "%f", trailing zeros dropped.
+ * Values too large for the fixed point path go through snprintf().
+ */
+static char *put_float(char *p, float f)
+{
+    double d = f, rem;
+    unsigned long long scaled, ip;
+    unsigned frac;
+    int i;
+
+    if (isnan(d)) {
+        memcpy(p, "nan", 3);
+        return p + 3;
+    }
+    if (fabs(d) >= 1e12)
+        return p + snprintf(p, 32, "%g", d);
+    /* exact for any float, so ties go to even like printf() */
+    d *= 1e6;
+    scaled = (unsigned long long)fabs(d);
+    rem = fabs(d) - (double)scaled;
+    if (rem > 0.5 || (rem == 0.5 && (scaled & 1)))
+        scaled++;
+    /* no "-0" for what rounds to zero */
+    if (d < 0 && scaled)
+        *p++ = '-';
+    ip = scaled / 1000000;
+    frac = (unsigned)(scaled % 1000000);
+    p = put_ulong(p, ip);
+    if (frac) {
+        *p++ = '.';
+        for (i = 5; i >= 0; i--) {
+            p[i] = (char)('0' + frac % 10);
+            frac /= 10;
+        }
+        for (i = 6; i > 0 && p[i - 1] == '0'; i--)
+            ;
+        p += i;
+    }
+    return p;
+}
+
+static void csv_header(const struct playback_row *row)
+{
+    char name[64];
+    char *p = out_reserve();
+    int i, j, first = 1;
+
+    for (i = 0; i < row->num; i++) {
+        for (j = 0; j < row->g[i].col->num; j++) {
+            if (label_at(row->g[i].col->labels, j, name, sizeof(name)))
+                strcpy(name, "?");
+            if (!first)
+                *p++ = ',';
+            first = 0;
+            p += sprintf(p, "%s", name);
+        }
+    }
+    *p++ = '\n';
+    out_len = p - out_buf;
+}
+
+static void csv_row(const struct playback_row *row)
+{
+    char *p = out_reserve();
+    int i, j, first = 1;
+
+    for (i = 0; i < row->num; i++) {
+        const struct playback_group *g = &row->g[i];
+
+        for (j = 0; j < g->col->num; j++) {
+            if (!first)
+                *p++ = ',';
+            first = 0;
+            switch (g->col->type) {
+            case PLAYBACK_FLOAT:
+                p = put_float(p, g->v.f[j]);
+                break;
+            case PLAYBACK_INT:
+                if (g->v.l[j] < 0) {
+                    *p++ = '-';
+                    p = put_ulong(p, 0ULL - (unsigned long long)g->v.l[j]);
+                } else {
+                    p = put_ulong(p, (unsigned long)g->v.l[j]);
+                }
+                break;
+            default:
+                p = put_ulong(p, (unsigned long)g->v.l[j]);
+                break;
+            }
+        }
+    }
+    *p++ = '\n';
+    out_len = p - out_buf;
+}
+
+/*
+    bin
+*/
+static void bin_header(const struct playback_row *row)
+{
+    char name[64];
+    char *p = out_reserve();
+    uint32_t v;
+    int i, j;
+
+    memcpy(p, PLAYBACK_OUTPUT_MAGIC, 8);
+    p += 8;
+    v = PLAYBACK_OUTPUT_VERSION;
+    memcpy(p, &v, 4);
+    p += 4;
+    v = 0;
+    for (i = 0; i < row->num; i++)
+        v += row->g[i].col->num;
+    memcpy(p, &v, 4);
+    p += 4;
+    for (i = 0; i < row->num; i++) {
+        for (j = 0; j < row->g[i].col->num; j++) {
+            if (label_at(row->g[i].col->labels, j, name, sizeof(name)))
+                strcpy(name, "?");
+            *p++ = (char)row->g[i].col->type;
+            p += sprintf(p, "%s", name) + 1;
+        }
+    }
+    out_len = p - out_buf;
+}
+
+static void bin_row(const struct playback_row *row)
+{
+    char *p = out_reserve();
+    int32_t l;
+    int i, j;
+
+    for (i = 0; i < row->num; i++) {
+        const struct playback_group *g = &row->g[i];
+
+        if (g->col->type == PLAYBACK_FLOAT) {
+            memcpy(p, g->v.f, g->col->num * sizeof(float));
+            p += g->col->num * sizeof(float);
+            continue;
+        }
+        for (j = 0; j < g->col->num; j++) {
+            l = (int32_t)g->v.l[j];
+            memcpy(p, &l, 4);
+            p += 4;
+        }
+    }
+    out_len = p - out_buf;
+}
+
+/*
+    null
+*/
+static void null_header(const struct playback_row *row)
+{
+    (void)row;
+}
+
+static void null_row(const struct playback_row *row)
+{
+    (void)row;
+}
+
+static const struct backend backends[] = {
+    { "text", ".csv", 0, text_header, text_row },
+    { "csv",  ".csv", 1, csv_header,  csv_row },
+    { "bin",  ".bin", 1, bin_header,  bin_row },
+    { "null", "",     0, null_header, null_row },
+};
+
+int playback_output_select(const char *name)
+{
+    unsigned i;
+
+    for (i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if (strcmp(backends[i].name, name) == 0) {
+            backend = &backends[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *playback_output_name(void)
+{
+    return backend ? backend->name : backends[0].name;
+}
+
+const char *playback_output_ext(void)
+{
+    return backend ? backend->ext : backends[0].ext;
+}
+
+int playback_output_needs_file(void)
+{
+    return backend ? backend->needs_file : backends[0].needs_file;
+}
+
+void playback_output_open(FILE *file)
+{
+    if (!backend)
+        backend = &backends[0];
+    out_file = file;
+    out_len = 0;
+    header_done = 0;
+}
+
+void playback_output_row(const struct playback_row *row)
+{
+    if (!header_done) {
+        backend->header(row);
+        header_done = 1;
+    }
+    backend->row(row);
+}
+
+void playback_output_close(void)
+{
+    out_flush();
+    if (out_file)
+        fclose(out_file);
+    out_file = NULL;
+}
@@ -0,0 +1,95 @@
+/*
+ * Output backends of the playback tool.
+ *
+ * fifo_callback() collects the requested components of one sample into a
+ * struct playback_row and hands it to the selected backend:
+ *
+ *   text   the historical output: printf() on the console with fixed
+ *          widths, and "%+f" per value in the -o file
+ *   csv    one line per sample, values formatted without stdio into a
+ *          single buffer, written in large blocks
+ *   bin    fixed size binary records, written in large blocks
+ *   null   nothing, to time the algorithms alone
+ *
+ * The bin format is a header, then one record per sample, all in host
+ * byte order:
+ *
+ *   char     magic[8]          PLAYBACK_OUTPUT_MAGIC
+ *   uint32   version           PLAYBACK_OUTPUT_VERSION
+ *   uint32   columns
+ *   columns times:
+ *     uint8  type              PLAYBACK_FLOAT, _INT or _TIME
+ *     char   name[]            NUL terminated
+ *   records: columns times 4 bytes, float32, int32 or uint32 (msec)
+ */
+
+#ifndef PLAYBACK_OUTPUT_H__
+#define PLAYBACK_OUTPUT_H__
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PLAYBACK_OUTPUT_MAGIC       "MPLOUT1"
+#define PLAYBACK_OUTPUT_VERSION     (1)
+
+#define PLAYBACK_MAX_VALUES         (4)
+#define PLAYBACK_MAX_GROUPS         (32)
+
+enum playback_value_type {
+    PLAYBACK_FLOAT = 0,
+    PLAYBACK_INT,
+    PLAYBACK_TIME,
+};
+
+/* one component, e.g. CALIBRATED_GYROSCOPE */
+struct playback_column {
+    const char *labels;         /* "NAME_X,NAME_Y,NAME_Z,", one per value */
+    int type;                   /* enum playback_value_type */
+    int num;                    /* values */
+    int width, prec;            /* text backend, console */
+    const char *trailer;        /* text backend, after the values */
+};
+
+struct playback_group {
+    const struct playback_column *col;
+    union {
+        float f[PLAYBACK_MAX_VALUES];
+        long l[PLAYBACK_MAX_VALUES];
+    } v;
+};
+
+struct playback_row {
+    int num;
+    struct playback_group g[PLAYBACK_MAX_GROUPS];
+};
+
+/*
+ * Select the backend by name, before playback_output_open().
+ * @return 0, or -1 for an unknown name.
+ */
+int playback_output_select(const char *name);
+const char *playback_output_name(void);
+/* file name extension of the selected backend, ".csv" or ".bin" */
+const char *playback_output_ext(void);
+
+/* whether the selected backend only writes to a file (csv, bin) */
+int playback_output_needs_file(void);
+
+/*
+ * Start writing to @file, NULL for none.  The text backend prints on the
+ * console in any case.
+ */
+void playback_output_open(FILE *file);
+/* the first row is preceded by the column names */
+void playback_output_row(const struct playback_row *row);
+/* flush what is buffered and close the file */
+void playback_output_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLAYBACK_OUTPUT_H__ */
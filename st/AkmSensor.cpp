@@ -25,6 +25,7 @@
 #include <cutils/log.h>
 
 #include "AkmSensor.h"
+#include "SampleAssembler.h"
 #include "akm8975.h"
 
 /*****************************************************************************/
@@ -38,6 +39,7 @@ AkmSensor::AkmSensor()
     memset(mPendingEvents, 0, sizeof(mPendingEvents));
     memset(mMagnInsertingEvents, 0, sizeof(mMagnInsertingEvents));
     mPretimestamp = 0;
+    sample_gap_init(&mGap, "st mag");
 /*
     mPendingEvents[Accelerometer].version = sizeof(sensors_event_t);
     mPendingEvents[Accelerometer].sensor = ID_A;
@@ -120,6 +122,7 @@ AkmSensor::AkmSensor()
 }
 
 AkmSensor::~AkmSensor() {
+    sample_gap_fini(&mGap);
 }
 
 int AkmSensor::enable(int32_t handle, int en)
@@ -207,13 +210,14 @@ int AkmSensor::update_delay()
         if (ioctl(dev_fd, ECS_IOCTL_APP_SET_DELAY, &delay)) {
             return -errno;
         }
+        sample_gap_reset(&mGap, wanted);
     }
     return result;
 }
 
 int AkmSensor::readEvents(sensors_event_t* data, int count)
 {
-	D("Entered : count = %d.", count);
+	HOT_LOGD("Entered : count = %d.", count);
     if (count < 1)
         return -EINVAL;
 
@@ -226,20 +230,27 @@ int AkmSensor::readEvents(sensors_event_t* data, int count)
 
     while (count && mInputReader.readEvent(&event)) {
         int type = event->type;
-        D("count = 0x%x, type = 0x%x.", count, type);
+        HOT_LOGD("count = 0x%x, type = 0x%x.", count, type);
         if (type == EV_ABS) {           // #define EV_ABS 0x03
             processEvent(event->code, event->value);
             mInputReader.next();
         } else if (type == EV_SYN) {    // #define EV_SYN 0x00
             for (int j=0 ; count && mPendingMask && j<numSensors ; j++) {
-                D("mPendingMask = 0x%x, j = %d; (mPendingMask & (1<<j)) = 0x%x", mPendingMask, j, (mPendingMask & (1<<j)) );
+                HOT_LOGD("mPendingMask = 0x%x, j = %d; (mPendingMask & (1<<j)) = 0x%x", mPendingMask, j, (mPendingMask & (1<<j)) );
                 if (mPendingMask & (1<<j)) {
                     mPendingMask &= ~(1<<j);
+                    if (j == MagneticField && (mEnabled & (1<<j)))
+                        sample_gap_check(&mGap, timevalToNano(event->time));
                     mPendingEvents[j].timestamp = getTimestamp();
-                    D( "mEnabled = 0x%x, j = %d; mEnabled & (1<<j) = 0x%x.", mEnabled, j, (mEnabled & (1 << j) ) );
+                    SENSOR_TRACE_MARK(TRACE_READ, mPendingEvents[j].sensor,
+                            mPendingEvents[j].timestamp);
+                    if (j == MagneticField)
+                        SampleAssembler::get().pushMag(mPendingEvents[j].magnetic.v,
+                                mPendingEvents[j].timestamp);
+                    HOT_LOGD( "mEnabled = 0x%x, j = %d; mEnabled & (1<<j) = 0x%x.", mEnabled, j, (mEnabled & (1 << j) ) );
                     if (mEnabled & (1<<j)) {
-                        D("hxw mPendingEvents[j].timestamp:%ld\n",mPendingEvents[j].timestamp);
-                        D("hxw mPretimestamp:%ld\n",mPretimestamp);
+                        HOT_LOGD("hxw mPendingEvents[j].timestamp:%ld\n",mPendingEvents[j].timestamp);
+                        HOT_LOGD("hxw mPretimestamp:%ld\n",mPretimestamp);
 #ifdef INSERT_FAKE_DATA
                         if(mPretimestamp == 0)mPretimestamp = mPendingEvents[j].timestamp;
                         int tmstamp_ms =  nanoseconds_to_milliseconds(mPendingEvents[j].timestamp - mPretimestamp);
@@ -253,6 +264,8 @@ int AkmSensor::readEvents(sensors_event_t* data, int count)
 	                     numEventReceived++;
                         }
 #endif
+                        SENSOR_TRACE_MARK(TRACE_OUTPUT, mPendingEvents[j].sensor,
+                                mPendingEvents[j].timestamp);
                         *data++ = mPendingEvents[j];
                         count--;
                         numEventReceived++;
@@ -285,14 +298,14 @@ void AkmSensor::instertFakeData(int num){
            //usleep(5000);
            //mMagnInsertingEvents[i].timestamp = getTimestamp();
            mMagnInsertingEvents[i].timestamp = mPendingEvents[MagneticField].timestamp - INSERT_DUR_MAX*1000000*(num-i);
-           D("hxw mMagnInsertingEvents[%d].timestamp:%ld\n",i,mMagnInsertingEvents[i].timestamp);
+           HOT_LOGD("hxw mMagnInsertingEvents[%d].timestamp:%ld\n",i,mMagnInsertingEvents[i].timestamp);
     }
 }
 
 
 void AkmSensor::processEvent(int code, int value)
 {
-	D("Entered : code = 0x%x, value = 0x%x.", code, value);
+	HOT_LOGD("Entered : code = 0x%x, value = 0x%x.", code, value);
     switch (code) {
 /*
         case EVENT_TYPE_ACCEL_X:
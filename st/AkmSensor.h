@@ -26,6 +26,7 @@
 #include "nusensors.h"
 #include "SensorBase.h"
 #include "InputEventReader.h"
+#include "sample_gap.h"
 
 /*****************************************************************************/
 
@@ -62,6 +63,7 @@ private:
     sensors_event_t mMagnInsertingEvents[INSERT_FAKE_MAX];
     int64_t mPretimestamp;
     uint64_t mDelays[numSensors];
+    struct sample_gap mGap;     // kernel EV_SYN times
 };
 
 /*****************************************************************************/
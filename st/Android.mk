@@ -61,10 +61,22 @@ LOCAL_SRC_FILES := \
 	SensorBase.cpp \
 	AkmSensor.cpp \
 	MmaSensor.cpp \
+	SampleAssembler.cpp \
 	LightSensor.cpp \
 	ProximitySensor.cpp \
 	PressureSensor.cpp \
-	TemperatureSensor.cpp
+	TemperatureSensor.cpp \
+	../common/sensor_log.c \
+	../common/sysfs_root.c \
+	../common/sample_gap.c \
+	../common/sensor_stats.c \
+	../common/sensor_trace.c \
+	../common/debug_config.c
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../common
+
+# hot path log ceiling, see common/sensor_log.h
+LOCAL_CFLAGS += -DSENSOR_LOG_LEVEL=SENSOR_LOG_LEVEL_WARN
 				
 LOCAL_SHARED_LIBRARIES := \
 	liblog \
@@ -88,6 +100,13 @@ endif
 
 include $(BUILD_SHARED_LIBRARY)
 
+######### Input device simulator #####################################
+
+# sim/Android.mk sets LOCAL_PATH to its own directory
+ST_HAL_PATH := $(LOCAL_PATH)
+include $(LOCAL_PATH)/sim/Android.mk
+LOCAL_PATH := $(ST_HAL_PATH)
+
 ######### AKM daemon #################################################
 
 ifeq ($(strip $(BOARD_SENSOR_COMPASS_AK8963)), true)
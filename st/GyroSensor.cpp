@@ -27,7 +27,7 @@
 #include "l3g4200d.h"
 
 #include "GyroSensor.h"
-#include "MEMSAlgLib_Fusion.h"
+#include "SampleAssembler.h"
 
 #define FETCH_FULL_EVENT_BEFORE_RETURN 1
 #define IGNORE_EVENT_TIME 350000000
@@ -48,6 +48,8 @@ GyroSensor::GyroSensor()
     mPendingEvent.type = SENSOR_TYPE_GYROSCOPE;
     mPendingEvent.gyro.status = SENSOR_STATUS_ACCURACY_HIGH;
     memset(mPendingEvent.data, 0x00, sizeof(mPendingEvent.data));
+    memset(mGyroRaw, 0, sizeof(mGyroRaw));
+    sample_gap_init(&mGap, "st gyro");
 	int err = 0;
     err = open_device();
 	err = err<0 ? -errno : 0;
@@ -73,6 +75,7 @@ GyroSensor::~GyroSensor() {
 	if (mEnabled) {
         enable(0, 0);
     }
+    sample_gap_fini(&mGap);
 }
 
 int GyroSensor::setInitialState() {
@@ -109,6 +112,7 @@ int GyroSensor::enable(int32_t, int en)
 		if (!err) {
 			mEnabled = en ? 1 : 0;
 			if (en) {
+				sample_gap_reset(&mGap, 0);
 				setInitialState();
 			}
 		}
@@ -133,6 +137,7 @@ int GyroSensor::setDelay(int32_t handle, int64_t ns)
     if (ioctl(dev_fd, L3G4200D_IOCTL_SET_DELAY, &delay)) {
         return -errno;
     }
+    sample_gap_reset(&mGap, ns);
     return 0;
 }
 
@@ -159,7 +164,6 @@ int GyroSensor::readEvents(sensors_event_t* data, int count)
 
     int numEventReceived = 0;
     input_event const* event;
-    float gyrox = 0, gyroy = 0, gyroz = 0;
 
 #if FETCH_FULL_EVENT_BEFORE_RETURN
 again:
@@ -171,54 +175,33 @@ again:
         if (type == EV_REL) {
             float value = event->value;
             if (event->code == EVENT_TYPE_GYRO_X) {
-                gyrox = value;
+                mGyroRaw[0] = value;
             } else if (event->code == EVENT_TYPE_GYRO_Y) {
-                gyroy = value;
+                mGyroRaw[1] = value;
             } else if (event->code == EVENT_TYPE_GYRO_Z) {
-                gyroz = value;
+                mGyroRaw[2] = value;
             }
-
-	    NineAxisTypeDef nineInput;
-            nineInput.ax =  1;
-            nineInput.ay =  1;
-            nineInput.az =  1000;
-            nineInput.mx =  300;
-            nineInput.my =  300;
-            nineInput.mz =  300;
-            nineInput.gx =  gyrox;
-            nineInput.gy =  gyroy;
-            nineInput.gz =  gyroz;
-
-            nineInput.time = getTimestamp()/1000000;
-
-#ifdef FLAG64BIT
-            float offx, offy, offz;
-            offx = 0.0;
-            offy = 0.0;
-            offz = 0.0;
-#else
-            FusionTypeDef fusionData = MEMSAlgLib_Fusion_Update(nineInput);
-            float offx, offy, offz;
-            offx = 0.0;
-            offy = 0.0;
-            offz = 0.0;
-            MEMSAlgLib_Fusion_Get_GyroOffset(&offx,&offy,&offz);
-#endif
-            //LOGD("gyro offset: %f, %f, %f", offx, offy, offz);
-            mPendingEvent.data[0] = (gyrox-offx) * CONVERT_GYRO_X;
-            mPendingEvent.data[1] = (gyroy-offy) * CONVERT_GYRO_Y;
-            mPendingEvent.data[2] = (gyroz-offz) * CONVERT_GYRO_Z;
-
-	    mPendingEvent.gyro.x =  mPendingEvent.data[0];
-            mPendingEvent.gyro.y =  mPendingEvent.data[1];
-            mPendingEvent.gyro.z =  mPendingEvent.data[2];
-	    //LOGD("mPendingEvent: %f, %f, %f", mPendingEvent.gyro.x, mPendingEvent.gyro.y, mPendingEvent.gyro.z);
         }else if (type == EV_SYN) {
            
             if(mEnabled) {
+                float off[3];
+                int64_t sample_ns = timevalToNano(event->time);
+                int lost;
+
+                /* frames the driver dropped would be integrated as one */
+                lost = sample_gap_check(&mGap, sample_ns);
+                if (lost > 0)
+                    SampleAssembler::get().markGap(lost * mGap.period_ns);
                 mPendingEvent.timestamp = getTimestamp();
-                D("hxw mPendingEvents[j].timestamp:%ld\n",mPendingEvent.timestamp);
-                D("hxw mPretimestamp:%ld\n",mPretimestamp);
+                SENSOR_TRACE_MARK(TRACE_READ, ID_GY, mPendingEvent.timestamp);
+                /* one fusion update per complete frame */
+                SampleAssembler::get().pushGyro(mGyroRaw,
+                        mPendingEvent.timestamp, sample_ns, off);
+                mPendingEvent.data[0] = (mGyroRaw[0] - off[0]) * CONVERT_GYRO_X;
+                mPendingEvent.data[1] = (mGyroRaw[1] - off[1]) * CONVERT_GYRO_Y;
+                mPendingEvent.data[2] = (mGyroRaw[2] - off[2]) * CONVERT_GYRO_Z;
+                HOT_LOGD("hxw mPendingEvents[j].timestamp:%ld\n",mPendingEvent.timestamp);
+                HOT_LOGD("hxw mPretimestamp:%ld\n",mPretimestamp);
 #ifdef INSERT_FAKE_DATA
                 if(mPretimestamp == 0)mPretimestamp = mPendingEvent.timestamp;
                 int tmstamp_ms =  nanoseconds_to_milliseconds(mPendingEvent.timestamp - mPretimestamp);
@@ -232,11 +215,14 @@ again:
                      numEventReceived++;
                 }
 #endif
+                SENSOR_TRACE_MARK(TRACE_OUTPUT, ID_GY, mPendingEvent.timestamp);
                 *data++ = mPendingEvent;
                 count--;
                 numEventReceived++;
                 mPretimestamp = mPendingEvent.timestamp;
             }
+            /* EV_REL axes are only reported when non-zero */
+            memset(mGyroRaw, 0, sizeof(mGyroRaw));
 
         }else {
             LOGE("GyroSensor: unknown event (type=%d, code=%d)", type, event->code);
@@ -269,7 +255,7 @@ void GyroSensor::instertFakeData(int num){
            //usleep(10);
            //mGyroInsertingEvents[i].timestamp = getTimestamp();
            mGyroInsertingEvents[i].timestamp = mPendingEvent.timestamp - INSERT_DUR_MAX*1000000*(num-i);
-           D("hxw mGyroInsertingEvents[%d].timestamp:%ld\n",i,mGyroInsertingEvents[i].timestamp);
+           HOT_LOGD("hxw mGyroInsertingEvents[%d].timestamp:%ld\n",i,mGyroInsertingEvents[i].timestamp);
     }
 }
 
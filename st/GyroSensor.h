@@ -25,6 +25,7 @@
 #include "nusensors.h"
 #include "SensorBase.h"
 #include "InputEventReader.h"
+#include "sample_gap.h"
 
 /*****************************************************************************/
 
@@ -34,12 +35,14 @@ class GyroSensor : public SensorBase {
     int mEnabled;
     InputEventCircularReader mInputReader;
     sensors_event_t mPendingEvent;
+    float mGyroRaw[3];      // current frame, raw LSB
     sensors_event_t mGyroInsertingEvents[INSERT_FAKE_MAX];
     int64_t mPretimestamp;
     bool mHasPendingEvent;
     char input_sysfs_path[PATH_MAX];
     int input_sysfs_path_len;
     int64_t mEnabledTime;
+    struct sample_gap mGap;     // kernel EV_SYN times
 
     int setInitialState();
 
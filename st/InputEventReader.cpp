@@ -62,7 +62,7 @@ ssize_t InputEventCircularReader::fill(int fd)
 
         numEventsRead = nread / sizeof(input_event);
         // dumpEvents(mHead, numEventsRead);
-        D("nread = %ld, numEventsRead = %d.", nread, numEventsRead);
+        HOT_LOGD("nread = %ld, numEventsRead = %d.", nread, numEventsRead);
         if (numEventsRead) {
             mHead += numEventsRead;
             mFreeSpace -= numEventsRead;
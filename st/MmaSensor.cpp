@@ -26,7 +26,9 @@
 #include <cutils/log.h>
 
 #include "MmaSensor.h"
+#include "SampleAssembler.h"
 #include "mma8452_kernel.h"
+#include "sysfs_root.h"
 
 #if defined(ANGLE_SUPPORT)
 static int sAngleFd = -1;
@@ -40,9 +42,12 @@ static int sKeyCtrl = -1;
 #define ANGLE_VALID_COUNT	5
 static int angle_open_device(void)
 {	
+	char path[PATH_MAX];
+
     if (sAngleFd < 0) 
     {
-		sAngleFd = open("/dev/angle", O_RDWR);
+		sysfs_root_path(path, sizeof(path), "/dev/angle");
+		sAngleFd = open(path, O_RDWR);
 		if(sAngleFd < 0)
 	    {
 			ALOGE("%s:line=%d,error=%s\n",__FUNCTION__, __LINE__, strerror(errno));
@@ -52,7 +57,8 @@ static int angle_open_device(void)
 
 	if (sAccFd < 0) 
     {
-		sAccFd = open(MMA_DEVICE_NAME, O_RDWR);
+		sysfs_root_path(path, sizeof(path), "%s", MMA_DEVICE_NAME);
+		sAccFd = open(path, O_RDWR);
 		if(sAccFd < 0)
 	    {
 			ALOGE("%s:line=%d,error=%s\n",__FUNCTION__, __LINE__, strerror(errno));
@@ -324,6 +330,7 @@ MmaSensor::MmaSensor()
     memset(mPendingEvents, 0, sizeof(mPendingEvents));
     memset(mAccelInsertingEvents, 0, sizeof(mAccelInsertingEvents));
     mPretimestamp = 0;
+    sample_gap_init(&mGap, "st accel");
 
     mPendingEvents[Accelerometer].version = sizeof(sensors_event_t);
     mPendingEvents[Accelerometer].sensor = ID_A;
@@ -352,6 +359,7 @@ MmaSensor::MmaSensor()
 }
 
 MmaSensor::~MmaSensor() {
+    sample_gap_fini(&mGap);
 }
 
 int MmaSensor::enable(int32_t handle, int en)
@@ -389,6 +397,7 @@ int MmaSensor::enable(int32_t handle, int en)
 				goto EXIT;
 			}
             mEnabled |= (1 << what);
+            sample_gap_reset(&mGap, mDelays[what]);
 		}
 		else {
             I("to call 'GSENSOR_IOCTL_CLOSE'.");
@@ -470,6 +479,7 @@ int MmaSensor::update_delay()
 				acceptable_sample_rate = MMA8452_RATE_50;
 		}
 		D("acceptable_sample_rate = %d", acceptable_sample_rate);
+		sample_gap_reset(&mGap, wanted);
 
 		if ( 0 > (result = ioctl(dev_fd, GSENSOR_IOCTL_APP_SET_RATE, &acceptable_sample_rate) ) ) {
 				E("fail to perform GSENSOR_IOCTL_APP_SET_RATE, result = %d, error is '%s'", result, strerror(errno) );
@@ -483,7 +493,7 @@ int MmaSensor::readEvents(sensors_event_t* data, int count)
 	#if defined(ANGLE_SUPPORT)	
 	int err = 0;
 	#endif
-	D("Entered : count = %d.", count);
+	HOT_LOGD("Entered : count = %d.", count);
     if (count < 1)
         return -EINVAL;
 
@@ -496,20 +506,25 @@ int MmaSensor::readEvents(sensors_event_t* data, int count)
 
     while (count && mInputReader.readEvent(&event)) {
         int type = event->type;
-        D("count = 0x%x, type = 0x%x.", count, type);
+        HOT_LOGD("count = 0x%x, type = 0x%x.", count, type);
         if (type == EV_ABS) {           // #define EV_ABS 0x03
             processEvent(event->code, event->value);
             mInputReader.next();
         } else if (type == EV_SYN) {    // #define EV_SYN 0x00
             for (int j=0 ; count && mPendingMask && j<numSensors ; j++) {
-                D("mPendingMask = 0x%x, j = %d; (mPendingMask & (1<<j)) = 0x%x", mPendingMask, j, (mPendingMask & (1<<j)) );
+                HOT_LOGD("mPendingMask = 0x%x, j = %d; (mPendingMask & (1<<j)) = 0x%x", mPendingMask, j, (mPendingMask & (1<<j)) );
                 if (mPendingMask & (1<<j)) {
                     mPendingMask &= ~(1<<j);
-                    D( "mEnabled = 0x%x, j = %d; mEnabled & (1<<j) = 0x%x.", mEnabled, j, (mEnabled & (1 << j) ) );
+                    HOT_LOGD( "mEnabled = 0x%x, j = %d; mEnabled & (1<<j) = 0x%x.", mEnabled, j, (mEnabled & (1 << j) ) );
                     if (mEnabled & (1<<j)) {
+                        sample_gap_check(&mGap, timevalToNano(event->time));
                         mPendingEvents[j].timestamp = getTimestamp();
-                        D("hxw mPendingEvents[j].timestamp:%ld\n",mPendingEvents[j].timestamp);
-                        D("hxw mPretimestamp:%ld\n",mPretimestamp);
+                        SENSOR_TRACE_MARK(TRACE_READ, mPendingEvents[j].sensor,
+                                mPendingEvents[j].timestamp);
+                        SampleAssembler::get().pushAccel(mPendingEvents[j].acceleration.v,
+                                mPendingEvents[j].timestamp);
+                        HOT_LOGD("hxw mPendingEvents[j].timestamp:%ld\n",mPendingEvents[j].timestamp);
+                        HOT_LOGD("hxw mPretimestamp:%ld\n",mPretimestamp);
 #ifdef INSERT_FAKE_DATA
                         if(mPretimestamp == 0)mPretimestamp = mPendingEvents[j].timestamp;
                         int tmstamp_ms =  nanoseconds_to_milliseconds(mPendingEvents[j].timestamp - mPretimestamp);
@@ -523,6 +538,8 @@ int MmaSensor::readEvents(sensors_event_t* data, int count)
 	                     numEventReceived++;
                         }
 #endif
+                        SENSOR_TRACE_MARK(TRACE_OUTPUT, mPendingEvents[j].sensor,
+                                mPendingEvents[j].timestamp);
                         *data++ = mPendingEvents[j];
                         count--;
                         numEventReceived++;
@@ -564,13 +581,13 @@ void MmaSensor::instertFakeData(int num){
            //usleep(10);
            //mAccelInsertingEvents[i].timestamp = getTimestamp();
            mAccelInsertingEvents[i].timestamp = mPendingEvents[Accelerometer].timestamp - INSERT_DUR_MAX*1000000*(num-i);
-           D("hxw mAccelInsertingEvents[%d].timestamp:%ld\n",i,mAccelInsertingEvents[i].timestamp);
+           HOT_LOGD("hxw mAccelInsertingEvents[%d].timestamp:%ld\n",i,mAccelInsertingEvents[i].timestamp);
     }
 }
 
 void MmaSensor::processEvent(int code, int value)
 {
-	D("Entered : code = 0x%x, value = 0x%x.", code, value);
+	HOT_LOGD("Entered : code = 0x%x, value = 0x%x.", code, value);
     switch (code) {
         case EVENT_TYPE_ACCEL_X:
             mPendingMask |= 1<<Accelerometer;
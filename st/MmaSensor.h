@@ -26,6 +26,7 @@
 #include "nusensors.h"
 #include "SensorBase.h"
 #include "InputEventReader.h"
+#include "sample_gap.h"
 
 /*****************************************************************************/
 
@@ -56,6 +57,7 @@ private:
     sensors_event_t mAccelInsertingEvents[INSERT_FAKE_MAX];
     int64_t mPretimestamp;
     uint64_t mDelays[numSensors];
+    struct sample_gap mGap;     // kernel EV_SYN times
 };
 
 /*****************************************************************************/
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "nusensors.h"
+#include "SampleAssembler.h"
+#include "MEMSAlgLib_Fusion.h"
+
+/* accel or compass frames older than this are not passed to fusion */
+#define FRAME_STALE_NS      1000000000LL
+
+/* used while there is no fresh frame, same as the old fixed inputs */
+#define DEFAULT_ACC_MG      { 1, 1, 1000 }
+#define DEFAULT_MAG_MGAUSS  { 300, 300, 300 }
+
+/*****************************************************************************/
+
+SampleAssembler::SampleAssembler()
+{
+    memset(&mAccel, 0, sizeof(mAccel));
+    memset(&mMag, 0, sizeof(mMag));
+    memset(mOffset, 0, sizeof(mOffset));
+    mTimeShift = 0;
+}
+
+SampleAssembler& SampleAssembler::get()
+{
+    static SampleAssembler instance;
+    return instance;
+}
+
+bool SampleAssembler::isFresh(const Frame& f, int64_t now)
+{
+    return f.timestamp != 0 && now - f.timestamp < FRAME_STALE_NS;
+}
+
+void SampleAssembler::pushAccel(const float* v, int64_t timestamp)
+{
+    memcpy(mAccel.v, v, sizeof(mAccel.v));
+    mAccel.timestamp = timestamp;
+}
+
+void SampleAssembler::pushMag(const float* v, int64_t timestamp)
+{
+    memcpy(mMag.v, v, sizeof(mMag.v));
+    mMag.timestamp = timestamp;
+}
+
+void SampleAssembler::markGap(int64_t ns)
+{
+    if (ns > 0)
+        mTimeShift += ns;
+}
+
+void SampleAssembler::pushGyro(const float* raw, int64_t timestamp,
+        int64_t sample_ns, float* offset)
+{
+#ifndef FLAG64BIT
+    static const long defAcc[3] = DEFAULT_ACC_MG;
+    static const long defMag[3] = DEFAULT_MAG_MGAUSS;
+    NineAxisTypeDef nineInput;
+
+    SENSOR_TRACE_MARK(TRACE_BUILD, -1, timestamp);
+    memset(&nineInput, 0, sizeof(nineInput));
+    if (isFresh(mAccel, timestamp)) {
+        /* m/s^2 -> mGravity */
+        nineInput.ax = long(mAccel.v[0] * 1000.0f / GRAVITY_EARTH);
+        nineInput.ay = long(mAccel.v[1] * 1000.0f / GRAVITY_EARTH);
+        nineInput.az = long(mAccel.v[2] * 1000.0f / GRAVITY_EARTH);
+    } else {
+        nineInput.ax = defAcc[0];
+        nineInput.ay = defAcc[1];
+        nineInput.az = defAcc[2];
+    }
+    if (isFresh(mMag, timestamp)) {
+        /* uT -> mGauss */
+        nineInput.mx = long(mMag.v[0] * 10.0f);
+        nineInput.my = long(mMag.v[1] * 10.0f);
+        nineInput.mz = long(mMag.v[2] * 10.0f);
+    } else {
+        nineInput.mx = defMag[0];
+        nineInput.my = defMag[1];
+        nineInput.mz = defMag[2];
+    }
+    nineInput.gx = long(raw[0]);
+    nineInput.gy = long(raw[1]);
+    nineInput.gz = long(raw[2]);
+    nineInput.time = long((sample_ns - mTimeShift) / 1000000);
+
+    MEMSAlgLib_Fusion_Update(nineInput);
+    MEMSAlgLib_Fusion_Get_GyroOffset(&mOffset[0], &mOffset[1], &mOffset[2]);
+    SENSOR_TRACE_MARK(TRACE_FUSION, -1, timestamp);
+    HOT_LOGV("fusion: acc %ld,%ld,%ld mag %ld,%ld,%ld offset %f,%f,%f",
+            nineInput.ax, nineInput.ay, nineInput.az,
+            nineInput.mx, nineInput.my, nineInput.mz,
+            mOffset[0], mOffset[1], mOffset[2]);
+#endif
+    memcpy(offset, mOffset, sizeof(mOffset));
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SAMPLE_ASSEMBLER_H
+#define ANDROID_SAMPLE_ASSEMBLER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/*****************************************************************************/
+
+/*
+ * Collects complete frames from the accel, compass and gyro drivers and
+ * feeds the iNEMO fusion library once per gyro frame.
+ *
+ * Every driver pushes its frame at EV_SYN, after all axes of the frame
+ * have been read.  Accel and compass frames are only stored; a gyro frame
+ * runs MEMSAlgLib_Fusion_Update() with the latest accel and compass data
+ * and returns the gyro offset estimated by the library.
+ *
+ * All drivers are read from the poll thread of sensors_poll_context_t, so
+ * no locking is done here.
+ */
+class SampleAssembler {
+    struct Frame {
+        float v[3];
+        int64_t timestamp;
+    };
+
+    Frame mAccel;           // m/s^2
+    Frame mMag;             // uT
+    float mOffset[3];       // gyro offset, raw LSB
+    int64_t mTimeShift;     // dropped gyro time hidden from the library
+
+    static bool isFresh(const Frame& f, int64_t now);
+
+public:
+            SampleAssembler();
+
+    static SampleAssembler& get();
+
+    /* android units, timestamps from SensorBase::getTimestamp() */
+    void pushAccel(const float* v, int64_t timestamp);
+    void pushMag(const float* v, int64_t timestamp);
+
+    /*
+     * raw gyro frame in LSB; offset receives the current offset in LSB.
+     * @sample_ns is the kernel EV_SYN time of the frame, the time base of
+     * the library and of markGap().
+     */
+    void pushGyro(const float* raw, int64_t timestamp, int64_t sample_ns,
+            float* offset);
+
+    /*
+     * The gyro driver dropped @ns worth of frames before the next one, as
+     * measured on the kernel times passed to pushGyro(); the library has
+     * no reset, so it is fed a time base without the hole instead of
+     * integrating the next frame over it.
+     */
+    void markGap(int64_t ns);
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_SAMPLE_ASSEMBLER_H
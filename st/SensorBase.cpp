@@ -26,6 +26,7 @@
 #include <linux/input.h>
 
 #include "SensorBase.h"
+#include "sysfs_root.h"
 
 //#define ENABLE_DEBUG_LOG
 #include "akm8975/custom_log.h"
@@ -52,7 +53,11 @@ SensorBase::~SensorBase() {
 
 int SensorBase::open_device() {
     if (dev_fd<0 && dev_name) {
-        dev_fd = open(dev_name, O_RDONLY);
+        char path[PATH_MAX];
+
+        if (sysfs_root_path(path, sizeof(path), "%s", dev_name) < 0)
+            return -ENAMETOOLONG;
+        dev_fd = open(path, O_RDONLY);
         if(dev_fd<0)
         {
 			LOGD("Couldn't open %s (%s)", dev_name, strerror(errno));
@@ -107,13 +112,15 @@ static int getInput(const char *inputName)
 
     if (first) {
         int fd = -1;
-        const char *dirname = "/dev/input";
+        char dirname[PATH_MAX];
         char devname[PATH_MAX];
         char *filename;
         DIR *dir;
         struct dirent *de;
 
         first = false;
+        if (sysfs_root_path(dirname, sizeof(dirname), "/dev/input") < 0)
+            return -1;
         for (i = 0; i < sizeof(dev)/sizeof(dev[0]); i++) {
             dev[i].fd = -1;
             dev[i].name[0] = '\0';
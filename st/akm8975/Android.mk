@@ -14,6 +14,7 @@ LOCAL_SRC_FILES:= \
 	AK8975Driver.c \
 	DispMessage.c \
 	FileIO.c \
+	HDOEWorker.c \
 	Measure.c \
 	misc.c \
 	main.c \
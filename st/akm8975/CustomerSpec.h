@@ -102,6 +102,12 @@
 #define CSPEC_SPI_USE			0     
 
 
+// Run HDOE on a worker thread Enable(1)/Disable(0)
+#define CSPEC_ASYNC_HDOE		1
+// Nice value of the HDOE worker thread
+#define CSPEC_HDOE_WORKER_NICE	10
+
+
 /*** Deprecate ****************************************************************/
 // Set Decimator for HDOEProcess( ) 
 // 8-16Hz : 1
@@ -0,0 +1,347 @@
+/******************************************************************************
+ *
+ * HDOE offset estimation worker. See HDOEWorker.h.
+ *
+ ******************************************************************************/
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "HDOEWorker.h"
+
+/*** Constant definition ******************************************************/
+#define SEQ_LOAD(p)			__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define SEQ_WRITE_BEGIN(p)	do { \
+		__atomic_store_n((p), *(p) + 1, __ATOMIC_RELAXED); \
+		__atomic_thread_fence(__ATOMIC_RELEASE); \
+	} while (0)
+#define SEQ_WRITE_END(p)	__atomic_store_n((p), *(p) + 1, __ATOMIC_RELEASE)
+#define SEQ_READ_RETRY(p, s) \
+	(__atomic_thread_fence(__ATOMIC_ACQUIRE), \
+	 __atomic_load_n((p), __ATOMIC_RELAXED) != (s))
+
+/*** Type declaration *********************************************************/
+/* Written by the measurement thread only. */
+typedef struct _HDOEW_RESET_SLOT {
+	uint32		seq;
+	int32		epoch;
+	int16		type;
+	int16vec	ho;
+	AKSC_HDST	hdst;
+	int16		initBuffer;
+} HDOEW_RESET_SLOT;
+
+/* Written by the measurement thread only. */
+typedef struct _HDOEW_REQUEST_SLOT {
+	uint32		seq;
+	int32		epoch;
+	int16vec	hdata[AKSC_HDATA_SIZE];
+	int16		hn;
+} HDOEW_REQUEST_SLOT;
+
+/* Written by the worker thread only. */
+typedef struct _HDOEW_RESULT_SLOT {
+	uint32			seq;
+	int32			epoch;
+	HDOEW_RESULT	result;
+} HDOEW_RESULT_SLOT;
+
+/*** Static variables *********************************************************/
+static pthread_t	s_thread;
+static sem_t		s_sem;
+static int			s_running = 0;
+static int			s_stop = 0;
+
+static HDOEW_RESET_SLOT		s_reset;
+static HDOEW_REQUEST_SLOT	s_request;
+static HDOEW_RESULT_SLOT	s_result;
+
+/* Owned by the measurement thread */
+static int32	s_epoch;
+static uint32	s_resultSeen;
+
+/* Owned by the worker thread */
+static uint8		w_licenser[AKSC_CI_MAX_CHARSIZE+1];
+static uint8		w_licensee[AKSC_CI_MAX_CHARSIZE+1];
+static int16		w_key[AKSC_CI_MAX_KEYSIZE];
+static AKSC_HDOEVAR	w_hdoev;
+static int16vec		w_ho;
+static AKSC_HDST	w_hdst;
+static int32		w_epoch;
+static uint32		w_resetDone;	/* also read by the measurement thread */
+static uint32		w_requestDone;
+
+/*!
+ Apply the latest reset command to the worker's HDOE state, if any.
+ */
+static void applyReset(void)
+{
+	HDOEW_RESET_SLOT cmd;
+	uint32 seq;
+
+	for (;;) {
+		seq = SEQ_LOAD(&s_reset.seq);
+		if (seq == w_resetDone) {
+			return;
+		}
+		if (seq & 1) {
+			sched_yield();
+			continue;
+		}
+		cmd = s_reset;
+		if (!SEQ_READ_RETRY(&s_reset.seq, seq)) {
+			break;
+		}
+	}
+
+	w_ho = cmd.ho;
+	w_hdst = cmd.hdst;
+	if (cmd.type == HDOEW_RESET_INIT) {
+		AKSC_InitHDOEProcPrmsS3(&w_hdoev, 1, &w_ho, w_hdst);
+	} else {
+		AKSC_SetHDOELevel(&w_hdoev, &w_ho, w_hdst, cmd.initBuffer);
+	}
+	w_epoch = cmd.epoch;
+	__atomic_store_n(&w_resetDone, seq, __ATOMIC_RELEASE);
+}
+
+/*!
+ Run AKSC_HDOEProcessS3 on the latest posted data, if any, and publish
+ the result.
+ */
+static void processRequest(void)
+{
+	static int16vec hdata[AKSC_HDATA_SIZE];
+	int16 hn;
+	int32 epoch;
+	int16 succ;
+	uint32 seq;
+
+	for (;;) {
+		seq = SEQ_LOAD(&s_request.seq);
+		if (seq == w_requestDone) {
+			return;
+		}
+		if (seq & 1) {
+			sched_yield();
+			continue;
+		}
+		epoch = s_request.epoch;
+		hn = s_request.hn;
+		memcpy(hdata, s_request.hdata, sizeof(hdata));
+		if (!SEQ_READ_RETRY(&s_request.seq, seq)) {
+			break;
+		}
+	}
+
+	/* Posted after a reset we have not seen yet; the reset has already
+	   woken us up again, so leave the request for the next round. */
+	if (epoch > w_epoch) {
+		return;
+	}
+	w_requestDone = seq;
+	if (epoch < w_epoch) {
+		return;
+	}
+
+	succ = AKSC_HDOEProcessS3(
+				w_licenser,
+				w_licensee,
+				w_key,
+				&w_hdoev,
+				hdata,
+				hn,
+				&w_ho,
+				&w_hdst
+			);
+
+	SEQ_WRITE_BEGIN(&s_result.seq);
+	s_result.epoch = w_epoch;
+	s_result.result.ho = w_ho;
+	s_result.result.hdst = w_hdst;
+	s_result.result.succ = succ;
+	s_result.result.hthIdx = w_hdoev.hthIdx;
+	s_result.result.hrdoeHR = w_hdoev.hrdoeHR;
+	SEQ_WRITE_END(&s_result.seq);
+}
+
+static void* thread_main(void* args)
+{
+	(void)args;
+
+	/* Stay below the measurement thread. */
+	setpriority(PRIO_PROCESS, (id_t)syscall(__NR_gettid),
+				CSPEC_HDOE_WORKER_NICE);
+
+	while (1) {
+		if (sem_wait(&s_sem) != 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			LOGE("%s: sem_wait failed (%s)", __FUNCTION__, strerror(errno));
+			break;
+		}
+		if (__atomic_load_n(&s_stop, __ATOMIC_ACQUIRE)) {
+			break;
+		}
+		applyReset();
+		processRequest();
+	}
+	return ((void*)0);
+}
+
+/*!
+ Start the worker. The worker's HDOE state is initialized from the
+ current offset and level in @a prms.
+ @return 1 on success, 0 if the thread could not be started.
+ @param[in] prms A pointer to a #AK8975PRMS structure.
+ */
+int16 HDOEWorker_Start(const AK8975PRMS* prms)
+{
+	if (s_running) {
+		return 1;
+	}
+
+	memcpy(w_licenser, prms->m_licenser, sizeof(w_licenser));
+	memcpy(w_licensee, prms->m_licensee, sizeof(w_licensee));
+	memcpy(w_key, prms->m_key, sizeof(w_key));
+	w_ho = prms->m_ho;
+	w_hdst = prms->m_hdst;
+	AKSC_InitHDOEProcPrmsS3(&w_hdoev, 1, &w_ho, w_hdst);
+
+	memset(&s_reset, 0, sizeof(s_reset));
+	memset(&s_request, 0, sizeof(s_request));
+	memset(&s_result, 0, sizeof(s_result));
+	s_epoch = 0;
+	s_resultSeen = 0;
+	w_epoch = 0;
+	w_resetDone = 0;
+	w_requestDone = 0;
+	s_stop = 0;
+
+	if (sem_init(&s_sem, 0, 0) != 0) {
+		LOGE("%s: sem_init failed (%s)", __FUNCTION__, strerror(errno));
+		return 0;
+	}
+	if (pthread_create(&s_thread, NULL, thread_main, NULL) != 0) {
+		LOGE("%s: pthread_create failed (%s)", __FUNCTION__, strerror(errno));
+		sem_destroy(&s_sem);
+		return 0;
+	}
+	s_running = 1;
+	return 1;
+}
+
+/*!
+ Stop the worker and wait for it to exit.
+ */
+void HDOEWorker_Stop(void)
+{
+	if (!s_running) {
+		return;
+	}
+	__atomic_store_n(&s_stop, 1, __ATOMIC_RELEASE);
+	sem_post(&s_sem);
+	pthread_join(s_thread, NULL);
+	sem_destroy(&s_sem);
+	s_running = 0;
+}
+
+/*!
+ @return 1 if HDOE runs on the worker, 0 if it must run inline.
+ */
+int16 HDOEWorker_IsRunning(void)
+{
+	return (int16)s_running;
+}
+
+/*!
+ Forward AKSC_SetHDOELevel() or AKSC_InitHDOEProcPrmsS3() to the worker.
+ Results computed before this call are discarded by HDOEWorker_Fetch().
+ Resets that the worker has not picked up yet are merged: an INIT
+ always survives and buffer clearing is sticky.
+ @param[in] type #HDOEW_RESET_LEVEL or #HDOEW_RESET_INIT
+ @param[in] ho Offset
+ @param[in] hdst HDOE level
+ @param[in] initBuffer Passed to AKSC_SetHDOELevel
+ */
+void HDOEWorker_Reset(
+	const int16		type,
+	const int16vec*	ho,
+	const AKSC_HDST	hdst,
+	const int16		initBuffer)
+{
+	int16 mtype = type;
+	int16 minit = initBuffer;
+
+	if (__atomic_load_n(&w_resetDone, __ATOMIC_ACQUIRE) != s_reset.seq) {
+		if (s_reset.type == HDOEW_RESET_INIT) {
+			mtype = HDOEW_RESET_INIT;
+		}
+		minit |= s_reset.initBuffer;
+	}
+
+	s_epoch++;
+	SEQ_WRITE_BEGIN(&s_reset.seq);
+	s_reset.epoch = s_epoch;
+	s_reset.type = mtype;
+	s_reset.ho = *ho;
+	s_reset.hdst = hdst;
+	s_reset.initBuffer = minit;
+	SEQ_WRITE_END(&s_reset.seq);
+
+	sem_post(&s_sem);
+}
+
+/*!
+ Hand a copy of the magnetic data to the worker. Never blocks; if the
+ worker is still busy, the previous request is replaced.
+ @param[in] hdata Vectors of data
+ @param[in] hn The number of data
+ */
+void HDOEWorker_Post(
+	const int16vec	hdata[],
+	const int16		hn)
+{
+	SEQ_WRITE_BEGIN(&s_request.seq);
+	s_request.epoch = s_epoch;
+	s_request.hn = hn;
+	memcpy(s_request.hdata, hdata, sizeof(s_request.hdata));
+	SEQ_WRITE_END(&s_request.seq);
+
+	sem_post(&s_sem);
+}
+
+/*!
+ Pick up a result published since the last call. Never blocks; a result
+ that is being written right now is picked up on the next call.
+ @return 1 if @a result holds a new result for the current offset
+ epoch, 0 otherwise.
+ @param[out] result Destination
+ */
+int16 HDOEWorker_Fetch(HDOEW_RESULT* result)
+{
+	HDOEW_RESULT tmp;
+	int32 epoch;
+	uint32 seq;
+
+	seq = SEQ_LOAD(&s_result.seq);
+	if ((seq & 1) || (seq == s_resultSeen)) {
+		return 0;
+	}
+	epoch = s_result.epoch;
+	tmp = s_result.result;
+	if (SEQ_READ_RETRY(&s_result.seq, seq)) {
+		return 0;
+	}
+
+	s_resultSeen = seq;
+	if (epoch != s_epoch) {
+		return 0;
+	}
+	*result = tmp;
+	return 1;
+}
@@ -0,0 +1,56 @@
+/******************************************************************************
+ *
+ * HDOE offset estimation worker.
+ *
+ * AKSC_HDOEProcessS3() is far more expensive than the rest of the
+ * per-sample processing, so it is moved off the measurement thread.
+ * The measurement thread posts copies of the magnetic data and reset
+ * commands; the worker owns its own AKSC_HDOEVAR and publishes the
+ * estimated offset and HDOE level back. All three mailboxes are
+ * single-slot sequence locks, so the measurement thread never blocks.
+ *
+ ******************************************************************************/
+#ifndef AKMD_INC_HDOEWORKER_H
+#define AKMD_INC_HDOEWORKER_H
+
+#include "AKCompass.h"
+
+/*** Constant definition ******************************************************/
+#define HDOEW_RESET_LEVEL	0	/*!< AKSC_SetHDOELevel() */
+#define HDOEW_RESET_INIT	1	/*!< AKSC_InitHDOEProcPrmsS3() */
+
+/*** Type declaration *********************************************************/
+typedef struct _HDOEW_RESULT {
+	int16vec	ho;		/*!< Estimated offset */
+	AKSC_HDST	hdst;	/*!< HDOE level */
+	int16		succ;	/*!< Return value of AKSC_HDOEProcessS3 */
+	int16		hthIdx;	/*!< Threshold index of the worker's AKSC_HDOEVAR */
+	int16		hrdoeHR;	/*!< Radius of the worker's AKSC_HDOEVAR */
+} HDOEW_RESULT;
+
+/*** Prototype of function ****************************************************/
+int16 HDOEWorker_Start(
+	const AK8975PRMS*	prms
+);
+
+void HDOEWorker_Stop(void);
+
+int16 HDOEWorker_IsRunning(void);
+
+void HDOEWorker_Reset(
+	const int16		type,
+	const int16vec*	ho,
+	const AKSC_HDST	hdst,
+	const int16		initBuffer
+);
+
+void HDOEWorker_Post(
+	const int16vec	hdata[],
+	const int16		hn
+);
+
+int16 HDOEWorker_Fetch(
+	HDOEW_RESULT*	result
+);
+
+#endif //AKMD_INC_HDOEWORKER_H
@@ -23,12 +23,110 @@
 #include "TestLimit.h"
 #include "FileIO.h"
 #include "DispMessage.h"
+#include "HDOEWorker.h"
 #include "misc.h"
 #include <errno.h>
 extern int g_file;			/*!< FD to AK8975 device file. @see : "MSENSOR_NAME" */
 
 //#define NOASA
 
+#define AKMD_LATENCY_BINS	16		/*!< log2(usec) latency bins */
+#define AKMD_LATENCY_DUMP	1000	/*!< Samples between dumps */
+
+/* Per-sample latency of MeasuringEventProcess */
+typedef struct _AKMD_LATENCY_HIST {
+	uint32	bin[AKMD_LATENCY_BINS];	/* bin[i]: [2^i, 2^(i+1)) usec */
+	uint32	count;
+	int64_t	max;
+} AKMD_LATENCY_HIST;
+
+/*!
+ Initialize HDOE parameters, on the worker too when it is running.
+ @param[in,out] prms A pointer to a #AK8975PRMS structure.
+ */
+static void initHDOE(AK8975PRMS* prms)
+{
+	AKSC_InitHDOEProcPrmsS3(
+							&prms->m_hdoev,
+							1,
+							&prms->m_ho,
+							prms->m_hdst
+							);
+	if (HDOEWorker_IsRunning()) {
+		HDOEWorker_Reset(HDOEW_RESET_INIT, &prms->m_ho, prms->m_hdst, 1);
+	}
+}
+
+/*!
+ Set a HDOE level, on the worker too when it is running.
+ @param[in,out] prms A pointer to a #AK8975PRMS structure.
+ @param[in] hdst HDOE level
+ */
+static void setHDOELevel(AK8975PRMS* prms, const AKSC_HDST hdst)
+{
+	AKSC_SetHDOELevel(
+					  &prms->m_hdoev,
+					  &prms->m_ho,
+					  hdst,
+					  1
+					  );
+	prms->m_hdst = hdst;
+	if (HDOEWorker_IsRunning()) {
+		HDOEWorker_Reset(HDOEW_RESET_LEVEL, &prms->m_ho, hdst, 1);
+	}
+}
+
+/*!
+ Take over the offset estimated by HDOE.
+ @param[in,out] prms A pointer to a #AK8975PRMS structure.
+ @param[in] ho Offset
+ @param[in] hdst HDOE level
+ @param[in] hdSucc Return value of AKSC_HDOEProcessS3
+ */
+static void updateHOffset(
+						  AK8975PRMS*		prms,
+						  const int16vec*	ho,
+						  const AKSC_HDST	hdst,
+						  const int16		hdSucc
+						  )
+{
+	prms->m_ho = *ho;
+	prms->m_hdst = hdst;
+	if(hdSucc > 0){
+		prms->HSUC_HO[prms->m_form] = prms->m_ho;
+		prms->HSUC_HDST[prms->m_form] = prms->m_hdst;
+		prms->HFLUCV_HREF[prms->m_form] = prms->m_hflucv.href;
+	}
+}
+
+static void latencyAdd(AKMD_LATENCY_HIST* h, const int64_t ns)
+{
+	int64_t us = ns / 1000;
+	int16 i = 0;
+
+	while ((us >>= 1) > 0 && i < (AKMD_LATENCY_BINS - 1)) {
+		i++;
+	}
+	h->bin[i]++;
+	h->count++;
+	if (ns > h->max) {
+		h->max = ns;
+	}
+}
+
+static void latencyDump(const AKMD_LATENCY_HIST* h)
+{
+	char buf[AKMD_LATENCY_BINS * 12];
+	int16 i;
+	int len = 0;
+
+	for (i = 0; i < AKMD_LATENCY_BINS; i++) {
+		len += snprintf(buf + len, sizeof(buf) - len, " %u", h->bin[i]);
+	}
+	LOGI("MeasuringEventProcess latency: n=%u max=%lldus log2(us) bins:%s",
+		 h->count, (long long)(h->max / 1000), buf);
+}
+
 /*!
  Initialize #AK8975PRMS structure. At first, 0 is set to all parameters. 
  After that, some parameters, which should not be 0, are set to specific
@@ -299,12 +397,7 @@ int16 InitAK8975_Measure(AK8975PRMS* prms)
 	AKSC_InitDecomp8975(prms->m_hdata);
 	
 	// Initialize HDOE parameters
-	AKSC_InitHDOEProcPrmsS3(
-							&prms->m_hdoev,
-							1,
-							&prms->m_ho,
-							prms->m_hdst
-							);
+	initHDOE(prms);
 	
 	AKSC_InitHFlucCheck(
 						&(prms->m_hflucv),
@@ -337,12 +430,7 @@ int16 SwitchFormation(AK8975PRMS* prms)
 	AKSC_InitDecomp8975(prms->m_hdata);
 	
 	// Initialize HDOE parameters
-	AKSC_InitHDOEProcPrmsS3(
-							&prms->m_hdoev,
-							1,
-							&prms->m_ho,
-							prms->m_hdst
-							);
+	initHDOE(prms);
 	
 	AKSC_InitHFlucCheck(
 						&(prms->m_hflucv),
@@ -617,6 +705,9 @@ void MeasureSNGLoop(AK8975PRMS* prms)
 	int32_t delay;
 	AKMD_INTERVAL interval;
 	struct timespec tsstart, tsend;
+	struct timespec evStart, evEnd;
+	AKMD_LATENCY_HIST latency;
+	memset(&latency, 0, sizeof(latency));
 	
 
 	if (openKey() < 0) {
@@ -628,6 +719,7 @@ void MeasureSNGLoop(AK8975PRMS* prms)
 	if (openFormation() < 0) {
 		DBGPRINT(DBG_LEVEL1, 
 				 "%s:%d Error.\n", __FUNCTION__, __LINE__);
+		closeKey();
 		return;
 	}
 
@@ -636,21 +728,28 @@ void MeasureSNGLoop(AK8975PRMS* prms)
 
 	// Initialize
 	if(InitAK8975_Measure(prms) != AKD_SUCCESS){
-		return;
+		goto MEASURE_SNG_END;
+	}
+
+#if CSPEC_ASYNC_HDOE
+	if (!HDOEWorker_Start(prms)) {
+		LOGW("%s: HDOE worker is not available, run it inline.",
+			 __FUNCTION__);
 	}
+#endif
 	
 	while(TRUE){
 		// Get start time
 		if (clock_gettime(CLOCK_REALTIME, &tsstart) < 0) {
 			DBGPRINT(DBG_LEVEL1, 
 					 "%s:%d Error.\n", __FUNCTION__, __LINE__);
-			return;
+			goto MEASURE_SNG_END;
 		}
 		// Set to SNG measurement pattern (Set CNTL register) 
 		if (AKD_SetMode(AK8975_MODE_SNG_MEASURE) != AKD_SUCCESS) {
 			DBGPRINT(DBG_LEVEL1, 
 					 "%s:%d Error.\n", __FUNCTION__, __LINE__);
-			return;
+			goto MEASURE_SNG_END;
 		}
 		
         // .! : ȡ M snesor ԭʼ. .  
@@ -660,7 +759,7 @@ void MeasureSNGLoop(AK8975PRMS* prms)
 		if (AKD_GetMagneticData(i2cData) != AKD_SUCCESS) {
 			DBGPRINT(DBG_LEVEL1, 
 					 "%s:%d Error.\n", __FUNCTION__, __LINE__);
-			return;
+			goto MEASURE_SNG_END;
 		}
 
 		// Copy to local variable
@@ -679,7 +778,7 @@ void MeasureSNGLoop(AK8975PRMS* prms)
         // .! : 
 		//  Get acceelration sensor's measurement data.
 		if (GetAccVec(prms) != AKRET_PROC_SUCCEED) {
-			return;
+			goto MEASURE_SNG_END;
 		}
         /*
 		DBGPRINT(DBG_LEVEL3, 
@@ -687,6 +786,7 @@ void MeasureSNGLoop(AK8975PRMS* prms)
 				 prms->m_avec.u.x, prms->m_avec.u.y, prms->m_avec.u.z);
         */
 		
+		clock_gettime(CLOCK_MONOTONIC, &evStart);
 		ret = MeasuringEventProcess(
 									bData,
 									prms,
@@ -694,6 +794,14 @@ void MeasureSNGLoop(AK8975PRMS* prms)
 									interval.decimator,
 									CSPEC_CNTSUSPEND_SNG
 									);
+		clock_gettime(CLOCK_MONOTONIC, &evEnd);
+		latencyAdd(&latency,
+				   (int64_t)(evEnd.tv_sec - evStart.tv_sec) * 1000000000LL +
+				   (evEnd.tv_nsec - evStart.tv_nsec));
+		if ((latency.count % AKMD_LATENCY_DUMP) == 0) {
+			DBGPRINT(DBG_LEVEL2, "latency n=%u max=%lldus\n",
+					 latency.count, (long long)(latency.max / 1000));
+		}
 		// Check the return value
 		if(ret == AKRET_PROC_SUCCEED){
 			if(prms->m_cntSuspend > 0){
@@ -751,7 +859,7 @@ void MeasureSNGLoop(AK8975PRMS* prms)
 		if (clock_gettime(CLOCK_REALTIME, &tsend) < 0) {
 			DBGPRINT(DBG_LEVEL1, 
 					 "%s:%d Error.\n", __FUNCTION__, __LINE__);
-			return;
+			goto MEASURE_SNG_END;
 		}
 		// calculate wait time
 		doze = interval.interval - ((tsend.tv_sec - tsstart.tv_sec)*1000000 +
@@ -764,6 +872,13 @@ void MeasureSNGLoop(AK8975PRMS* prms)
 		// DBGPRINT(DBG_LEVEL3, "Sleep %d usec.\n", doze);
 		usleep(doze);
 	}
+
+MEASURE_SNG_END:
+	HDOEWorker_Stop();
+	if (latency.count > 0) {
+		latencyDump(&latency);
+	}
+
 	// Set to PowerDown mode 
 	if (AKD_SetMode(AK8975_MODE_POWERDOWN) != AKD_SUCCESS) {
 		DBGPRINT(DBG_LEVEL1, 
@@ -803,6 +918,9 @@ int16 MeasuringEventProcess(
 	int16    aksc_ret;
 	int16    hdSucc;
 	int16    preThe;
+	int16vec hoffset;
+	AKSC_HDST hdst;
+	HDOEW_RESULT hdoeResult;
 	
 	dor = 0;
 	derr = 0;
@@ -852,45 +970,35 @@ int16 MeasuringEventProcess(
 		
 		if(hofl == 1){
 			// Set a HDOE level as "HDST_UNSOLVED" 
-			AKSC_SetHDOELevel(
-							  &prms->m_hdoev,
-							  &prms->m_ho,
-							  AKSC_HDST_UNSOLVED,
-							  1
-							  );
-			prms->m_hdst = AKSC_HDST_UNSOLVED;
+			setHDOELevel(prms, AKSC_HDST_UNSOLVED);
 			return AKRET_DATA_OVERFLOW;
 		}
 		else if(isOF == 1){
 			// Set a HDOE level as "HDST_UNSOLVED" 
-			AKSC_SetHDOELevel(
-							  &prms->m_hdoev,
-							  &prms->m_ho,
-							  AKSC_HDST_UNSOLVED,
-							  1
-							  );
-			prms->m_hdst = AKSC_HDST_UNSOLVED;
+			setHDOELevel(prms, AKSC_HDST_UNSOLVED);
 			return AKRET_HFLUC_OCCURRED;
 		}
 		else {
 			prms->m_callcnt--;
 			if(prms->m_callcnt <= 0){
 				//Calculate Magnetic sensor's offset by DOE     .Q : DOE ?
-				hdSucc = AKSC_HDOEProcessS3(
-											prms->m_licenser,
-											prms->m_licensee,
-											prms->m_key,
-											&prms->m_hdoev,
-											prms->m_hdata,
-											prms->m_hn,
-											&prms->m_ho,
-											&prms->m_hdst
-											);
-				
-				if(hdSucc > 0){
-					prms->HSUC_HO[prms->m_form] = prms->m_ho;
-					prms->HSUC_HDST[prms->m_form] = prms->m_hdst;
-					prms->HFLUCV_HREF[prms->m_form] = prms->m_hflucv.href;
+				if (HDOEWorker_IsRunning()) {
+					// The result is picked up by a later call.
+					HDOEWorker_Post(prms->m_hdata, prms->m_hn);
+				} else {
+					hoffset = prms->m_ho;
+					hdst = prms->m_hdst;
+					hdSucc = AKSC_HDOEProcessS3(
+												prms->m_licenser,
+												prms->m_licensee,
+												prms->m_key,
+												&prms->m_hdoev,
+												prms->m_hdata,
+												prms->m_hn,
+												&hoffset,
+												&hdst
+												);
+					updateHOffset(prms, &hoffset, hdst, hdSucc);
 				}
 				
 				prms->m_callcnt = hDecimator;
@@ -898,6 +1006,15 @@ int16 MeasuringEventProcess(
 		}
 	}
 	
+	// Use the latest offset published by the HDOE worker
+	if (HDOEWorker_IsRunning() && HDOEWorker_Fetch(&hdoeResult)) {
+		updateHOffset(prms, &hdoeResult.ho, hdoeResult.hdst,
+					  hdoeResult.succ);
+		// The worker owns the live AKSC_HDOEVAR; mirror what DispMessage shows.
+		prms->m_hdoev.hthIdx = hdoeResult.hthIdx;
+		prms->m_hdoev.hrdoeHR = hdoeResult.hrdoeHR;
+	}
+	
 	// Subtract offset and normalize magnetic field vector.
 	aksc_ret = AKSC_VNorm(
 						  &have,
@@ -26,6 +26,7 @@
 #include <linux/input.h>
 
 #include <cutils/atomic.h>
+#include <utils/SystemClock.h>
 #include <math.h>
 
 #include "nusensors.h"
@@ -36,6 +37,8 @@
 #include "GyroSensor.h"
 #include "PressureSensor.h"
 #include "TemperatureSensor.h"
+#include "sensor_stats.h"
+#include "debug_config.h"
 
 #if defined(CALIBRATION_SUPPORT)
 typedef		unsigned short	    uint16;
@@ -263,6 +266,7 @@ int sensors_poll_context_t::activate(int handle, int enabled) {
 	}
 #endif
     int err =  mSensors[index]->enable(handle, enabled);
+    sensor_stats_config(handle, NULL, -1);
     if (enabled && !err) {
         const char wakeMessage(WAKE_MESSAGE);
         int result = write(mWritePipeFd, &wakeMessage, 1);
@@ -275,22 +279,25 @@ int sensors_poll_context_t::setDelay(int handle, int64_t ns) {
 
     int index = handleToDriver(handle);
     if (index < 0) return index;
+    sensor_stats_config(handle, NULL, ns);
     return mSensors[index]->setDelay(handle, ns);
 }
 
 int sensors_poll_context_t::pollEvents(sensors_event_t* data, int count)
 {
-	D("Entered : count = %d", count);
+	HOT_LOGD("Entered : count = %d", count);
     int nbEvents = 0;
     int n = 0;
 
+    sensor_debug_poll();
+
     do {
         // see if we have some leftover from the last poll()
         for (int i=0 ; count && i<numSensorDrivers ; i++) {
             SensorBase* const sensor(mSensors[i]);
             if ((mPollFds[i].revents & POLLIN) || (sensor->hasPendingEvents())) {
                 int nb = sensor->readEvents(data, count);	// num of evens received.
-				D("nb = %d.", nb);
+				HOT_LOGD("nb = %d.", nb);
 				#if defined(CALIBRATION_SUPPORT)
 				if(i == mma)
 				{
@@ -303,10 +310,19 @@ int sensors_poll_context_t::pollEvents(sensors_event_t* data, int count)
                     // no more data for this sensor
                     mPollFds[i].revents = 0;
                 }
+                if (nb > 0) {
+                    /* same clock as SensorBase::getTimestamp() */
+                    int64_t now = android::elapsedRealtimeNano();
+
+                    for (int j = 0; j < nb; j++) {
+                        sensor_stats_event(data[j].sensor, data[j].timestamp, now);
+                        SENSOR_TRACE_MARK(TRACE_POLL, data[j].sensor, data[j].timestamp);
+                    }
+                }
                 count -= nb;
                 nbEvents += nb;
                 data += nb;
-				D("count = %d, nbEvents = %d, data = 0x%p.", count, nbEvents, data);
+				HOT_LOGD("count = %d, nbEvents = %d, data = 0x%p.", count, nbEvents, data);
             }
         }
 
@@ -328,10 +344,10 @@ int sensors_poll_context_t::pollEvents(sensors_event_t* data, int count)
             }
         }
         // if we have events and space, go read them
-		D("n =0x%x, count = 0x%x.", n, count);
+		HOT_LOGD("n =0x%x, count = 0x%x.", n, count);
     } while (n && count);
 
-	D("to return : nbEvents = %d", nbEvents);
+	HOT_LOGD("to return : nbEvents = %d", nbEvents);
     return nbEvents;
 }
 
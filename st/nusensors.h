@@ -32,6 +32,8 @@
 
 //#define ENABLE_DEBUG_LOG
 #include "akm8975/custom_log.h"
+#include "sensor_log.h"
+#include "sensor_trace.h"
 
 /*
 sensor hal v1.1 add pressure and temperature support 2013-2-27
@@ -17,6 +17,7 @@
 #include <hardware/sensors.h>
 
 #include "nusensors.h"
+#include "sensor_stats.h"
 
 /*****************************************************************************/
 
@@ -168,5 +169,10 @@ static struct hw_module_methods_t sensors_module_methods = {
 static int open_sensors(const struct hw_module_t* module, const char* name,
         struct hw_device_t** device)
 {
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(sSensorList); i++)
+        sensor_stats_config(sSensorList[i].handle, sSensorList[i].name, -1);
+    sensor_stats_start(SENSOR_STATS_FIFO);
     return init_nusensors(module, device);
 }
@@ -0,0 +1,49 @@
+#
+# Simulated input devices for the ST HAL, see input_sim.h.
+#   st_input_sim -t 60 &
+#   SENSORS_SYSFS_ROOT=<printed root> LD_PRELOAD=libinput_sim_ioctl.so \
+#       sensors_hal_bench -l /system/lib/hw/sensors.$(TARGET_BOARD_HARDWARE).so
+# (sensors_hal_bench is in mpu/libsensors/sim.)  With the fifo backend the
+# sim writes struct input_event as its own ABI lays it out, so run the
+# 32-bit st_input_sim against a 32-bit HAL.
+#
+LOCAL_PATH:= $(call my-dir)
+
+INPUT_SIM_CFLAGS := -Wall -Wextra -O2
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := st_input_sim
+LOCAL_MODULE_TAGS := optional
+LOCAL_MULTILIB := both
+LOCAL_MODULE_STEM_32 := st_input_sim
+LOCAL_MODULE_STEM_64 := st_input_sim64
+LOCAL_CFLAGS := $(INPUT_SIM_CFLAGS)
+LOCAL_SRC_FILES := input_sim.c input_sim_main.c
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := st_input_sim
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := $(INPUT_SIM_CFLAGS)
+LOCAL_SRC_FILES := input_sim.c input_sim_main.c
+LOCAL_LDLIBS := -lm -lrt
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := libinput_sim_ioctl
+LOCAL_MODULE_TAGS := optional
+LOCAL_MULTILIB := both
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../../common
+LOCAL_CFLAGS := $(INPUT_SIM_CFLAGS)
+LOCAL_SRC_FILES := ioctl_stub.c
+LOCAL_SHARED_LIBRARIES := libdl
+include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := libinput_sim_ioctl
+LOCAL_MODULE_TAGS := optional
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../../common
+LOCAL_CFLAGS := $(INPUT_SIM_CFLAGS)
+LOCAL_SRC_FILES := ioctl_stub.c
+LOCAL_LDLIBS := -ldl -lpthread
+include $(BUILD_HOST_SHARED_LIBRARY)
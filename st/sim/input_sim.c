@@ -0,0 +1,1053 @@
+/*
+ * Input device simulator for the ST HAL, see input_sim.h
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <limits.h>
+#include <math.h>
+#include <poll.h>
+#include <stddef.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+
+#include "input_sim.h"
+
+#define NSEC_PER_SEC		1000000000LL
+#define NSEC_PER_MSEC		1000000LL
+#define NSEC_PER_USEC		1000LL
+
+/* IIO attributes are re-read at most this often */
+#define ATTR_REFRESH_NS		(20 * NSEC_PER_MSEC)
+/* longest sleep, so a stop request is seen */
+#define IDLE_NS			(100 * NSEC_PER_MSEC)
+/* period of the synthetic signal */
+#define SIGNAL_PERIOD_NS	(4 * NSEC_PER_SEC)
+
+#define MAX_CODES		(6)
+#define MAX_CLIENTS		(8)
+
+#define DEV_ABS			(0)	/* evdev, EV_ABS */
+#define DEV_REL			(1)	/* evdev, EV_REL */
+#define DEV_IIO			(2)	/* yas IIO, 3 x s32 + pad + s64 ts */
+
+/*
+ * Control ioctl semantics, matched on the _IOC_NR of commands with the
+ * device's _IOC_TYPE.  The direction bits are not used: several of the
+ * driver headers declare getters with _IOW.
+ */
+#define OP_END			(0)
+#define OP_NOP			(1)
+#define OP_ENABLE		(2)
+#define OP_DISABLE		(3)
+#define OP_SET_ENABLE		(4)	/* enabled = arg */
+#define OP_GET_ENABLE		(5)
+#define OP_SET_FLAG		(6)	/* akm flags, enabled = any flag */
+#define OP_GET_FLAG		(7)
+#define OP_SET_DELAY		(8)	/* msec */
+#define OP_GET_DELAY		(9)
+#define OP_SET_RATE		(10)	/* mma8452 rate code */
+#define OP_ZERO			(11)	/* read back zeros */
+
+struct ctl_op {
+	uint8_t nr;
+	uint8_t op;
+	uint8_t width;		/* argument size, 0: the command's size */
+	uint8_t bit;		/* OP_xxx_FLAG */
+};
+
+/* mma8452_kernel.h, GSENSOR_IOCTL_MAGIC 'a' */
+static const struct ctl_op mma_ops[] = {
+	{ 0x01, OP_NOP, 0, 0 },		/* INIT */
+	{ 0x02, OP_DISABLE, 0, 0 },	/* CLOSE */
+	{ 0x03, OP_ENABLE, 0, 0 },	/* START */
+	{ 0x04, OP_NOP, 0, 0 },		/* RESET */
+	{ 0x08, OP_ZERO, 0, 0 },	/* GETDATA */
+	{ 0x10, OP_SET_RATE, 1, 0 },	/* APP_SET_RATE */
+	{ 0x11, OP_NOP, 0, 0 },		/* KEYBOARD */
+	{ 0, OP_END, 0, 0 },
+};
+
+/* akm8975.h, COMPASS_IOCTL_MAGIC 'c' */
+static const struct ctl_op akm_ops[] = {
+	{ 0x10, OP_NOP, 0, 0 },		/* SET_MODE */
+	{ 0x11, OP_SET_FLAG, 2, 0 },	/* SET_MFLAG */
+	{ 0x12, OP_GET_FLAG, 2, 0 },	/* GET_MFLAG */
+	{ 0x13, OP_SET_FLAG, 2, 1 },	/* SET_AFLAG */
+	{ 0x14, OP_GET_FLAG, 2, 1 },	/* GET_AFLAG */
+	{ 0x15, OP_NOP, 0, 0 },		/* SET_TFLAG */
+	{ 0x16, OP_ZERO, 2, 0 },	/* GET_TFLAG */
+	{ 0x18, OP_SET_DELAY, 2, 0 },	/* SET_DELAY */
+	{ 0x19, OP_SET_FLAG, 2, 2 },	/* SET_MVFLAG */
+	{ 0x1a, OP_GET_FLAG, 2, 2 },	/* GET_MVFLAG */
+	{ 0x1b, OP_GET_DELAY, 2, 0 },	/* GET_DELAY */
+	{ 0, OP_END, 0, 0 },
+};
+
+/* l3g4200d.h, L3G4200D_IOCTL_BASE 77 */
+static const struct ctl_op l3g_ops[] = {
+	{ 0, OP_SET_DELAY, 4, 0 },
+	{ 1, OP_GET_DELAY, 4, 0 },
+	{ 2, OP_SET_ENABLE, 4, 0 },
+	{ 3, OP_GET_ENABLE, 4, 0 },
+	{ 0, OP_END, 0, 0 },
+};
+
+/* isl29028.h, LIGHTSENSOR_IOCTL_MAGIC 'l' */
+static const struct ctl_op light_ops[] = {
+	{ 1, OP_GET_ENABLE, 4, 0 },
+	{ 2, OP_SET_ENABLE, 4, 0 },
+	{ 0, OP_END, 0, 0 },
+};
+
+/*
+ * isl29028.h PSENSOR_IOCTL_MAGIC 'p', PressureSensor.h 'r' and
+ * TemperatureSensor.h 't'; proximity has no SET_DELAY
+ */
+static const struct ctl_op onoff_ops[] = {
+	{ 1, OP_GET_ENABLE, 4, 0 },
+	{ 2, OP_SET_ENABLE, 4, 0 },
+	{ 3, OP_DISABLE, 0, 0 },
+	{ 4, OP_SET_DELAY, 4, 0 },
+	{ 0, OP_END, 0, 0 },
+};
+
+/* MMA8452_RATE_800 ... MMA8452_RATE_1P56, in mHz */
+static const int mma_rates[] = {
+	800000, 400000, 200000, 100000, 50000, 12500, 6250, 1560,
+};
+
+struct sim_dev {
+	/* description */
+	const char *name;	/* input device name, or IIO name */
+	const char *ctl;	/* control node below /dev */
+	int type;		/* DEV_xxx */
+	int magic;		/* ioctl _IOC_TYPE */
+	const struct ctl_op *ops;
+	int num_codes;
+	uint16_t codes[MAX_CODES];
+	int32_t range;		/* EVIOCGABS min/max */
+	int32_t base[MAX_CODES];	/* synthetic signal */
+	int32_t amp[MAX_CODES];
+	int def_hz;
+	int max_hz;
+
+	/* state */
+	int enabled;
+	int flags;
+	int delay_ms;
+	int code;		/* OP_SET_RATE */
+	int rate;		/* source rate, mHz */
+	int fd;			/* FIFO write end, uinput fd */
+	char node[INPUT_SIM_NODE_LEN];	/* below <root>/dev */
+	int32_t value[MAX_CODES];
+	int32_t sent[MAX_CODES];	/* evdev duplicate filter */
+	int has_sent;
+	int resync;		/* SYN_DROPPED due */
+	int64_t next;
+	struct input_sim_stats stats;
+};
+
+static struct sim_dev devs[] = {
+	{
+		.name = "gsensor", .ctl = "mma8452_daemon", .type = DEV_ABS,
+		.magic = 'a', .ops = mma_ops, .num_codes = 3,
+		.codes = { ABS_X, ABS_Y, ABS_Z },
+		.range = 2000000,		/* ug */
+		.base = { 0, 0, 1000000 }, .amp = { 50000, 50000, 5000 },
+		.def_hz = 50, .max_hz = 800,
+	}, {
+		.name = "compass", .ctl = "compass", .type = DEV_ABS,
+		.magic = 'c', .ops = akm_ops, .num_codes = 6,
+		.codes = { ABS_HAT0X, ABS_HAT0Y, ABS_BRAKE,
+			ABS_RX, ABS_RY, ABS_RZ },
+		.range = 360 * 64,		/* 0.06 uT, 1/64 deg */
+		.base = { 333, 0, -667, 90 * 64, 0, 0 },
+		.amp = { 30, 30, 10, 5 * 64, 2 * 64, 2 * 64 },
+		.def_hz = 10, .max_hz = 100,
+	}, {
+		.name = "gyro", .ctl = "gyrosensor", .type = DEV_REL,
+		.magic = 77, .ops = l3g_ops, .num_codes = 3,
+		.codes = { REL_RX, REL_RY, REL_RZ },
+		.range = 32767,			/* 70 mdps */
+		.base = { 0, 0, 0 }, .amp = { 15, 15, 15 },
+		.def_hz = 100, .max_hz = 800,
+	}, {
+		.name = "lightsensor-level", .ctl = "lightsensor",
+		.type = DEV_ABS, .magic = 'l', .ops = light_ops,
+		.num_codes = 1, .codes = { ABS_MISC }, .range = 65535,
+		.base = { 200 }, .amp = { 100 },
+		.def_hz = 5, .max_hz = 10,
+	}, {
+		.name = "proximity", .ctl = "psensor", .type = DEV_ABS,
+		.magic = 'p', .ops = onoff_ops, .num_codes = 1,
+		.codes = { ABS_DISTANCE }, .range = 1,
+		.base = { 1 }, .amp = { 0 },
+		.def_hz = 5, .max_hz = 10,
+	}, {
+		.name = "pressure", .ctl = "pressure", .type = DEV_ABS,
+		.magic = 'r', .ops = onoff_ops, .num_codes = 1,
+		.codes = { ABS_PRESSURE }, .range = 200000,	/* Pa */
+		.base = { 101325 }, .amp = { 20 },
+		.def_hz = 10, .max_hz = 50,
+	}, {
+		.name = "temperature", .ctl = "temperature", .type = DEV_ABS,
+		.magic = 't', .ops = onoff_ops, .num_codes = 1,
+		.codes = { ABS_THROTTLE }, .range = 1000,	/* 0.1 C */
+		.base = { 250 }, .amp = { 5 },
+		.def_hz = 1, .max_hz = 10,
+	}, {
+		.name = "yas_magnetometer", .type = DEV_IIO, .num_codes = 3,
+		.range = 2000000,		/* nT */
+		.base = { 20000, 0, -40000 }, .amp = { 1000, 1000, 500 },
+		.def_hz = 20, .max_hz = 100,
+	},
+};
+
+#define NUM_DEVS		((int)(sizeof(devs) / sizeof(devs[0])))
+
+struct rec_event {
+	uint32_t time;		/* msec */
+	int dev;
+	int num;
+	int32_t v[MAX_CODES];
+};
+
+static struct {
+	char root[PATH_MAX / 4];
+	char iio[PATH_MAX / 2];
+	struct input_sim_config cfg;
+	int listen;
+	int clients[MAX_CLIENTS];
+	int num_clients;
+	struct rec_event *rec;
+	int rec_num;
+	int rec_pos;
+	int64_t t0;
+} sim = { .listen = -1 };
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static int64_t stamp_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(sim.cfg.clock, &ts);
+	return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static int mkdirs(const char *path)
+{
+	char tmp[PATH_MAX], *p;
+
+	snprintf(tmp, sizeof(tmp), "%s", path);
+	for (p = tmp + 1; *p; p++) {
+		if (*p != '/')
+			continue;
+		*p = 0;
+		if (mkdir(tmp, 0755) < 0 && errno != EEXIST)
+			return -errno;
+		*p = '/';
+	}
+	if (mkdir(tmp, 0755) < 0 && errno != EEXIST)
+		return -errno;
+	return 0;
+}
+
+static int put_file(const char *dir, const char *name, const char *value)
+{
+	char path[PATH_MAX];
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	fp = fopen(path, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "cannot create %s: %s\n", path,
+				strerror(errno));
+		return -errno;
+	}
+	if (value)
+		fprintf(fp, "%s\n", value);
+	fclose(fp);
+	return 0;
+}
+
+static int get_attr(const char *name, int def)
+{
+	char path[PATH_MAX], buf[32];
+	ssize_t n;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", sim.iio, name);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return def;
+	n = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (n <= 0)
+		return def;
+	buf[n] = 0;
+	return (int)strtod(buf, NULL);
+}
+
+static void set_rate(struct sim_dev *d, int mhz)
+{
+	if (mhz > d->max_hz * 1000)
+		mhz = d->max_hz * 1000;
+	if (mhz < 100)
+		mhz = 100;
+	if (mhz != d->rate) {
+		d->rate = mhz;
+		d->stats.rate_changes++;
+	}
+	d->stats.rate = d->rate;
+}
+
+/* the rate the HAL asked for, unless a sweep or burst overrides it */
+static int wanted_rate(const struct sim_dev *d)
+{
+	if (d->type == DEV_IIO)
+		return get_attr("sampling_frequency", d->def_hz) * 1000;
+	if (d->magic == 'a')
+		return mma_rates[d->code & 7];
+	if (d->delay_ms > 0)
+		return 1000000 / d->delay_ms;
+	return d->delay_ms < 0 ? d->def_hz * 1000 : d->max_hz * 1000;
+}
+
+static void set_enabled(struct sim_dev *d, int enabled)
+{
+	enabled = !!enabled;
+	if (enabled && !d->enabled) {
+		d->stats.enables++;
+		d->next = now_ns();
+	}
+	d->enabled = enabled;
+}
+
+static int setup_fifo(struct sim_dev *d, int index)
+{
+	char path[PATH_MAX];
+
+	if (d->type == DEV_IIO)
+		snprintf(d->node, sizeof(d->node), "iio:device0");
+	else
+		snprintf(d->node, sizeof(d->node), "input/event%d", index);
+	snprintf(path, sizeof(path), "%s/dev/%s", sim.root, d->node);
+	if (mkfifo(path, 0666) < 0 && errno != EEXIST)
+		return -errno;
+	/* hold both ends, so the HAL's O_RDONLY open does not block */
+	d->fd = open(path, O_RDWR | O_NONBLOCK);
+	if (d->fd < 0)
+		return -errno;
+#ifdef F_SETPIPE_SZ
+	if (sim.cfg.fifo_events > 0 && d->type != DEV_IIO)
+		fcntl(d->fd, F_SETPIPE_SZ,
+				sim.cfg.fifo_events * (int)sizeof(struct input_event));
+#endif
+	return 0;
+}
+
+static int find_uinput_node(int fd, const char *name, char *node, size_t size)
+{
+	char path[PATH_MAX], buf[80];
+	struct dirent *de;
+	DIR *dir;
+	int n, found = -1;
+
+#ifdef UI_GET_SYSNAME
+	char sysname[64];
+
+	if (ioctl(fd, UI_GET_SYSNAME(sizeof(sysname)), sysname) >= 0) {
+		snprintf(path, sizeof(path), "/sys/devices/virtual/input/%s",
+				sysname);
+		dir = opendir(path);
+		while (dir && (de = readdir(dir)) != NULL) {
+			if (sscanf(de->d_name, "event%d", &n) == 1) {
+				found = n;
+				break;
+			}
+		}
+		if (dir)
+			closedir(dir);
+	}
+#else
+	(void)fd;
+#endif
+	if (found < 0) {
+		/* the newest node with our name */
+		dir = opendir("/dev/input");
+		while (dir && (de = readdir(dir)) != NULL) {
+			int efd;
+
+			if (sscanf(de->d_name, "event%d", &n) != 1 || n < found)
+				continue;
+			snprintf(path, sizeof(path), "/dev/input/%s",
+					de->d_name);
+			efd = open(path, O_RDONLY);
+			if (efd < 0)
+				continue;
+			memset(buf, 0, sizeof(buf));
+			if (ioctl(efd, EVIOCGNAME(sizeof(buf) - 1), buf) >= 1
+					&& strcmp(buf, name) == 0)
+				found = n;
+			close(efd);
+		}
+		if (dir)
+			closedir(dir);
+	}
+	if (found < 0)
+		return -ENODEV;
+	snprintf(node, size, "input/event%d", found);
+	return 0;
+}
+
+static int setup_uinput(struct sim_dev *d)
+{
+	struct uinput_user_dev ud;
+	char path[PATH_MAX], target[PATH_MAX];
+	int i, rt, type = d->type == DEV_REL ? EV_REL : EV_ABS;
+
+	d->fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+	if (d->fd < 0)
+		return -errno;
+	memset(&ud, 0, sizeof(ud));
+	snprintf(ud.name, sizeof(ud.name), "%s", d->name);
+	ud.id.bustype = BUS_VIRTUAL;
+	ioctl(d->fd, UI_SET_EVBIT, EV_SYN);
+	ioctl(d->fd, UI_SET_EVBIT, type);
+	for (i = 0; i < d->num_codes; i++) {
+		ioctl(d->fd, type == EV_REL ? UI_SET_RELBIT : UI_SET_ABSBIT,
+				d->codes[i]);
+		if (type == EV_ABS) {
+			ud.absmin[d->codes[i]] = -d->range;
+			ud.absmax[d->codes[i]] = d->range;
+		}
+	}
+	if (write(d->fd, &ud, sizeof(ud)) != sizeof(ud) ||
+			ioctl(d->fd, UI_DEV_CREATE) < 0)
+		return -errno;
+
+	rt = find_uinput_node(d->fd, d->name, d->node, sizeof(d->node));
+	if (rt < 0)
+		return rt;
+	snprintf(path, sizeof(path), "%s/dev/%s", sim.root, d->node);
+	snprintf(target, sizeof(target), "/dev/%s", d->node);
+	if (symlink(target, path) < 0 && errno != EEXIST)
+		return -errno;
+	return 0;
+}
+
+static int setup_iio(struct sim_dev *d)
+{
+	char dir[PATH_MAX], buf[16];
+	int rt;
+
+	snprintf(sim.iio, sizeof(sim.iio),
+			"%s/sys/bus/iio/devices/iio:device0", sim.root);
+	snprintf(dir, sizeof(dir), "%s/buffer", sim.iio);
+	if ((rt = mkdirs(dir)) < 0)
+		return rt;
+	snprintf(dir, sizeof(dir), "%s/trigger", sim.iio);
+	if ((rt = mkdirs(dir)) < 0)
+		return rt;
+	snprintf(buf, sizeof(buf), "%d", d->def_hz);
+	if ((rt = put_file(sim.iio, "name", d->name)) < 0 ||
+			(rt = put_file(sim.iio, "sampling_frequency", buf)) < 0 ||
+			(rt = put_file(sim.iio, "buffer/length", "2")) < 0 ||
+			(rt = put_file(sim.iio, "buffer/enable", "0")) < 0 ||
+			(rt = put_file(sim.iio, "trigger/current_trigger",
+					NULL)) < 0)
+		return rt;
+	return setup_fifo(d, 0);
+}
+
+static int setup_socket(void)
+{
+	struct sockaddr_un addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/dev/%s",
+			sim.root, INPUT_SIM_IOCTL_SOCK)
+			>= (int)sizeof(addr.sun_path))
+		return -ENAMETOOLONG;
+	unlink(addr.sun_path);
+	sim.listen = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0);
+	if (sim.listen < 0)
+		return -errno;
+	if (bind(sim.listen, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+			listen(sim.listen, MAX_CLIENTS) < 0)
+		return -errno;
+	return 0;
+}
+
+/**
+ * Builds the device tree below @root and creates the devices.
+ * @return 0 or a negative errno
+ */
+int input_sim_create(const char *root, const struct input_sim_config *cfg)
+{
+	char dir[PATH_MAX];
+	int i, rt;
+
+	if (snprintf(sim.root, sizeof(sim.root), "%s", root)
+			>= (int)sizeof(sim.root))
+		return -ENAMETOOLONG;
+	sim.cfg = *cfg;
+	snprintf(dir, sizeof(dir), "%s/dev/input", sim.root);
+	if ((rt = mkdirs(dir)) < 0)
+		return rt;
+	snprintf(dir, sizeof(dir), "%s/dev", sim.root);
+
+	for (i = 0; i < NUM_DEVS; i++) {
+		struct sim_dev *d = &devs[i];
+
+		d->fd = -1;
+		d->delay_ms = -1;
+		d->code = 4;	/* MMA8452_RATE_50 */
+		d->stats.name = d->name;
+		memcpy(d->value, d->base, sizeof(d->value));
+		if (d->type == DEV_IIO) {
+			rt = setup_iio(d);
+		} else {
+			rt = put_file(dir, d->ctl, NULL);
+			if (rt == 0)
+				rt = sim.cfg.backend == INPUT_SIM_UINPUT ?
+					setup_uinput(d) : setup_fifo(d, i);
+		}
+		if (rt < 0) {
+			fprintf(stderr, "cannot create %s: %s\n", d->name,
+					strerror(-rt));
+			return rt;
+		}
+		set_rate(d, wanted_rate(d));
+		d->stats.rate_changes = 0;
+	}
+	return setup_socket();
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag,
+		struct FTW *ftw)
+{
+	(void)st;
+	(void)flag;
+	(void)ftw;
+	return remove(path);
+}
+
+void input_sim_destroy(int remove_tree)
+{
+	int i;
+
+	for (i = 0; i < sim.num_clients; i++)
+		close(sim.clients[i]);
+	sim.num_clients = 0;
+	if (sim.listen >= 0)
+		close(sim.listen);
+	sim.listen = -1;
+	for (i = 0; i < NUM_DEVS; i++) {
+		if (devs[i].fd < 0)
+			continue;
+		if (sim.cfg.backend == INPUT_SIM_UINPUT &&
+				devs[i].type != DEV_IIO)
+			ioctl(devs[i].fd, UI_DEV_DESTROY);
+		close(devs[i].fd);
+		devs[i].fd = -1;
+	}
+	if (remove_tree && sim.root[0])
+		nftw(sim.root, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+	free(sim.rec);
+	sim.rec = NULL;
+	sim.rec_num = 0;
+}
+
+/**
+ * Loads recorded values, one sample per line:
+ *   <msec>,<device name>,<v0>[,<v1>...]
+ * in the raw units the driver reports.  A recorded device replays the
+ * last value at the source rate until the next line; the others keep the
+ * synthetic signal.  Lines that do not parse are skipped.
+ * @return 0, or -1 if the file cannot be read
+ */
+int input_sim_load_recording(const char *path)
+{
+	struct rec_event *ev = NULL, *tmp;
+	int num = 0, cap = 0, i;
+	char line[256], name[INPUT_SIM_NODE_LEN], *p;
+	unsigned int time;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return -1;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		struct rec_event e;
+		int n;
+
+		if (sscanf(line, "%u,%63[^,],%n", &time, name, &n) != 2)
+			continue;
+		for (e.dev = 0; e.dev < NUM_DEVS; e.dev++)
+			if (strcmp(devs[e.dev].name, name) == 0)
+				break;
+		if (e.dev == NUM_DEVS || (num && time < ev[num - 1].time))
+			continue;
+		e.time = time;
+		for (p = line + n, e.num = 0; e.num < MAX_CODES; e.num++) {
+			char *end;
+
+			e.v[e.num] = (int32_t)strtol(p, &end, 10);
+			if (end == p)
+				break;
+			p = *end == ',' ? end + 1 : end;
+		}
+		if (e.num == 0)
+			continue;
+		if (num == cap) {
+			cap = cap ? cap * 2 : 256;
+			tmp = realloc(ev, cap * sizeof(*ev));
+			if (tmp == NULL)
+				break;
+			ev = tmp;
+		}
+		ev[num++] = e;
+		memset(devs[e.dev].amp, 0, sizeof(devs[e.dev].amp));
+	}
+	fclose(fp);
+
+	free(sim.rec);
+	sim.rec = ev;
+	sim.rec_num = num;
+	sim.rec_pos = 0;
+	for (i = 0; i < num; i++)
+		if (ev[i].time == 0)
+			memcpy(devs[ev[i].dev].base, ev[i].v,
+					ev[i].num * sizeof(int32_t));
+	return 0;
+}
+
+static void update_values(int64_t now)
+{
+	int64_t t = now - sim.t0;
+	int i, j;
+
+	while (sim.rec_pos < sim.rec_num &&
+			(int64_t)sim.rec[sim.rec_pos].time * NSEC_PER_MSEC <= t) {
+		const struct rec_event *e = &sim.rec[sim.rec_pos++];
+
+		memcpy(devs[e->dev].base, e->v, e->num * sizeof(int32_t));
+	}
+	for (i = 0; i < NUM_DEVS; i++) {
+		struct sim_dev *d = &devs[i];
+
+		for (j = 0; j < d->num_codes; j++) {
+			double ph = 2 * M_PI * (double)(t % SIGNAL_PERIOD_NS) /
+				SIGNAL_PERIOD_NS + j * M_PI / 3;
+			d->value[j] = d->base[j] +
+				(int32_t)lrint(d->amp[j] * sin(ph));
+		}
+	}
+}
+
+static void put_event(struct input_event *ev, int64_t ts, int type, int code,
+		int32_t value)
+{
+	memset(ev, 0, sizeof(*ev));
+#ifdef input_event_sec
+	ev->input_event_sec = ts / NSEC_PER_SEC;
+	ev->input_event_usec = (ts % NSEC_PER_SEC) / NSEC_PER_USEC;
+#else
+	ev->time.tv_sec = ts / NSEC_PER_SEC;
+	ev->time.tv_usec = (ts % NSEC_PER_SEC) / NSEC_PER_USEC;
+#endif
+	ev->type = (uint16_t)type;
+	ev->code = (uint16_t)code;
+	ev->value = value;
+}
+
+/*
+ * One evdev packet.  The input core drops EV_ABS values equal to the last
+ * one and EV_REL values of 0, and a packet with nothing left is never
+ * delivered; the FIFO backend does the same.
+ */
+static void emit_evdev(struct sim_dev *d)
+{
+	struct input_event ev[MAX_CODES + 2];
+	int64_t ts = stamp_ns();
+	int i, n = 0, type = d->type == DEV_REL ? EV_REL : EV_ABS;
+	ssize_t len;
+
+	if (sim.cfg.backend == INPUT_SIM_FIFO && d->resync)
+		put_event(&ev[n++], ts, EV_SYN, SYN_DROPPED, 0);
+	for (i = 0; i < d->num_codes; i++) {
+		if (sim.cfg.backend == INPUT_SIM_FIFO &&
+				(type == EV_REL ? d->value[i] == 0 :
+				 d->has_sent && d->value[i] == d->sent[i]))
+			continue;
+		put_event(&ev[n++], ts, type, d->codes[i], d->value[i]);
+	}
+	if (n == 0) {
+		d->stats.filtered++;
+		return;
+	}
+	put_event(&ev[n++], ts, EV_SYN, SYN_REPORT, 0);
+
+	len = (ssize_t)(n * sizeof(ev[0]));
+	/* packets are below PIPE_BUF, so a FIFO write is all or nothing */
+	if (write(d->fd, ev, len) != len) {
+		d->stats.dropped++;
+		d->resync = 1;
+		return;
+	}
+	d->resync = 0;
+	memcpy(d->sent, d->value, sizeof(d->sent));
+	d->has_sent = 1;
+	d->stats.samples++;
+}
+
+static void emit_iio(struct sim_dev *d)
+{
+	struct {
+		int32_t v[3];
+		int32_t pad;
+		int64_t ts;
+	} scan;
+
+	memcpy(scan.v, d->value, sizeof(scan.v));
+	scan.pad = 0;
+	scan.ts = stamp_ns();
+	/* a full FIFO drops the scan, like the driver's kfifo */
+	if (write(d->fd, &scan, sizeof(scan)) == (ssize_t)sizeof(scan))
+		d->stats.samples++;
+	else
+		d->stats.dropped++;
+}
+
+static void emit(struct sim_dev *d)
+{
+	if (d->type == DEV_IIO)
+		emit_iio(d);
+	else
+		emit_evdev(d);
+}
+
+static const struct ctl_op *find_op(const struct sim_dev *d, uint32_t cmd)
+{
+	const struct ctl_op *op;
+
+	if (d->ops == NULL || (int)_IOC_TYPE(cmd) != d->magic)
+		return NULL;
+	for (op = d->ops; op->op != OP_END; op++)
+		if (op->nr == _IOC_NR(cmd))
+			return op;
+	return NULL;
+}
+
+static int32_t get_arg(const struct input_sim_ioctl_req *req, int width)
+{
+	int16_t s;
+	int32_t i;
+
+	if (width == 1)
+		return req->len >= 1 ? req->arg[0] : 0;
+	if (width == 2) {
+		if (req->len < 2)
+			return 0;
+		memcpy(&s, req->arg, 2);
+		return s;
+	}
+	if (req->len < 4)
+		return 0;
+	memcpy(&i, req->arg, 4);
+	return i;
+}
+
+static void put_arg(struct input_sim_ioctl_rsp *rsp, int width, int32_t v)
+{
+	int16_t s = (int16_t)v;
+	int8_t c = (int8_t)v;
+
+	rsp->len = width;
+	if (width == 1)
+		memcpy(rsp->arg, &c, 1);
+	else if (width == 2)
+		memcpy(rsp->arg, &s, 2);
+	else
+		memcpy(rsp->arg, &v, 4);
+}
+
+/* EVIOCGNAME, EVIOCGABS and friends on FIFO nodes */
+static int handle_evdev(struct sim_dev *d, const struct input_sim_ioctl_req *req,
+		struct input_sim_ioctl_rsp *rsp)
+{
+	uint32_t cmd = req->cmd, size = _IOC_SIZE(cmd);
+	struct input_absinfo abs;
+	int i, len;
+
+	if (_IOC_TYPE(cmd) != 'E')
+		return -ENOTTY;
+	if (size > INPUT_SIM_ARG_LEN)
+		size = INPUT_SIM_ARG_LEN;
+	if (_IOC_NR(cmd) == _IOC_NR(EVIOCGNAME(0))) {
+		len = (int)strlen(d->name) + 1;
+		if (len > (int)size)
+			len = (int)size;
+		memcpy(rsp->arg, d->name, len);
+		rsp->len = len;
+		return len;
+	}
+	if (cmd == EVIOCGVERSION) {
+		put_arg(rsp, 4, EV_VERSION);
+		return 0;
+	}
+	if (_IOC_NR(cmd) >= _IOC_NR(EVIOCGABS(0)) &&
+			_IOC_NR(cmd) < _IOC_NR(EVIOCGABS(ABS_CNT)) &&
+			_IOC_DIR(cmd) == _IOC_READ) {
+		int code = _IOC_NR(cmd) - _IOC_NR(EVIOCGABS(0));
+
+		memset(&abs, 0, sizeof(abs));
+		for (i = 0; i < d->num_codes; i++) {
+			if (d->codes[i] != code || d->type != DEV_ABS)
+				continue;
+			abs.value = d->has_sent ? d->sent[i] : d->value[i];
+			abs.minimum = -d->range;
+			abs.maximum = d->range;
+			len = size < sizeof(abs) ? (int)size : (int)sizeof(abs);
+			memcpy(rsp->arg, &abs, len);
+			rsp->len = len;
+			return 0;
+		}
+		return -EINVAL;
+	}
+	return -EINVAL;
+}
+
+static int handle_ctl(struct sim_dev *d, const struct input_sim_ioctl_req *req,
+		struct input_sim_ioctl_rsp *rsp)
+{
+	const struct ctl_op *op = find_op(d, req->cmd);
+	int width;
+
+	if (op == NULL)
+		return -ENOTTY;
+	width = op->width ? op->width : (int)_IOC_SIZE(req->cmd);
+	switch (op->op) {
+	case OP_ENABLE:
+		set_enabled(d, 1);
+		break;
+	case OP_DISABLE:
+		set_enabled(d, 0);
+		break;
+	case OP_SET_ENABLE:
+		set_enabled(d, get_arg(req, width));
+		break;
+	case OP_GET_ENABLE:
+		put_arg(rsp, width, d->enabled);
+		break;
+	case OP_SET_FLAG:
+		if (get_arg(req, width))
+			d->flags |= 1 << op->bit;
+		else
+			d->flags &= ~(1 << op->bit);
+		set_enabled(d, d->flags);
+		break;
+	case OP_GET_FLAG:
+		put_arg(rsp, width, !!(d->flags & (1 << op->bit)));
+		break;
+	case OP_SET_DELAY:
+		d->delay_ms = get_arg(req, width);
+		break;
+	case OP_GET_DELAY:
+		put_arg(rsp, width, d->delay_ms < 0 ? 1000 / d->def_hz :
+				d->delay_ms);
+		break;
+	case OP_SET_RATE:
+		d->code = get_arg(req, width) & 7;
+		break;
+	case OP_ZERO:
+		if (width > INPUT_SIM_ARG_LEN)
+			width = INPUT_SIM_ARG_LEN;
+		memset(rsp->arg, 0, width);
+		rsp->len = width;
+		break;
+	}
+	return 0;
+}
+
+static void handle_request(int fd)
+{
+	struct input_sim_ioctl_req req;
+	struct input_sim_ioctl_rsp rsp;
+	struct sim_dev *d = NULL;
+	ssize_t n;
+	int i;
+
+	n = recv(fd, &req, sizeof(req), 0);
+	if (n < (ssize_t)offsetof(struct input_sim_ioctl_req, arg))
+		return;
+	req.node[sizeof(req.node) - 1] = 0;
+	memset(&rsp, 0, sizeof(rsp));
+	rsp.ret = -ENOTTY;
+	for (i = 0; i < NUM_DEVS; i++) {
+		if (devs[i].ctl && strcmp(req.node, devs[i].ctl) == 0) {
+			d = &devs[i];
+			rsp.ret = handle_ctl(d, &req, &rsp);
+			break;
+		}
+		if (strcmp(req.node, devs[i].node) == 0) {
+			d = &devs[i];
+			rsp.ret = handle_evdev(d, &req, &rsp);
+			break;
+		}
+	}
+	if (d)
+		d->stats.ioctls++;
+	send(fd, &rsp, sizeof(rsp), MSG_NOSIGNAL);
+}
+
+static void serve(int64_t wake)
+{
+	struct pollfd fds[MAX_CLIENTS + 1];
+	struct timespec ts;
+	int64_t wait = wake - now_ns();
+	int i, n;
+
+	if (wait < 0)
+		wait = 0;
+	if (wait > IDLE_NS)
+		wait = IDLE_NS;
+	ts.tv_sec = wait / NSEC_PER_SEC;
+	ts.tv_nsec = wait % NSEC_PER_SEC;
+
+	fds[0].fd = sim.listen;
+	fds[0].events = POLLIN;
+	for (i = 0; i < sim.num_clients; i++) {
+		fds[i + 1].fd = sim.clients[i];
+		fds[i + 1].events = POLLIN;
+	}
+	n = ppoll(fds, sim.num_clients + 1, &ts, NULL);
+	if (n <= 0)
+		return;
+
+	for (i = sim.num_clients - 1; i >= 0; i--) {
+		if (fds[i + 1].revents & POLLIN)
+			handle_request(sim.clients[i]);
+		else if (fds[i + 1].revents & (POLLHUP | POLLERR)) {
+			close(sim.clients[i]);
+			sim.clients[i] = sim.clients[--sim.num_clients];
+		}
+	}
+	if ((fds[0].revents & POLLIN) && sim.num_clients < MAX_CLIENTS) {
+		int fd = accept(sim.listen, NULL, NULL);
+		if (fd >= 0)
+			sim.clients[sim.num_clients++] = fd;
+	}
+}
+
+static int64_t source_period(struct sim_dev *d, int64_t now)
+{
+	int mhz;
+
+	if (sim.cfg.burst > 0) {
+		d->stats.rate = sim.cfg.burst * 1000000 / (int)sim.cfg.burst_msec;
+		return (int64_t)sim.cfg.burst_msec * NSEC_PER_MSEC;
+	}
+	if (sim.cfg.sweep_num > 0) {
+		int64_t step = (now - sim.t0) /
+			((int64_t)sim.cfg.sweep_msec * NSEC_PER_MSEC);
+		mhz = sim.cfg.sweep[step % sim.cfg.sweep_num] * 1000;
+	} else {
+		mhz = wanted_rate(d);
+	}
+	set_rate(d, mhz);
+	return NSEC_PER_SEC * 1000 / d->rate;
+}
+
+/**
+ * Streams until @msec have passed (0: forever) or *@stop is set, serving
+ * the HAL's ioctls in between.
+ * @return 0 or a negative errno
+ */
+int input_sim_run(uint32_t msec, volatile int *stop)
+{
+	int64_t now, wake, refresh = 0, period, late;
+	int i, j, n;
+
+	if (sim.listen < 0)
+		return -EBADF;
+	signal(SIGPIPE, SIG_IGN);
+
+	sim.t0 = now_ns();
+	while (!(stop && *stop)) {
+		now = now_ns();
+		if (msec && now - sim.t0 >= (int64_t)msec * NSEC_PER_MSEC)
+			break;
+		if (now >= refresh) {
+			for (i = 0; i < NUM_DEVS; i++)
+				if (devs[i].type == DEV_IIO)
+					set_enabled(&devs[i], get_attr(
+						"buffer/enable", 0));
+			refresh = now + ATTR_REFRESH_NS;
+		}
+		update_values(now);
+
+		wake = refresh;
+		for (i = 0; i < NUM_DEVS; i++) {
+			struct sim_dev *d = &devs[i];
+
+			if (!d->enabled)
+				continue;
+			period = source_period(d, now);
+			if (d->next <= now) {
+				late = now - d->next;
+				if (late > period)
+					d->stats.late++;
+				if (late > (int64_t)d->stats.max_late_ns)
+					d->stats.max_late_ns = (uint64_t)late;
+				/* a burst is the backlog of one period */
+				n = sim.cfg.burst > 0 ? sim.cfg.burst : 1;
+				for (j = 0; j < n; j++) {
+					if (n > 1)
+						update_values(now - period *
+							(n - 1 - j) / n);
+					emit(d);
+				}
+				d->next += period;
+				/* missed periods are skipped, not caught up */
+				if (d->next <= now)
+					d->next = now + period;
+			}
+			if (d->next < wake)
+				wake = d->next;
+		}
+		serve(wake);
+	}
+	return 0;
+}
+
+int input_sim_get_stats(struct input_sim_stats *stats, int num)
+{
+	int i;
+
+	for (i = 0; i < num && i < NUM_DEVS; i++)
+		stats[i] = devs[i].stats;
+	return i;
+}
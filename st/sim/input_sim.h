@@ -0,0 +1,88 @@
+/*
+ * Input device simulator for the ST HAL (and the Yamaha IIO magnetometer)
+ *
+ * input_sim_create() builds, below a root directory, the nodes the HALs
+ * look for and serves them from a recording or a synthetic signal:
+ *
+ *   <root>/dev/input/eventN		one evdev source per ST sensor
+ *   <root>/dev/mma8452_daemon, compass, gyrosensor, lightsensor, psensor,
+ *   pressure, temperature			control nodes
+ *   <root>/sys/bus/iio/devices/iio:deviceN/	yas_magnetometer attributes
+ *   <root>/dev/iio:deviceN			its scan FIFO
+ *
+ * The HAL is pointed at it with SENSORS_SYSFS_ROOT=<root> (see
+ * common/sysfs_root.h).  Two evdev backends are available:
+ *
+ *   INPUT_SIM_UINPUT	devices are created through /dev/uinput and
+ *			<root>/dev/input/eventN links to the real node, so
+ *			timestamps, buffering and SYN_DROPPED come from the
+ *			kernel.  Needs write access to /dev/uinput.
+ *   INPUT_SIM_FIFO	eventN is a FIFO carrying struct input_event, with
+ *			the evdev duplicate-value filter and SYN_DROPPED on
+ *			overflow emulated here.  The sim and the HAL must then
+ *			share struct input_event, i.e. be built for the same
+ *			ABI.
+ *
+ * Control nodes are plain files; their ioctls, and EVIOCGNAME/EVIOCGABS on
+ * FIFO nodes, are carried to the sim over INPUT_SIM_IOCTL_SOCK by
+ * libinput_sim_ioctl.so (ioctl_stub.c), which the HAL process loads with
+ * LD_PRELOAD.  The sim follows the enables and delays the HAL sets there.
+ */
+
+#ifndef __INPUT_SIM_H__
+#define __INPUT_SIM_H__
+
+#include <stdint.h>
+
+#define INPUT_SIM_FIFO			(0)
+#define INPUT_SIM_UINPUT		(1)
+
+/* below <root>/dev, SOCK_SEQPACKET */
+#define INPUT_SIM_IOCTL_SOCK		".ioctl"
+#define INPUT_SIM_NODE_LEN		(64)
+#define INPUT_SIM_ARG_LEN		(128)
+
+struct input_sim_ioctl_req {
+	char node[INPUT_SIM_NODE_LEN];	/*!< path below <root>/dev */
+	uint32_t cmd;
+	uint32_t len;			/*!< bytes of arg copied in */
+	uint8_t arg[INPUT_SIM_ARG_LEN];
+};
+
+struct input_sim_ioctl_rsp {
+	int32_t ret;			/*!< 0 or -errno */
+	uint32_t len;			/*!< bytes of arg to copy back */
+	uint8_t arg[INPUT_SIM_ARG_LEN];
+};
+
+struct input_sim_config {
+	int backend;			/*!< INPUT_SIM_FIFO or INPUT_SIM_UINPUT */
+	int fifo_events;		/*!< FIFO backend queue, 0: pipe default */
+	int clock;			/*!< clock for event and scan timestamps */
+	const int *sweep;		/*!< source rates in Hz, overriding the HAL */
+	int sweep_num;
+	uint32_t sweep_msec;		/*!< time spent on each rate */
+	int burst;			/*!< samples per burst, 0: paced */
+	uint32_t burst_msec;		/*!< burst period */
+};
+
+struct input_sim_stats {
+	const char *name;
+	uint64_t samples;		/*!< packets or scans written */
+	uint64_t filtered;		/*!< packets with no changed value */
+	uint64_t dropped;		/*!< lost to a full queue */
+	uint64_t late;			/*!< written over one period late */
+	uint64_t max_late_ns;
+	uint32_t enables;
+	uint32_t rate_changes;
+	uint32_t ioctls;
+	int rate;			/*!< last source rate, mHz */
+};
+
+int input_sim_create(const char *root, const struct input_sim_config *cfg);
+void input_sim_destroy(int remove_tree);
+int input_sim_load_recording(const char *path);
+int input_sim_run(uint32_t msec, volatile int *stop);
+int input_sim_get_stats(struct input_sim_stats *stats, int num);
+
+#endif
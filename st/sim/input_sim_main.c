@@ -0,0 +1,181 @@
+/*
+ * Serves the simulated ST input devices until interrupted or for -t
+ * seconds.
+ *
+ * usage: st_input_sim [-r root] [-b fifo|uinput] [-p recording] [-q events]
+ *                     [-c realtime|monotonic|boottime]
+ *                     [-s hz,hz,... [-S msec]] [-B samples:msec]
+ *                     [-t seconds] [-k]
+ *
+ * Then start the HAL (or sensors_hal_bench) with the printed
+ * SENSORS_SYSFS_ROOT and LD_PRELOAD.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "input_sim.h"
+
+#define MAX_SWEEP		(16)
+#define MAX_DEVS		(16)
+
+static volatile int stop;
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop = 1;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-r root] [-b fifo|uinput] [-p recording] "
+		"[-q events] [-c clock]\n"
+		"          [-s hz,hz,... [-S msec]] [-B samples:msec] "
+		"[-t seconds] [-k]\n"
+		"  -r  directory to build the tree in (default: mkdtemp)\n"
+		"  -b  evdev backend, default fifo\n"
+		"  -p  recorded values, msec,device,v0[,v1...] per line\n"
+		"  -q  fifo backend queue in events (overflow tests)\n"
+		"  -c  timestamp clock, default realtime like evdev\n"
+		"  -s  source rate sweep, overriding the HAL's delays\n"
+		"  -S  time per sweep step, default 2000\n"
+		"  -B  bursts of this many samples every msec\n"
+		"  -t  stop after this many seconds\n"
+		"  -k  keep the tree on exit\n",
+		name);
+}
+
+static int parse_clock(const char *s)
+{
+	if (strcmp(s, "realtime") == 0)
+		return CLOCK_REALTIME;
+	if (strcmp(s, "monotonic") == 0)
+		return CLOCK_MONOTONIC;
+	if (strcmp(s, "boottime") == 0)
+		return CLOCK_BOOTTIME;
+	return -1;
+}
+
+int main(int argc, char **argv)
+{
+	char tmp[] = "/tmp/st_input_sim.XXXXXX";
+	const char *root = NULL, *recording = NULL;
+	struct input_sim_config cfg;
+	struct input_sim_stats st[MAX_DEVS];
+	int sweep[MAX_SWEEP];
+	int seconds = 0, keep = 0, opt, rt, i, n;
+	char *p;
+
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.backend = INPUT_SIM_FIFO;
+	cfg.clock = CLOCK_REALTIME;
+	cfg.sweep = sweep;
+	cfg.sweep_msec = 2000;
+
+	while ((opt = getopt(argc, argv, "r:b:p:q:c:s:S:B:t:kh")) != -1) {
+		switch (opt) {
+		case 'r':
+			root = optarg;
+			break;
+		case 'b':
+			if (strcmp(optarg, "uinput") == 0)
+				cfg.backend = INPUT_SIM_UINPUT;
+			else if (strcmp(optarg, "fifo") != 0)
+				goto bad;
+			break;
+		case 'p':
+			recording = optarg;
+			break;
+		case 'q':
+			cfg.fifo_events = atoi(optarg);
+			break;
+		case 'c':
+			cfg.clock = parse_clock(optarg);
+			if (cfg.clock < 0)
+				goto bad;
+			break;
+		case 's':
+			for (p = optarg; p && cfg.sweep_num < MAX_SWEEP; ) {
+				sweep[cfg.sweep_num] = atoi(p);
+				if (sweep[cfg.sweep_num] <= 0)
+					goto bad;
+				cfg.sweep_num++;
+				p = strchr(p, ',');
+				if (p)
+					p++;
+			}
+			break;
+		case 'S':
+			cfg.sweep_msec = (uint32_t)atoi(optarg);
+			break;
+		case 'B':
+			if (sscanf(optarg, "%d:%u", &cfg.burst,
+					&cfg.burst_msec) != 2 ||
+					cfg.burst <= 0 || cfg.burst_msec == 0)
+				goto bad;
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'k':
+			keep = 1;
+			break;
+		default:
+			goto bad;
+		}
+	}
+	if (seconds < 0 || cfg.sweep_msec == 0)
+		goto bad;
+	if (root == NULL) {
+		root = mkdtemp(tmp);
+		if (root == NULL) {
+			perror("mkdtemp");
+			return 1;
+		}
+	}
+
+	if (recording && input_sim_load_recording(recording) < 0) {
+		fprintf(stderr, "cannot load %s\n", recording);
+		return 1;
+	}
+	rt = input_sim_create(root, &cfg);
+	if (rt < 0) {
+		fprintf(stderr, "cannot build the tree in %s (%d)\n", root, rt);
+		input_sim_destroy(!keep);
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	printf("export SENSORS_SYSFS_ROOT=%s\n", root);
+	printf("export LD_PRELOAD=libinput_sim_ioctl.so\n");
+	fflush(stdout);
+
+	input_sim_run((uint32_t)seconds * 1000, &stop);
+
+	n = input_sim_get_stats(st, MAX_DEVS);
+	input_sim_destroy(!keep);
+	fprintf(stderr, "%-18s %8s %8s %8s %8s %9s %8s %5s %6s\n", "device",
+			"samples", "filtered", "dropped", "late", "max late",
+			"rate Hz", "on", "ioctls");
+	for (i = 0; i < n; i++)
+		fprintf(stderr, "%-18s %8llu %8llu %8llu %8llu %7.3fms "
+				"%8.2f %5u %6u\n", st[i].name,
+				(unsigned long long)st[i].samples,
+				(unsigned long long)st[i].filtered,
+				(unsigned long long)st[i].dropped,
+				(unsigned long long)st[i].late,
+				st[i].max_late_ns / 1e6, st[i].rate / 1000.0,
+				st[i].enables, st[i].ioctls);
+	return 0;
+
+bad:
+	usage(argv[0]);
+	return 1;
+}
@@ -0,0 +1,148 @@
+/*
+ * LD_PRELOAD shim carrying ioctls on simulated nodes to input_sim.
+ *
+ * With SENSORS_SYSFS_ROOT set, ioctl() on a file below <root>/dev is sent
+ * to the simulator over <root>/dev/INPUT_SIM_IOCTL_SOCK and answered from
+ * there; every other ioctl, and all of them without the variable, go
+ * straight to libc.  The argument is copied in up to _IOC_SIZE() bytes and
+ * back as far as the simulator says, since the driver headers do not get
+ * the direction bits right.
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "input_sim.h"
+#include "sysfs_root.h"
+
+#ifdef __BIONIC__
+typedef int ioctl_req_t;
+#else
+typedef unsigned long ioctl_req_t;
+#endif
+
+static int (*real_ioctl)(int, ioctl_req_t, ...);
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static char dev_dir[PATH_MAX / 2];	/* "<root>/dev/", "" if unset */
+static size_t dev_len;
+static int sock = -1;
+
+static void init(void)
+{
+	const char *root = getenv(SYSFS_ROOT_ENV);
+
+	real_ioctl = (int (*)(int, ioctl_req_t, ...))dlsym(RTLD_NEXT, "ioctl");
+	if (root && *root &&
+			snprintf(dev_dir, sizeof(dev_dir), "%s/dev/", root)
+			< (int)sizeof(dev_dir))
+		dev_len = strlen(dev_dir);
+}
+
+/* @return 0 and the path below <root>/dev if @fd is a simulated node */
+static int sim_node(int fd, char *node, size_t size)
+{
+	char link[32], path[PATH_MAX];
+	ssize_t n;
+
+	snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+	n = readlink(link, path, sizeof(path) - 1);
+	if (n <= (ssize_t)dev_len)
+		return -1;
+	path[n] = 0;
+	if (strncmp(path, dev_dir, dev_len) != 0)
+		return -1;
+	snprintf(node, size, "%s", path + dev_len);
+	return 0;
+}
+
+static int sim_connect(void)
+{
+	struct sockaddr_un addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (snprintf(addr.sun_path, sizeof(addr.sun_path), "%.*s%s",
+			(int)(sizeof(addr.sun_path) - 1), dev_dir,
+			INPUT_SIM_IOCTL_SOCK) >= (int)sizeof(addr.sun_path))
+		return -1;
+	sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (sock < 0)
+		return -1;
+	if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(sock);
+		sock = -1;
+		return -1;
+	}
+	return 0;
+}
+
+static int sim_ioctl(const char *node, ioctl_req_t req, void *arg)
+{
+	struct input_sim_ioctl_req rq;
+	struct input_sim_ioctl_rsp rsp;
+	uint32_t size = _IOC_SIZE((uint32_t)req);
+	ssize_t n;
+
+	memset(&rq, 0, sizeof(rq));
+	snprintf(rq.node, sizeof(rq.node), "%s", node);
+	rq.cmd = (uint32_t)req;
+	if (arg && size) {
+		rq.len = size < INPUT_SIM_ARG_LEN ? size : INPUT_SIM_ARG_LEN;
+		memcpy(rq.arg, arg, rq.len);
+	}
+
+	pthread_mutex_lock(&lock);
+	if (sock < 0 && sim_connect() < 0) {
+		pthread_mutex_unlock(&lock);
+		errno = ENOTTY;
+		return -1;
+	}
+	n = send(sock, &rq, sizeof(rq), MSG_NOSIGNAL);
+	if (n == (ssize_t)sizeof(rq))
+		n = recv(sock, &rsp, sizeof(rsp), 0);
+	if (n != (ssize_t)sizeof(rsp)) {
+		/* the simulator went away; reconnect next time */
+		close(sock);
+		sock = -1;
+		pthread_mutex_unlock(&lock);
+		errno = ENOTTY;
+		return -1;
+	}
+	pthread_mutex_unlock(&lock);
+
+	if (arg && rsp.len)
+		memcpy(arg, rsp.arg, rsp.len < size ? rsp.len : size);
+	if (rsp.ret < 0) {
+		errno = -rsp.ret;
+		return -1;
+	}
+	return rsp.ret;
+}
+
+int ioctl(int fd, ioctl_req_t req, ...)
+{
+	char node[INPUT_SIM_NODE_LEN];
+	va_list ap;
+	void *arg;
+
+	va_start(ap, req);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+
+	pthread_once(&once, init);
+	if (dev_len && sim_node(fd, node, sizeof(node)) == 0)
+		return sim_ioctl(node, req, arg);
+	return real_ioctl(fd, req, arg);
+}